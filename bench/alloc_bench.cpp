@@ -0,0 +1,144 @@
+#include "../includes/compose/blend.hpp"
+#include "../includes/ffmpeg/handles.hpp"
+#include "../includes/pipeline/frame_allocator.hpp"
+#include "bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace {
+/** The width of the allocated frames. */
+const int FRAME_WIDTH = 1920;
+/** The height of the allocated frames. */
+const int FRAME_HEIGHT = 1080;
+
+/**
+ * @brief Huge pages backing the current process, from
+ * /proc/self/smaps_rollup.
+ */
+struct HugePageCounters {
+  std::uint64_t transparent_kb = 0; /**< AnonHugePages. */
+  std::uint64_t reserved_kb = 0;    /**< Private_Hugetlb. */
+};
+
+/**
+ * @brief Reads the huge page counters of the current process.
+ */
+HugePageCounters read_huge_pages() {
+  HugePageCounters counters;
+  std::ifstream smaps_file("/proc/self/smaps_rollup");
+  std::string line;
+  while (std::getline(smaps_file, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    std::uint64_t value = 0;
+    fields >> key >> value;
+    if (key == "AnonHugePages:") {
+      counters.transparent_kb = value;
+    } else if (key == "Private_Hugetlb:") {
+      counters.reserved_kb = value;
+    }
+  }
+  return counters;
+}
+
+/**
+ * @brief Allocates a YUV420P frame and writes every sample, as a decoder
+ * would.
+ */
+ffmpeg::FramePtr decoded_frame(pipeline::FrameAllocator &allocator,
+                               int value) {
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  frame->format = AV_PIX_FMT_YUV420P;
+  frame->width = FRAME_WIDTH;
+  frame->height = FRAME_HEIGHT;
+  if (!allocator.get_buffer(frame.get())) {
+    return nullptr;
+  }
+  for (int plane = 0; plane < 3; ++plane) {
+    const int rows = plane == 0 ? FRAME_HEIGHT : FRAME_HEIGHT / 2;
+    std::memset(frame->data[plane], value + plane,
+                static_cast<std::size_t>(frame->linesize[plane]) * rows);
+  }
+  return frame;
+}
+} // namespace
+
+int bench::run_alloc_bench(const std::vector<std::string> &args) {
+  const int count = args.size() > 0 ? std::stoi(args[0]) : 300;
+  const int in_flight = std::max(2, args.size() > 1 ? std::stoi(args[1]) : 16);
+  const simd::Kernels &kernels =
+      simd::kernels_for(simd::detect_cpu_level());
+
+  std::cout << "Allocating " << count << " " << FRAME_WIDTH << "x"
+            << FRAME_HEIGHT << " YUV420P frames with " << in_flight
+            << " in flight, on NUMA node " << pipeline::current_numa_node()
+            << std::endl;
+  std::printf("%-8s %12s %12s %10s %10s %10s\n", "pages", "cold ms/f",
+              "steady ms/f", "mapped", "thp", "hugetlb");
+
+  for (pipeline::PageMode mode :
+       {pipeline::PageMode::Default, pipeline::PageMode::Transparent,
+        pipeline::PageMode::Explicit}) {
+    pipeline::FrameAllocator allocator(mode);
+    const HugePageCounters before = read_huge_pages();
+
+    // STEP 1: Fill the pipeline. Every buffer is new, so this pays for the
+    // page faults.
+    std::deque<ffmpeg::FramePtr> frames;
+    Stopwatch cold;
+    for (int i = 0; i < in_flight; ++i) {
+      frames.push_back(decoded_frame(allocator, i));
+    }
+    const double cold_ms = 1000.0 * cold.seconds() / in_flight;
+    bool allocated = true;
+    for (const ffmpeg::FramePtr &frame : frames) {
+      allocated = allocated && frame;
+    }
+    if (!allocated) {
+      std::cerr << "Failed to allocate " << pipeline::page_mode_name(mode)
+                << " frames" << std::endl;
+      continue;
+    }
+
+    // STEP 2: Steady state: retire the oldest frame, decode a new one into
+    // a recycled buffer and crossfade it with the one before
+    Stopwatch steady;
+    for (int i = 0; i < count; ++i) {
+      frames.pop_front();
+      ffmpeg::FramePtr frame = decoded_frame(allocator, i);
+      compose::mix_frames(frames.back().get(), frames.front().get(),
+                          frame.get(), i % 256, kernels);
+      frames.push_back(std::move(frame));
+    }
+    const double steady_ms = 1000.0 * steady.seconds() / count;
+
+    // STEP 3: Report how the buffers are backed
+    const HugePageCounters after = read_huge_pages();
+    std::printf("%-8s %12.3f %12.3f %9.1fM %9.1fM %9.1fM\n",
+                pipeline::page_mode_name(mode), cold_ms, steady_ms,
+                allocator.mapped_bytes() / (1024.0 * 1024.0),
+                (static_cast<double>(after.transparent_kb) -
+                 before.transparent_kb) / 1024.0,
+                (static_cast<double>(after.reserved_kb) - before.reserved_kb) /
+                    1024.0);
+    if (allocator.fallbacks() > 0) {
+      std::cout << "  " << allocator.fallbacks()
+                << " buffers fell back to thp, reserve pages in "
+                   "/proc/sys/vm/nr_hugepages"
+                << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,240 @@
+#ifndef GAMEFLIX_BENCH
+#define GAMEFLIX_BENCH
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace bench {
+/**
+ * @brief The corpus file used when a suite is given no input.
+ */
+std::string default_corpus_file();
+
+/**
+ * @brief The directory the synthetic corpus is generated into when a suite
+ * is given none.
+ */
+std::string default_corpus_dir();
+
+/**
+ * @brief One clip of the synthetic corpus.
+ */
+struct ClipSpec {
+  std::string codec = "h264"; /**< "h264", "hevc" or "vp9". */
+  int width = 1280;           /**< The width in pixels. */
+  int height = 720;           /**< The height in pixels. */
+  int fps = 30;               /**< The frame rate. */
+  int gop_frames = 60;        /**< The frames between keyframes. */
+  int b_frames = 0;           /**< The most consecutive B-frames. */
+  bool ten_bit = false;       /**< Whether samples are 10 bits wide. */
+  double seconds = 2.0;       /**< The duration. */
+};
+
+/**
+ * @brief Gets the file name of a corpus clip, which spells out its spec.
+ * @param clip The clip.
+ * @return The name, e.g. "h264_1280x720_30fps_gop60_b0_8bit_2s.mkv".
+ */
+std::string clip_filename(const ClipSpec &clip);
+
+/**
+ * @brief Lists the clips of a corpus preset.
+ * @param preset "quick" for 720p and 1080p clips of one GOP structure, or
+ * "full" for 720p to 2160p clips of short and long GOPs.
+ * @return The clips.
+ * @throws std::invalid_argument If the preset is not known.
+ */
+std::vector<ClipSpec> corpus_matrix(const std::string &preset);
+
+/**
+ * @brief Encodes a clip of a deterministic test pattern, so every run of a
+ * suite reads the same bitstream.
+ * @param clip The clip.
+ * @param path The path to write the clip to, a Matroska file.
+ * @return `true` if the clip was written, `false` if its encoder is missing
+ * or failed.
+ */
+bool generate_clip(const ClipSpec &clip, const std::string &path);
+
+/**
+ * @brief Generates the clips of a preset that are not in a directory yet.
+ * @param dir The directory.
+ * @param preset The preset (see corpus_matrix()).
+ * @return The paths to the clips that exist.
+ */
+std::vector<std::string> ensure_corpus(const std::string &dir,
+                                       const std::string &preset);
+
+/**
+ * @brief Read syscall counters of the current process from /proc/self/io.
+ */
+struct IoCounters {
+  std::uint64_t read_syscalls = 0; /**< The number of read syscalls. */
+  std::uint64_t read_bytes = 0;    /**< The number of bytes read. */
+};
+
+/**
+ * @brief Reads the I/O counters of the current process.
+ * @return The counters, all zero if /proc/self/io is not available.
+ */
+IoCounters read_io_counters();
+
+/**
+ * @brief Monotonic stopwatch.
+ */
+class Stopwatch {
+public:
+  /**
+   * @brief Constructs a Stopwatch object and starts it.
+   */
+  Stopwatch();
+
+  /**
+   * @brief Gets the time since the stopwatch was started.
+   * @return The elapsed time in seconds.
+   */
+  double seconds() const;
+
+private:
+  std::chrono::steady_clock::time_point start_; /**< When it was started. */
+};
+
+/**
+ * @brief Decodes the first frames of a video.
+ * @param path The path to the video.
+ * @param count The maximum number of frames to decode.
+ * @return The decoded frames, owned by the caller (see free_frames()).
+ */
+std::vector<AVFrame *> decode_video_frames(const std::string &path,
+                                           int count);
+
+/**
+ * @brief Frees frames returned by decode_video_frames().
+ * @param frames The frames to free. The vector is cleared.
+ */
+void free_frames(std::vector<AVFrame *> &frames);
+
+/**
+ * @brief Computes the PSNR between two 8-bit planes.
+ * @param a The first plane.
+ * @param a_stride The line size of the first plane.
+ * @param b The second plane.
+ * @param b_stride The line size of the second plane.
+ * @param width The width of the planes.
+ * @param height The height of the planes.
+ * @return The PSNR in dB, 100 for identical planes.
+ */
+double psnr(const std::uint8_t *a, int a_stride, const std::uint8_t *b,
+            int b_stride, int width, int height);
+
+/**
+ * @brief Computes the mean SSIM between two 8-bit planes over 8x8 windows.
+ * @param a The first plane.
+ * @param a_stride The line size of the first plane.
+ * @param b The second plane.
+ * @param b_stride The line size of the second plane.
+ * @param width The width of the planes.
+ * @param height The height of the planes.
+ * @return The SSIM, 1 for identical planes.
+ */
+double ssim(const std::uint8_t *a, int a_stride, const std::uint8_t *b,
+            int b_stride, int width, int height);
+
+/**
+ * @brief Compares allocating, first touching and blending 1080p frames on
+ * default pages, transparent huge pages and reserved huge pages.
+ * @param args The suite arguments: [frames] [in_flight].
+ * @return The process exit code.
+ */
+int run_alloc_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Generates the synthetic corpus.
+ * @param args The suite arguments: [output_dir] [preset].
+ * @return The process exit code, 1 if no clip could be generated.
+ */
+int run_corpus_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Round-trips the first frames of every clip of the synthetic
+ * corpus through each intermediate format, generating the missing clips
+ * first, and compares their encode and decode speed and size.
+ * @param args The suite arguments: [corpus_dir] [preset] [frames].
+ * @return The process exit code, 1 if there are no clips or a format is
+ * not lossless.
+ */
+int run_intermediate_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Compares the input modes of the I/O layer.
+ * @param args The suite arguments: [video_path] [runs].
+ * @return The process exit code.
+ */
+int run_io_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Measures the decode throughput and the interleave and vertical
+ * job throughput of every clip of the synthetic corpus, generating the
+ * missing clips first.
+ * @param args The suite arguments: [corpus_dir] [preset].
+ * @return The process exit code, 1 if there are no clips.
+ */
+int run_matrix_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Measures how the throughput of the task scheduler scales with its
+ * workers, and how fairly it shares them between two jobs.
+ * @param args The suite arguments: [frames] [max_workers].
+ * @return The process exit code.
+ */
+int run_sched_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Compares the speed and quality of the scaler algorithms.
+ * @param args The suite arguments: [video_path] [frames].
+ * @return The process exit code.
+ */
+int run_scaler_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Sweeps the decoder threads, encoder threads and scheduler workers
+ * over 1, 2, 4... threads, each configuration in its own process, and
+ * writes the decode, encode and job throughput with their speedup and
+ * parallel efficiency and the peak RSS as CSV.
+ * @param args The suite arguments: [video_path] [max_threads] [seconds]
+ * [csv_path].
+ * @return The process exit code, 1 if a configuration failed.
+ */
+int run_scaling_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Times the SIMD kernels at every supported CPU level, checks them
+ * bit for bit against the scalar kernels and compares them with swscale.
+ * @param args The suite arguments: [video_path] [frames].
+ * @return The process exit code, 1 if a level differs from scalar.
+ */
+int run_simd_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Times the 1080p crossfade, constant-alpha and alpha-over blends at
+ * every supported CPU level and checks them against the scalar kernels.
+ * @param args The suite arguments: [frames].
+ * @return The process exit code, 1 if a level differs from scalar.
+ */
+int run_blend_bench(const std::vector<std::string> &args);
+
+/**
+ * @brief Compares composing a vertical layout in one pass with rescaling
+ * every source to 1920x1080 first.
+ * @param args The suite arguments: [video_path] [frames].
+ * @return The process exit code.
+ */
+int run_compose_bench(const std::vector<std::string> &args);
+} // namespace bench
+#endif
@@ -0,0 +1,141 @@
+#include "../includes/compose/blend.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace {
+/** The width of the blended frames. */
+const int FRAME_WIDTH = 1920;
+/** The height of the blended frames. */
+const int FRAME_HEIGHT = 1080;
+/** The per-frame time the blends are expected to stay under, in ms. */
+const double TARGET_MS = 1.0;
+
+/**
+ * @brief Allocates a frame filled with random samples.
+ */
+AVFrame *random_frame(AVPixelFormat format, std::mt19937 &random) {
+  AVFrame *frame = av_frame_alloc();
+  frame->format = format;
+  frame->width = FRAME_WIDTH;
+  frame->height = FRAME_HEIGHT;
+  av_frame_get_buffer(frame, 32);
+  const int planes = format == AV_PIX_FMT_YUVA420P ? 4 : 3;
+  for (int plane = 0; plane < planes; ++plane) {
+    const int shift = plane == 1 || plane == 2 ? 1 : 0;
+    for (int y = 0; y < FRAME_HEIGHT >> shift; ++y) {
+      std::uint8_t *row = frame->data[plane] + y * frame->linesize[plane];
+      for (int x = 0; x < FRAME_WIDTH >> shift; ++x) {
+        row[x] = static_cast<std::uint8_t>(random());
+      }
+    }
+  }
+  return frame;
+}
+
+/**
+ * @brief Copies the visible samples of a YUV420P frame into a buffer.
+ */
+std::vector<std::uint8_t> frame_samples(const AVFrame *frame) {
+  std::vector<std::uint8_t> samples;
+  for (int plane = 0; plane < 3; ++plane) {
+    const int shift = plane == 0 ? 0 : 1;
+    for (int y = 0; y < frame->height >> shift; ++y) {
+      const std::uint8_t *row = frame->data[plane] + y * frame->linesize[plane];
+      samples.insert(samples.end(), row, row + (frame->width >> shift));
+    }
+  }
+  return samples;
+}
+} // namespace
+
+int bench::run_blend_bench(const std::vector<std::string> &args) {
+  const int count = args.size() > 0 ? std::stoi(args[0]) : 200;
+
+  // STEP 1: Random frames, so no blend can take a shortcut
+  std::mt19937 random(42);
+  AVFrame *base = random_frame(AV_PIX_FMT_YUV420P, random);
+  AVFrame *top = random_frame(AV_PIX_FMT_YUV420P, random);
+  AVFrame *top_alpha = random_frame(AV_PIX_FMT_YUVA420P, random);
+  AVFrame *canvas = random_frame(AV_PIX_FMT_YUV420P, random);
+  const compose::Rect full = {0, 0, FRAME_WIDTH, FRAME_HEIGHT};
+
+  const std::vector<std::pair<const char *,
+                              std::function<void(const simd::Kernels &, int)>>>
+      blends = {
+          {"crossfade",
+           [&](const simd::Kernels &kernels, int i) {
+             compose::mix_frames(top, base, canvas, i % 256, kernels);
+           }},
+          {"constant-alpha",
+           [&](const simd::Kernels &kernels, int) {
+             compose::blend_over(top, canvas, full, 96, kernels);
+           }},
+          {"alpha-over",
+           [&](const simd::Kernels &kernels, int) {
+             compose::blend_over(top_alpha, canvas, full, 200, kernels);
+           }},
+      };
+
+  const simd::CpuLevel detected = simd::detect_cpu_level();
+  std::cout << "Blending " << count << " " << FRAME_WIDTH << "x"
+            << FRAME_HEIGHT << " YUV420P frames on one core, CPU level "
+            << simd::cpu_level_name(detected) << ", target < " << TARGET_MS
+            << " ms/frame" << std::endl;
+  std::printf("%-16s %-8s %10s %10s\n", "blend", "level", "ms/frame",
+              "exact");
+
+  bool all_exact = true;
+  for (const auto &blend : blends) {
+    // STEP 2: The scalar result of the first iterations is the reference
+    av_frame_copy(canvas, base);
+    for (int i = 0; i < 3; ++i) {
+      blend.second(simd::scalar::KERNELS, i);
+    }
+    const std::vector<std::uint8_t> reference = frame_samples(canvas);
+
+    // STEP 3: Check and time every supported level
+    for (simd::CpuLevel level :
+         {simd::CpuLevel::Scalar, simd::CpuLevel::Avx2,
+          simd::CpuLevel::Avx512}) {
+      if (level > detected) {
+        continue;
+      }
+      const simd::Kernels &kernels = simd::kernels_for(level);
+      av_frame_copy(canvas, base);
+      for (int i = 0; i < 3; ++i) {
+        blend.second(kernels, i);
+      }
+      const bool exact = frame_samples(canvas) == reference;
+      all_exact = all_exact && exact;
+
+      Stopwatch stopwatch;
+      for (int i = 0; i < count; ++i) {
+        blend.second(kernels, i);
+      }
+      std::printf("%-16s %-8s %10.3f %10s\n", blend.first,
+                  simd::cpu_level_name(level),
+                  1000.0 * stopwatch.seconds() / count, exact ? "yes" : "NO");
+    }
+  }
+
+  // STEP 4: Cleanup
+  av_frame_free(&canvas);
+  av_frame_free(&top_alpha);
+  av_frame_free(&top);
+  av_frame_free(&base);
+  if (!all_exact) {
+    std::cerr << "SIMD blends differ from the scalar blends" << std::endl;
+    return 1;
+  }
+  return 0;
+}
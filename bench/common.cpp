@@ -0,0 +1,148 @@
+#include "bench.hpp"
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+std::vector<AVFrame *> bench::decode_video_frames(const std::string &path,
+                                                  int count) {
+  std::vector<AVFrame *> frames;
+
+  // STEP 1: Open the video and its decoder
+  AVFormatContext *format_context = nullptr;
+  if (avformat_open_input(&format_context, path.c_str(), nullptr, nullptr) !=
+      0) {
+    std::cerr << "Failed to open " << path << std::endl;
+    return frames;
+  }
+  if (avformat_find_stream_info(format_context, nullptr) < 0) {
+    avformat_close_input(&format_context);
+    return frames;
+  }
+
+  const AVCodec *codec = nullptr;
+  const int stream_index = av_find_best_stream(
+      format_context, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+  if (stream_index < 0 || !codec) {
+    avformat_close_input(&format_context);
+    return frames;
+  }
+
+  AVCodecContext *codec_context = avcodec_alloc_context3(codec);
+  if (!codec_context ||
+      avcodec_parameters_to_context(
+          codec_context, format_context->streams[stream_index]->codecpar) < 0 ||
+      avcodec_open2(codec_context, codec, nullptr) < 0) {
+    avcodec_free_context(&codec_context);
+    avformat_close_input(&format_context);
+    return frames;
+  }
+
+  // STEP 2: Decode until enough frames were collected
+  AVPacket *packet = av_packet_alloc();
+  AVFrame *frame = av_frame_alloc();
+  bool draining = false;
+  while (static_cast<int>(frames.size()) < count) {
+    if (!draining) {
+      if (av_read_frame(format_context, packet) < 0) {
+        draining = true;
+        avcodec_send_packet(codec_context, nullptr);
+      } else if (packet->stream_index == stream_index) {
+        avcodec_send_packet(codec_context, packet);
+      }
+      av_packet_unref(packet);
+    }
+
+    int received = 0;
+    while (static_cast<int>(frames.size()) < count &&
+           (received = avcodec_receive_frame(codec_context, frame)) == 0) {
+      frames.push_back(av_frame_clone(frame));
+      av_frame_unref(frame);
+    }
+    if (draining && received != 0) {
+      break;
+    }
+  }
+
+  // STEP 3: Cleanup
+  av_frame_free(&frame);
+  av_packet_free(&packet);
+  avcodec_free_context(&codec_context);
+  avformat_close_input(&format_context);
+
+  return frames;
+}
+
+void bench::free_frames(std::vector<AVFrame *> &frames) {
+  for (AVFrame *&frame : frames) {
+    av_frame_free(&frame);
+  }
+  frames.clear();
+}
+
+double bench::psnr(const std::uint8_t *a, int a_stride, const std::uint8_t *b,
+                   int b_stride, int width, int height) {
+  double squared_error = 0.0;
+  for (int y = 0; y < height; ++y) {
+    const std::uint8_t *a_row = a + static_cast<std::ptrdiff_t>(y) * a_stride;
+    const std::uint8_t *b_row = b + static_cast<std::ptrdiff_t>(y) * b_stride;
+    for (int x = 0; x < width; ++x) {
+      const double difference = a_row[x] - b_row[x];
+      squared_error += difference * difference;
+    }
+  }
+
+  const double mse = squared_error / (static_cast<double>(width) * height);
+  if (mse == 0.0) {
+    return 100.0;
+  }
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+double bench::ssim(const std::uint8_t *a, int a_stride, const std::uint8_t *b,
+                   int b_stride, int width, int height) {
+  static const int WINDOW = 8;
+  static const int STEP = 4;
+  static const double C1 = (0.01 * 255) * (0.01 * 255);
+  static const double C2 = (0.03 * 255) * (0.03 * 255);
+
+  double total = 0.0;
+  int windows = 0;
+  for (int y = 0; y + WINDOW <= height; y += STEP) {
+    for (int x = 0; x + WINDOW <= width; x += STEP) {
+      // STEP 1: Gather the window statistics
+      double sum_a = 0, sum_b = 0, sum_aa = 0, sum_bb = 0, sum_ab = 0;
+      for (int j = 0; j < WINDOW; ++j) {
+        const std::uint8_t *a_row =
+            a + static_cast<std::ptrdiff_t>(y + j) * a_stride + x;
+        const std::uint8_t *b_row =
+            b + static_cast<std::ptrdiff_t>(y + j) * b_stride + x;
+        for (int i = 0; i < WINDOW; ++i) {
+          sum_a += a_row[i];
+          sum_b += b_row[i];
+          sum_aa += a_row[i] * a_row[i];
+          sum_bb += b_row[i] * b_row[i];
+          sum_ab += a_row[i] * b_row[i];
+        }
+      }
+
+      // STEP 2: Compute the SSIM of the window
+      const double n = WINDOW * WINDOW;
+      const double mean_a = sum_a / n;
+      const double mean_b = sum_b / n;
+      const double var_a = sum_aa / n - mean_a * mean_a;
+      const double var_b = sum_bb / n - mean_b * mean_b;
+      const double covariance = sum_ab / n - mean_a * mean_b;
+      const double luminance = mean_a * mean_a + mean_b * mean_b + C1;
+      total += ((2 * mean_a * mean_b + C1) * (2 * covariance + C2)) /
+               (luminance * (var_a + var_b + C2));
+      windows += 1;
+    }
+  }
+
+  return windows > 0 ? total / windows : 1.0;
+}
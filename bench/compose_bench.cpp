@@ -0,0 +1,110 @@
+#include "../includes/compose/compositor.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+/** The width of the full-frame intermediate of the two-pass path. */
+const int INTERMEDIATE_WIDTH = 1920;
+/** The height of the full-frame intermediate of the two-pass path. */
+const int INTERMEDIATE_HEIGHT = 1080;
+
+AVFrame *allocate_yuv_frame(int width, int height) {
+  AVFrame *frame = av_frame_alloc();
+  frame->format = AV_PIX_FMT_YUV420P;
+  frame->width = width;
+  frame->height = height;
+  av_frame_get_buffer(frame, 32);
+  return frame;
+}
+
+/**
+ * @brief Composes the way the Combiner did before the compositor: every
+ * source is rescaled to 1920x1080 first, then cropped and scaled into its
+ * region.
+ */
+void compose_two_pass(const compose::Layout &layout,
+                      const std::vector<AVFrame *> &sources,
+                      AVFrame *intermediate, compose::Compositor &compositor,
+                      AVFrame *canvas) {
+  compose::Compositor::clear(canvas);
+  for (std::size_t index = 0; index < layout.regions.size(); ++index) {
+    const compose::Region &region = layout.regions[index];
+    const AVFrame *source = sources[region.source];
+    SwsContext *sws_context = sws_getContext(
+        source->width, source->height,
+        static_cast<AVPixelFormat>(source->format), intermediate->width,
+        intermediate->height, AV_PIX_FMT_YUV420P, SWS_BICUBIC, nullptr,
+        nullptr, nullptr);
+    sws_scale(sws_context, source->data, source->linesize, 0, source->height,
+              intermediate->data, intermediate->linesize);
+    sws_freeContext(sws_context);
+
+    const compose::Rect src_rect = compose::fill_crop(
+        intermediate->width, intermediate->height, region.rect);
+    compositor.place(index, intermediate, src_rect, canvas, region.rect);
+  }
+}
+} // namespace
+
+int bench::run_compose_bench(const std::vector<std::string> &args) {
+  const std::string path = args.size() > 0 ? args[0] : default_corpus_file();
+  const int count = args.size() > 1 ? std::stoi(args[1]) : 60;
+
+  // STEP 1: Decode the source frames once. Both regions show the same
+  // video, offset by half the frames.
+  std::vector<AVFrame *> frames = decode_video_frames(path, count);
+  if (frames.size() < 2) {
+    std::cerr << "Failed to decode " << path << std::endl;
+    return 1;
+  }
+
+  const compose::Layout layout = compose::Layout::vertical_stack(2);
+  AVFrame *canvas = allocate_yuv_frame(layout.width, layout.height);
+  AVFrame *intermediate =
+      allocate_yuv_frame(INTERMEDIATE_WIDTH, INTERMEDIATE_HEIGHT);
+  const std::size_t half = frames.size() / 2;
+
+  std::cout << "Composing " << half << " " << layout.width << "x"
+            << layout.height << " frames from two " << frames[0]->width
+            << "x" << frames[0]->height << " sources of " << path
+            << std::endl;
+  std::printf("%-10s %12s %22s\n", "path", "ms/frame", "intermediate bytes");
+
+  // STEP 2: Fused crop-scale-place
+  compose::Compositor compositor;
+  Stopwatch fused_stopwatch;
+  for (std::size_t i = 0; i < half; ++i) {
+    compositor.compose(layout, {frames[i], frames[i + half]}, canvas);
+  }
+  const double fused_seconds = fused_stopwatch.seconds();
+  std::printf("%-10s %12.3f %22d\n", "fused", 1000.0 * fused_seconds / half,
+              0);
+
+  // STEP 3: Full-frame rescale first, then crop and place
+  Stopwatch two_pass_stopwatch;
+  for (std::size_t i = 0; i < half; ++i) {
+    compose_two_pass(layout, {frames[i], frames[i + half]}, intermediate,
+                     compositor, canvas);
+  }
+  const double two_pass_seconds = two_pass_stopwatch.seconds();
+  std::printf("%-10s %12.3f %22d\n", "two-pass",
+              1000.0 * two_pass_seconds / half,
+              av_image_get_buffer_size(AV_PIX_FMT_YUV420P, INTERMEDIATE_WIDTH,
+                                       INTERMEDIATE_HEIGHT, 1) *
+                  static_cast<int>(layout.regions.size()));
+
+  // STEP 4: Cleanup
+  av_frame_free(&intermediate);
+  av_frame_free(&canvas);
+  free_frames(frames);
+  return 0;
+}
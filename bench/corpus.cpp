@@ -0,0 +1,310 @@
+#include "../includes/ffmpeg/handles.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+}
+
+namespace {
+/** The seed of the grain, so every run writes the same frames. */
+const std::uint32_t GRAIN_SEED = 0x9e3779b9u;
+/** The bits per pixel of the corpus clips, before scaling by frame rate. */
+const double BITS_PER_PIXEL = 0.1;
+
+/**
+ * @brief Finds the encoder of a corpus codec, preferring the encoders that
+ * produce the streams real captures use.
+ */
+const AVCodec *find_encoder(const std::string &codec) {
+  const char *name = nullptr;
+  AVCodecID id = AV_CODEC_ID_NONE;
+  if (codec == "h264") {
+    name = "libx264";
+    id = AV_CODEC_ID_H264;
+  } else if (codec == "hevc") {
+    name = "libx265";
+    id = AV_CODEC_ID_HEVC;
+  } else if (codec == "vp9") {
+    name = "libvpx-vp9";
+    id = AV_CODEC_ID_VP9;
+  } else {
+    return nullptr;
+  }
+
+  if (const AVCodec *encoder = avcodec_find_encoder_by_name(name)) {
+    return encoder;
+  }
+  return avcodec_find_encoder(id);
+}
+
+/**
+ * @brief Trades quality for speed, so a full corpus takes minutes, not
+ * hours. The frames stay the same either way.
+ */
+void set_fast_options(AVCodecContext *codec_context, const AVCodec *encoder) {
+  const std::string name = encoder->name;
+  if (name == "libx264") {
+    av_opt_set(codec_context->priv_data, "preset", "veryfast", 0);
+  } else if (name == "libx265") {
+    av_opt_set(codec_context->priv_data, "preset", "ultrafast", 0);
+    av_opt_set(codec_context->priv_data, "x265-params", "log-level=error", 0);
+  } else if (name == "libvpx-vp9") {
+    av_opt_set(codec_context->priv_data, "deadline", "realtime", 0);
+    av_opt_set_int(codec_context->priv_data, "cpu-used", 8, 0);
+    av_opt_set_int(codec_context->priv_data, "row-mt", 1, 0);
+  }
+}
+
+/**
+ * @brief Draws frame `index` of the test pattern: a scrolling diagonal
+ * gradient with a bouncing box over deterministic grain, so the encoders
+ * see motion, edges and texture.
+ */
+void draw_pattern(AVFrame *frame, int index, bool ten_bit) {
+  const int shift = ten_bit ? 2 : 0;
+  const int box_size = frame->height / 6;
+  const int period = 2 * (frame->width - box_size);
+  int box_x = (index * 8) % period;
+  box_x = box_x < period / 2 ? box_x : period - box_x;
+  const int box_y = (frame->height - box_size) / 2;
+  std::uint32_t grain = GRAIN_SEED ^ static_cast<std::uint32_t>(index);
+
+  // Writes one sample, 8 or 10 bits wide
+  auto put = [ten_bit, shift](std::uint8_t *row, int x, int value) {
+    if (ten_bit) {
+      reinterpret_cast<std::uint16_t *>(row)[x] =
+          static_cast<std::uint16_t>(value << shift);
+    } else {
+      row[x] = static_cast<std::uint8_t>(value);
+    }
+  };
+
+  // STEP 1: Luma: the gradient, the box and the grain
+  for (int y = 0; y < frame->height; ++y) {
+    std::uint8_t *row = frame->data[0] + y * frame->linesize[0];
+    const bool box_row = y >= box_y && y < box_y + box_size;
+    for (int x = 0; x < frame->width; ++x) {
+      grain ^= grain << 13;
+      grain ^= grain >> 17;
+      grain ^= grain << 5;
+      int value = 16 + ((x + y + 4 * index) & 0x7f) + (grain & 0x0f);
+      if (box_row && x >= box_x && x < box_x + box_size) {
+        value = 235;
+      }
+      put(row, x, value);
+    }
+  }
+
+  // STEP 2: Chroma: slow horizontal and vertical ramps
+  for (int plane = 1; plane < 3; ++plane) {
+    for (int y = 0; y < (frame->height + 1) / 2; ++y) {
+      std::uint8_t *row = frame->data[plane] + y * frame->linesize[plane];
+      for (int x = 0; x < (frame->width + 1) / 2; ++x) {
+        const int ramp = plane == 1 ? x + index : y + index;
+        put(row, x, 64 + (ramp & 0x7f));
+      }
+    }
+  }
+}
+
+/**
+ * @brief Sends a frame, or `nullptr` to drain, and writes the packets the
+ * encoder returns.
+ */
+bool encode_and_write(AVCodecContext *codec_context, AVStream *stream,
+                      AVFormatContext *format_context, const AVFrame *frame,
+                      AVPacket *packet) {
+  if (avcodec_send_frame(codec_context, frame) < 0) {
+    return false;
+  }
+  while (avcodec_receive_packet(codec_context, packet) == 0) {
+    av_packet_rescale_ts(packet, codec_context->time_base, stream->time_base);
+    packet->stream_index = stream->index;
+    if (av_interleaved_write_frame(format_context, packet) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+std::string bench::clip_filename(const ClipSpec &clip) {
+  char name[128];
+  std::snprintf(name, sizeof(name), "%s_%dx%d_%dfps_gop%d_b%d_%s_%gs.mkv",
+                clip.codec.c_str(), clip.width, clip.height, clip.fps,
+                clip.gop_frames, clip.b_frames,
+                clip.ten_bit ? "10bit" : "8bit", clip.seconds);
+  return name;
+}
+
+std::vector<bench::ClipSpec>
+bench::corpus_matrix(const std::string &preset) {
+  // STEP 1: The axes of the preset
+  std::vector<std::pair<int, int>> sizes;
+  std::vector<int> frame_rates = {30, 60};
+  std::vector<std::string> codecs = {"h264", "hevc", "vp9"};
+  // The keyframe interval in seconds and the B-frames: streaming-style
+  // short GOPs with B-frames, and capture-style long GOPs without
+  std::vector<std::pair<double, int>> gops;
+  double seconds = 2.0;
+  if (preset == "quick") {
+    sizes = {{1280, 720}, {1920, 1080}};
+    gops = {{2.0, 2}};
+  } else if (preset == "full") {
+    sizes = {{1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+    gops = {{1.0, 3}, {10.0, 0}};
+    seconds = 4.0;
+  } else {
+    throw std::invalid_argument("Unknown corpus preset: " + preset);
+  }
+
+  // STEP 2: Every combination, with 10-bit variants of the codecs that
+  // carry 10-bit in practice
+  std::vector<ClipSpec> clips;
+  for (const std::pair<int, int> &size : sizes) {
+    for (int fps : frame_rates) {
+      for (const std::string &codec : codecs) {
+        for (const std::pair<double, int> &gop : gops) {
+          for (bool ten_bit : {false, true}) {
+            if (ten_bit && codec == "h264") {
+              continue;
+            }
+            ClipSpec clip;
+            clip.codec = codec;
+            clip.width = size.first;
+            clip.height = size.second;
+            clip.fps = fps;
+            clip.gop_frames = static_cast<int>(gop.first * fps);
+            clip.b_frames = gop.second;
+            clip.ten_bit = ten_bit;
+            clip.seconds = seconds;
+            clips.push_back(clip);
+          }
+        }
+      }
+    }
+  }
+  return clips;
+}
+
+bool bench::generate_clip(const ClipSpec &clip, const std::string &path) {
+  // STEP 1: Find and configure the encoder
+  const AVCodec *encoder = find_encoder(clip.codec);
+  if (!encoder) {
+    std::cerr << "No " << clip.codec << " encoder, skipping "
+              << clip_filename(clip) << std::endl;
+    return false;
+  }
+  ffmpeg::CodecContextPtr codec_context(avcodec_alloc_context3(encoder));
+  if (!codec_context) {
+    return false;
+  }
+  codec_context->width = clip.width;
+  codec_context->height = clip.height;
+  codec_context->time_base = {1, clip.fps};
+  codec_context->framerate = {clip.fps, 1};
+  codec_context->pix_fmt =
+      clip.ten_bit ? AV_PIX_FMT_YUV420P10LE : AV_PIX_FMT_YUV420P;
+  codec_context->gop_size = clip.gop_frames;
+  codec_context->max_b_frames = clip.b_frames;
+  codec_context->bit_rate = static_cast<int64_t>(
+      BITS_PER_PIXEL * clip.width * clip.height * clip.fps);
+  set_fast_options(codec_context.get(), encoder);
+
+  // STEP 2: Open the output file, its stream and the encoder
+  AVFormatContext *raw_format_context = nullptr;
+  if (avformat_alloc_output_context2(&raw_format_context, nullptr, nullptr,
+                                     path.c_str()) < 0) {
+    std::cerr << "Failed to allocate the output of " << path << std::endl;
+    return false;
+  }
+  ffmpeg::OutputContextPtr format_context(raw_format_context);
+  if (format_context->oformat->flags & AVFMT_GLOBALHEADER) {
+    codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+  if (avcodec_open2(codec_context.get(), encoder, nullptr) < 0) {
+    std::cerr << "Failed to open the " << encoder->name << " encoder for "
+              << clip_filename(clip) << std::endl;
+    return false;
+  }
+  AVStream *stream = avformat_new_stream(format_context.get(), nullptr);
+  if (!stream || avcodec_parameters_from_context(stream->codecpar,
+                                                 codec_context.get()) < 0) {
+    return false;
+  }
+  stream->time_base = codec_context->time_base;
+  if (avio_open(&format_context->pb, path.c_str(), AVIO_FLAG_WRITE) < 0 ||
+      avformat_write_header(format_context.get(), nullptr) < 0) {
+    std::cerr << "Failed to open " << path << std::endl;
+    return false;
+  }
+
+  // STEP 3: Encode the pattern, then drain the encoder
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  ffmpeg::PacketPtr packet = ffmpeg::make_packet();
+  if (!frame || !packet) {
+    return false;
+  }
+  frame->format = codec_context->pix_fmt;
+  frame->width = clip.width;
+  frame->height = clip.height;
+  if (av_frame_get_buffer(frame.get(), 32) < 0) {
+    return false;
+  }
+  const int frames = static_cast<int>(clip.seconds * clip.fps);
+  for (int i = 0; i < frames; ++i) {
+    if (av_frame_make_writable(frame.get()) < 0) {
+      return false;
+    }
+    draw_pattern(frame.get(), i, clip.ten_bit);
+    frame->pts = i;
+    if (!encode_and_write(codec_context.get(), stream, format_context.get(),
+                          frame.get(), packet.get())) {
+      std::cerr << "Failed to encode " << path << std::endl;
+      return false;
+    }
+  }
+  return encode_and_write(codec_context.get(), stream, format_context.get(),
+                          nullptr, packet.get()) &&
+         av_write_trailer(format_context.get()) == 0;
+}
+
+std::vector<std::string> bench::ensure_corpus(const std::string &dir,
+                                              const std::string &preset) {
+  std::filesystem::create_directories(dir);
+  std::vector<std::string> paths;
+  for (const ClipSpec &clip : corpus_matrix(preset)) {
+    const std::string path = dir + "/" + clip_filename(clip);
+    if (std::filesystem::exists(path)) {
+      paths.push_back(path);
+      continue;
+    }
+
+    // A clip that fails half-way is removed, so it is generated again
+    Stopwatch stopwatch;
+    if (!generate_clip(clip, path)) {
+      std::filesystem::remove(path);
+      continue;
+    }
+    std::printf("Generated %s in %.1f s\n", clip_filename(clip).c_str(),
+                stopwatch.seconds());
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+int bench::run_corpus_bench(const std::vector<std::string> &args) {
+  const std::string dir = args.size() > 0 ? args[0] : default_corpus_dir();
+  const std::string preset = args.size() > 1 ? args[1] : "quick";
+  const std::vector<ClipSpec> clips = corpus_matrix(preset);
+  const std::vector<std::string> paths = ensure_corpus(dir, preset);
+  std::cout << paths.size() << " of " << clips.size() << " " << preset
+            << " corpus clips in " << dir << std::endl;
+  return paths.empty() ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+#include "../includes/frame/intermediate.hpp"
+#include "../includes/frame/scaler.hpp"
+#include "../includes/logging/logger.hpp"
+#include "../includes/simd/convert.hpp"
+#include "bench.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+/** The formats compared, in the order they are printed. */
+const frame::IntermediateFormat FORMATS[] = {
+    frame::IntermediateFormat::Png,
+    frame::IntermediateFormat::PngFast,
+    frame::IntermediateFormat::Qoi,
+    frame::IntermediateFormat::Raw,
+};
+
+/**
+ * @brief Converts a frame to RGBA like the extractor does: with the SIMD
+ * kernels if they cover it, with swscale otherwise.
+ */
+AVFrame *to_rgba(const AVFrame *frame) {
+  AVFrame *rgba = av_frame_alloc();
+  rgba->format = AV_PIX_FMT_RGBA;
+  rgba->width = frame->width;
+  rgba->height = frame->height;
+  av_frame_get_buffer(rgba, 0);
+  if (simd::convert_frame(frame, rgba)) {
+    return rgba;
+  }
+  SwsContext *sws_context = sws_getContext(
+      frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+      rgba->width, rgba->height, AV_PIX_FMT_RGBA, SWS_BICUBIC, nullptr,
+      nullptr, nullptr);
+  frame::use_bt709_colors(sws_context, frame);
+  sws_scale(sws_context, frame->data, frame->linesize, 0, frame->height,
+            rgba->data, rgba->linesize);
+  sws_freeContext(sws_context);
+  return rgba;
+}
+
+/**
+ * @brief Checks if two frames hold the same pixels, by packing both as raw
+ * frames, which drops the padding of their lines.
+ */
+bool same_pixels(const AVFrame *a, const AVFrame *b) {
+  std::vector<std::uint8_t> packed_a;
+  std::vector<std::uint8_t> packed_b;
+  return frame::encode_intermediate(a, frame::IntermediateFormat::Raw,
+                                    packed_a) &&
+         frame::encode_intermediate(b, frame::IntermediateFormat::Raw,
+                                    packed_b) &&
+         packed_a == packed_b;
+}
+
+/**
+ * @brief Times one format on a clip's frames and prints its row.
+ * @return `true` if every frame came back unchanged, `false` otherwise.
+ */
+bool measure_format(const std::string &clip,
+                    const std::vector<AVFrame *> &decoded,
+                    frame::IntermediateFormat format) {
+  // STEP 1: Encode every frame, the RGBA conversion included
+  std::vector<std::vector<std::uint8_t>> encoded(decoded.size());
+  std::vector<AVFrame *> images;
+  bench::Stopwatch encode_stopwatch;
+  for (std::size_t i = 0; i < decoded.size(); ++i) {
+    AVFrame *image = frame::intermediate_needs_rgba(format)
+                         ? to_rgba(decoded[i])
+                         : av_frame_clone(decoded[i]);
+    frame::encode_intermediate(image, format, encoded[i]);
+    images.push_back(image);
+  }
+  const double encode_seconds = encode_stopwatch.seconds();
+
+  // STEP 2: Decode every frame back
+  std::vector<ffmpeg::FramePtr> restored;
+  bench::Stopwatch decode_stopwatch;
+  for (const std::vector<std::uint8_t> &data : encoded) {
+    restored.push_back(
+        frame::decode_intermediate(data.data(), data.size(), format));
+  }
+  const double decode_seconds = decode_stopwatch.seconds();
+
+  // STEP 3: Check the round trip and print the row
+  std::size_t bytes = 0;
+  bool lossless = true;
+  for (std::size_t i = 0; i < decoded.size(); ++i) {
+    bytes += encoded[i].size();
+    lossless = lossless && restored[i] &&
+               same_pixels(images[i], restored[i].get());
+  }
+  const double frames = static_cast<double>(decoded.size());
+  std::printf("%-44s %-9s %10.1f %10.1f %12.1f %9s\n", clip.c_str(),
+              frame::intermediate_format_name(format),
+              frames / encode_seconds, frames / decode_seconds,
+              bytes / frames / 1024.0, lossless ? "yes" : "NO");
+  bench::free_frames(images);
+  return lossless;
+}
+} // namespace
+
+int bench::run_intermediate_bench(const std::vector<std::string> &args) {
+  const std::string dir = args.size() > 0 ? args[0] : default_corpus_dir();
+  const std::string preset = args.size() > 1 ? args[1] : "quick";
+  const int count = args.size() > 2 ? std::stoi(args[2]) : 30;
+  logging::set_level(logging::Level::Warning);
+
+  // STEP 1: Generate the clips that are missing
+  const std::vector<std::string> paths = ensure_corpus(dir, preset);
+  if (paths.empty()) {
+    std::cerr << "No corpus clips in " << dir << std::endl;
+    return 1;
+  }
+
+  // STEP 2: Round-trip the first frames of every clip through every format
+  std::printf("%-44s %-9s %10s %10s %12s %9s\n", "clip", "format",
+              "enc fps", "dec fps", "KiB/frame", "lossless");
+  bool all_lossless = true;
+  for (const std::string &path : paths) {
+    std::vector<AVFrame *> decoded = decode_video_frames(path, count);
+    if (decoded.empty()) {
+      std::cerr << "Failed to decode " << path << std::endl;
+      continue;
+    }
+    const std::string clip = std::filesystem::path(path).filename().string();
+    for (frame::IntermediateFormat format : FORMATS) {
+      all_lossless = measure_format(clip, decoded, format) && all_lossless;
+    }
+    free_frames(decoded);
+  }
+  if (!all_lossless) {
+    std::cerr << "An intermediate format changed the frames" << std::endl;
+    return 1;
+  }
+  return 0;
+}
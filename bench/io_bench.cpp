@@ -0,0 +1,99 @@
+#include "../includes/io/input_source.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+namespace {
+/**
+ * @brief One configuration of the I/O layer to measure.
+ */
+struct IoCase {
+  const char *name;       /**< The name printed in the table. */
+  io::InputOptions options; /**< The options for the input source. */
+};
+
+/**
+ * @brief Demuxes every packet of a file.
+ * @param path The path to the file.
+ * @param options The options for the input source.
+ * @return The number of packet bytes read, or -1 on error.
+ */
+long long demux_file(const std::string &path,
+                     const io::InputOptions &options) {
+  io::InputSource input_source(path, options);
+  AVFormatContext *format_context = nullptr;
+  if (!input_source.open_format_context(&format_context)) {
+    return -1;
+  }
+
+  if (avformat_find_stream_info(format_context, nullptr) < 0) {
+    avformat_close_input(&format_context);
+    return -1;
+  }
+
+  long long bytes = 0;
+  AVPacket *packet = av_packet_alloc();
+  while (av_read_frame(format_context, packet) >= 0) {
+    bytes += packet->size;
+    av_packet_unref(packet);
+  }
+
+  av_packet_free(&packet);
+  avformat_close_input(&format_context);
+  return bytes;
+}
+} // namespace
+
+int bench::run_io_bench(const std::vector<std::string> &args) {
+  const std::string path = args.size() > 0 ? args[0] : default_corpus_file();
+  const int runs = args.size() > 1 ? std::stoi(args[1]) : 5;
+
+  std::vector<IoCase> cases = {
+      {"default", {io::InputMode::Default, 0}},
+      {"mmap", {io::InputMode::Mmap, 4 << 20}},
+      {"buffered-64K", {io::InputMode::Buffered, 64 << 10}},
+      {"buffered-1M", {io::InputMode::Buffered, 1 << 20}},
+      {"buffered-4M", {io::InputMode::Buffered, 4 << 20}},
+  };
+
+  std::cout << "I/O layer demux of " << path << " (" << runs << " runs)"
+            << std::endl;
+  std::printf("%-14s %12s %14s %14s\n", "mode", "MB/s", "read syscalls",
+              "bytes read");
+
+  for (const IoCase &io_case : cases) {
+    // STEP 1: Warm the page cache so every mode sees the same state
+    if (demux_file(path, io_case.options) < 0) {
+      std::cerr << "Failed to demux " << path << std::endl;
+      return 1;
+    }
+
+    // STEP 2: Measure the runs
+    const IoCounters before = read_io_counters();
+    Stopwatch stopwatch;
+    long long bytes = 0;
+    for (int run = 0; run < runs; ++run) {
+      bytes += demux_file(path, io_case.options);
+    }
+    const double seconds = stopwatch.seconds();
+    const IoCounters after = read_io_counters();
+
+    // STEP 3: Report per-run averages
+    const double syscalls =
+        static_cast<double>(after.read_syscalls - before.read_syscalls);
+    const double read_bytes =
+        static_cast<double>(after.read_bytes - before.read_bytes);
+    std::printf("%-14s %12.1f %14.0f %14.0f\n", io_case.name,
+                bytes / seconds / (1024.0 * 1024.0), syscalls / runs,
+                read_bytes / runs);
+  }
+
+  return 0;
+}
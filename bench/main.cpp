@@ -0,0 +1,78 @@
+#include "bench.hpp"
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef GAMEFLIX_ASSETS_DIR
+#define GAMEFLIX_ASSETS_DIR "assets"
+#endif
+
+std::string bench::default_corpus_file() {
+  return std::string(GAMEFLIX_ASSETS_DIR) +
+         "/videos/big_buck_bunny_720p_30mb.mp4";
+}
+
+std::string bench::default_corpus_dir() {
+  return std::string(GAMEFLIX_ASSETS_DIR) + "/corpus";
+}
+
+bench::IoCounters bench::read_io_counters() {
+  IoCounters counters;
+  std::ifstream io_file("/proc/self/io");
+  std::string line;
+  while (std::getline(io_file, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    std::uint64_t value = 0;
+    fields >> key >> value;
+    if (key == "syscr:") {
+      counters.read_syscalls = value;
+    } else if (key == "rchar:") {
+      counters.read_bytes = value;
+    }
+  }
+  return counters;
+}
+
+bench::Stopwatch::Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+double bench::Stopwatch::seconds() const {
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_;
+  return elapsed.count();
+}
+
+int main(int argc, char **argv) {
+  const std::map<std::string,
+                 std::function<int(const std::vector<std::string> &)>>
+      suites = {
+          {"alloc", bench::run_alloc_bench},
+          {"blend", bench::run_blend_bench},
+          {"compose", bench::run_compose_bench},
+          {"corpus", bench::run_corpus_bench},
+          {"intermediate", bench::run_intermediate_bench},
+          {"io", bench::run_io_bench},
+          {"matrix", bench::run_matrix_bench},
+          {"scaler", bench::run_scaler_bench},
+          {"scaling", bench::run_scaling_bench},
+          {"sched", bench::run_sched_bench},
+          {"simd", bench::run_simd_bench},
+      };
+
+  if (argc < 2 || suites.find(argv[1]) == suites.end()) {
+    std::cerr << "Usage: " << argv[0] << " <suite> [args...]" << std::endl;
+    std::cerr << "Suites:";
+    for (const auto &suite : suites) {
+      std::cerr << " " << suite.first;
+    }
+    std::cerr << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> args(argv + 2, argv + argc);
+  return suites.at(argv[1])(args);
+}
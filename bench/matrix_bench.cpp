@@ -0,0 +1,115 @@
+#include "../includes/frame/extractor.hpp"
+#include "../includes/gameflix/engine.hpp"
+#include "../includes/logging/logger.hpp"
+#include "../includes/pipeline/frame_queue.hpp"
+#include "../includes/pipeline/memory_budget.hpp"
+#include "bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace {
+/** The memory budget of the frames in flight of a matrix run. */
+const std::size_t MATRIX_MEMORY = std::size_t(1) << 30;
+
+/**
+ * @brief Decodes a whole clip into a frame queue and drains it, like the
+ * decode stage of an in-memory job.
+ * @return The frames per second, 0 if nothing was decoded.
+ */
+double measure_decode(const std::string &path) {
+  pipeline::MemoryBudget budget(MATRIX_MEMORY);
+  pipeline::FrameQueue queue(budget);
+  frame::Extractor frame_extractor(path);
+  bench::Stopwatch stopwatch;
+  std::thread extractor_thread(
+      [&] { frame_extractor.extract_frames(queue); });
+  int frames = 0;
+  while (AVFrame *frame = queue.pop()) {
+    av_frame_free(&frame);
+    ++frames;
+  }
+  extractor_thread.join();
+  const double seconds = stopwatch.seconds();
+  return seconds > 0.0 ? frames / seconds : 0.0;
+}
+
+/**
+ * @brief Runs a job that combines a clip with itself.
+ * @return The frames per second of the output, 0 if the job failed.
+ */
+double measure_job(const std::string &path, compose::LayoutKind layout) {
+  gameflix::JobDescription job;
+  job.video_path1 = path;
+  job.video_path2 = path;
+  job.output_path =
+      (std::filesystem::temp_directory_path() / "gameflix_matrix.mp4")
+          .string();
+  job.options.max_memory = MATRIX_MEMORY;
+  job.options.layout = layout;
+  // Re-encode every frame, the cost the matrix is after
+  job.options.remux = false;
+  job.options.in_memory = true;
+
+  gameflix::JobProgress last;
+  gameflix::Engine engine;
+  const gameflix::JobStatus status =
+      engine
+          .submit(job,
+                  [&last](const gameflix::JobProgress &progress) {
+                    last = progress;
+                  })
+          .wait();
+  std::filesystem::remove(job.output_path);
+  if (status != gameflix::JobStatus::Succeeded ||
+      last.elapsed_seconds <= 0.0) {
+    return 0.0;
+  }
+  return last.frames_encoded / last.elapsed_seconds;
+}
+} // namespace
+
+int bench::run_matrix_bench(const std::vector<std::string> &args) {
+  const std::string dir = args.size() > 0 ? args[0] : default_corpus_dir();
+  const std::string preset = args.size() > 1 ? args[1] : "quick";
+  // The jobs' own log lines would break up the table
+  logging::set_level(logging::Level::Warning);
+
+  // STEP 1: Generate the clips that are missing
+  const std::vector<ClipSpec> clips = corpus_matrix(preset);
+  ensure_corpus(dir, preset);
+
+  // STEP 2: Decode and combine every clip that exists
+  std::printf("%-44s %10s %12s %12s %10s\n", "clip", "decode fps",
+              "interleave", "vertical", "xrealtime");
+  bool ran = false;
+  for (const ClipSpec &clip : clips) {
+    const std::string path = dir + "/" + clip_filename(clip);
+    if (!std::filesystem::exists(path)) {
+      continue;
+    }
+    const double decode_fps = measure_decode(path);
+    const double interleave_fps =
+        measure_job(path, compose::LayoutKind::Interleave);
+    const double vertical_fps =
+        measure_job(path, compose::LayoutKind::Vertical);
+    // The slowest stage sets how much faster than playback a job runs
+    const double realtime = std::min(interleave_fps, vertical_fps) / clip.fps;
+    std::printf("%-44s %10.1f %12.1f %12.1f %9.2fx\n",
+                clip_filename(clip).c_str(), decode_fps, interleave_fps,
+                vertical_fps, realtime);
+    ran = true;
+  }
+  if (!ran) {
+    std::cerr << "No corpus clips in " << dir << std::endl;
+  }
+  return ran ? 0 : 1;
+}
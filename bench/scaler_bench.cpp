@@ -0,0 +1,106 @@
+#include "../includes/frame/scaler.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+/** The width every frame is scaled to, the Combiner's output width. */
+const int TARGET_WIDTH = 1920;
+/** The height every frame is scaled to, the Combiner's output height. */
+const int TARGET_HEIGHT = 1080;
+
+/**
+ * @brief Scales frames to the target size with one algorithm.
+ * @param frames The source frames.
+ * @param algorithm The scaler algorithm.
+ * @param seconds Set to the time spent in sws_scale().
+ * @return The scaled frames, owned by the caller.
+ */
+std::vector<AVFrame *> scale_frames(const std::vector<AVFrame *> &frames,
+                                    frame::ScaleAlgorithm algorithm,
+                                    double &seconds) {
+  std::vector<AVFrame *> scaled_frames;
+  seconds = 0.0;
+  for (const AVFrame *source : frames) {
+    AVFrame *scaled = av_frame_alloc();
+    scaled->format = AV_PIX_FMT_YUV420P;
+    scaled->width = TARGET_WIDTH;
+    scaled->height = TARGET_HEIGHT;
+    av_frame_get_buffer(scaled, 32);
+
+    // Context creation is included, as it is in Combiner::scale_frame
+    bench::Stopwatch stopwatch;
+    SwsContext *sws_context = sws_getContext(
+        source->width, source->height,
+        static_cast<AVPixelFormat>(source->format), TARGET_WIDTH,
+        TARGET_HEIGHT, AV_PIX_FMT_YUV420P, frame::to_sws_flags(algorithm),
+        nullptr, nullptr, nullptr);
+    sws_scale(sws_context, source->data, source->linesize, 0, source->height,
+              scaled->data, scaled->linesize);
+    sws_freeContext(sws_context);
+    seconds += stopwatch.seconds();
+
+    scaled_frames.push_back(scaled);
+  }
+  return scaled_frames;
+}
+} // namespace
+
+int bench::run_scaler_bench(const std::vector<std::string> &args) {
+  const std::string path = args.size() > 0 ? args[0] : default_corpus_file();
+  const int count = args.size() > 1 ? std::stoi(args[1]) : 60;
+
+  // STEP 1: Decode the source frames once
+  std::vector<AVFrame *> frames = decode_video_frames(path, count);
+  if (frames.empty()) {
+    std::cerr << "Failed to decode " << path << std::endl;
+    return 1;
+  }
+
+  // STEP 2: Scale with lanczos as the quality reference
+  double reference_seconds = 0.0;
+  std::vector<AVFrame *> reference =
+      scale_frames(frames, frame::ScaleAlgorithm::Lanczos, reference_seconds);
+
+  std::cout << "Scaling " << frames.size() << " frames of " << path << " ("
+            << frames[0]->width << "x" << frames[0]->height << ") to "
+            << TARGET_WIDTH << "x" << TARGET_HEIGHT
+            << ", quality against lanczos" << std::endl;
+  std::printf("%-14s %10s %12s %10s\n", "algorithm", "fps", "luma PSNR",
+              "luma SSIM");
+
+  // STEP 3: Measure every algorithm
+  for (frame::ScaleAlgorithm algorithm : frame::all_scale_algorithms()) {
+    double seconds = 0.0;
+    std::vector<AVFrame *> scaled = scale_frames(frames, algorithm, seconds);
+
+    double total_psnr = 0.0;
+    double total_ssim = 0.0;
+    for (std::size_t i = 0; i < scaled.size(); ++i) {
+      total_psnr += psnr(scaled[i]->data[0], scaled[i]->linesize[0],
+                         reference[i]->data[0], reference[i]->linesize[0],
+                         TARGET_WIDTH, TARGET_HEIGHT);
+      total_ssim += ssim(scaled[i]->data[0], scaled[i]->linesize[0],
+                         reference[i]->data[0], reference[i]->linesize[0],
+                         TARGET_WIDTH, TARGET_HEIGHT);
+    }
+
+    std::printf("%-14s %10.1f %12.2f %10.4f\n",
+                frame::scale_algorithm_name(algorithm).c_str(),
+                scaled.size() / seconds, total_psnr / scaled.size(),
+                total_ssim / scaled.size());
+    free_frames(scaled);
+  }
+
+  // STEP 4: Cleanup
+  free_frames(reference);
+  free_frames(frames);
+  return 0;
+}
@@ -0,0 +1,286 @@
+#include "../includes/frame/encoder.hpp"
+#include "../includes/frame/extractor.hpp"
+#include "../includes/gameflix/engine.hpp"
+#include "../includes/logging/logger.hpp"
+#include "../includes/pipeline/frame_queue.hpp"
+#include "../includes/pipeline/memory_budget.hpp"
+#include "../includes/pipeline/task_scheduler.hpp"
+#include "bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace {
+/** The memory budget of the frames in flight of a configuration. */
+const std::size_t SCALING_MEMORY = std::size_t(1) << 30;
+
+/**
+ * @brief The threads of one configuration of the sweep.
+ */
+struct ThreadConfig {
+  int decoder = 1; /**< The threads of each decoder. */
+  int encoder = 1; /**< The threads of each encoder. */
+  int workers = 1; /**< The workers of the task scheduler. */
+};
+
+/**
+ * @brief The throughput of one configuration.
+ */
+struct ScalingSample {
+  double decode_fps = 0.0; /**< Extractor decode, frames per second. */
+  double encode_fps = 0.0; /**< Encoder encode, frames per second. */
+  double job_fps = 0.0;    /**< A whole interleave job, frames per second. */
+  std::uint64_t peak_rss_bytes = 0; /**< The peak RSS of the configuration. */
+};
+
+/**
+ * @brief Decodes the first seconds of a video into a frame queue, as the
+ * decode stage of an in-memory job does.
+ * @return The frames per second, and the frames decoded.
+ */
+double measure_decode(const std::string &path, double seconds,
+                      const ThreadConfig &config, int &frames) {
+  pipeline::MemoryBudget budget(SCALING_MEMORY);
+  pipeline::FrameQueue queue(budget);
+  io::InputOptions input_options;
+  input_options.decoder_threads = config.decoder;
+  frame::Extractor frame_extractor(path, input_options);
+  frame::TrimRange trim;
+  trim.end = seconds;
+  frame_extractor.set_trim(trim);
+
+  bench::Stopwatch stopwatch;
+  std::thread extractor_thread(
+      [&] { frame_extractor.extract_frames(queue); });
+  frames = 0;
+  while (AVFrame *frame = queue.pop()) {
+    av_frame_free(&frame);
+    ++frames;
+  }
+  extractor_thread.join();
+  const double elapsed = stopwatch.seconds();
+  return elapsed > 0.0 ? frames / elapsed : 0.0;
+}
+
+/**
+ * @brief Encodes decoded frames with the encoder the combiner writes its
+ * output with, so the encode stage is timed on its own.
+ * @return The frames per second, 0 if the frames cannot be encoded.
+ */
+double measure_encode(const std::string &path, int frame_count,
+                      const ThreadConfig &config) {
+  std::vector<AVFrame *> frames =
+      bench::decode_video_frames(path, frame_count);
+  if (frames.empty() || frames[0]->format != frame::OUTPUT_PIXEL_FORMAT) {
+    bench::free_frames(frames);
+    return 0.0;
+  }
+
+  frame::OutputSpec spec;
+  spec.filename =
+      (std::filesystem::temp_directory_path() / "gameflix_scaling.mp4")
+          .string();
+  spec.width = frames[0]->width;
+  spec.height = frames[0]->height;
+  frame::Encoder encoder;
+  encoder.set_threads(config.encoder);
+  bool encoded = encoder.open(spec);
+  bench::Stopwatch stopwatch;
+  for (std::size_t i = 0; encoded && i < frames.size(); ++i) {
+    // Decoded keyframes would force keyframes on the encoder
+    frames[i]->pts = static_cast<int64_t>(i);
+    frames[i]->pict_type = AV_PICTURE_TYPE_NONE;
+    encoded = encoder.encode(frames[i]);
+  }
+  encoded = encoded && encoder.finish();
+  const double elapsed = stopwatch.seconds();
+  const std::size_t count = frames.size();
+  bench::free_frames(frames);
+  std::filesystem::remove(spec.filename);
+  return encoded && elapsed > 0.0 ? count / elapsed : 0.0;
+}
+
+/**
+ * @brief Runs an interleave job combining the first seconds of a video
+ * with themselves.
+ * @return The frames per second of the output, 0 if the job failed.
+ */
+double measure_job(const std::string &path, double seconds,
+                   const ThreadConfig &config) {
+  gameflix::JobDescription job;
+  job.video_path1 = path;
+  job.video_path2 = path;
+  job.output_path =
+      (std::filesystem::temp_directory_path() / "gameflix_scaling_job.mp4")
+          .string();
+  job.options.max_memory = SCALING_MEMORY;
+  job.options.input_options.decoder_threads = config.decoder;
+  job.options.encoder_threads = config.encoder;
+  job.options.trim.end = seconds;
+  job.options.remux = false;
+  job.options.in_memory = true;
+
+  gameflix::JobProgress last;
+  gameflix::Engine engine;
+  const gameflix::JobStatus status =
+      engine
+          .submit(job,
+                  [&last](const gameflix::JobProgress &progress) {
+                    last = progress;
+                  })
+          .wait();
+  std::filesystem::remove(job.output_path);
+  if (status != gameflix::JobStatus::Succeeded ||
+      last.elapsed_seconds <= 0.0) {
+    return 0.0;
+  }
+  return last.frames_encoded / last.elapsed_seconds;
+}
+
+/**
+ * @brief Measures a configuration in a child process. The global scheduler
+ * only takes its worker count before it starts, and the child's peak RSS
+ * is the configuration's alone.
+ * @return `true` if the child reported its throughput.
+ */
+bool measure_isolated(const std::string &path, double seconds,
+                      const ThreadConfig &config, ScalingSample &sample) {
+  int sample_pipe[2];
+  if (pipe(sample_pipe) != 0) {
+    return false;
+  }
+  const pid_t child = fork();
+  if (child < 0) {
+    close(sample_pipe[0]);
+    close(sample_pipe[1]);
+    return false;
+  }
+  if (child == 0) {
+    // The jobs' reports and log lines would break up the CSV
+    close(sample_pipe[0]);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDOUT_FILENO);
+    }
+    logging::set_level(logging::Level::Warning);
+    pipeline::TaskScheduler::set_global_workers(
+        static_cast<std::size_t>(config.workers));
+    int frames = 0;
+    double fps[3] = {};
+    fps[0] = measure_decode(path, seconds, config, frames);
+    fps[1] = measure_encode(path, frames, config);
+    fps[2] = measure_job(path, seconds, config);
+    logging::flush();
+    const bool sent = write(sample_pipe[1], fps, sizeof(fps)) == sizeof(fps);
+    _exit(sent ? 0 : 1);
+  }
+
+  close(sample_pipe[1]);
+  double fps[3] = {};
+  const bool received =
+      read(sample_pipe[0], fps, sizeof(fps)) == sizeof(fps);
+  close(sample_pipe[0]);
+  int exit_status = 0;
+  struct rusage usage = {};
+  if (wait4(child, &exit_status, 0, &usage) != child || !received) {
+    return false;
+  }
+  sample.decode_fps = fps[0];
+  sample.encode_fps = fps[1];
+  sample.job_fps = fps[2];
+  // Linux reports the peak RSS in kilobytes
+  sample.peak_rss_bytes = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+  return true;
+}
+
+/**
+ * @brief Formats a throughput with its speedup over one thread and its
+ * parallel efficiency.
+ */
+std::string scaling_columns(double fps, double single_fps, int threads) {
+  const double speedup = single_fps > 0.0 ? fps / single_fps : 0.0;
+  char columns[64];
+  std::snprintf(columns, sizeof(columns), "%.2f,%.3f,%.3f", fps, speedup,
+                speedup / threads);
+  return columns;
+}
+} // namespace
+
+int bench::run_scaling_bench(const std::vector<std::string> &args) {
+  const std::string path = args.size() > 0 ? args[0] : default_corpus_file();
+  const int max_threads =
+      args.size() > 1
+          ? std::max(1, std::stoi(args[1]))
+          : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  const double seconds = args.size() > 2 ? std::stod(args[2]) : 10.0;
+  const std::string csv_path = args.size() > 3 ? args[3] : "scaling.csv";
+
+  std::vector<int> thread_counts;
+  for (int threads = 1; threads < max_threads; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(max_threads);
+
+  std::ofstream csv(csv_path);
+  if (!csv) {
+    std::cerr << "Failed to write " << csv_path << std::endl;
+    return 1;
+  }
+  const std::string header =
+      "axis,threads,decode_fps,decode_speedup,decode_efficiency,encode_fps,"
+      "encode_speedup,encode_efficiency,job_fps,job_speedup,job_efficiency,"
+      "peak_rss_bytes";
+  csv << header << "\n";
+  std::cout << header << std::endl;
+
+  // Each axis varies one kind of thread and keeps the others at one; "all"
+  // gives a job n of each, the allocation the sweep is there to pick
+  for (const std::string axis : {"decoder", "encoder", "scheduler", "all"}) {
+    ScalingSample single;
+    for (int threads : thread_counts) {
+      ThreadConfig config;
+      if (axis == "decoder" || axis == "all") {
+        config.decoder = threads;
+      }
+      if (axis == "encoder" || axis == "all") {
+        config.encoder = threads;
+      }
+      if (axis == "scheduler" || axis == "all") {
+        config.workers = threads;
+      }
+
+      ScalingSample sample;
+      if (!measure_isolated(path, seconds, config, sample)) {
+        std::cerr << "Failed to measure " << axis << " at " << threads
+                  << " threads" << std::endl;
+        return 1;
+      }
+      if (threads == 1) {
+        single = sample;
+      }
+      const std::string line =
+          axis + "," + std::to_string(threads) + "," +
+          scaling_columns(sample.decode_fps, single.decode_fps, threads) +
+          "," +
+          scaling_columns(sample.encode_fps, single.encode_fps, threads) +
+          "," + scaling_columns(sample.job_fps, single.job_fps, threads) +
+          "," + std::to_string(sample.peak_rss_bytes);
+      csv << line << "\n";
+      std::cout << line << std::endl;
+    }
+  }
+  return csv ? 0 : 1;
+}
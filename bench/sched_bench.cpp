@@ -0,0 +1,122 @@
+#include "../includes/ffmpeg/handles.hpp"
+#include "../includes/pipeline/task_scheduler.hpp"
+#include "../includes/simd/convert.hpp"
+#include "bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace {
+/**
+ * @brief Allocates a YUV420P frame filled with a gradient.
+ */
+ffmpeg::FramePtr gradient_frame(int width, int height) {
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  frame->format = AV_PIX_FMT_YUV420P;
+  frame->width = width;
+  frame->height = height;
+  if (av_frame_get_buffer(frame.get(), 32) < 0) {
+    return nullptr;
+  }
+  for (int plane = 0; plane < 3; ++plane) {
+    const int rows = plane == 0 ? height : height / 2;
+    for (int y = 0; y < rows; ++y) {
+      std::memset(frame->data[plane] + y * frame->linesize[plane],
+                  (y + 64 * plane) % 256, frame->linesize[plane]);
+    }
+  }
+  return frame;
+}
+
+/**
+ * @brief Upscales a 720p frame to 1080p, as one task of a render. The
+ * conversion splits itself into row tasks on the same scheduler.
+ */
+void upscale_task(const AVFrame *source) {
+  // Every worker scales into a frame of its own
+  thread_local ffmpeg::FramePtr scaled = gradient_frame(1920, 1080);
+  if (scaled) {
+    simd::convert_frame(source, scaled.get());
+  }
+}
+
+/**
+ * @brief Submits upscale tasks as one job and waits for them.
+ * @return The seconds until the job's last task finished.
+ */
+double run_job(pipeline::TaskScheduler &scheduler, std::size_t job,
+               const AVFrame *source, int tasks) {
+  pipeline::TaskScheduler::set_current_job(job);
+  bench::Stopwatch stopwatch;
+  pipeline::TaskGroup group(scheduler);
+  for (int i = 0; i < tasks; ++i) {
+    group.run([source] { upscale_task(source); });
+  }
+  group.wait();
+  return stopwatch.seconds();
+}
+} // namespace
+
+int bench::run_sched_bench(const std::vector<std::string> &args) {
+  const int frames = args.size() > 0 ? std::stoi(args[0]) : 240;
+  const int max_workers =
+      args.size() > 1
+          ? std::stoi(args[1])
+          : static_cast<int>(
+                std::max(1u, std::thread::hardware_concurrency()));
+  const ffmpeg::FramePtr source = gradient_frame(1280, 720);
+  if (!source) {
+    std::cerr << "Failed to allocate the source frame" << std::endl;
+    return 1;
+  }
+
+  // STEP 1: Throughput of one job at 1, 2, 4... workers
+  std::cout << "Upscaling " << frames << " 720p frames to 1080p" << std::endl;
+  std::printf("%-8s %12s %10s %11s\n", "workers", "frames/s", "speedup",
+              "efficiency");
+  std::vector<int> worker_counts;
+  for (int workers = 1; workers < max_workers; workers *= 2) {
+    worker_counts.push_back(workers);
+  }
+  worker_counts.push_back(max_workers);
+
+  double single_fps = 0.0;
+  for (int workers : worker_counts) {
+    pipeline::TaskScheduler scheduler(workers);
+    const double fps = frames / run_job(scheduler, 1, source.get(), frames);
+    if (single_fps == 0.0) {
+      single_fps = fps;
+    }
+    std::printf("%-8d %12.1f %9.2fx %10.0f%%\n", workers, fps,
+                fps / single_fps, 100.0 * fps / single_fps / workers);
+  }
+
+  // STEP 2: Fairness: a job with three times the tasks of another, both
+  // submitted at once, should not hold the smaller one up
+  pipeline::TaskScheduler scheduler(max_workers);
+  const int small_tasks = std::max(1, frames / 4);
+  double large_seconds = 0.0;
+  double small_seconds = 0.0;
+  std::thread large_job([&] {
+    large_seconds = run_job(scheduler, 1, source.get(), 3 * small_tasks);
+  });
+  std::thread small_job([&] {
+    small_seconds = run_job(scheduler, 2, source.get(), small_tasks);
+  });
+  large_job.join();
+  small_job.join();
+  std::printf("Fairness at %d workers: %d tasks took %.1f ms, %d tasks "
+              "submitted alongside took %.1f ms (%.0f%%)\n",
+              max_workers, 3 * small_tasks, 1000.0 * large_seconds,
+              small_tasks, 1000.0 * small_seconds,
+              100.0 * small_seconds / large_seconds);
+  return 0;
+}
@@ -0,0 +1,224 @@
+#include "../includes/simd/convert.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+/** The lowest mean PSNR against swscale, in dB, before the kernels fail. */
+const double MIN_SWSCALE_PSNR = 35.0;
+
+/**
+ * @brief A conversion covered by the SIMD kernels.
+ */
+struct Conversion {
+  const char *name;        /**< The name printed in the table. */
+  AVPixelFormat src_format; /**< The format of the source frames. */
+  AVPixelFormat dst_format; /**< The format of the converted frames. */
+  int numerator;           /**< The resize factor numerator. */
+  int denominator;         /**< The resize factor denominator. */
+};
+
+const Conversion CONVERSIONS[] = {
+    {"yuv420p 1.5x", AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P, 3, 2},
+    {"yuv420p 0.5x", AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P, 1, 2},
+    {"rgba->yuv420p", AV_PIX_FMT_RGBA, AV_PIX_FMT_YUV420P, 1, 1},
+    {"rgba->yuv 1.5x", AV_PIX_FMT_RGBA, AV_PIX_FMT_YUV420P, 3, 2},
+    {"yuv420p->rgba", AV_PIX_FMT_YUV420P, AV_PIX_FMT_RGBA, 1, 1},
+};
+
+AVFrame *allocate_frame(AVPixelFormat format, int width, int height) {
+  AVFrame *frame = av_frame_alloc();
+  frame->format = format;
+  frame->width = width;
+  frame->height = height;
+  av_frame_get_buffer(frame, 32);
+  return frame;
+}
+
+/**
+ * @brief Gets the source frames of a conversion, converting the decoded
+ * frames to RGBA with the scalar kernels if needed.
+ */
+std::vector<AVFrame *> source_frames(const std::vector<AVFrame *> &decoded,
+                                     AVPixelFormat format) {
+  std::vector<AVFrame *> frames;
+  for (const AVFrame *frame : decoded) {
+    if (format == AV_PIX_FMT_YUV420P) {
+      frames.push_back(av_frame_clone(frame));
+      continue;
+    }
+    AVFrame *rgba = allocate_frame(format, frame->width, frame->height);
+    simd::convert_frame(frame, rgba, simd::scalar::KERNELS);
+    frames.push_back(rgba);
+  }
+  return frames;
+}
+
+/**
+ * @brief Converts every frame with one set of kernels.
+ * @return The time spent converting, or a negative value if the kernels do
+ * not cover the conversion.
+ */
+double convert_frames(const std::vector<AVFrame *> &sources,
+                      const std::vector<AVFrame *> &converted,
+                      const simd::Kernels &kernels) {
+  bench::Stopwatch stopwatch;
+  for (std::size_t i = 0; i < sources.size(); ++i) {
+    if (!simd::convert_frame(sources[i], converted[i], kernels)) {
+      return -1.0;
+    }
+  }
+  return stopwatch.seconds();
+}
+
+/**
+ * @brief Converts every frame with bilinear swscale set up for BT.709.
+ * @return The time spent converting, context creation included.
+ */
+double convert_frames_sws(const std::vector<AVFrame *> &sources,
+                          const std::vector<AVFrame *> &converted) {
+  bench::Stopwatch stopwatch;
+  for (std::size_t i = 0; i < sources.size(); ++i) {
+    const AVFrame *src = sources[i];
+    AVFrame *dst = converted[i];
+    SwsContext *sws_context = sws_getContext(
+        src->width, src->height, static_cast<AVPixelFormat>(src->format),
+        dst->width, dst->height, static_cast<AVPixelFormat>(dst->format),
+        SWS_BILINEAR, nullptr, nullptr, nullptr);
+    const int *bt709 = sws_getCoefficients(SWS_CS_ITU709);
+    sws_setColorspaceDetails(sws_context, bt709, 0, bt709, 0, 0, 1 << 16,
+                             1 << 16);
+    sws_scale(sws_context, src->data, src->linesize, 0, src->height,
+              dst->data, dst->linesize);
+    sws_freeContext(sws_context);
+  }
+  return stopwatch.seconds();
+}
+
+/**
+ * @brief Gets the number of bytes per row of the first plane.
+ */
+int first_plane_bytes(const AVFrame *frame) {
+  return frame->format == AV_PIX_FMT_RGBA ? 4 * frame->width : frame->width;
+}
+
+bool frames_equal(const AVFrame *a, const AVFrame *b) {
+  const int planes = a->format == AV_PIX_FMT_RGBA ? 1 : 3;
+  for (int plane = 0; plane < planes; ++plane) {
+    const int shift = plane == 0 ? 0 : 1;
+    const int bytes = plane == 0 ? first_plane_bytes(a) : a->width >> shift;
+    for (int y = 0; y < a->height >> shift; ++y) {
+      if (std::memcmp(a->data[plane] + y * a->linesize[plane],
+                      b->data[plane] + y * b->linesize[plane], bytes) != 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+} // namespace
+
+int bench::run_simd_bench(const std::vector<std::string> &args) {
+  const std::string path = args.size() > 0 ? args[0] : default_corpus_file();
+  const int count = args.size() > 1 ? std::stoi(args[1]) : 60;
+
+  // STEP 1: Decode the source frames once
+  std::vector<AVFrame *> decoded = decode_video_frames(path, count);
+  if (decoded.empty()) {
+    std::cerr << "Failed to decode " << path << std::endl;
+    return 1;
+  }
+
+  const simd::CpuLevel detected = simd::detect_cpu_level();
+  std::cout << "Converting " << decoded.size() << " frames of " << path
+            << " (" << decoded[0]->width << "x" << decoded[0]->height
+            << "), CPU level " << simd::cpu_level_name(detected)
+            << ", quality against bilinear swscale" << std::endl;
+  std::printf("%-16s %-8s %10s %12s %10s\n", "conversion", "level", "fps",
+              "PSNR", "exact");
+
+  bool all_exact = true;
+  bool all_close = true;
+  for (const Conversion &conversion : CONVERSIONS) {
+    // STEP 2: Convert with the scalar kernels as the reference
+    std::vector<AVFrame *> sources =
+        source_frames(decoded, conversion.src_format);
+    const int width =
+        decoded[0]->width * conversion.numerator / conversion.denominator;
+    const int height =
+        decoded[0]->height * conversion.numerator / conversion.denominator;
+    auto allocate_all = [&] {
+      std::vector<AVFrame *> frames;
+      for (std::size_t i = 0; i < sources.size(); ++i) {
+        frames.push_back(allocate_frame(conversion.dst_format, width, height));
+      }
+      return frames;
+    };
+
+    std::vector<AVFrame *> reference = allocate_all();
+    if (convert_frames(sources, reference, simd::scalar::KERNELS) < 0.0) {
+      std::printf("%-16s not covered at this size\n", conversion.name);
+      free_frames(reference);
+      free_frames(sources);
+      continue;
+    }
+
+    // STEP 3: Time every supported level and check it against scalar
+    std::vector<AVFrame *> converted = allocate_all();
+    for (simd::CpuLevel level :
+         {simd::CpuLevel::Scalar, simd::CpuLevel::Avx2,
+          simd::CpuLevel::Avx512}) {
+      if (level > detected) {
+        continue;
+      }
+      const double seconds =
+          convert_frames(sources, converted, simd::kernels_for(level));
+      bool exact = true;
+      for (std::size_t i = 0; i < converted.size(); ++i) {
+        exact = exact && frames_equal(converted[i], reference[i]);
+      }
+      all_exact = all_exact && exact;
+      std::printf("%-16s %-8s %10.1f %12s %10s\n", conversion.name,
+                  simd::cpu_level_name(level), converted.size() / seconds,
+                  "", exact ? "yes" : "NO");
+    }
+
+    // STEP 4: Time swscale and compare the first plane with it
+    const double sws_seconds = convert_frames_sws(sources, converted);
+    double total_psnr = 0.0;
+    for (std::size_t i = 0; i < converted.size(); ++i) {
+      total_psnr += psnr(reference[i]->data[0], reference[i]->linesize[0],
+                         converted[i]->data[0], converted[i]->linesize[0],
+                         first_plane_bytes(reference[i]), height);
+    }
+    const double mean_psnr = total_psnr / converted.size();
+    all_close = all_close && mean_psnr >= MIN_SWSCALE_PSNR;
+    std::printf("%-16s %-8s %10.1f %12.2f %10s\n", conversion.name, "swscale",
+                converted.size() / sws_seconds, mean_psnr, "-");
+
+    free_frames(converted);
+    free_frames(reference);
+    free_frames(sources);
+  }
+
+  // STEP 5: Cleanup
+  free_frames(decoded);
+  if (!all_exact) {
+    std::cerr << "SIMD kernels differ from the scalar kernels" << std::endl;
+    return 1;
+  }
+  if (!all_close) {
+    std::cerr << "SIMD kernels are under " << MIN_SWSCALE_PSNR
+              << " dB against swscale" << std::endl;
+    return 1;
+  }
+  return 0;
+}
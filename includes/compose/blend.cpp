@@ -0,0 +1,118 @@
+#include "blend.hpp"
+#include "../logging/logger.hpp"
+#include "../pipeline/task_scheduler.hpp"
+#include <vector>
+
+using namespace compose;
+
+namespace {
+/** The number of planes of a YUV420P frame. */
+const int YUV_PLANES = 3;
+/** The rows of a plane blended by one scheduler task. */
+const int ROWS_PER_TASK = 64;
+
+int plane_width(const AVFrame *frame, int plane) {
+  return plane == 0 ? frame->width : (frame->width + 1) / 2;
+}
+
+int plane_height(const AVFrame *frame, int plane) {
+  return plane == 0 ? frame->height : (frame->height + 1) / 2;
+}
+
+std::uint8_t *plane_row(const AVFrame *frame, int plane, int y) {
+  return frame->data[plane] + y * frame->linesize[plane];
+}
+} // namespace
+
+bool compose::mix_frames(const AVFrame *a, const AVFrame *b, AVFrame *dst,
+                         int alpha, const simd::Kernels &kernels) {
+  if (a->format != AV_PIX_FMT_YUV420P || b->format != AV_PIX_FMT_YUV420P ||
+      dst->format != AV_PIX_FMT_YUV420P || a->width != b->width ||
+      a->height != b->height || a->width != dst->width ||
+      a->height != dst->height) {
+    logging::error() << "Frames to mix do not match.";
+    return false;
+  }
+
+  for (int plane = 0; plane < YUV_PLANES; ++plane) {
+    auto mix_plane_rows = [&](int first, int last) {
+      for (int y = first; y < last; ++y) {
+        kernels.mix_rows(plane_row(a, plane, y), plane_row(b, plane, y),
+                         plane_row(dst, plane, y), plane_width(a, plane),
+                         alpha);
+      }
+    };
+    pipeline::parallel_for(0, plane_height(a, plane), ROWS_PER_TASK,
+                           mix_plane_rows);
+  }
+  return true;
+}
+
+bool compose::blend_over(const AVFrame *src, AVFrame *canvas,
+                         const Rect &rect, int opacity,
+                         const simd::Kernels &kernels) {
+  // STEP 1: Check the frames
+  const bool has_alpha = src->format == AV_PIX_FMT_YUVA420P;
+  if ((!has_alpha && src->format != AV_PIX_FMT_YUV420P) ||
+      canvas->format != AV_PIX_FMT_YUV420P || src->width != rect.width ||
+      src->height != rect.height || rect.x % 2 != 0 || rect.y % 2 != 0 ||
+      rect.width % 2 != 0 || rect.height % 2 != 0 ||
+      rect.x + rect.width > canvas->width ||
+      rect.y + rect.height > canvas->height) {
+    logging::error() << "Frame to blend does not fit the canvas.";
+    return false;
+  }
+
+  // STEP 2: Without an alpha plane, mix each row with the opacity
+  if (!has_alpha) {
+    for (int plane = 0; plane < YUV_PLANES; ++plane) {
+      const int shift = plane == 0 ? 0 : 1;
+      auto mix_plane_rows = [&](int first, int last) {
+        for (int y = first; y < last; ++y) {
+          std::uint8_t *canvas_row =
+              plane_row(canvas, plane, (rect.y >> shift) + y) +
+              (rect.x >> shift);
+          kernels.mix_rows(plane_row(src, plane, y), canvas_row, canvas_row,
+                           plane_width(src, plane), opacity);
+        }
+      };
+      pipeline::parallel_for(0, plane_height(src, plane), ROWS_PER_TASK,
+                             mix_plane_rows);
+    }
+    return true;
+  }
+
+  // STEP 3: With an alpha plane, scale two luma rows of alpha by the
+  // opacity at a time, then average them down for the chroma row. Every
+  // task works on its own pairs of rows with its own scratch rows.
+  const int width = src->width;
+  const std::vector<std::uint8_t> transparent(width, 0);
+  auto blend_row_pairs = [&](int first, int last) {
+    std::vector<std::uint8_t> alpha(2 * width);
+    std::vector<std::uint8_t> chroma_alpha(width / 2);
+    for (int y = 2 * first; y < 2 * last; y += 2) {
+      for (int row = 0; row < 2; ++row) {
+        std::uint8_t *alpha_row = alpha.data() + row * width;
+        kernels.mix_rows(plane_row(src, 3, y + row), transparent.data(),
+                         alpha_row, width, opacity);
+        kernels.alpha_over_row(plane_row(src, 0, y + row), alpha_row,
+                               plane_row(canvas, 0, rect.y + y + row) +
+                                   rect.x,
+                               width);
+      }
+
+      kernels.downscale_rows_2(alpha.data(), alpha.data() + width,
+                               chroma_alpha.data(), width / 2);
+      for (int plane = 1; plane < YUV_PLANES; ++plane) {
+        kernels.alpha_over_row(plane_row(src, plane, y / 2),
+                               chroma_alpha.data(),
+                               plane_row(canvas, plane, (rect.y + y) / 2) +
+                                   rect.x / 2,
+                               width / 2);
+      }
+    }
+  };
+  pipeline::parallel_for(0, src->height / 2, ROWS_PER_TASK / 2,
+                         blend_row_pairs);
+  return true;
+}
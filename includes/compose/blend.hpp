@@ -0,0 +1,42 @@
+#ifndef COMPOSE_BLEND
+#define COMPOSE_BLEND
+
+#include "../simd/kernels.hpp"
+#include "layout.hpp"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace compose {
+/**
+ * @brief Mixes two YUV420P frames of the same size with a constant alpha,
+ * as used for crossfades.
+ * @param a The first frame.
+ * @param b The second frame.
+ * @param dst The destination frame. May be `a` or `b`.
+ * @param alpha The alpha of the first frame, 0 to 255.
+ * @param kernels The kernels to blend with.
+ * @return `true` if the frames were mixed, `false` if they do not match.
+ */
+bool mix_frames(const AVFrame *a, const AVFrame *b, AVFrame *dst, int alpha,
+                const simd::Kernels &kernels = simd::active_kernels());
+
+/**
+ * @brief Blends a frame over a rectangle of a YUV420P canvas.
+ *
+ * A YUVA420P frame is blended with its alpha plane scaled by the opacity,
+ * and the chroma alpha is the average of each 2x2 luma alpha block. Any
+ * other frame is mixed with the opacity alone.
+ * @param src The YUV420P or YUVA420P frame, the size of the rectangle.
+ * @param canvas The YUV420P canvas.
+ * @param rect The rectangle of the canvas, with an even position and size.
+ * @param opacity The opacity of the frame, 0 to 255.
+ * @param kernels The kernels to blend with.
+ * @return `true` if the frame was blended, `false` if it does not fit.
+ */
+bool blend_over(const AVFrame *src, AVFrame *canvas, const Rect &rect,
+                int opacity,
+                const simd::Kernels &kernels = simd::active_kernels());
+} // namespace compose
+#endif
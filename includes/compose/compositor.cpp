@@ -0,0 +1,185 @@
+#include "compositor.hpp"
+#include "../logging/logger.hpp"
+#include "blend.hpp"
+#include <cstring>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+using namespace compose;
+
+namespace {
+/**
+ * @brief Gets the plane pointers of a frame offset to the top left corner
+ * of a rectangle.
+ * @param frame The frame.
+ * @param rect The rectangle.
+ * @param data Set to the offset plane pointers.
+ * @return `true` if the pointers were set, `false` if the pixel format
+ * cannot be addressed this way.
+ */
+bool offset_planes(const AVFrame *frame, const Rect &rect,
+                   std::uint8_t *data[AV_NUM_DATA_POINTERS]) {
+  const AVPixFmtDescriptor *descriptor =
+      av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+  if (!descriptor ||
+      descriptor->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL)) {
+    return false;
+  }
+
+  int max_step[4];
+  av_image_fill_max_pixsteps(max_step, nullptr, descriptor);
+  for (int plane = 0; plane < AV_NUM_DATA_POINTERS; ++plane) {
+    if (plane >= 4 || !frame->data[plane]) {
+      data[plane] = nullptr;
+      continue;
+    }
+    const bool chroma = plane == 1 || plane == 2;
+    const int shift_x = chroma ? descriptor->log2_chroma_w : 0;
+    const int shift_y = chroma ? descriptor->log2_chroma_h : 0;
+    data[plane] = frame->data[plane] +
+                  (rect.y >> shift_y) * frame->linesize[plane] +
+                  (rect.x >> shift_x) * max_step[plane];
+  }
+  return true;
+}
+
+bool has_alpha(const AVFrame *frame) {
+  const AVPixFmtDescriptor *descriptor =
+      av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+  return descriptor && descriptor->flags & AV_PIX_FMT_FLAG_ALPHA;
+}
+
+bool contains(const AVFrame *frame, const Rect &rect) {
+  return rect.x >= 0 && rect.y >= 0 && rect.width > 0 && rect.height > 0 &&
+         rect.x + rect.width <= frame->width &&
+         rect.y + rect.height <= frame->height;
+}
+} // namespace
+
+Compositor::Compositor()
+    : blend_frames_(), contexts_(),
+      scale_algorithm_(frame::ScaleAlgorithm::Bicubic) {}
+
+void Compositor::set_scale_algorithm(frame::ScaleAlgorithm algorithm) {
+  scale_algorithm_ = algorithm;
+}
+
+bool Compositor::place(std::size_t slot, const AVFrame *src_frame,
+                       const Rect &src_rect, AVFrame *canvas,
+                       const Rect &dst_rect) {
+  // STEP 1: Check the rectangles
+  if (!contains(src_frame, src_rect) || !contains(canvas, dst_rect) ||
+      dst_rect.x % 2 != 0 || dst_rect.y % 2 != 0 || dst_rect.width % 2 != 0 ||
+      dst_rect.height % 2 != 0) {
+    logging::error() << "Invalid rectangle to place.";
+    return false;
+  }
+
+  // STEP 2: Get the scaler context of the slot, recreated only if the
+  // placement changed since the last frame
+  if (slot >= contexts_.size()) {
+    contexts_.resize(slot + 1);
+  }
+  SwsContext *context = ffmpeg::update_sws_context(
+      contexts_[slot], src_rect.width, src_rect.height,
+      static_cast<AVPixelFormat>(src_frame->format), dst_rect.width,
+      dst_rect.height, static_cast<AVPixelFormat>(canvas->format),
+      frame::to_sws_flags(scale_algorithm_));
+  if (!context) {
+    logging::error() << "Failed to initialize the image converter.";
+    return false;
+  }
+
+  // STEP 3: Scale straight from the source rectangle into the canvas
+  std::uint8_t *src_data[AV_NUM_DATA_POINTERS];
+  std::uint8_t *dst_data[AV_NUM_DATA_POINTERS];
+  if (!offset_planes(src_frame, src_rect, src_data) ||
+      !offset_planes(canvas, dst_rect, dst_data)) {
+    logging::error() << "Unsupported pixel format to place.";
+    return false;
+  }
+  sws_scale(context, src_data, src_frame->linesize, 0, src_rect.height,
+            dst_data, canvas->linesize);
+  return true;
+}
+
+bool Compositor::compose(const Layout &layout,
+                         const std::vector<AVFrame *> &frames,
+                         AVFrame *canvas) {
+  // STEP 1: Clear the canvas so empty regions are black
+  clear(canvas);
+
+  // STEP 2: Fill every region with its source
+  bool composed = true;
+  for (std::size_t index = 0; index < layout.regions.size(); ++index) {
+    const Region &region = layout.regions[index];
+    if (region.source >= frames.size() || !frames[region.source]) {
+      continue;
+    }
+
+    const AVFrame *source = frames[region.source];
+    const Rect src_rect = fill_crop(source->width, source->height, region.rect);
+    const bool source_has_alpha = has_alpha(source);
+    if (region.opacity >= OPAQUE && !source_has_alpha) {
+      composed =
+          place(index, source, src_rect, canvas, region.rect) && composed;
+      continue;
+    }
+
+    // Translucent regions are scaled on their own first, then blended
+    AVFrame *blended = blend_frame(index, region.rect, source_has_alpha);
+    const Rect blended_rect = {0, 0, region.rect.width, region.rect.height};
+    composed = blended &&
+               place(index, source, src_rect, blended, blended_rect) &&
+               blend_over(blended, canvas, region.rect, region.opacity) &&
+               composed;
+  }
+  return composed;
+}
+
+AVFrame *Compositor::blend_frame(std::size_t slot, const Rect &rect,
+                                 bool has_alpha) {
+  if (slot >= blend_frames_.size()) {
+    blend_frames_.resize(slot + 1);
+  }
+
+  // STEP 1: Reuse the frame of the last call if it still fits
+  const int format = has_alpha ? AV_PIX_FMT_YUVA420P : AV_PIX_FMT_YUV420P;
+  ffmpeg::FramePtr &blended = blend_frames_[slot];
+  if (blended && blended->format == format && blended->width == rect.width &&
+      blended->height == rect.height) {
+    return blended.get();
+  }
+
+  // STEP 2: Allocate a new one
+  blended = ffmpeg::make_frame();
+  if (!blended) {
+    logging::error() << "Failed to allocate the blend frame.";
+    return nullptr;
+  }
+  blended->format = format;
+  blended->width = rect.width;
+  blended->height = rect.height;
+  if (av_frame_get_buffer(blended.get(), 32) < 0) {
+    logging::error() << "Failed to allocate the blend frame buffer.";
+    blended.reset();
+    return nullptr;
+  }
+  return blended.get();
+}
+
+void Compositor::clear(AVFrame *canvas) {
+  const int values[3] = {16, 128, 128};
+  for (int plane = 0; plane < 3; ++plane) {
+    const int shift = plane == 0 ? 0 : 1;
+    const int width = (canvas->width + shift) >> shift;
+    const int height = (canvas->height + shift) >> shift;
+    for (int y = 0; y < height; ++y) {
+      std::memset(canvas->data[plane] + y * canvas->linesize[plane],
+                  values[plane], width);
+    }
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef COMPOSE_COMPOSITOR
+#define COMPOSE_COMPOSITOR
+
+#include "../ffmpeg/handles.hpp"
+#include "../frame/scaler.hpp"
+#include "layout.hpp"
+#include <cstddef>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace compose {
+/**
+ * @brief Writes source rectangles straight into their destination
+ * rectangles on an output canvas.
+ *
+ * Cropping, scaling, pixel format conversion and placement happen in a
+ * single sws_scale() call per rectangle: the source and destination plane
+ * pointers are offset to the rectangles, so no intermediate frame is
+ * allocated or written.
+ */
+class Compositor {
+public:
+  /**
+   * @brief Constructs a Compositor object.
+   */
+  Compositor();
+
+  Compositor(const Compositor &) = delete;
+  Compositor &operator=(const Compositor &) = delete;
+  Compositor(Compositor &&) = default;
+  Compositor &operator=(Compositor &&) = default;
+
+  /**
+   * @brief Sets the algorithm rectangles are scaled with.
+   * @param algorithm The scaler algorithm.
+   */
+  void set_scale_algorithm(frame::ScaleAlgorithm algorithm);
+
+  /**
+   * @brief Scales a rectangle of a frame into a rectangle of the canvas.
+   * @param slot The scaler context to use. Each placement that recurs on
+   * every frame should have its own slot so its context is reused.
+   * @param src_frame The source frame.
+   * @param src_rect The rectangle of the source frame to read.
+   * @param canvas The YUV420P canvas.
+   * @param dst_rect The rectangle of the canvas to write. Its position and
+   * size must be even.
+   * @return `true` if the rectangle was placed, `false` otherwise.
+   */
+  bool place(std::size_t slot, const AVFrame *src_frame, const Rect &src_rect,
+             AVFrame *canvas, const Rect &dst_rect);
+
+  /**
+   * @brief Composes one output frame from the current frame of each source.
+   *
+   * The canvas is cleared to black, then every region of the layout is
+   * filled with the center of its source, cropped to the region's aspect
+   * ratio. Regions whose source has no frame stay black. Opaque regions
+   * without alpha are placed straight on the canvas; translucent ones and
+   * sources with an alpha channel are scaled into a region-sized frame and
+   * blended over the canvas.
+   * @param layout The layout.
+   * @param frames The current frame of each source, nullptr if none.
+   * @param canvas The YUV420P canvas, the size of the layout.
+   * @return `true` if every region was composed, `false` otherwise.
+   */
+  bool compose(const Layout &layout, const std::vector<AVFrame *> &frames,
+               AVFrame *canvas);
+
+  /**
+   * @brief Clears a YUV420P canvas to black.
+   * @param canvas The canvas.
+   */
+  static void clear(AVFrame *canvas);
+
+private:
+  /**
+   * @brief Gets the region-sized frame to scale a blended source into.
+   * @param slot The slot of the region.
+   * @param rect The rectangle of the region.
+   * @param has_alpha Whether the source has an alpha channel.
+   * @return The frame, nullptr if it could not be allocated.
+   */
+  AVFrame *blend_frame(std::size_t slot, const Rect &rect, bool has_alpha);
+
+  std::vector<ffmpeg::FramePtr>
+      blend_frames_; /**< The blend frame of each slot. */
+  std::vector<ffmpeg::SwsContextPtr>
+      contexts_; /**< The scaler context of each slot. */
+  frame::ScaleAlgorithm scale_algorithm_; /**< The algorithm to scale with. */
+};
+} // namespace compose
+#endif
@@ -0,0 +1,119 @@
+#include "layout.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+using namespace compose;
+
+Layout Layout::vertical_stack(std::size_t sources, int width, int height) {
+  Layout layout;
+  layout.width = width;
+  layout.height = height;
+  if (sources == 0) {
+    return layout;
+  }
+
+  // Keep every region even so the chroma planes line up
+  const int region_height = (height / static_cast<int>(sources)) & ~1;
+  for (std::size_t source = 0; source < sources; ++source) {
+    Region region;
+    region.source = source;
+    region.rect.x = 0;
+    region.rect.y = static_cast<int>(source) * region_height;
+    region.rect.width = width;
+    region.rect.height = region_height;
+    layout.regions.push_back(region);
+  }
+  return layout;
+}
+
+Layout Layout::picture_in_picture(int opacity, int width, int height) {
+  Layout layout;
+  layout.width = width;
+  layout.height = height;
+
+  Region background;
+  background.source = 0;
+  background.rect = {0, 0, width, height};
+  layout.regions.push_back(background);
+
+  Region inset;
+  inset.source = 1;
+  inset.rect.width = (width / 4) & ~1;
+  inset.rect.height = (height / 4) & ~1;
+  const int margin = (width / 32) & ~1;
+  inset.rect.x = width - inset.rect.width - margin;
+  inset.rect.y = height - inset.rect.height - margin;
+  inset.opacity = opacity;
+  layout.regions.push_back(inset);
+  return layout;
+}
+
+Layout Layout::overlay(int opacity, int width, int height) {
+  Layout layout;
+  layout.width = width;
+  layout.height = height;
+  for (std::size_t source = 0; source < 2; ++source) {
+    Region region;
+    region.source = source;
+    region.rect = {0, 0, width, height};
+    region.opacity = source == 0 ? OPAQUE : opacity;
+    layout.regions.push_back(region);
+  }
+  return layout;
+}
+
+Layout compose::make_layout(LayoutKind kind, int opacity) {
+  switch (kind) {
+  case LayoutKind::Interleave:
+    return Layout();
+  case LayoutKind::Vertical:
+    return Layout::vertical_stack(2);
+  case LayoutKind::PictureInPicture:
+    return Layout::picture_in_picture(opacity);
+  case LayoutKind::Overlay:
+    return Layout::overlay(opacity);
+  }
+  return Layout();
+}
+
+LayoutKind compose::parse_layout_kind(const std::string &name) {
+  if (name == "interleave") {
+    return LayoutKind::Interleave;
+  }
+  if (name == "vertical") {
+    return LayoutKind::Vertical;
+  }
+  if (name == "pip") {
+    return LayoutKind::PictureInPicture;
+  }
+  if (name == "overlay") {
+    return LayoutKind::Overlay;
+  }
+  throw std::invalid_argument("Unknown layout: " + name);
+}
+
+Rect compose::fill_crop(int src_width, int src_height, const Rect &dst) {
+  Rect rect;
+  rect.width = src_width;
+  rect.height = src_height;
+
+  // STEP 1: Cut the sides or the top and bottom, whichever is too long.
+  // The aspect ratios are compared cross-multiplied to stay in integers.
+  const std::int64_t src_aspect =
+      static_cast<std::int64_t>(src_width) * dst.height;
+  const std::int64_t dst_aspect =
+      static_cast<std::int64_t>(dst.width) * src_height;
+  if (src_aspect > dst_aspect) {
+    rect.width = static_cast<int>(dst_aspect / dst.height);
+  } else if (src_aspect < dst_aspect) {
+    rect.height = static_cast<int>(src_aspect / dst.width);
+  }
+
+  // STEP 2: Center it on even coordinates
+  rect.width = std::max(2, rect.width & ~1);
+  rect.height = std::max(2, rect.height & ~1);
+  rect.x = ((src_width - rect.width) / 2) & ~1;
+  rect.y = ((src_height - rect.height) / 2) & ~1;
+  return rect;
+}
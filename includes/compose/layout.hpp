@@ -0,0 +1,111 @@
+#ifndef COMPOSE_LAYOUT
+#define COMPOSE_LAYOUT
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace compose {
+/**
+ * @brief A rectangle of a frame, in pixels.
+ */
+struct Rect {
+  int x = 0;      /**< The left edge. */
+  int y = 0;      /**< The top edge. */
+  int width = 0;  /**< The width. */
+  int height = 0; /**< The height. */
+};
+
+/**
+ * @brief How the sources are arranged in the output.
+ */
+enum class LayoutKind {
+  Interleave,       /**< The sources' frames alternate at full size. */
+  Vertical,         /**< The sources are stacked on a 1080x1920 canvas. */
+  PictureInPicture, /**< The second source is inset over the first. */
+  Overlay,          /**< The second source covers the first, translucent. */
+};
+
+/** The opacity of a fully opaque region. */
+static const int OPAQUE = 255;
+
+/**
+ * @brief A part of the canvas showing one source.
+ */
+struct Region {
+  std::size_t source = 0; /**< The index of the source shown. */
+  Rect rect;              /**< Where the source is placed on the canvas. */
+  int opacity = OPAQUE;   /**< The opacity of the source, 0 to 255. */
+};
+
+/**
+ * @brief The canvas of the output and where each source is placed on it.
+ */
+struct Layout {
+  int width = 0;               /**< The width of the canvas. */
+  int height = 0;              /**< The height of the canvas. */
+  std::vector<Region> regions; /**< The regions, drawn in order. */
+
+  /**
+   * @brief Creates a layout stacking the sources top to bottom in regions
+   * of equal height.
+   * @param sources The number of sources.
+   * @param width The width of the canvas.
+   * @param height The height of the canvas.
+   * @return The layout.
+   */
+  static Layout vertical_stack(std::size_t sources, int width = 1080,
+                               int height = 1920);
+
+  /**
+   * @brief Creates a layout showing the first source on the whole canvas and
+   * the second one inset in the bottom right corner at a quarter of the
+   * canvas width.
+   * @param opacity The opacity of the inset, 0 to 255.
+   * @param width The width of the canvas.
+   * @param height The height of the canvas.
+   * @return The layout.
+   */
+  static Layout picture_in_picture(int opacity = OPAQUE, int width = 1920,
+                                   int height = 1080);
+
+  /**
+   * @brief Creates a layout showing the second source over the first one,
+   * both on the whole canvas.
+   * @param opacity The opacity of the second source, 0 to 255.
+   * @param width The width of the canvas.
+   * @param height The height of the canvas.
+   * @return The layout.
+   */
+  static Layout overlay(int opacity, int width = 1920, int height = 1080);
+};
+
+/**
+ * @brief Creates the layout of a kind for two sources.
+ * @param kind The layout kind.
+ * @param opacity The opacity of the source on top, for the kinds that have
+ * one.
+ * @return The layout, without regions for LayoutKind::Interleave.
+ */
+Layout make_layout(LayoutKind kind, int opacity);
+
+/**
+ * @brief Parses the name of a layout kind.
+ * @param name "interleave", "vertical", "pip" or "overlay".
+ * @return The layout kind.
+ * @throws std::invalid_argument if the name is unknown.
+ */
+LayoutKind parse_layout_kind(const std::string &name);
+
+/**
+ * @brief Gets the largest centered rectangle of a source with the aspect
+ * ratio of a destination, so the source fills the destination without
+ * being stretched.
+ * @param src_width The width of the source.
+ * @param src_height The height of the source.
+ * @param dst The destination rectangle.
+ * @return The source rectangle, with an even position and size.
+ */
+Rect fill_crop(int src_width, int src_height, const Rect &dst);
+} // namespace compose
+#endif
@@ -0,0 +1,49 @@
+#include "handles.hpp"
+
+void ffmpeg::FrameDeleter::operator()(AVFrame *frame) const {
+  av_frame_free(&frame);
+}
+
+void ffmpeg::PacketDeleter::operator()(AVPacket *packet) const {
+  av_packet_free(&packet);
+}
+
+void ffmpeg::CodecContextDeleter::operator()(
+    AVCodecContext *codec_context) const {
+  avcodec_free_context(&codec_context);
+}
+
+void ffmpeg::InputContextDeleter::operator()(
+    AVFormatContext *format_context) const {
+  avformat_close_input(&format_context);
+}
+
+void ffmpeg::OutputContextDeleter::operator()(
+    AVFormatContext *format_context) const {
+  if (format_context->pb && !(format_context->oformat->flags & AVFMT_NOFILE)) {
+    avio_closep(&format_context->pb);
+  }
+  avformat_free_context(format_context);
+}
+
+void ffmpeg::SwsContextDeleter::operator()(SwsContext *sws_context) const {
+  sws_freeContext(sws_context);
+}
+
+ffmpeg::FramePtr ffmpeg::make_frame() { return FramePtr(av_frame_alloc()); }
+
+ffmpeg::PacketPtr ffmpeg::make_packet() {
+  return PacketPtr(av_packet_alloc());
+}
+
+SwsContext *ffmpeg::update_sws_context(SwsContextPtr &context, int src_width,
+                                       int src_height,
+                                       AVPixelFormat src_format,
+                                       int dst_width, int dst_height,
+                                       AVPixelFormat dst_format, int flags) {
+  context.reset(sws_getCachedContext(context.release(), src_width, src_height,
+                                     src_format, dst_width, dst_height,
+                                     dst_format, flags, nullptr, nullptr,
+                                     nullptr));
+  return context.get();
+}
@@ -0,0 +1,91 @@
+#ifndef FFMPEG_HANDLES
+#define FFMPEG_HANDLES
+
+#include <memory>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace ffmpeg {
+/** @brief Frees an AVFrame with av_frame_free(). */
+struct FrameDeleter {
+  void operator()(AVFrame *frame) const;
+};
+
+/** @brief Frees an AVPacket with av_packet_free(). */
+struct PacketDeleter {
+  void operator()(AVPacket *packet) const;
+};
+
+/** @brief Frees an AVCodecContext with avcodec_free_context(). */
+struct CodecContextDeleter {
+  void operator()(AVCodecContext *codec_context) const;
+};
+
+/** @brief Closes an input AVFormatContext with avformat_close_input(). */
+struct InputContextDeleter {
+  void operator()(AVFormatContext *format_context) const;
+};
+
+/**
+ * @brief Closes the file of an output AVFormatContext, if it opened one, and
+ * frees the context.
+ */
+struct OutputContextDeleter {
+  void operator()(AVFormatContext *format_context) const;
+};
+
+/** @brief Frees a SwsContext with sws_freeContext(). */
+struct SwsContextDeleter {
+  void operator()(SwsContext *sws_context) const;
+};
+
+/** @brief An owned AVFrame. */
+using FramePtr = std::unique_ptr<AVFrame, FrameDeleter>;
+/** @brief An owned AVPacket. */
+using PacketPtr = std::unique_ptr<AVPacket, PacketDeleter>;
+/** @brief An owned AVCodecContext. */
+using CodecContextPtr = std::unique_ptr<AVCodecContext, CodecContextDeleter>;
+/** @brief An owned AVFormatContext opened for reading. */
+using InputContextPtr = std::unique_ptr<AVFormatContext, InputContextDeleter>;
+/** @brief An owned AVFormatContext allocated for writing. */
+using OutputContextPtr =
+    std::unique_ptr<AVFormatContext, OutputContextDeleter>;
+/** @brief An owned SwsContext. */
+using SwsContextPtr = std::unique_ptr<SwsContext, SwsContextDeleter>;
+
+/**
+ * @brief Allocates a frame.
+ * @return The frame, empty if allocation failed.
+ */
+FramePtr make_frame();
+
+/**
+ * @brief Allocates a packet.
+ * @return The packet, empty if allocation failed.
+ */
+PacketPtr make_packet();
+
+/**
+ * @brief Updates a cached scaler context, like sws_getCachedContext(), which
+ * frees the context it replaces.
+ * @param context The context to reuse or replace. Empty if it failed.
+ * @param src_width The source width.
+ * @param src_height The source height.
+ * @param src_format The source pixel format.
+ * @param dst_width The destination width.
+ * @param dst_height The destination height.
+ * @param dst_format The destination pixel format.
+ * @param flags The swscale flags.
+ * @return The context, nullptr if it could not be created.
+ */
+SwsContext *update_sws_context(SwsContextPtr &context, int src_width,
+                               int src_height, AVPixelFormat src_format,
+                               int dst_width, int dst_height,
+                               AVPixelFormat dst_format, int flags);
+} // namespace ffmpeg
+#endif
@@ -1,8 +1,16 @@
 #include "combiner.hpp"
+#include "../simd/convert.hpp"
+#include "../compose/blend.hpp"
+#include "../logging/logger.hpp"
+#include "../pipeline/task_scheduler.hpp"
+#include "frame_manifest.hpp"
 #include <algorithm>
-#include <filesystem>
+#include <cmath>
+#include <cstring>
+#include <deque>
 #include <fstream>
-#include <iostream>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -19,143 +27,707 @@ extern "C" {
 
 using namespace frame;
 
+/** The default width of the output video. */
+static const int OUTPUT_WIDTH = 1920;
+/** The default height of the output video. */
+static const int OUTPUT_HEIGHT = 1080;
+/** The frames each rendition may fall behind the main output. */
+static const std::size_t RENDITION_QUEUE_FRAMES = 4;
+/** The PNGs per scheduler worker decoded ahead of the encoder. */
+static const std::size_t PNG_FRAMES_PER_WORKER = 2;
+
+Combiner::Rendition::Rendition(const OutputSpec &spec,
+                               pipeline::MemoryBudget *budget)
+    : spec(spec), own_budget(std::numeric_limits<std::size_t>::max()),
+      queue(budget ? *budget : own_budget, RENDITION_QUEUE_FRAMES), encoder(),
+      thread(), stats() {}
+
 Combiner::Combiner(const std::string &png_dir)
-    : png_dir(png_dir), frames(), png_files(), format_context_(nullptr),
-      codec_context_(nullptr), stream_(nullptr), frame_(nullptr) {}
+    : png_dir(png_dir), frames(), png_files(), file_formats(),
+      encoder_(), frame_(),
+      fragment_seconds_(0.0), input_options_(), concatenate_(false),
+      scale_algorithm_(ScaleAlgorithm::Bicubic), simd_kernels_(true),
+      frame_allocator_(nullptr),
+      output_width_(OUTPUT_WIDTH), output_height_(OUTPUT_HEIGHT), layout_(),
+      compositor_(), crossfade_frames_(0),
+      keyframe_seconds_(DEFAULT_KEYFRAME_SECONDS), encoder_threads_(0),
+      scene_detector_(),
+      renditions_(), cancel_flag_(nullptr), progress_counters_(nullptr),
+      memory_budget_(nullptr) {}
 
 Combiner::~Combiner() { cleanup_resources(); }
 
-void Combiner::combine_frames_to_video(
+bool Combiner::combine_frames_to_video(
     const std::string &output_filename) {
-  // STEP 1: Set up video codec
-  setup_video_codec();
-
-  // STEP 2: Open the output file
-  open_output_file(output_filename);
+  // STEP 1: Open the output files
+  if (!open_outputs(output_filename)) {
+    return false;
+  }
 
-  // STEP 3: Get PNG files in the directory
-  get_png_files_in_dir();
+  // STEP 2: Get the PNG files from the frame manifest
+  const bool listed = read_png_files_from_manifest();
 
-  // STEP 4: Convert PNGs to frames
-  convert_pngs_to_frames();
+  // STEP 3: Convert PNGs to frames
+  const bool converted = listed && convert_pngs_to_frames();
 
-  // STEP 5: Process the frames
+  // STEP 4: Process the frames
   process_frames();
 
-  // STEP 6: Write the trailer
-  write_trailer();
+  // STEP 5: Write the trailer
+  return write_trailer() && converted;
 }
 
-void Combiner::get_png_files_in_dir() {
-  std::filesystem::path path(png_dir);
+bool Combiner::combine_queues_to_video(
+    const std::vector<pipeline::FrameQueue *> &sources,
+    const std::string &output_filename) {
+  // STEP 1: Open the output files
+  if (!open_outputs(output_filename)) {
+    // Stop the extractors instead of leaving them blocked on full queues
+    for (pipeline::FrameQueue *source : sources) {
+      source->close();
+    }
+    return false;
+  }
+
+  // STEP 2: Process the queued frames
+  bool processed = false;
+  if (!layout_.regions.empty()) {
+    processed = process_composed_frames(sources);
+  } else if (concatenate_ && crossfade_frames_ > 0) {
+    processed = process_crossfaded_frames(sources);
+  } else {
+    processed = process_queued_frames(sources);
+  }
 
-  // STEP 1: Check if the directory exists and is a valid directory
-  if (!std::filesystem::exists(path) || !std::filesystem::is_directory(path)) {
-    std::cerr << "Invalid png_dir: " << png_dir << std::endl;
-    return;
+  // STEP 3: Write the trailer
+  return write_trailer() && processed;
+}
+
+bool Combiner::open_outputs(const std::string &output_filename) {
+  // STEP 1: Open the main output
+  OutputSpec spec;
+  spec.filename = output_filename;
+  spec.width = output_width_;
+  spec.height = output_height_;
+  encoder_.set_fragment_duration(fragment_seconds_);
+  encoder_.set_keyframe_interval(keyframe_seconds_);
+  encoder_.set_threads(encoder_threads_);
+  if (!encoder_.open(spec)) {
+    return false;
   }
 
-  // STEP 2: Iterate through the directory entries
-  for (const auto &entry : std::filesystem::directory_iterator(path)) {
-    // STEP 3: Check if the entry is a regular file with the ".png" extension
-    if (entry.is_regular_file() && entry.path().extension() == ".png") {
-      // STEP 4: Add the file path to the png_files vector
-      png_files.push_back(entry.path().string());
+  // STEP 2: Open every rendition and start its encoder thread. A rendition
+  // that fails to open closes its queue, so it never holds the others up.
+  for (std::unique_ptr<Rendition> &rendition : renditions_) {
+    rendition->encoder.set_fragment_duration(fragment_seconds_);
+    rendition->encoder.set_keyframe_interval(keyframe_seconds_);
+    rendition->encoder.set_threads(encoder_threads_);
+    rendition->encoder.set_progress_counters(progress_counters_);
+    if (!rendition->encoder.open(rendition->spec)) {
+      logging::error() << "Failed to open the rendition "
+                       << rendition->spec.filename;
+      rendition->queue.close();
+      continue;
     }
+    // The thread scales for the same job as this one
+    Rendition &started = *rendition;
+    const std::size_t job = pipeline::TaskScheduler::current_job();
+    rendition->thread = std::thread([this, &started, job] {
+      pipeline::TaskScheduler::set_current_job(job);
+      run_rendition(started);
+    });
   }
 
-  // STEP 5: Sort the png_files vector
-  std::sort(png_files.begin(), png_files.end());
+  return true;
 }
 
-void Combiner::write_trailer() { av_write_trailer(format_context_); }
+void Combiner::run_rendition(Rendition &rendition) {
+  const pipeline::StageTimer timer("encode " + rendition.spec.filename);
+  logging::set_thread_stage("encode " + rendition.spec.filename);
+  ffmpeg::SwsContextPtr sws_context;
+  bool failed = false;
 
-void Combiner::open_output_file(const std::string &output_filename) {
-  // STEP 1: Create the format context
-  if (avformat_alloc_output_context2(&format_context_, nullptr, nullptr,
-                                     output_filename.c_str()) < 0) {
-    std::cerr << "Failed to allocate the output format context." << std::endl;
-    return;
+  while (AVFrame *popped = rendition.queue.pop()) {
+    const ffmpeg::FramePtr frame(popped);
+    if (failed) {
+      continue;
+    }
+
+    // STEP 1: Scale the frame of the main output to the rendition's size.
+    // Its pts and picture type carry over, so the keyframes of every
+    // rendition line up.
+    const ffmpeg::FramePtr scaled =
+        scale_to_rendition(frame.get(), rendition.spec, sws_context);
+
+    // STEP 2: Encode and write the frame. After a failure the remaining
+    // frames are only drained, and the main output goes on.
+    if (!scaled || !rendition.encoder.encode(scaled.get())) {
+      logging::error().frame(frame->pts)
+          << "Failed to encode the rendition " << rendition.spec.filename;
+      rendition.queue.close();
+      failed = true;
+    }
   }
 
-  // STEP 2: Find the video output format
-  const AVOutputFormat *output_format = format_context_->oformat;
+  // STEP 3: Write the trailer
+  rendition.encoder.finish();
+  rendition.stats = timer.stop();
+}
 
-  // STEP 3: Create a new video stream
-  stream_ = avformat_new_stream(format_context_, nullptr);
-  if (!stream_) {
-    std::cerr << "Failed to allocate the video stream." << std::endl;
-    return;
+bool Combiner::get_frame_buffer(AVFrame *frame) const {
+  if (frame_allocator_) {
+    return frame_allocator_->get_buffer(frame);
   }
+  return av_frame_get_buffer(frame, 32) >= 0;
+}
 
-  // STEP 4: Set the codec parameters for the video stream
-  AVCodecParameters *codec_parameters = stream_->codecpar;
-  codec_parameters->codec_id = output_format->video_codec;
-  codec_parameters->codec_type = AVMEDIA_TYPE_VIDEO;
-  codec_parameters->width = codec_context_->width;
-  codec_parameters->height = codec_context_->height;
-  codec_parameters->format = codec_context_->pix_fmt;
+ffmpeg::FramePtr
+Combiner::scale_to_rendition(const AVFrame *frame, const OutputSpec &spec,
+                             ffmpeg::SwsContextPtr &sws_context) const {
+  // STEP 1: Allocate the scaled frame
+  ffmpeg::FramePtr scaled = ffmpeg::make_frame();
+  if (!scaled) {
+    return nullptr;
+  }
+  scaled->format = OUTPUT_PIXEL_FORMAT;
+  scaled->width = spec.width;
+  scaled->height = spec.height;
+  if (!get_frame_buffer(scaled.get()) ||
+      av_frame_copy_props(scaled.get(), frame) < 0) {
+    return nullptr;
+  }
 
-  // STEP 5: Open the output file
-  if (avio_open(&format_context_->pb, output_filename.c_str(),
-                AVIO_FLAG_WRITE) < 0) {
-    std::cerr << "Failed to open the output file." << std::endl;
-    return;
+  // STEP 2: Scale it with the SIMD kernels if they cover the sizes, such as
+  // a half-size rendition, and with swscale otherwise
+  if (simd_kernels_ && kernels_match(scale_algorithm_, frame, scaled.get()) &&
+      simd::convert_frame(frame, scaled.get())) {
+    return scaled;
+  }
+  SwsContext *context = ffmpeg::update_sws_context(
+      sws_context, frame->width, frame->height,
+      static_cast<AVPixelFormat>(frame->format), spec.width, spec.height,
+      OUTPUT_PIXEL_FORMAT, to_sws_flags(scale_algorithm_));
+  if (!context) {
+    logging::error() << "Failed to initialize the image converter.";
+    return nullptr;
   }
+  use_bt709_colors(context, frame);
+  sws_scale(context, frame->data, frame->linesize, 0, frame->height,
+            scaled->data, scaled->linesize);
+  return scaled;
+}
 
-  // STEP 6: Write the stream header
-  if (avformat_write_header(format_context_, nullptr) < 0) {
-    std::cerr << "Failed to write the stream header." << std::endl;
-    return;
+void Combiner::finish_renditions() {
+  for (std::unique_ptr<Rendition> &rendition : renditions_) {
+    rendition->queue.close();
+    if (rendition->thread.joinable()) {
+      rendition->thread.join();
+    }
   }
 }
 
-void Combiner::setup_video_codec() {
-  // STEP 1: Find the video encoder
-  const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_H264);
-  if (!codec) {
-    std::cerr << "Failed to find the video encoder." << std::endl;
-    return;
+bool Combiner::process_queued_frames(
+    const std::vector<pipeline::FrameQueue *> &sources) {
+  std::vector<pipeline::FrameQueue *> open_sources(sources);
+  int64_t pts = 0;
+  bool transition = false;
+
+  while (!open_sources.empty()) {
+    for (auto it = open_sources.begin(); it != open_sources.end();) {
+      // STEP 1: Pop the next frame of this source. Concatenated sources
+      // stay on the first source until it is drained.
+      AVFrame *frame = (*it)->pop();
+      if (!frame) {
+        it = open_sources.erase(it);
+        transition = pts > 0;
+        continue;
+      }
+      if (!concatenate_) {
+        ++it;
+      }
+
+      // STEP 2: Rescale and convert the frame if necessary
+      frame = prepare_frame(frame);
+      if (!frame) {
+        continue;
+      }
+
+      // STEP 3: Set the frame properties. Interleaved sources alternate on
+      // every frame, so only concatenated ones are checked for cuts.
+      frame->pts = pts++;
+      if (concatenate_) {
+        set_picture_type(frame, transition);
+        transition = false;
+      } else {
+        frame->pict_type = AV_PICTURE_TYPE_NONE;
+      }
+
+      // STEP 4: Encode and write the frame to the output file
+      const bool written = encode_and_write_frame(frame);
+      av_frame_free(&frame);
+      if (!written || cancelled()) {
+        // Stop the extractors instead of leaving them blocked on full queues
+        for (pipeline::FrameQueue *source : sources) {
+          source->close();
+        }
+        return false;
+      }
+    }
   }
+  return true;
+}
 
-  // STEP 2: Create a new codec context
-  codec_context_ = avcodec_alloc_context3(codec);
-  if (!codec_context_) {
-    std::cerr << "Failed to allocate the video codec context." << std::endl;
-    return;
+bool Combiner::process_crossfaded_frames(
+    const std::vector<pipeline::FrameQueue *> &sources) {
+  const std::size_t fade_frames = static_cast<std::size_t>(crossfade_frames_);
+  std::deque<AVFrame *> pending;
+  int64_t pts = 0;
+  bool failed = false;
+
+  // Frees a held back frame and refunds it to the budget
+  auto free_held = [this](AVFrame *&frame) {
+    if (memory_budget_) {
+      memory_budget_->release(pipeline::frame_bytes(frame));
+    }
+    av_frame_free(&frame);
+  };
+
+  // Encodes a held back frame, then frees it
+  auto encode_held = [&](AVFrame *frame) {
+    frame->pts = pts++;
+    set_picture_type(frame, false);
+    failed = !encode_and_write_frame(frame) || cancelled();
+    free_held(frame);
+  };
+
+  // Encodes the oldest pending frame
+  auto encode_pending = [&]() {
+    AVFrame *frame = pending.front();
+    pending.pop_front();
+    encode_held(frame);
+  };
+
+  // Fades the pending head of a source in over the outgoing tail. A source
+  // shorter than the tail fades in over its last frames, after the first
+  // ones play unmixed.
+  auto fade_in = [&](std::deque<AVFrame *> &outgoing) {
+    const std::size_t faded = std::min(outgoing.size(), pending.size());
+    while (!failed && outgoing.size() > faded) {
+      AVFrame *frame = outgoing.front();
+      outgoing.pop_front();
+      encode_held(frame);
+    }
+    for (std::size_t i = 0; !failed && i < faded; ++i) {
+      AVFrame *frame = pending[i];
+      const int alpha = static_cast<int>(255 * (i + 1) / (faded + 1));
+      if (av_frame_make_writable(frame) < 0 ||
+          !compose::mix_frames(frame, outgoing[i], frame, alpha)) {
+        logging::error().frame(pts + static_cast<int64_t>(i))
+            << "Failed to crossfade the frame.";
+        failed = true;
+      }
+    }
+    for (AVFrame *&frame : outgoing) {
+      free_held(frame);
+    }
+    outgoing.clear();
+  };
+
+  for (pipeline::FrameQueue *source : sources) {
+    // STEP 1: The frames still pending are the tail of the previous source,
+    // which the head of this source fades in over
+    std::deque<AVFrame *> outgoing;
+    outgoing.swap(pending);
+
+    while (!failed) {
+      AVFrame *frame = source->pop();
+      if (!frame) {
+        break;
+      }
+      frame = prepare_frame(frame);
+      if (!frame) {
+        continue;
+      }
+
+      // STEP 2: Hold back the last frames of the source for the next fade
+      if (memory_budget_) {
+        memory_budget_->hold(pipeline::frame_bytes(frame));
+      }
+      pending.push_back(frame);
+
+      // STEP 3: Mix the head of the source once it is as long as the
+      // outgoing tail
+      if (!outgoing.empty() && pending.size() == outgoing.size()) {
+        fade_in(outgoing);
+      }
+      if (pending.size() > fade_frames) {
+        encode_pending();
+      }
+    }
+
+    // STEP 4: A source shorter than the outgoing tail fades in over the end
+    // of it
+    if (!outgoing.empty()) {
+      fade_in(outgoing);
+    }
   }
 
-  // STEP 3: Set the codec parameters
-  codec_context_->bit_rate = 8000000;
-  codec_context_->width = 1920;
-  codec_context_->height = 1080;
-  codec_context_->time_base = {1, 30};
-  codec_context_->framerate = {30, 1};
-  codec_context_->gop_size = 10;
-  codec_context_->max_b_frames = 1;
-  codec_context_->pix_fmt = AV_PIX_FMT_YUV420P;
+  // STEP 5: The tail of the last source has nothing to fade into
+  while (!failed && !pending.empty()) {
+    encode_pending();
+  }
 
-  // STEP 4: Open the codec
-  if (avcodec_open2(codec_context_, codec, nullptr) < 0) {
-    std::cerr << "Failed to open the video codec." << std::endl;
-    return;
+  if (failed) {
+    // Stop the extractors instead of leaving them blocked on full queues
+    for (pipeline::FrameQueue *source : sources) {
+      source->close();
+    }
+    for (AVFrame *&frame : pending) {
+      free_held(frame);
+    }
   }
+  return !failed;
 }
 
-void Combiner::cleanup_resources() {
-  // STEP 1: Free the codec context
-  avcodec_free_context(&codec_context_);
+AVFrame *Combiner::prepare_frame(AVFrame *frame) {
+  // STEP 1: Rescale the frame if necessary
+  frame = rescale_frame_if_necessary(frame);
+  if (!frame) {
+    return nullptr;
+  }
 
-  // STEP 2: Close the output file
-  if (format_context_ && format_context_->pb) {
-    avio_close(format_context_->pb);
+  // STEP 2: Convert the pixel format if necessary
+  if (frame->format != OUTPUT_PIXEL_FORMAT) {
+    AVFrame *converted_frame = convert_pixel_format(frame);
+    av_frame_free(&frame);
+    return converted_frame;
   }
+  return frame;
+}
 
-  // STEP 3: Free the format context
-  avformat_free_context(format_context_);
+bool Combiner::process_composed_frames(
+    const std::vector<pipeline::FrameQueue *> &sources) {
+  std::vector<AVFrame *> current_frames(sources.size(), nullptr);
+  std::vector<bool> drained(sources.size(), false);
+  int64_t pts = 0;
+  bool result = true;
+
+  while (true) {
+    // STEP 1: Advance every source that still has frames. A drained source
+    // keeps its last frame on screen.
+    bool advanced = false;
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+      if (drained[i]) {
+        continue;
+      }
+      AVFrame *frame = sources[i]->pop();
+      if (!frame) {
+        drained[i] = true;
+        continue;
+      }
+      av_frame_free(&current_frames[i]);
+      current_frames[i] = frame;
+      advanced = true;
+    }
+    if (!advanced) {
+      break;
+    }
+
+    // STEP 2: Compose the sources straight onto a new canvas. The encoder
+    // may keep a reference to the previous one, so it is not reused.
+    AVFrame *canvas = allocate_rescaled_frame();
+    if (!canvas) {
+      result = false;
+      break;
+    }
+    compositor_.compose(layout_, current_frames, canvas);
+
+    // STEP 3: Set the frame properties
+    canvas->pts = pts++;
+    set_picture_type(canvas, false);
 
-  // STEP 4: Free the frame
-  av_frame_free(&frame_);
+    // STEP 4: Encode and write the frame to the output file
+    const bool written = encode_and_write_frame(canvas);
+    av_frame_free(&canvas);
+    if (!written || cancelled()) {
+      // Stop the extractors instead of leaving them blocked on full queues
+      for (pipeline::FrameQueue *source : sources) {
+        source->close();
+      }
+      result = false;
+      break;
+    }
+  }
+
+  // STEP 5: Free the last frame of every source
+  for (AVFrame *&frame : current_frames) {
+    av_frame_free(&frame);
+  }
+  return result;
+}
+
+void Combiner::set_picture_type(AVFrame *frame, bool transition) {
+  // The detector sees every frame, so the next cut is measured against the
+  // new source rather than the old one
+  const bool cut = scene_detector_.is_scene_cut(frame);
+  if (transition) {
+    scene_detector_.mark_keyframe();
+  }
+  frame->pict_type =
+      transition || cut ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+}
+
+bool Combiner::remux_to_video(const std::vector<Extractor *> &inputs,
+                              const TrimRange &trim,
+                              const std::string &output_filename) {
+  // STEP 1: Check that every input can be copied as is and that they share
+  // the same codec configuration
+  if (inputs.empty()) {
+    return false;
+  }
+  const AVCodecParameters *codec_parameters =
+      inputs.front()->get_video_stream()
+          ? inputs.front()->get_video_stream()->codecpar
+          : nullptr;
+  for (const Extractor *input : inputs) {
+    if (!can_remux(*input)) {
+      return false;
+    }
+
+    const AVCodecParameters *input_parameters =
+        input->get_video_stream()->codecpar;
+    if (input_parameters->extradata_size != codec_parameters->extradata_size ||
+        (codec_parameters->extradata_size > 0 &&
+         std::memcmp(input_parameters->extradata, codec_parameters->extradata,
+                     codec_parameters->extradata_size) != 0)) {
+      return false;
+    }
+  }
+
+  // STEP 2: Create the output stream with the parameters of the inputs,
+  // open the output file and write the stream header
+  encoder_.set_fragment_duration(fragment_seconds_);
+  if (!encoder_.open_copy(output_filename, codec_parameters,
+                          inputs.front()->get_video_stream()->time_base)) {
+    return false;
+  }
+
+  // STEP 3: Copy the packets of each input, back to back
+  int64_t offset = 0;
+  for (Extractor *input : inputs) {
+    if (!remux_input(*input, trim, offset)) {
+      return false;
+    }
+  }
+
+  // STEP 4: Write the trailer
+  return encoder_.finish();
+}
+
+bool Combiner::remux_input(Extractor &input, const TrimRange &trim,
+                           int64_t &offset) {
+  const AVStream *input_stream = input.get_video_stream();
+  const AVRational input_time_base = input_stream->time_base;
+  const AVRational output_time_base = encoder_.get_stream()->time_base;
+  const int64_t frame_duration = av_rescale_q(
+      1, av_inv_q(input_stream->avg_frame_rate), output_time_base);
+
+  // STEP 1: Start at the keyframe before the trim start
+  if (trim.start > 0.0 && !input.seek_to_keyframe(trim.start)) {
+    return false;
+  }
+
+  AVPacket *packet = av_packet_alloc();
+  if (!packet) {
+    logging::error() << "Failed to allocate packet.";
+    return false;
+  }
+
+  bool started = false;
+  int64_t first_dts = 0;
+  int64_t end = offset;
+  bool result = true;
+
+  while (!cancelled() && input.read_video_packet(packet)) {
+    const bool keyframe = packet->flags & AV_PKT_FLAG_KEY;
+
+    // STEP 2: Skip to the first keyframe, and stop at the first keyframe at
+    // or after the trim end
+    if (!started && !keyframe) {
+      av_packet_unref(packet);
+      continue;
+    }
+    if (started && keyframe && trim.end > 0.0 &&
+        input.timestamp_to_seconds(packet->pts) >= trim.end) {
+      av_packet_unref(packet);
+      break;
+    }
+    if (!started) {
+      started = true;
+      first_dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    }
+
+    // STEP 3: Rebase the timestamps so the input starts at the offset
+    if (packet->pts != AV_NOPTS_VALUE) {
+      packet->pts -= first_dts;
+    }
+    if (packet->dts != AV_NOPTS_VALUE) {
+      packet->dts -= first_dts;
+    }
+    av_packet_rescale_ts(packet, input_time_base, output_time_base);
+    if (packet->pts != AV_NOPTS_VALUE) {
+      packet->pts += offset;
+    }
+    if (packet->dts != AV_NOPTS_VALUE) {
+      packet->dts += offset;
+    }
+
+    const int64_t duration =
+        packet->duration > 0 ? packet->duration : frame_duration;
+    if (packet->pts != AV_NOPTS_VALUE && packet->pts + duration > end) {
+      end = packet->pts + duration;
+    }
+
+    // STEP 4: Write the packet to the output file
+    if (!encoder_.write_packet(packet)) {
+      result = false;
+      break;
+    }
+  }
+
+  // STEP 5: The next input starts where this one ended
+  offset = end;
+
+  av_packet_unref(packet);
+  av_packet_free(&packet);
+  return result && !cancelled();
+}
+
+bool Combiner::can_remux(const Extractor &input) const {
+  const AVStream *stream = input.get_video_stream();
+  if (!stream) {
+    return false;
+  }
+
+  const AVCodecParameters *codec_parameters = stream->codecpar;
+  return codec_parameters->codec_id == OUTPUT_CODEC_ID &&
+         codec_parameters->width == output_width_ &&
+         codec_parameters->height == output_height_ &&
+         codec_parameters->format == OUTPUT_PIXEL_FORMAT &&
+         av_cmp_q(stream->avg_frame_rate, OUTPUT_FRAME_RATE) == 0;
+}
+
+void Combiner::set_concatenate(bool concatenate) {
+  concatenate_ = concatenate;
+}
+
+void Combiner::set_output_size(int width, int height) {
+  output_width_ = width;
+  output_height_ = height;
+}
+
+void Combiner::set_layout(const compose::Layout &layout) {
+  layout_ = layout;
+  set_output_size(layout.width, layout.height);
+}
+
+void Combiner::set_crossfade_duration(double seconds) {
+  crossfade_frames_ =
+      seconds > 0.0
+          ? static_cast<int>(std::lround(seconds * av_q2d(OUTPUT_FRAME_RATE)))
+          : 0;
+}
+
+void Combiner::add_rendition(const OutputSpec &spec) {
+  renditions_.push_back(std::make_unique<Rendition>(spec, memory_budget_));
+}
+
+void Combiner::set_memory_budget(pipeline::MemoryBudget *budget) {
+  memory_budget_ = budget;
+}
+
+std::vector<pipeline::StageStats> Combiner::get_rendition_stats() const {
+  std::vector<pipeline::StageStats> stats;
+  for (const std::unique_ptr<Rendition> &rendition : renditions_) {
+    stats.push_back(rendition->stats);
+  }
+  return stats;
+}
+
+void Combiner::set_fragment_duration(double seconds) {
+  fragment_seconds_ = seconds > 0.0 ? seconds : 0.0;
+}
+
+void Combiner::set_keyframe_interval(double seconds) {
+  keyframe_seconds_ = seconds > 0.0 ? seconds : DEFAULT_KEYFRAME_SECONDS;
+}
+
+void Combiner::set_encoder_threads(int threads) {
+  encoder_threads_ = threads > 0 ? threads : 0;
+}
+
+void Combiner::set_scale_algorithm(ScaleAlgorithm algorithm) {
+  scale_algorithm_ = algorithm;
+  compositor_.set_scale_algorithm(algorithm);
+}
+
+void Combiner::set_simd_kernels(bool enabled) { simd_kernels_ = enabled; }
+
+void Combiner::set_frame_allocator(pipeline::FrameAllocator *allocator) {
+  frame_allocator_ = allocator;
+}
+
+void Combiner::set_cancel_flag(const std::atomic<bool> *flag) {
+  cancel_flag_ = flag;
+}
+
+void Combiner::set_progress_counters(pipeline::ProgressCounters *counters) {
+  progress_counters_ = counters;
+  encoder_.set_progress_counters(counters);
+}
+
+bool Combiner::cancelled() const { return cancel_flag_ && *cancel_flag_; }
+
+void Combiner::set_input_options(const io::InputOptions &input_options) {
+  input_options_ = input_options;
+}
+
+bool Combiner::read_png_files_from_manifest() {
+  // STEP 1: Read the frames the extractors recorded, already in order
+  std::vector<FrameManifestEntry> entries;
+  if (!read_frame_manifest(png_dir + "/" + FRAME_MANIFEST_NAME, entries)) {
+    return false;
+  }
+
+  // STEP 2: Name their files without touching the directory
+  png_files.reserve(entries.size());
+  file_formats.reserve(entries.size());
+  for (const FrameManifestEntry &entry : entries) {
+    const IntermediateFormat format =
+        static_cast<IntermediateFormat>(entry.format);
+    png_files.push_back(png_dir + "/" +
+                        frame_file_name(entry.source, entry.index, format));
+    file_formats.push_back(format);
+  }
+  return true;
+}
+
+bool Combiner::write_trailer() {
+  // STEP 1: Drain the packets still buffered in the encoder and write the
+  // trailer
+  const bool finished = encoder_.finish();
+
+  // STEP 2: Let the renditions encode the frames they still have queued
+  finish_renditions();
+  return finished;
+}
+
+void Combiner::cleanup_resources() {
+  // STEP 1: Stop the renditions. The encoders close their own files.
+  finish_renditions();
+
+  // STEP 2: Free the frame
+  frame_.reset();
 }
 
 void Combiner::process_frames() {
@@ -167,10 +739,10 @@ void Combiner::process_frames() {
 
   // STEP 2: Iterate over the frames and encode them
   for (unsigned int i = 0; i < frames.size(); ++i) {
-    AVFrame *currentFrame = frames[i];
+    AVFrame *currentFrame = frames[i].get();
 
     // STEP 3: Convert the pixel format if necessary
-    if (currentFrame->format != codec_context_->pix_fmt) {
+    if (currentFrame->format != OUTPUT_PIXEL_FORMAT) {
       AVFrame *converted_frame = convert_pixel_format(currentFrame);
       if (!converted_frame) {
         av_frame_free(&frame);
@@ -201,33 +773,39 @@ AVFrame *Combiner::convert_pixel_format(AVFrame *frame) {
   // STEP 1: Allocate memory for the converted frame
   AVFrame *converted_frame = av_frame_alloc();
   if (!converted_frame) {
-    std::cerr << "Failed to allocate the converted frame." << std::endl;
+    logging::error() << "Failed to allocate the converted frame.";
     return nullptr;
   }
 
   // STEP 2: Set the converted frame properties
-  converted_frame->format = codec_context_->pix_fmt;
+  converted_frame->format = OUTPUT_PIXEL_FORMAT;
   converted_frame->width = frame->width;
   converted_frame->height = frame->height;
 
   // STEP 3: Allocate the converted frame buffer
-  if (av_frame_get_buffer(converted_frame, 32) < 0) {
-    std::cerr << "Failed to allocate the converted frame buffer." << std::endl;
+  if (!get_frame_buffer(converted_frame)) {
+    logging::error() << "Failed to allocate the converted frame buffer.";
     av_frame_free(&converted_frame);
     return nullptr;
   }
 
-  // STEP 4: Perform pixel format conversion
+  // STEP 4: Perform pixel format conversion, with the SIMD kernels if they
+  // cover it
+  if (simd_kernels_ && simd::convert_frame(frame, converted_frame)) {
+    return converted_frame;
+  }
+
   SwsContext *swsContext = sws_getContext(
       frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
-      frame->width, frame->height, codec_context_->pix_fmt, SWS_BICUBIC,
-      nullptr, nullptr, nullptr);
+      frame->width, frame->height, OUTPUT_PIXEL_FORMAT,
+      to_sws_flags(scale_algorithm_), nullptr, nullptr, nullptr);
 
   if (!swsContext) {
-    std::cerr << "Failed to initialize the image converter." << std::endl;
+    logging::error() << "Failed to initialize the image converter.";
     av_frame_free(&converted_frame);
     return nullptr;
   }
+  use_bt709_colors(swsContext, frame);
 
   sws_scale(swsContext, frame->data, frame->linesize, 0, frame->height,
             converted_frame->data, converted_frame->linesize);
@@ -241,18 +819,18 @@ AVFrame *Combiner::setup_frame() {
   // STEP 1: Allocate memory for the frame
   AVFrame *frame = av_frame_alloc();
   if (!frame) {
-    std::cerr << "Failed to allocate the video frame." << std::endl;
+    logging::error() << "Failed to allocate the video frame.";
     return nullptr;
   }
 
   // STEP 2: Set frame properties
-  frame->format = codec_context_->pix_fmt;
-  frame->width = codec_context_->width;
-  frame->height = codec_context_->height;
+  frame->format = OUTPUT_PIXEL_FORMAT;
+  frame->width = output_width_;
+  frame->height = output_height_;
 
   // STEP 3: Allocate the frame buffer
-  if (av_frame_get_buffer(frame, 32) < 0) {
-    std::cerr << "Failed to allocate the video frame buffer." << std::endl;
+  if (!get_frame_buffer(frame)) {
+    logging::error() << "Failed to allocate the video frame buffer.";
     av_frame_free(&frame);
     return nullptr;
   }
@@ -272,47 +850,74 @@ void Combiner::set_current_frame(AVFrame *frame, AVFrame *currentFrame) {
   frame->linesize[2] = currentFrame->linesize[2];
 }
 
-void Combiner::convert_pngs_to_frames() {
+bool Combiner::convert_pngs_to_frames() {
+  // PNGs are decoded a window at a time on the scheduler, then scaled and
+  // encoded in order here. Decoding only reads the input options.
+  pipeline::TaskGroup png_tasks;
+  const std::size_t window =
+      PNG_FRAMES_PER_WORKER * png_tasks.scheduler().worker_count();
   unsigned int i = 0;
-  for (const auto &png_file : png_files) {
-
-    // STEP 1: Convert PNG to AVFrame
-    AVFrame *frame = convert_png_to_av_frame(png_file);
-
-    if (!frame) {
-      std::cerr << "Failed to convert PNG to AVFrame for file: " << png_file
-                << std::endl;
-      continue;
+  for (std::size_t start = 0; start < png_files.size(); start += window) {
+    if (cancelled()) {
+      return false;
     }
 
-    // STEP 2: Rescale the frame if necessary
-    frame = rescale_frame_if_necessary(frame);
-    if (!frame) {
-      continue;
+    // STEP 1: Convert the window's PNGs to AVFrames
+    std::vector<AVFrame *> decoded(
+        std::min(window, png_files.size() - start), nullptr);
+    for (std::size_t j = 0; j < decoded.size(); ++j) {
+      png_tasks.run([this, &decoded, start, j] {
+        decoded[j] = load_frame_file(start + j);
+      });
     }
+    png_tasks.wait();
 
-    // STEP 3: Set the frame properties
-    frame->pts = i++;
+    // A failed frame fails the run, after freeing the rest of the window
+    auto fail_window = [&decoded](std::size_t next) {
+      for (std::size_t k = next; k < decoded.size(); ++k) {
+        av_frame_free(&decoded[k]);
+      }
+      return false;
+    };
+
+    for (std::size_t j = 0; j < decoded.size(); ++j) {
+      AVFrame *frame = decoded[j];
+      if (!frame) {
+        logging::error().frame(static_cast<int64_t>(start + j))
+            << "Failed to convert frame file to AVFrame: "
+            << png_files[start + j];
+        return fail_window(j + 1);
+      }
 
-    // STEP 4: Encode and write the frame to the output file
-    if (!encode_and_write_frame(frame)) {
+      // STEP 2: Rescale the frame if necessary
+      frame = rescale_frame_if_necessary(frame);
+      if (!frame) {
+        return fail_window(j + 1);
+      }
+
+      // STEP 3: Set the frame properties
+      frame->pts = i++;
+
+      // STEP 4: Encode and write the frame to the output file
+      const bool written = encode_and_write_frame(frame);
       av_frame_free(&frame);
-      continue;
+      if (!written) {
+        return fail_window(j + 1);
+      }
     }
-
-    // Free the frame
-    av_frame_free(&frame);
   }
+  return true;
 }
 
 AVFrame *Combiner::rescale_frame_if_necessary(AVFrame *frame) {
-  // STEP 1: Check if the frame size matches
-  if (!is_frame_size_matching(frame)) {
+  // STEP 1: Check if the frame size and pixel format match
+  if (!is_frame_size_matching(frame) ||
+      frame->format != OUTPUT_PIXEL_FORMAT) {
     // STEP 2: Allocate a rescaled frame
     AVFrame *rescaled_frame = allocate_rescaled_frame();
     if (!rescaled_frame) {
       // Failed to allocate the rescaled frame
-      std::cerr << "Failed to allocate the rescaled frame." << std::endl;
+      logging::error() << "Failed to allocate the rescaled frame.";
       av_frame_free(&frame);
       return nullptr;
     }
@@ -320,7 +925,7 @@ AVFrame *Combiner::rescale_frame_if_necessary(AVFrame *frame) {
     // STEP 3: Initialize the rescaled frame
     if (!init_rescaled_frame(rescaled_frame)) {
       // Failed to initialize the rescaled frame
-      std::cerr << "Failed to initialize the rescaled frame." << std::endl;
+      logging::error() << "Failed to initialize the rescaled frame.";
       av_frame_free(&rescaled_frame);
       av_frame_free(&frame);
       return nullptr;
@@ -329,7 +934,7 @@ AVFrame *Combiner::rescale_frame_if_necessary(AVFrame *frame) {
     // STEP 4: Scale the frame
     if (!scale_frame(frame, rescaled_frame)) {
       // Failed to scale the frame
-      std::cerr << "Failed to scale the frame." << std::endl;
+      logging::error() << "Failed to scale the frame.";
       av_frame_free(&rescaled_frame);
       av_frame_free(&frame);
 
@@ -346,48 +951,32 @@ AVFrame *Combiner::rescale_frame_if_necessary(AVFrame *frame) {
   return frame;
 }
 
-bool Combiner::encode_and_write_frame(AVFrame *frame) {
-  // STEP 1: Allocate a packet for the encoded frame
-  AVPacket *packet = av_packet_alloc();
+bool Combiner::encode_and_write_frame(const AVFrame *frame) {
+  // STEP 1: Hand a reference to the frame to every rendition, which scales
+  // and encodes it on its own thread
+  for (std::unique_ptr<Rendition> &rendition : renditions_) {
+    AVFrame *reference = av_frame_clone(frame);
+    if (reference) {
+      rendition->queue.push(reference);
+    }
+  }
 
-  // STEP 2: Send the frame to the codec for encoding
-  if (avcodec_send_frame(codec_context_, frame) < 0) {
-    // Error sending the frame to the codec
-    std::cerr << "Error sending a frame to the codec." << std::endl;
-    av_frame_free(&frame);
-    av_packet_free(&packet);
+  // STEP 2: Encode and write the frame to the main output
+  if (progress_counters_) {
+    progress_counters_->add_composited();
+  }
+  if (!encoder_.encode(frame)) {
     return false;
   }
-
-  // STEP 3: Receive and write packets until no more packets are available
-  while (avcodec_receive_packet(codec_context_, packet) == 0) {
-    // Rescale the packet's timestamp
-    av_packet_rescale_ts(packet, codec_context_->time_base, stream_->time_base);
-    // Set the packet's stream index
-    packet->stream_index = stream_->index;
-
-    // Write the packet to the output file
-    if (av_interleaved_write_frame(format_context_, packet) < 0) {
-      // Error writing the video frame
-      std::cerr << "Error writing video frame." << std::endl;
-      av_packet_unref(packet);
-      av_frame_free(&frame);
-      av_packet_free(&packet);
-      return false;
-    }
-
-    // Free the packet for reuse
-    av_packet_unref(packet);
+  if (progress_counters_) {
+    progress_counters_->add_encoded();
   }
-
-  // STEP 4: Free the packet
-  av_packet_free(&packet);
   return true;
 }
 
 bool Combiner::is_frame_size_matching(const AVFrame *frame) const {
-  return (frame->width == codec_context_->width &&
-          frame->height == codec_context_->height);
+  return (frame->width == output_width_ &&
+          frame->height == output_height_);
 }
 
 AVFrame *Combiner::allocate_rescaled_frame() const {
@@ -397,20 +986,20 @@ AVFrame *Combiner::allocate_rescaled_frame() const {
   // Check if the allocation was successful
   if (!rescaled_frame) {
     // STEP 2: Failed to allocate the rescaled frame
-    std::cerr << "Failed to allocate the rescaled frame." << std::endl;
+    logging::error() << "Failed to allocate the rescaled frame.";
     return nullptr;
   }
 
   // STEP 3: Set the format, width, and height of the rescaled frame
-  rescaled_frame->format = codec_context_->pix_fmt;
-  rescaled_frame->width = codec_context_->width;
-  rescaled_frame->height = codec_context_->height;
+  rescaled_frame->format = OUTPUT_PIXEL_FORMAT;
+  rescaled_frame->width = output_width_;
+  rescaled_frame->height = output_height_;
 
   // STEP 4: Allocate the buffer for the rescaled frame
-  if (av_frame_get_buffer(rescaled_frame, 32) < 0) {
+  if (!get_frame_buffer(rescaled_frame)) {
     // STEP 5: Failed to allocate the rescaled frame buffer
 
-    std::cerr << "Failed to allocate the rescaled frame buffer." << std::endl;
+    logging::error() << "Failed to allocate the rescaled frame buffer.";
     av_frame_free(&rescaled_frame);
 
     return nullptr;
@@ -423,16 +1012,17 @@ bool Combiner::init_rescaled_frame(AVFrame *frame) const {
   // STEP 1: Initialize the image converter (SWSContext)
   SwsContext *swsContext = sws_getContext(
       frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
-      codec_context_->width, codec_context_->height, codec_context_->pix_fmt,
-      SWS_BICUBIC, nullptr, nullptr, nullptr);
+      output_width_, output_height_, OUTPUT_PIXEL_FORMAT,
+      to_sws_flags(scale_algorithm_), nullptr, nullptr, nullptr);
 
   // Check if the initialization was successful
   if (!swsContext) {
 
     // Failed to initialize the image converter
-    std::cerr << "Failed to initialize the image converter." << std::endl;
+    logging::error() << "Failed to initialize the image converter.";
     return false;
   }
+  use_bt709_colors(swsContext, frame);
 
   // STEP 2: Free the image converter context
   sws_freeContext(swsContext);
@@ -442,47 +1032,55 @@ bool Combiner::init_rescaled_frame(AVFrame *frame) const {
 
 bool Combiner::scale_frame(const AVFrame *src_frame,
                                 AVFrame *dst_frame) const {
-  // STEP 1: Initialize the image converter (SWSContext)
+  // STEP 1: Use the SIMD kernels if they cover the conversion and scale
+  // like the selected algorithm
+  if (simd_kernels_ && kernels_match(scale_algorithm_, src_frame, dst_frame) &&
+      simd::convert_frame(src_frame, dst_frame)) {
+    return true;
+  }
+
+  // STEP 2: Initialize the image converter (SWSContext)
   SwsContext *swsContext = sws_getContext(
       src_frame->width, src_frame->height,
-      static_cast<AVPixelFormat>(src_frame->format), codec_context_->width,
-      codec_context_->height, codec_context_->pix_fmt, SWS_BICUBIC, nullptr,
-      nullptr, nullptr);
+      static_cast<AVPixelFormat>(src_frame->format), output_width_,
+      output_height_, OUTPUT_PIXEL_FORMAT,
+      to_sws_flags(scale_algorithm_), nullptr, nullptr, nullptr);
 
   // Check if the initialization was successful
   if (!swsContext) {
     // Failed to initialize the image converter
-    std::cerr << "Failed to initialize the image converter." << std::endl;
+    logging::error() << "Failed to initialize the image converter.";
     return false;
   }
+  use_bt709_colors(swsContext, src_frame);
 
-  // STEP 2: Scale the frame using the image converter
+  // STEP 3: Scale the frame using the image converter
   sws_scale(swsContext, src_frame->data, src_frame->linesize, 0,
             src_frame->height, dst_frame->data, dst_frame->linesize);
 
-  // STEP 3: Free the image converter context
+  // STEP 4: Free the image converter context
   sws_freeContext(swsContext);
 
   return true;
 }
 
 AVFrame *Combiner::convert_png_to_av_frame(const std::string &file_path) {
-  // STEP 1: Open the input file
-  AVFormatContext *format_context = nullptr;
-  if (!open_input_file(file_path, &format_context)) {
+  // STEP 1: Open the input file. It is read through the input source, so
+  // the handles declared after it are closed before it.
+  io::InputSource input_source(file_path, input_options_);
+  ffmpeg::InputContextPtr format_context;
+  if (!open_input_file(input_source, format_context)) {
     return nullptr;
   }
 
   // STEP 2: Retrieve stream information
-  if (!retrieve_stream_info(format_context)) {
-    avformat_close_input(&format_context);
+  if (!retrieve_stream_info(format_context.get())) {
     return nullptr;
   }
 
   // STEP 3: Find the video stream
-  int video_stream_index = find_video_stream(format_context);
+  int video_stream_index = find_video_stream(format_context.get());
   if (video_stream_index < 0) {
-    avformat_close_input(&format_context);
     return nullptr;
   }
 
@@ -493,55 +1091,66 @@ AVFrame *Combiner::convert_png_to_av_frame(const std::string &file_path) {
   // STEP 5: Find the decoder codec
   const AVCodec *codec = find_decoder(codec_parameters->codec_id);
   if (!codec) {
-    avformat_close_input(&format_context);
     return nullptr;
   }
 
   // STEP 6: Create and initialize codec context
-  AVCodecContext *codec_context = create_codec_context(codec, codec_parameters);
+  const ffmpeg::CodecContextPtr codec_context =
+      create_codec_context(codec, codec_parameters);
   if (!codec_context) {
-    avformat_close_input(&format_context);
     return nullptr;
   }
 
   // STEP 7: Create an AVFrame to store the decoded frame
-  AVFrame *frame = create_frame();
+  ffmpeg::FramePtr frame = create_frame();
   if (!frame) {
-    avcodec_free_context(&codec_context);
-    avformat_close_input(&format_context);
     return nullptr;
   }
 
   // STEP 8: Decode frames until the end of the file
-  if (!decode_frames(format_context, codec_context, frame,
+  if (!decode_frames(format_context.get(), codec_context.get(), frame.get(),
                      video_stream_index)) {
-    avcodec_free_context(&codec_context);
-    avformat_close_input(&format_context);
-    av_frame_free(&frame);
     return nullptr;
   }
 
-  // STEP 9: Cleanup
-  avcodec_free_context(&codec_context);
-  avformat_close_input(&format_context);
+  return frame.release();
+}
 
-  return frame;
+AVFrame *Combiner::load_frame_file(std::size_t index) {
+  // STEP 1: Decode PNGs through the input source
+  const IntermediateFormat format = file_formats[index];
+  if (format == IntermediateFormat::Png ||
+      format == IntermediateFormat::PngFast) {
+    return convert_png_to_av_frame(png_files[index]);
+  }
+
+  // STEP 2: Read the whole file
+  std::ifstream input(png_files[index], std::ios::binary);
+  if (!input) {
+    logging::error() << "Failed to open frame file " << png_files[index];
+    return nullptr;
+  }
+  const std::vector<std::uint8_t> data(
+      (std::istreambuf_iterator<char>(input)),
+      std::istreambuf_iterator<char>());
+
+  // STEP 3: Decode it in memory
+  return decode_intermediate(data.data(), data.size(), format).release();
 }
 
-bool Combiner::open_input_file(const std::string &file_path,
-                                    AVFormatContext **format_context) {
-  if (avformat_open_input(format_context, file_path.c_str(), nullptr,
-                          nullptr) != 0) {
-    std::cerr << "Failed to open input file." << std::endl;
+bool Combiner::open_input_file(io::InputSource &input_source,
+                               ffmpeg::InputContextPtr &format_context) {
+  AVFormatContext *opened = nullptr;
+  if (!input_source.open_format_context(&opened)) {
     return false;
   }
+  format_context.reset(opened);
   return true;
 }
 
 bool Combiner::retrieve_stream_info(AVFormatContext *format_context) {
   if (avformat_find_stream_info(format_context, nullptr) < 0) {
-    std::cerr << "Failed to retrieve stream information." << std::endl;
-    avformat_close_input(&format_context);
+    logging::error() << "Failed to retrieve stream information.";
     return false;
   }
   return true;
@@ -551,8 +1160,7 @@ int Combiner::find_video_stream(AVFormatContext *format_context) {
   int video_stream_index = av_find_best_stream(
       format_context, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
   if (video_stream_index < 0) {
-    std::cerr << "Failed to find video stream." << std::endl;
-    avformat_close_input(&format_context);
+    logging::error() << "Failed to find video stream.";
   }
   return video_stream_index;
 }
@@ -560,46 +1168,45 @@ int Combiner::find_video_stream(AVFormatContext *format_context) {
 const AVCodec *Combiner::find_decoder(AVCodecID codec_id) {
   const AVCodec *codec = avcodec_find_decoder(codec_id);
   if (!codec) {
-    std::cerr << "Failed to find decoder." << std::endl;
+    logging::error() << "Failed to find decoder.";
   }
   return codec;
 }
 
-AVCodecContext *
+ffmpeg::CodecContextPtr
 Combiner::create_codec_context(const AVCodec *codec,
-                                    AVCodecParameters *codec_parameters) {
+                               AVCodecParameters *codec_parameters) {
   // STEP 1: Create and initialize codec context
-  AVCodecContext *codec_context = avcodec_alloc_context3(codec);
+  ffmpeg::CodecContextPtr codec_context(avcodec_alloc_context3(codec));
   if (!codec_context) {
-    std::cerr << "Failed to allocate codec context." << std::endl;
+    logging::error() << "Failed to allocate codec context.";
     return nullptr;
   }
 
-  if (avcodec_parameters_to_context(codec_context, codec_parameters) < 0) {
-    std::cerr << "Failed to copy codec parameters to context." << std::endl;
-
-    avcodec_free_context(&codec_context);
+  if (avcodec_parameters_to_context(codec_context.get(), codec_parameters) <
+      0) {
+    logging::error() << "Failed to copy codec parameters to context.";
     return nullptr;
   }
 
-  if (avcodec_open2(codec_context, codec, nullptr) < 0) {
-    std::cerr << "Failed to open codec." << std::endl;
-    avcodec_free_context(&codec_context);
+  if (avcodec_open2(codec_context.get(), codec, nullptr) < 0) {
+    logging::error() << "Failed to open codec.";
     return nullptr;
   }
 
   return codec_context;
 }
 
-AVFrame *Combiner::create_frame() {
-  AVFrame *frame = av_frame_alloc();
+ffmpeg::FramePtr Combiner::create_frame() {
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
   if (!frame) {
-    std::cerr << "Failed to allocate frame." << std::endl;
+    logging::error() << "Failed to allocate frame.";
     return nullptr;
   }
 
   return frame;
 }
+
 bool Combiner::decode_frames(AVFormatContext *format_context,
                                   AVCodecContext *codec_context, AVFrame *frame,
                                   int video_stream_index) {
@@ -611,7 +1218,7 @@ bool Combiner::decode_frames(AVFormatContext *format_context,
     if (packet.stream_index == video_stream_index) {
       // STEP 2: Send packet to the decoder
       if (avcodec_send_packet(codec_context, &packet) < 0) {
-        std::cerr << "Failed to send packet to the decoder." << std::endl;
+        logging::error() << "Failed to send packet to the decoder.";
         break;
       }
 
@@ -628,7 +1235,7 @@ bool Combiner::decode_frames(AVFormatContext *format_context,
 
   // STEP 4: Check if decoding of frame was successful
   if (!frame_finished) {
-    std::cerr << "Failed to decode frame." << std::endl;
+    logging::error() << "Failed to decode frame.";
     return false;
   }
 
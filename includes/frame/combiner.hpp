@@ -1,23 +1,43 @@
 #ifndef FRAME_COMBINER
 #define FRAME_COMBINER
 
+#include "../compose/compositor.hpp"
+#include "../compose/layout.hpp"
+#include "../ffmpeg/handles.hpp"
+#include "../io/input_source.hpp"
+#include "../pipeline/frame_allocator.hpp"
+#include "../pipeline/frame_queue.hpp"
+#include "../pipeline/memory_budget.hpp"
+#include "../pipeline/run_report.hpp"
+#include "encoder.hpp"
+#include "extractor.hpp"
+#include "intermediate.hpp"
+#include "scaler.hpp"
+#include "scene_detector.hpp"
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
 }
 
 namespace frame {
 /**
- * @brief Struct for combining frames into a video.
+ * @brief Struct for combining frames into a video. Combiners are movable
+ * but not copyable. The rendition threads only run inside the combine
+ * calls, so a combiner can be moved between them.
  */
 class Combiner {
 public:
   /**
    * @brief Constructs a FrameCombiner object.
-   * @param output_dir The directory where the output video will be saved.
+   * @param output_dir The directory of the extracted frames and their
+   * manifest, empty if the frames come from queues.
    */
   Combiner(const std::string &output_dir);
 
@@ -26,53 +46,377 @@ public:
    */
   ~Combiner();
 
+  Combiner(const Combiner &) = delete;
+  Combiner &operator=(const Combiner &) = delete;
+  Combiner(Combiner &&) = default;
+  Combiner &operator=(Combiner &&) = default;
+
   /**
-   * @brief Combines the frames into a video file.
+   * @brief Combines the frames of the directory into a video file, in the
+   * order of its frame manifest.
    * @param output_filename The filename of the output video.
+   * @return `true` if every frame was written, `false` if writing failed
+   * or the call was cancelled.
+   */
+  bool combine_frames_to_video(const std::string &output_filename);
+
+  /**
+   * @brief Combines frames popped from in-memory queues into a video file.
+   *
+   * Frames are taken from the sources in turn, the same order in which the
+   * PNG frames of the sources are combined, until every source is drained.
+   * If a layout is set, every output frame is composed instead from the
+   * next frame of each source, and a drained source keeps showing its last
+   * frame until all of them are drained.
+   * @param sources The queues filled by the extractors.
+   * @param output_filename The filename of the output video.
+   * @return `true` if every frame was written, `false` if writing failed
+   * or the call was cancelled.
+   */
+  bool
+  combine_queues_to_video(const std::vector<pipeline::FrameQueue *> &sources,
+                          const std::string &output_filename);
+
+  /**
+   * @brief Copies the compressed packets of the inputs, one after the other,
+   * into a video file without decoding or re-encoding them.
+   *
+   * Each input is cut at keyframes: it starts at the last keyframe at or
+   * before its trim start and ends before the first keyframe at or after its
+   * trim end. Timestamps are rebased so the inputs play back to back.
+   * @param inputs The extractors of the videos to concatenate.
+   * @param trim The range of each input to keep.
+   * @param output_filename The filename of the output video.
+   * @return `true` if the video was written, `false` if an input cannot be
+   * copied into the output format or writing failed.
+   */
+  bool remux_to_video(const std::vector<Extractor *> &inputs,
+                      const TrimRange &trim,
+                      const std::string &output_filename);
+
+  /**
+   * @brief Checks if an input can be copied into the output without
+   * re-encoding.
+   * @param input The extractor of the input video.
+   * @return `true` if its codec, resolution and frame rate match the output,
+   * `false` otherwise.
+   */
+  bool can_remux(const Extractor &input) const;
+
+  /**
+   * @brief Plays the queued sources one after the other instead of
+   * interleaving their frames.
+   * @param concatenate Whether to concatenate the sources.
+   */
+  void set_concatenate(bool concatenate);
+
+  /**
+   * @brief Sets the size of the output video. Defaults to 1920x1080.
+   * @param width The width of the output video.
+   * @param height The height of the output video.
+   */
+  void set_output_size(int width, int height);
+
+  /**
+   * @brief Composes queued sources into the regions of a layout instead of
+   * interleaving them. The output takes the size of the layout's canvas.
+   * @param layout The layout.
+   */
+  void set_layout(const compose::Layout &layout);
+
+  /**
+   * @brief Crossfades from each concatenated source into the next one.
+   *
+   * The last frames of a source are held back and mixed with the first
+   * frames of the next one, so the output is shorter by the fade on every
+   * transition. The held back frames are charged to the memory budget set
+   * by set_memory_budget(), if any.
+   * @param seconds The duration of each fade. 0 disables crossfades.
+   */
+  void set_crossfade_duration(double seconds);
+
+  /**
+   * @brief Also writes the output at another size, such as a smaller rung
+   * of a streaming ladder.
+   *
+   * Every frame is decoded and composed once. Each rendition scales the
+   * frame of the main output down to its own size and encodes it on its own
+   * thread, with the same keyframes as the main output. The fragment and
+   * keyframe settings apply to every rendition.
+   * @param spec The size and file of the rendition.
    */
-  void combine_frames_to_video(const std::string &output_filename);
+  void add_rendition(const OutputSpec &spec);
+
+  /**
+   * @brief Charges the rendition queues and the frames held back for
+   * crossfades to a job's memory budget, so it bounds them as it bounds the
+   * queues of the decoders. Call it before add_rendition().
+   * @param budget The budget, `nullptr` for none. It must outlive the
+   * combiner.
+   */
+  void set_memory_budget(pipeline::MemoryBudget *budget);
+
+  /**
+   * @brief Gets what the encoder thread of every rendition cost, after a
+   * combine call.
+   * @return The counters, in the order the renditions were added.
+   */
+  std::vector<pipeline::StageStats> get_rendition_stats() const;
+
+  /**
+   * @brief Writes the output as fragmented MP4 instead of a regular MP4.
+   *
+   * A fragmented MP4 starts with an empty moov atom and is followed by
+   * self-contained moof/mdat fragments, so it can be consumed while it is
+   * still being written. An output filename of "-" writes to stdout and is
+   * always fragmented.
+   * @param seconds The minimum duration of a fragment. Fragments start at the
+   * first keyframe after this duration. 0 disables fragmentation.
+   */
+  void set_fragment_duration(double seconds);
+
+  /**
+   * @brief Sets the longest distance between two keyframes. Defaults to 4
+   * seconds.
+   *
+   * Scene cuts and the transitions between concatenated sources get a
+   * keyframe of their own, so the interval only bounds how far a seek has
+   * to decode. Fragmented outputs clamp it to the fragment duration.
+   * @param seconds The keyframe interval.
+   */
+  void set_keyframe_interval(double seconds);
+
+  /**
+   * @brief Sets the threads each encoder may use, the main output's and
+   * every rendition's. Defaults to FFmpeg's default.
+   * @param threads The threads, 0 for FFmpeg's default.
+   */
+  void set_encoder_threads(int threads);
+
+  /**
+   * @brief Sets the algorithm used to rescale and convert frames.
+   * @param algorithm The scaler algorithm.
+   */
+  void set_scale_algorithm(ScaleAlgorithm algorithm);
+
+  /**
+   * @brief Sets whether the SIMD kernels handle the conversions they cover,
+   * such as the 720p to 1080p resize. Other conversions always use swscale.
+   * @param enabled `true` to use the kernels, `false` to always use swscale.
+   */
+  void set_simd_kernels(bool enabled);
+
+  /**
+   * @brief Allocates the canvas, converted and rendition frames through a
+   * frame allocator instead of av_frame_get_buffer().
+   * @param allocator The allocator, `nullptr` for the default. It must
+   * outlive the combine calls.
+   */
+  void set_frame_allocator(pipeline::FrameAllocator *allocator);
+
+  /**
+   * @brief Sets how the PNG frames are read.
+   * @param input_options The options for reading the PNG files.
+   */
+  void set_input_options(const io::InputOptions &input_options);
+
+  /**
+   * @brief Stops the combine and remux calls early once a flag is set. The
+   * sources are closed and the output is finished with the frames written
+   * so far.
+   * @param flag The flag, `nullptr` to never stop early. It must outlive
+   * the combine calls.
+   */
+  void set_cancel_flag(const std::atomic<bool> *flag);
+
+  /**
+   * @brief Counts the frames handed to and encoded by the main output, and
+   * the bytes written to every output.
+   * @param counters The counters, `nullptr` for none. They must outlive
+   * the combine calls.
+   */
+  void set_progress_counters(pipeline::ProgressCounters *counters);
 
 private:
+  /**
+   * @brief An extra output scaled from the frames of the main output.
+   */
+  struct Rendition {
+    OutputSpec spec;               /**< The size and file of the output. */
+    pipeline::MemoryBudget
+        own_budget; /**< The budget of the queue if the job has none. */
+    pipeline::FrameQueue queue;    /**< The frames waiting to be encoded. */
+    Encoder encoder;               /**< Encodes and writes the output. */
+    std::thread thread;            /**< Scales and encodes the frames. */
+    pipeline::StageStats stats;    /**< What the thread cost. */
+
+    /**
+     * @brief Constructs a Rendition object.
+     * @param spec The size and file of the output.
+     * @param budget The job's budget the queue is charged to, `nullptr` for
+     * an unlimited budget of its own.
+     */
+    Rendition(const OutputSpec &spec, pipeline::MemoryBudget *budget);
+  };
+
   std::string png_dir;           /**< The directory containing PNG frames. */
-  std::vector<AVFrame *> frames; /**< The vector of frames. */
+  std::vector<ffmpeg::FramePtr> frames; /**< The vector of frames. */
   std::vector<std::string> png_files; /**< The vector of PNG file paths. */
-  AVFormatContext
-      *format_context_; /**< The format context for the output video. */
-  AVCodecContext
-      *codec_context_; /**< The codec context for encoding the video. */
-  AVStream *stream_;   /**< The video stream. */
-  AVFrame *frame_;     /**< The current frame being processed. */
+  std::vector<IntermediateFormat>
+      file_formats; /**< The format of each file in png_files. */
+  Encoder encoder_;    /**< Encodes and writes the main output. */
+  ffmpeg::FramePtr frame_; /**< The current frame being processed. */
+  double fragment_seconds_; /**< The fragment duration, 0 if unfragmented. */
+  io::InputOptions input_options_; /**< The options for reading PNG files. */
+  bool concatenate_; /**< Whether queued sources play one after another. */
+  ScaleAlgorithm scale_algorithm_; /**< The algorithm frames are scaled with. */
+  bool simd_kernels_; /**< Whether the SIMD kernels convert frames. */
+  pipeline::FrameAllocator
+      *frame_allocator_; /**< Allocates frame buffers, if set. */
+  int output_width_;  /**< The width of the output video. */
+  int output_height_; /**< The height of the output video. */
+  compose::Layout layout_; /**< The layout, without regions if none. */
+  compose::Compositor compositor_; /**< Places the sources on the canvas. */
+  int crossfade_frames_; /**< The frames of each crossfade, 0 for none. */
+  double keyframe_seconds_; /**< The longest distance between keyframes. */
+  int encoder_threads_; /**< The threads of each encoder, 0 for default. */
+  SceneDetector scene_detector_; /**< Finds the cuts that get keyframes. */
+  std::vector<std::unique_ptr<Rendition>>
+      renditions_; /**< The extra outputs, in the order they were added. */
+  const std::atomic<bool> *cancel_flag_; /**< Stops the calls, if set. */
+  pipeline::ProgressCounters
+      *progress_counters_; /**< Counts the progress, if set. */
+  pipeline::MemoryBudget
+      *memory_budget_; /**< Charged for queued and held frames, if set. */
 
   /**
-   * @brief Gets the PNG files in the specified directory.
+   * @brief Gets the frame files of the frame manifest in the directory, in
+   * the order they are combined, and the format of each.
+   * @return `true` if the manifest was read, `false` otherwise.
    */
-  void get_png_files_in_dir();
+  bool read_png_files_from_manifest();
 
   /**
    * @brief Converts PNG frames to AVFrames.
+   * @return `true` if every frame was written, `false` if a frame failed to
+   * load, scale or encode, or if cancelled.
    */
-  void convert_pngs_to_frames();
+  bool convert_pngs_to_frames();
 
   /**
-   * @brief Sets up the video codec for encoding.
+   * @brief Checks if the cancel flag is set.
+   * @return `true` if the calls should stop early, `false` otherwise.
    */
-  void setup_video_codec();
+  bool cancelled() const;
 
   /**
-   * @brief Opens the output file for writing.
-   * @param output_filename The filename of the output video.
+   * @brief Opens the main output and the renditions, and starts the
+   * rendition threads.
+   * @param output_filename The filename of the main output.
+   * @return `true` if the main output was opened, `false` otherwise.
+   */
+  bool open_outputs(const std::string &output_filename);
+
+  /**
+   * @brief Scales and encodes the frames queued for a rendition until its
+   * queue is closed, then writes its trailer.
+   * @param rendition The rendition.
+   */
+  void run_rendition(Rendition &rendition);
+
+  /**
+   * @brief Allocates the buffer of a frame through the frame allocator, if
+   * one is set.
+   * @param frame The frame, with its format, width and height set.
+   * @return `true` if the buffer was allocated, `false` otherwise.
+   */
+  bool get_frame_buffer(AVFrame *frame) const;
+
+  /**
+   * @brief Scales a frame of the main output to the size of a rendition.
+   * @param frame The frame of the main output.
+   * @param spec The size of the rendition.
+   * @param sws_context The scaler context of the rendition, created or
+   * updated as needed.
+   * @return The scaled frame, with the properties of the source frame, empty
+   * if scaling failed.
    */
-  void open_output_file(const std::string &output_filename);
+  ffmpeg::FramePtr scale_to_rendition(const AVFrame *frame,
+                                      const OutputSpec &spec,
+                                      ffmpeg::SwsContextPtr &sws_context) const;
+
+  /**
+   * @brief Closes the rendition queues and waits for the renditions to
+   * write their last frames.
+   */
+  void finish_renditions();
+
+  /**
+   * @brief Copies the packets of one input into the output.
+   * @param input The extractor of the input video.
+   * @param trim The range of the input to keep.
+   * @param offset The output timestamp the input starts at. It is advanced
+   * to the end of the input.
+   * @return `true` if copying was successful, `false` otherwise.
+   */
+  bool remux_input(Extractor &input, const TrimRange &trim, int64_t &offset);
 
   /**
    * @brief Processes the frames and writes them to the output file.
    */
   void process_frames();
 
+  /**
+   * @brief Encodes the frames popped from the sources in turn.
+   * @param sources The queues filled by the extractors.
+   * @return `true` if every frame was written, `false` if writing failed
+   * or the call was cancelled.
+   */
+  bool process_queued_frames(
+      const std::vector<pipeline::FrameQueue *> &sources);
+
+  /**
+   * @brief Encodes the concatenated sources, crossfading between them. A
+   * source shorter than the fade fades in over the last frames of the
+   * previous one.
+   * @param sources The queues filled by the extractors.
+   * @return `true` if every frame was written, `false` if writing or mixing
+   * failed or the call was cancelled.
+   */
+  bool process_crossfaded_frames(
+      const std::vector<pipeline::FrameQueue *> &sources);
+
+  /**
+   * @brief Rescales a queued frame to the output size and converts it to the
+   * output pixel format, if necessary.
+   * @param frame The frame, owned by the call.
+   * @return The frame to encode, nullptr if it failed.
+   */
+  AVFrame *prepare_frame(AVFrame *frame);
+
+  /**
+   * @brief Encodes frames composed from the next frame of every source.
+   * @param sources The queues filled by the extractors.
+   * @return `true` if every frame was written, `false` if writing failed
+   * or the call was cancelled.
+   */
+  bool process_composed_frames(
+      const std::vector<pipeline::FrameQueue *> &sources);
+
+  /**
+   * @brief Sets the picture type of a frame before it is encoded: a
+   * keyframe at transitions and scene cuts, and the encoder's choice
+   * otherwise.
+   * @param frame The frame.
+   * @param transition Whether the frame starts a new source.
+   */
+  void set_picture_type(AVFrame *frame, bool transition);
+
   /**
    * @brief Writes the trailer of the output video file.
+   * @return `true` if the trailer was written, `false` otherwise.
    */
-  void write_trailer();
+  bool write_trailer();
 
   /**
    * @brief Cleans up allocated resources and closes the output file.
@@ -86,6 +430,15 @@ private:
    */
   AVFrame *convert_png_to_av_frame(const std::string &file_path);
 
+  /**
+   * @brief Reads a frame file in the format the extractor saved it in.
+   * PNGs go through convert_png_to_av_frame(), so the input options apply
+   * to them; the other formats are read whole and decoded in memory.
+   * @param index The index of the file in png_files.
+   * @return The decoded AVFrame, `nullptr` if it failed.
+   */
+  AVFrame *load_frame_file(std::size_t index);
+
   /**
    * @brief Sets up a new AVFrame.
    * @return The allocated AVFrame.
@@ -100,11 +453,13 @@ private:
   void set_current_frame(AVFrame *frame, AVFrame *currentFrame);
 
   /**
-   * @brief Encodes and writes a frame to the output video file.
-   * @param frame The frame to encode and write.
+   * @brief Encodes and writes a frame to the output video file, and queues
+   * it for the renditions.
+   * @param frame The frame to encode and write. It stays owned by the
+   * caller.
    * @return `true` if encoding and writing was successful, `false` otherwise.
    */
-  bool encode_and_write_frame(AVFrame *frame);
+  bool encode_and_write_frame(const AVFrame *frame);
 
   /**
    * @brief Converts the pixel format of a frame if necessary.
@@ -163,18 +518,19 @@ private:
 
   /**
    * @brief Creates a new AVFrame.
-   * @return The created AVFrame.
+   * @return The created AVFrame, empty if allocation failed.
    */
-  AVFrame *create_frame();
+  ffmpeg::FramePtr create_frame();
 
   /**
    * @brief Creates a new AVCodecContext.
    * @param codec The AVCodec for the codec context.
    * @param codec_parameters The codec parameters for the codec context.
-   * @return The created AVCodecContext.
+   * @return The opened AVCodecContext, empty if it failed.
    */
-  AVCodecContext *create_codec_context(const AVCodec *codec,
-                                       AVCodecParameters *codec_parameters);
+  ffmpeg::CodecContextPtr
+  create_codec_context(const AVCodec *codec,
+                       AVCodecParameters *codec_parameters);
 
   /**
    * @brief Finds a decoder for the specified codec ID.
@@ -199,13 +555,13 @@ private:
 
   /**
    * @brief Opens the input file for reading.
-   * @param file_path The path of the input file.
-   * @param format_context The pointer to the format context to store the opened
-   * file.
+   * @param input_source The I/O layer of the input file.
+   * @param format_context Set to the format context of the opened file. It
+   * must be closed before the input source.
    * @return `true` if opening was successful, `false` otherwise.
    */
-  bool open_input_file(const std::string &file_path,
-                       AVFormatContext **format_context);
+  bool open_input_file(io::InputSource &input_source,
+                       ffmpeg::InputContextPtr &format_context);
 };
 } // namespace frame
 #endif
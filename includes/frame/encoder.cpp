@@ -0,0 +1,327 @@
+#include "encoder.hpp"
+#include "../logging/logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/dict.h>
+#include <libavutil/opt.h>
+}
+
+using namespace frame;
+
+/** The output filename that selects stdout. */
+static const std::string STDOUT_FILENAME = "-";
+/** The fragment duration used for stdout when none is configured. */
+static const double DEFAULT_FRAGMENT_SECONDS = 2.0;
+/** The bit rate of a 1920x1080 output, scaled by pixels for other sizes. */
+static const int64_t BIT_RATE_1080P = 8000000;
+
+OutputSpec frame::parse_output_spec(const std::string &text) {
+  // STEP 1: Split the size from the filename
+  const std::size_t colon = text.find(':');
+  const std::size_t x = text.find('x');
+  if (colon == std::string::npos || x == std::string::npos || x > colon ||
+      colon + 1 == text.size()) {
+    throw std::invalid_argument("Invalid output spec: " + text);
+  }
+
+  // STEP 2: Parse the size. H.264 with 4:2:0 chroma needs even sizes.
+  OutputSpec spec;
+  spec.filename = text.substr(colon + 1);
+  try {
+    std::size_t width_end = 0;
+    std::size_t height_end = 0;
+    spec.width = std::stoi(text.substr(0, x), &width_end);
+    spec.height = std::stoi(text.substr(x + 1, colon - x - 1), &height_end);
+    if (width_end != x || height_end != colon - x - 1) {
+      throw std::invalid_argument("Invalid output spec: " + text);
+    }
+  } catch (const std::logic_error &) {
+    throw std::invalid_argument("Invalid output spec: " + text);
+  }
+  if (spec.width <= 0 || spec.height <= 0 || spec.width % 2 != 0 ||
+      spec.height % 2 != 0) {
+    throw std::invalid_argument("Invalid output size: " + text);
+  }
+  return spec;
+}
+
+Encoder::Encoder()
+    : format_context_(), codec_context_(), stream_(nullptr),
+      fragment_seconds_(0.0), keyframe_seconds_(DEFAULT_KEYFRAME_SECONDS),
+      threads_(0), progress_counters_(nullptr) {}
+
+void Encoder::set_fragment_duration(double seconds) {
+  fragment_seconds_ = seconds > 0.0 ? seconds : 0.0;
+}
+
+void Encoder::set_keyframe_interval(double seconds) {
+  keyframe_seconds_ = seconds > 0.0 ? seconds : DEFAULT_KEYFRAME_SECONDS;
+}
+
+void Encoder::set_threads(int threads) {
+  threads_ = threads > 0 ? threads : 0;
+}
+
+bool Encoder::open(const OutputSpec &spec) {
+  // STEP 1: Set up video codec
+  if (!setup_video_codec(spec)) {
+    return false;
+  }
+
+  // STEP 2: Create the format context and the video stream
+  if (!allocate_output_context(spec.filename)) {
+    return false;
+  }
+
+  // STEP 3: Set the codec parameters for the video stream, including the
+  // global headers the fragments refer to
+  if (avcodec_parameters_from_context(stream_->codecpar,
+                                      codec_context_.get()) < 0) {
+    logging::error() << "Failed to copy the codec parameters.";
+    return false;
+  }
+  stream_->time_base = codec_context_->time_base;
+
+  // STEP 4: Open the output file and write the stream header
+  return write_output_header(spec.filename);
+}
+
+bool Encoder::open_copy(const std::string &filename,
+                        const AVCodecParameters *codec_parameters,
+                        AVRational time_base) {
+  // STEP 1: Create the output stream with the parameters of the input
+  if (!allocate_output_context(filename)) {
+    return false;
+  }
+  if (avcodec_parameters_copy(stream_->codecpar, codec_parameters) < 0) {
+    logging::error() << "Failed to copy the codec parameters.";
+    return false;
+  }
+  stream_->codecpar->codec_tag = 0;
+  stream_->time_base = time_base;
+
+  // STEP 2: Open the output file and write the stream header
+  return write_output_header(filename);
+}
+
+bool Encoder::encode(const AVFrame *frame) {
+  return frame && send_frame(frame);
+}
+
+void Encoder::set_progress_counters(pipeline::ProgressCounters *counters) {
+  progress_counters_ = counters;
+}
+
+bool Encoder::write_packet(AVPacket *packet) {
+  packet->stream_index = stream_->index;
+  packet->pos = -1;
+  if (progress_counters_) {
+    progress_counters_->add_bytes_written(packet->size);
+  }
+  if (av_interleaved_write_frame(format_context_.get(), packet) < 0) {
+    logging::error() << "Error writing video packet.";
+    av_packet_unref(packet);
+    return false;
+  }
+  return true;
+}
+
+bool Encoder::finish() {
+  if (!format_context_ || !stream_) {
+    return false;
+  }
+
+  // STEP 1: Drain the packets still buffered in the encoder
+  bool result = !codec_context_ || send_frame(nullptr);
+
+  // STEP 2: Write the trailer
+  if (av_write_trailer(format_context_.get()) < 0) {
+    logging::error() << "Failed to write the trailer.";
+    result = false;
+  }
+  return result;
+}
+
+const AVStream *Encoder::get_stream() const { return stream_; }
+
+bool Encoder::is_fragmented_output(const std::string &filename) const {
+  return fragment_seconds_ > 0.0 || filename == STDOUT_FILENAME;
+}
+
+const AVOutputFormat *
+Encoder::guess_output_format(const std::string &filename) const {
+  if (is_fragmented_output(filename)) {
+    return av_guess_format("mp4", nullptr, nullptr);
+  }
+  return av_guess_format(nullptr, filename.c_str(), nullptr);
+}
+
+bool Encoder::setup_video_codec(const OutputSpec &spec) {
+  // STEP 1: Find the video encoder
+  const AVCodec *codec = avcodec_find_encoder(OUTPUT_CODEC_ID);
+  if (!codec) {
+    logging::error() << "Failed to find the video encoder.";
+    return false;
+  }
+
+  // STEP 2: Create a new codec context
+  codec_context_.reset(avcodec_alloc_context3(codec));
+  if (!codec_context_) {
+    logging::error() << "Failed to allocate the video codec context.";
+    return false;
+  }
+
+  // STEP 3: Set the codec parameters
+  codec_context_->bit_rate = static_cast<int64_t>(
+      static_cast<double>(BIT_RATE_1080P) * spec.width * spec.height /
+      (1920.0 * 1080.0));
+  codec_context_->width = spec.width;
+  codec_context_->height = spec.height;
+  codec_context_->time_base = av_inv_q(OUTPUT_FRAME_RATE);
+  codec_context_->framerate = OUTPUT_FRAME_RATE;
+  codec_context_->max_b_frames = 1;
+  codec_context_->pix_fmt = OUTPUT_PIXEL_FORMAT;
+  if (threads_ > 0) {
+    codec_context_->thread_count = threads_;
+  }
+
+  // Keyframes are placed at scene cuts, so the GOP only has to be short
+  // enough to seek in and to start every fragment on time
+  double keyframe_seconds = keyframe_seconds_;
+  if (is_fragmented_output(spec.filename)) {
+    keyframe_seconds = std::min(keyframe_seconds,
+                                fragment_seconds_ > 0.0
+                                    ? fragment_seconds_
+                                    : DEFAULT_FRAGMENT_SECONDS);
+  }
+  codec_context_->gop_size = std::max(
+      1, static_cast<int>(
+             std::lround(keyframe_seconds * av_q2d(OUTPUT_FRAME_RATE))));
+
+  // Forced keyframes become IDR frames, which the fragments and seeks can
+  // start at. Encoders without the option ignore it.
+  av_opt_set(codec_context_->priv_data, "forced-idr", "1", 0);
+
+  // Containers such as MP4 keep SPS/PPS in the stream header rather than in
+  // the bitstream
+  const AVOutputFormat *output_format = guess_output_format(spec.filename);
+  if (output_format && (output_format->flags & AVFMT_GLOBALHEADER)) {
+    codec_context_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  // STEP 4: Open the codec
+  if (avcodec_open2(codec_context_.get(), codec, nullptr) < 0) {
+    logging::error() << "Failed to open the video codec.";
+    return false;
+  }
+  return true;
+}
+
+bool Encoder::allocate_output_context(const std::string &filename) {
+  const std::string url = filename == STDOUT_FILENAME ? "pipe:1" : filename;
+
+  // STEP 1: Create the format context
+  AVFormatContext *format_context = nullptr;
+  if (avformat_alloc_output_context2(&format_context,
+                                     guess_output_format(filename), nullptr,
+                                     url.c_str()) < 0) {
+    logging::error() << "Failed to allocate the output format context.";
+    return false;
+  }
+  format_context_.reset(format_context);
+
+  // STEP 2: Create a new video stream
+  stream_ = avformat_new_stream(format_context_.get(), nullptr);
+  if (!stream_) {
+    logging::error() << "Failed to allocate the video stream.";
+    return false;
+  }
+
+  return true;
+}
+
+bool Encoder::write_output_header(const std::string &filename) {
+  const std::string url = filename == STDOUT_FILENAME ? "pipe:1" : filename;
+
+  // STEP 1: Open the output file
+  if (!(format_context_->oformat->flags & AVFMT_NOFILE) &&
+      avio_open(&format_context_->pb, url.c_str(), AVIO_FLAG_WRITE) < 0) {
+    logging::error() << "Failed to open the output file.";
+    return false;
+  }
+
+  // STEP 2: Configure fragmentation. Each fragment starts at a keyframe and
+  // is flushed as soon as it is complete.
+  AVDictionary *options = nullptr;
+  if (is_fragmented_output(filename)) {
+    const double seconds =
+        fragment_seconds_ > 0.0 ? fragment_seconds_ : DEFAULT_FRAGMENT_SECONDS;
+    av_dict_set(&options, "movflags",
+                "frag_keyframe+empty_moov+default_base_moof", 0);
+    av_dict_set_int(&options, "min_frag_duration",
+                    static_cast<int64_t>(seconds * AV_TIME_BASE), 0);
+    av_dict_set(&options, "flush_packets", "1", 0);
+  }
+
+  // STEP 3: Write the stream header
+  const int header_result =
+      avformat_write_header(format_context_.get(), &options);
+  av_dict_free(&options);
+  if (header_result < 0) {
+    logging::error() << "Failed to write the stream header.";
+    return false;
+  }
+
+  return true;
+}
+
+bool Encoder::send_frame(const AVFrame *frame) {
+  if (!codec_context_ || !format_context_) {
+    return false;
+  }
+
+  // STEP 1: Allocate a packet for the encoded frame
+  ffmpeg::PacketPtr packet = ffmpeg::make_packet();
+  if (!packet) {
+    logging::error() << "Failed to allocate packet.";
+    return false;
+  }
+
+  // STEP 2: Send the frame to the codec for encoding
+  if (avcodec_send_frame(codec_context_.get(), frame) < 0) {
+    // Error sending the frame to the codec
+    logging::error() << "Error sending a frame to the codec.";
+    return false;
+  }
+
+  // STEP 3: Receive and write packets until no more packets are available
+  while (avcodec_receive_packet(codec_context_.get(), packet.get()) == 0) {
+    // Rescale the packet's timestamp
+    av_packet_rescale_ts(packet.get(), codec_context_->time_base,
+                         stream_->time_base);
+    // Set the packet's stream index
+    packet->stream_index = stream_->index;
+
+    // Write the packet to the output file
+    if (progress_counters_) {
+      progress_counters_->add_bytes_written(packet->size);
+    }
+    if (av_interleaved_write_frame(format_context_.get(), packet.get()) < 0) {
+      // Error writing the video frame
+      logging::error() << "Error writing video frame.";
+      av_packet_unref(packet.get());
+      return false;
+    }
+
+    // Free the packet for reuse
+    av_packet_unref(packet.get());
+  }
+
+  return true;
+}
@@ -0,0 +1,191 @@
+#ifndef FRAME_ENCODER
+#define FRAME_ENCODER
+
+#include "../ffmpeg/handles.hpp"
+#include "../pipeline/progress.hpp"
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+namespace frame {
+/** The codec of the output videos. */
+static const AVCodecID OUTPUT_CODEC_ID = AV_CODEC_ID_H264;
+/** The pixel format of the output videos. */
+static const AVPixelFormat OUTPUT_PIXEL_FORMAT = AV_PIX_FMT_YUV420P;
+/** The frame rate of the output videos. */
+static const AVRational OUTPUT_FRAME_RATE = {30, 1};
+/** The default longest distance between keyframes, in seconds. */
+static const double DEFAULT_KEYFRAME_SECONDS = 4.0;
+
+/**
+ * @brief The size and file of one output video.
+ */
+struct OutputSpec {
+  std::string filename; /**< The filename of the output video. */
+  int width = 0;        /**< The width of the output video. */
+  int height = 0;       /**< The height of the output video. */
+};
+
+/**
+ * @brief Parses an output spec such as "720x1280:clip_720.mp4".
+ * @param text The size, a colon and the filename.
+ * @return The output spec.
+ * @throws std::invalid_argument If the text is not a valid output spec.
+ */
+OutputSpec parse_output_spec(const std::string &text);
+
+/**
+ * @brief Writes one output video: the H.264 encoder, the muxer and the
+ * output file. Encoders are movable but not copyable; the file is closed
+ * when the encoder is destroyed.
+ */
+class Encoder {
+public:
+  /**
+   * @brief Constructs an Encoder object.
+   */
+  Encoder();
+
+  Encoder(const Encoder &) = delete;
+  Encoder &operator=(const Encoder &) = delete;
+  Encoder(Encoder &&) = default;
+  Encoder &operator=(Encoder &&) = default;
+
+  /**
+   * @brief Writes the output as fragmented MP4. See
+   * Combiner::set_fragment_duration().
+   * @param seconds The minimum duration of a fragment, 0 for none.
+   */
+  void set_fragment_duration(double seconds);
+
+  /**
+   * @brief Sets the longest distance between two keyframes. See
+   * Combiner::set_keyframe_interval().
+   * @param seconds The keyframe interval.
+   */
+  void set_keyframe_interval(double seconds);
+
+  /**
+   * @brief Sets the threads the encoder may use. See
+   * Combiner::set_encoder_threads().
+   * @param threads The threads, 0 for FFmpeg's default.
+   */
+  void set_threads(int threads);
+
+  /**
+   * @brief Counts the bytes of every packet written.
+   * @param counters The counters, `nullptr` for none. They must outlive the
+   * encoder's writes.
+   */
+  void set_progress_counters(pipeline::ProgressCounters *counters);
+
+  /**
+   * @brief Opens the encoder and the output file, and writes the header.
+   * The bit rate follows the number of pixels, 8 Mbit/s at 1080p.
+   * @param spec The size and file of the output video.
+   * @return `true` if the output is ready for frames, `false` otherwise.
+   */
+  bool open(const OutputSpec &spec);
+
+  /**
+   * @brief Opens the output file for packets copied from an input, and
+   * writes the header.
+   * @param filename The filename of the output video.
+   * @param codec_parameters The parameters of the copied stream.
+   * @param time_base The time base of the copied packets.
+   * @return `true` if the output is ready for packets, `false` otherwise.
+   */
+  bool open_copy(const std::string &filename,
+                 const AVCodecParameters *codec_parameters,
+                 AVRational time_base);
+
+  /**
+   * @brief Encodes a frame and writes the packets it completes.
+   * @param frame The frame. It stays owned by the caller.
+   * @return `true` if encoding and writing was successful, `false`
+   * otherwise.
+   */
+  bool encode(const AVFrame *frame);
+
+  /**
+   * @brief Writes a packet copied from an input.
+   * @param packet The packet, with timestamps in the output stream's time
+   * base. It is unreferenced.
+   * @return `true` if writing was successful, `false` otherwise.
+   */
+  bool write_packet(AVPacket *packet);
+
+  /**
+   * @brief Drains the packets still buffered in the encoder and writes the
+   * trailer.
+   * @return `true` if writing was successful, `false` otherwise.
+   */
+  bool finish();
+
+  /**
+   * @brief Gets the output video stream.
+   * @return The stream, or `nullptr` before the output is opened.
+   */
+  const AVStream *get_stream() const;
+
+  /**
+   * @brief Checks if an output filename writes fragmented MP4.
+   * @param filename The filename of the output video.
+   * @return `true` if the output is fragmented, `false` otherwise.
+   */
+  bool is_fragmented_output(const std::string &filename) const;
+
+private:
+  ffmpeg::OutputContextPtr
+      format_context_; /**< The format context for the output video. */
+  ffmpeg::CodecContextPtr
+      codec_context_; /**< The codec context for encoding the video. */
+  AVStream *stream_;  /**< The video stream, owned by the format context. */
+  double fragment_seconds_; /**< The fragment duration, 0 if unfragmented. */
+  double keyframe_seconds_; /**< The longest distance between keyframes. */
+  int threads_; /**< The encoder threads, 0 for FFmpeg's default. */
+  pipeline::ProgressCounters
+      *progress_counters_; /**< Counts the bytes written, if set. */
+
+  /**
+   * @brief Sets up the video codec for encoding.
+   * @param spec The size and file of the output video.
+   * @return `true` if the codec was opened, `false` otherwise.
+   */
+  bool setup_video_codec(const OutputSpec &spec);
+
+  /**
+   * @brief Allocates the output format context and its video stream.
+   * @param filename The filename of the output video.
+   * @return `true` if allocation was successful, `false` otherwise.
+   */
+  bool allocate_output_context(const std::string &filename);
+
+  /**
+   * @brief Opens the output file and writes the stream header.
+   * @param filename The filename of the output video.
+   * @return `true` if writing was successful, `false` otherwise.
+   */
+  bool write_output_header(const std::string &filename);
+
+  /**
+   * @brief Guesses the muxer for the output file.
+   * @param filename The filename of the output video.
+   * @return The output format, or `nullptr` if none matches.
+   */
+  const AVOutputFormat *guess_output_format(const std::string &filename) const;
+
+  /**
+   * @brief Sends a frame, or `nullptr` to drain, to the encoder and writes
+   * the packets it returns.
+   * @param frame The frame, or `nullptr`.
+   * @return `true` if encoding and writing was successful, `false`
+   * otherwise.
+   */
+  bool send_frame(const AVFrame *frame);
+};
+} // namespace frame
+#endif
@@ -1,10 +1,14 @@
 #include "extractor.hpp"
+#include "../logging/logger.hpp"
+#include "../pipeline/task_scheduler.hpp"
+#include "../simd/convert.hpp"
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
-#include <iostream>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 extern "C" {
@@ -16,20 +20,120 @@ extern "C" {
 
 using namespace frame;
 
-Extractor::Extractor(const std::string &video_path)
-    : format_context(nullptr), codec_context(nullptr), codec(nullptr),
-      video_stream_index(-1), frame_count(0) {
-  // STEP 1: Retrieve the stream information from the video file
-  if (avformat_open_input(&format_context, video_path.c_str(), nullptr,
-                          nullptr) != 0) {
-    std::cerr << "Failed to open video file." << std::endl;
+/** The brightest luma sample a black bar may contain. */
+static const int BLACK_MAX_LUMA = 40;
+/** The brightest mean luma of a black bar's row or column. */
+static const int BLACK_MEAN_LUMA = 24;
+/** The distance between the rows or columns scanned for bars. */
+static const int CROP_SCAN_STEP = 2;
+/** The distance between the samples read along a row or column. */
+static const int CROP_SAMPLE_STEP = 8;
+/** The frames per scheduler worker that may wait to be saved as images. */
+static const std::size_t PNG_FRAMES_PER_WORKER = 2;
+
+namespace {
+/**
+ * @brief Checks if a luma line is black from a decimated subset of samples.
+ * @param luma The first sample of the line.
+ * @param stride The distance between consecutive samples of the line.
+ * @param length The number of samples in the line.
+ */
+bool is_black_line(const std::uint8_t *luma, std::ptrdiff_t stride,
+                   int length) {
+  int sum = 0;
+  int count = 0;
+  for (int i = 0; i < length; i += CROP_SAMPLE_STEP) {
+    const int sample = luma[i * stride];
+    if (sample > BLACK_MAX_LUMA) {
+      return false;
+    }
+    sum += sample;
+    ++count;
+  }
+  return count == 0 || sum <= BLACK_MEAN_LUMA * count;
+}
+
+/**
+ * @brief Checks if the luma plane of a frame is 8-bit and addressable on
+ * its own.
+ */
+bool has_8bit_luma(const AVFrame *frame) {
+  switch (frame->format) {
+  case AV_PIX_FMT_YUV420P:
+  case AV_PIX_FMT_YUVJ420P:
+  case AV_PIX_FMT_YUV422P:
+  case AV_PIX_FMT_YUV444P:
+  case AV_PIX_FMT_NV12:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Finds the picture content of a frame inside its black bars.
+ * @param frame The frame.
+ * @param content Set to the content rectangle.
+ * @return `true` if there is content, `false` if the frame is all black.
+ */
+bool find_content(const AVFrame *frame, compose::Rect &content) {
+  const std::uint8_t *luma = frame->data[0];
+  const int stride = frame->linesize[0];
+  const int width = frame->width;
+  const int height = frame->height;
+
+  // STEP 1: Scan rows inwards from the top and bottom
+  int top = 0;
+  while (top < height && is_black_line(luma + top * stride, 1, width)) {
+    top += CROP_SCAN_STEP;
+  }
+  if (top >= height) {
+    return false;
+  }
+  int bottom = height;
+  while (bottom - 1 > top &&
+         is_black_line(luma + (bottom - 1) * stride, 1, width)) {
+    bottom -= CROP_SCAN_STEP;
+  }
+
+  // STEP 2: Scan columns inwards from the sides, only between the bars
+  const std::uint8_t *content_rows = luma + top * stride;
+  const int rows = bottom - top;
+  int left = 0;
+  while (left < width && is_black_line(content_rows + left, stride, rows)) {
+    left += CROP_SCAN_STEP;
+  }
+  int right = width;
+  while (right - 1 > left &&
+         is_black_line(content_rows + right - 1, stride, rows)) {
+    right -= CROP_SCAN_STEP;
+  }
+
+  content = {left, top, right - left, bottom - top};
+  return true;
+}
+} // namespace
+
+Extractor::Extractor(const std::string &video_path,
+                     const io::InputOptions &input_options)
+    : input_source(new io::InputSource(video_path, input_options)),
+      format_context(), codec_context(), codec(nullptr),
+      video_stream_index(-1), frame_count(0), trim(),
+      scale_algorithm(ScaleAlgorithm::Bicubic), simd_kernels(true),
+      intermediate_format(IntermediateFormat::Png), crop(),
+      cancel_flag(nullptr), progress_counters(nullptr) {
+  // STEP 1: Open the video file through the configured I/O layer
+  AVFormatContext *input_context = nullptr;
+  if (!input_source->open_format_context(&input_context)) {
+    logging::error() << "Failed to open video file.";
     return;
   }
+  format_context.reset(input_context);
 
   // STEP 2: Retrieve the stream information from the video file
-  if (avformat_find_stream_info(format_context, nullptr) < 0) {
-    avformat_close_input(&format_context);
-    std::cerr << "Failed to retrieve stream information." << std::endl;
+  if (avformat_find_stream_info(format_context.get(), nullptr) < 0) {
+    format_context.reset();
+    logging::error() << "Failed to retrieve stream information.";
     return;
   }
 
@@ -37,29 +141,126 @@ Extractor::Extractor(const std::string &video_path)
   find_video_stream();
 
   // STEP 4: Initialize the video codec for decoding frames
-  init_video_codec();
+  init_video_codec(input_options.decoder_threads);
 }
 
-// Destructor to clean up allocated resources
-Extractor::~Extractor() {
-  avcodec_free_context(&codec_context);
-  avformat_close_input(&format_context);
+int Extractor::extract_thumbnails(const std::string &output_path,
+                                  const ThumbnailOptions &options) {
+  if (!format_context || !codec_context) {
+    return 0;
+  }
+  const double duration =
+      format_context->duration > 0
+          ? static_cast<double>(format_context->duration) / AV_TIME_BASE
+          : 0.0;
+  const bool interval_mode = options.mode == ThumbnailMode::Interval;
+  if (interval_mode && options.interval_seconds <= 0.0) {
+    logging::error() << "The thumbnail interval must be positive.";
+    return 0;
+  }
+
+  // STEP 1: Have the decoder skip anything but keyframes
+  codec_context->skip_frame = AVDISCARD_NONKEY;
+
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  if (!frame) {
+    logging::error() << "Failed to allocate frame.";
+    codec_context->skip_frame = AVDISCARD_DEFAULT;
+    return 0;
+  }
+  ffmpeg::SwsContextPtr sws_context;
+  std::vector<ffmpeg::FramePtr> sheet_thumbnails;
+  int count = 0;
+  double next_time = 0.0;
+  double last_time = -1.0;
+
+  while (options.max_thumbnails <= 0 || count < options.max_thumbnails) {
+    // STEP 2: In interval mode, jump to the keyframe at or before the next
+    // sample time
+    if (interval_mode) {
+      if (duration > 0.0 && next_time >= duration) {
+        break;
+      }
+      if (next_time > 0.0 && !seek_to_keyframe(next_time)) {
+        break;
+      }
+      next_time += options.interval_seconds;
+    }
+    if (!decode_next_keyframe(frame.get())) {
+      break;
+    }
+
+    // STEP 3: Skip keyframes too close to the last thumbnail. In interval
+    // mode, a long GOP makes several seeks land on the same keyframe.
+    const double time = timestamp_to_seconds(frame->best_effort_timestamp);
+    const bool too_close =
+        last_time >= 0.0 &&
+        (interval_mode ? time <= last_time
+                       : time < last_time + options.interval_seconds);
+    if (too_close) {
+      av_frame_unref(frame.get());
+      if (interval_mode && duration <= 0.0) {
+        break;
+      }
+      continue;
+    }
+
+    // STEP 4: Scale the frame down to a thumbnail
+    apply_crop(frame.get());
+    ffmpeg::FramePtr thumbnail =
+        scale_thumbnail(frame.get(), options.width, options.format,
+                        scale_algorithm, sws_context);
+    av_frame_unref(frame.get());
+    if (!thumbnail) {
+      break;
+    }
+    last_time = time;
+    ++count;
+
+    // STEP 5: Keep it for the contact sheet, or write it to its own file
+    if (options.columns > 0) {
+      sheet_thumbnails.push_back(std::move(thumbnail));
+      continue;
+    }
+    std::stringstream thumbnail_path_ss;
+    thumbnail_path_ss << output_path << "/thumb_" << std::setfill('0')
+                      << std::setw(5) << count
+                      << image_extension(options.format);
+    const std::string thumbnail_path = thumbnail_path_ss.str();
+    if (write_image(thumbnail.get(), options.format, thumbnail_path)) {
+      logging::info() << "Processed " << thumbnail_path;
+    }
+  }
+
+  // STEP 6: Tile the contact sheet
+  if (!sheet_thumbnails.empty()) {
+    const ffmpeg::FramePtr sheet =
+        tile_contact_sheet(sheet_thumbnails, options.columns);
+    if (sheet && write_image(sheet.get(), options.format, output_path)) {
+      logging::info() << "Processed " << output_path;
+    }
+  }
+
+  // STEP 7: Decode every frame again, from the start
+  codec_context->skip_frame = AVDISCARD_DEFAULT;
+  seek_to_keyframe(0.0);
+  return count;
 }
 
 int Extractor::get_leading_zeros() {
   AVPacket packet;
-  AVFrame *frame = av_frame_alloc();
 
   // STEP 1: Calculate the total number of frames
   int total_frames = 0;
-  while (av_read_frame(format_context, &packet) >= 0) {
+  while (av_read_frame(format_context.get(), &packet) >= 0) {
     if (packet.stream_index == video_stream_index) {
       total_frames += 1;
     }
 
     av_packet_unref(&packet);
   }
-  av_seek_frame(format_context, video_stream_index, 0, AVSEEK_FLAG_BACKWARD);
+  av_seek_frame(format_context.get(), video_stream_index, 0,
+                AVSEEK_FLAG_BACKWARD);
 
   // STEP 2: Determine the width for leading zeros
   int width = 1;
@@ -69,43 +270,374 @@ int Extractor::get_leading_zeros() {
     width += 1;
   }
 
-  // STEP 3: Cleanup
-  av_frame_free(&frame);
-
   return width;
 }
 
-void Extractor::extract_frames(const std::string &output_dir, int width) {
+bool Extractor::extract_frames(const std::string &output_dir,
+                               FrameManifestWriter &manifest,
+                               std::uint32_t source) {
   AVPacket packet;
-  AVFrame *frame = av_frame_alloc();
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  if (!frame) {
+    logging::error() << "Failed to allocate frame.";
+    return false;
+  }
+
+  // Frames are encoded as images on the scheduler while decoding goes on,
+  // with a few frames per worker in flight at most
+  pipeline::TaskGroup png_tasks;
+  const std::size_t max_in_flight =
+      PNG_FRAMES_PER_WORKER * png_tasks.scheduler().worker_count();
+
+  // Saves a decoded frame as an image file in the output directory, and
+  // records it in decode order, so the combiner never has to list or sort
+  // the directory. A frame that cannot be saved fails the extraction, so
+  // the manifest never lists a file that is missing.
+  std::atomic<bool> failed(false);
+  frame_count = 0;
+  auto handle_frame = [&] {
+    const int index = frame_count++;
+
+    // The task gets its own reference, as the decoder reuses `frame`
+    apply_crop(frame.get());
+    AVFrame *decoded = av_frame_clone(frame.get());
+    if (!decoded) {
+      logging::error().frame(index) << "Failed to reference frame.";
+      failed = true;
+      return;
+    }
+    FrameManifestEntry entry;
+    entry.source = source;
+    entry.format = static_cast<std::uint32_t>(intermediate_format);
+    entry.index = index;
+    entry.pts = frame->best_effort_timestamp;
+    if (!manifest.append(entry)) {
+      logging::error().frame(index) << "Failed to record frame.";
+      av_frame_free(&decoded);
+      failed = true;
+      return;
+    }
+
+    const std::string frame_path =
+        output_dir + "/" + frame_file_name(source, index, intermediate_format);
+    png_tasks.wait(max_in_flight - 1);
+    png_tasks.run([this, decoded, frame_path, index, &failed] {
+      const ffmpeg::FramePtr owned(decoded);
+      if (!save_frame_as_image(owned.get(), frame_path)) {
+        logging::error().frame(index) << "Failed to save frame.";
+        failed = true;
+      }
+    });
+    if (progress_counters) {
+      progress_counters->add_decoded();
+    }
+  };
 
   // STEP 1: Read packets from the format context until the end of
   // the video stream is reached
-  int frame_count = 0;
-  while (av_read_frame(format_context, &packet) >= 0) {
-    // STEP 2: Send packets to the codec context for decoding and
-    // receive frames
+  while (!failed && !cancelled() &&
+         av_read_frame(format_context.get(), &packet) >= 0) {
+    // STEP 2: Send packets to the codec context for decoding and save
+    // every frame it returns
     if (packet.stream_index == video_stream_index) {
-      avcodec_send_packet(codec_context, &packet);
+      avcodec_send_packet(codec_context.get(), &packet);
+      while (!failed &&
+             avcodec_receive_frame(codec_context.get(), frame.get()) == 0) {
+        handle_frame();
+      }
+    }
+    av_packet_unref(&packet);
+  }
 
-      for (; avcodec_receive_frame(codec_context, frame) == 0; frame_count++) {
-        // STEP 3: Save each received frame as an image file in the
-        // output directory with leading zeros in the filename
-        std::stringstream frame_path_ss;
-        frame_path_ss << output_dir << "/frame_" << std::setfill('0')
-                      << std::setw(width) << frame_count << "_" << this
-                      << ".png";
+  // STEP 3: Drain the frames still buffered in the decoder, which frame
+  // threading holds back
+  if (!failed && !cancelled()) {
+    avcodec_send_packet(codec_context.get(), nullptr);
+    while (!failed &&
+           avcodec_receive_frame(codec_context.get(), frame.get()) == 0) {
+      handle_frame();
+    }
+  }
+  png_tasks.wait();
+  return !failed;
+}
+
+void Extractor::extract_frames(pipeline::FrameQueue &queue) {
+  AVPacket packet;
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  if (!frame) {
+    logging::error() << "Failed to allocate frame.";
+    queue.close();
+    return;
+  }
+  bool consumer_open = true;
+  bool in_range = true;
+
+  // STEP 1: Start at the keyframe before the trim start
+  if (trim.start > 0.0) {
+    seek_to_keyframe(trim.start);
+  }
+
+  // Queues a decoded frame if it lies inside the trim range
+  auto handle_frame = [&] {
+    const double seconds = timestamp_to_seconds(frame->best_effort_timestamp);
+    if (trim.end > 0.0 && seconds >= trim.end) {
+      in_range = false;
+      av_frame_unref(frame.get());
+      return;
+    }
+    if (seconds < trim.start) {
+      av_frame_unref(frame.get());
+      return;
+    }
+    apply_crop(frame.get());
+    if (progress_counters) {
+      progress_counters->add_decoded();
+    }
+    consumer_open = queue_frame(queue, frame.get());
+  };
 
-        std::string frame_path = frame_path_ss.str();
+  // STEP 2: Read packets until the end of the video stream is reached
+  while (consumer_open && in_range && !cancelled() &&
+         av_read_frame(format_context.get(), &packet) >= 0) {
+    if (packet.stream_index == video_stream_index) {
+      // STEP 3: Send the packet to the decoder and queue every frame it
+      // returns. Pushing blocks while the consumer is behind.
+      avcodec_send_packet(codec_context.get(), &packet);
 
-        save_frame_as_image(frame, frame_path);
-        std::cout << "[INFO] Processed " << frame_path << std::endl;
+      while (consumer_open && in_range &&
+             avcodec_receive_frame(codec_context.get(), frame.get()) == 0) {
+        handle_frame();
       }
     }
     av_packet_unref(&packet);
   }
 
-  av_frame_free(&frame);
+  // STEP 4: Drain the frames still buffered in the decoder
+  if (consumer_open && in_range) {
+    avcodec_send_packet(codec_context.get(), nullptr);
+    while (consumer_open && in_range &&
+           avcodec_receive_frame(codec_context.get(), frame.get()) == 0) {
+      handle_frame();
+    }
+  }
+
+  // STEP 5: Tell the consumer that no more frames will follow
+  queue.close();
+}
+
+bool Extractor::queue_frame(pipeline::FrameQueue &queue, AVFrame *frame) {
+  // STEP 1: Move the decoded frame into a new reference for the queue
+  ffmpeg::FramePtr queued_frame = ffmpeg::make_frame();
+  if (!queued_frame) {
+    logging::error() << "Failed to allocate queued frame.";
+    av_frame_unref(frame);
+    return false;
+  }
+  av_frame_move_ref(queued_frame.get(), frame);
+
+  // STEP 2: Push it, blocking while the consumer is behind
+  return queue.push(queued_frame.release());
+}
+
+void Extractor::set_trim(const TrimRange &range) { trim = range; }
+
+void Extractor::set_scale_algorithm(ScaleAlgorithm algorithm) {
+  scale_algorithm = algorithm;
+}
+
+void Extractor::set_simd_kernels(bool enabled) { simd_kernels = enabled; }
+
+void Extractor::set_intermediate_format(IntermediateFormat format) {
+  intermediate_format = format;
+}
+
+void Extractor::set_cancel_flag(const std::atomic<bool> *flag) {
+  cancel_flag = flag;
+}
+
+bool Extractor::cancelled() const { return cancel_flag && *cancel_flag; }
+
+void Extractor::set_progress_counters(pipeline::ProgressCounters *counters) {
+  progress_counters = counters;
+}
+
+void Extractor::set_frame_allocator(pipeline::FrameAllocator *allocator) {
+  if (allocator && codec_context) {
+    allocator->attach(codec_context.get());
+  }
+}
+
+compose::Rect Extractor::detect_crop(int samples) {
+  if (!format_context || !codec_context) {
+    return compose::Rect();
+  }
+  const compose::Rect whole = {0, 0, codec_context->width,
+                               codec_context->height};
+  const double duration =
+      format_context->duration > 0
+          ? static_cast<double>(format_context->duration) / AV_TIME_BASE
+          : 0.0;
+
+  // STEP 1: Find the content of frames spread evenly over the video, and
+  // keep the union of them
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  if (!frame) {
+    logging::error() << "Failed to allocate frame.";
+    return whole;
+  }
+  int top = whole.height, bottom = 0, left = whole.width, right = 0;
+  for (int i = 0; i < samples; ++i) {
+    if (duration > 0.0) {
+      seek_to_keyframe(duration * (i + 1) / (samples + 1));
+    }
+    if (!decode_next_frame(frame.get())) {
+      break;
+    }
+
+    compose::Rect content;
+    if (has_8bit_luma(frame.get()) && find_content(frame.get(), content)) {
+      top = std::min(top, content.y);
+      bottom = std::max(bottom, content.y + content.height);
+      left = std::min(left, content.x);
+      right = std::max(right, content.x + content.width);
+    }
+    av_frame_unref(frame.get());
+  }
+
+  // STEP 2: Rewind so extraction starts at the beginning
+  seek_to_keyframe(0.0);
+
+  // STEP 3: Keep the chroma planes aligned with even edges
+  if (bottom <= top || right <= left) {
+    return whole;
+  }
+  top = (top + 1) & ~1;
+  left = (left + 1) & ~1;
+  bottom &= ~1;
+  right &= ~1;
+  if (bottom <= top || right <= left) {
+    return whole;
+  }
+  return {left, top, right - left, bottom - top};
+}
+
+void Extractor::set_crop(const compose::Rect &rect) { crop = rect; }
+
+const AVStream *Extractor::get_video_stream() const {
+  if (!format_context || video_stream_index < 0) {
+    return nullptr;
+  }
+  return format_context->streams[video_stream_index];
+}
+
+bool Extractor::seek_to_keyframe(double seconds) {
+  const AVStream *stream = get_video_stream();
+  if (!stream) {
+    return false;
+  }
+
+  // STEP 1: Convert the time to a timestamp of the video stream
+  int64_t timestamp = static_cast<int64_t>(seconds / av_q2d(stream->time_base));
+  if (stream->start_time != AV_NOPTS_VALUE) {
+    timestamp += stream->start_time;
+  }
+
+  // STEP 2: Seek backwards to the closest keyframe
+  if (av_seek_frame(format_context.get(), video_stream_index, timestamp,
+                    AVSEEK_FLAG_BACKWARD) < 0) {
+    logging::error() << "Failed to seek video.";
+    return false;
+  }
+
+  // STEP 3: Drop the frames the decoder buffered before the seek
+  if (codec_context) {
+    avcodec_flush_buffers(codec_context.get());
+  }
+
+  return true;
+}
+
+bool Extractor::read_video_packet(AVPacket *packet) {
+  while (av_read_frame(format_context.get(), packet) >= 0) {
+    if (packet->stream_index == video_stream_index) {
+      return true;
+    }
+    av_packet_unref(packet);
+  }
+  return false;
+}
+
+bool Extractor::decode_next_frame(AVFrame *frame) {
+  // STEP 1: Take a frame the decoder already has
+  if (avcodec_receive_frame(codec_context.get(), frame) == 0) {
+    return true;
+  }
+
+  // STEP 2: Feed it packets until it returns one
+  ffmpeg::PacketPtr packet = ffmpeg::make_packet();
+  bool decoded = false;
+  while (!decoded && packet && read_video_packet(packet.get())) {
+    avcodec_send_packet(codec_context.get(), packet.get());
+    av_packet_unref(packet.get());
+    decoded = avcodec_receive_frame(codec_context.get(), frame) == 0;
+  }
+  return decoded;
+}
+
+bool Extractor::decode_next_keyframe(AVFrame *frame) {
+  // STEP 1: Take a frame the decoder already has
+  if (avcodec_receive_frame(codec_context.get(), frame) == 0) {
+    return true;
+  }
+
+  // STEP 2: Feed it keyframe packets until it returns one
+  ffmpeg::PacketPtr packet = ffmpeg::make_packet();
+  bool decoded = false;
+  while (!decoded && packet && read_video_packet(packet.get())) {
+    if (packet->flags & AV_PKT_FLAG_KEY) {
+      avcodec_send_packet(codec_context.get(), packet.get());
+      decoded = avcodec_receive_frame(codec_context.get(), frame) == 0;
+    }
+    av_packet_unref(packet.get());
+  }
+
+  // STEP 3: At the end of the video, drain the frames the decoder delays
+  if (!decoded) {
+    avcodec_send_packet(codec_context.get(), nullptr);
+    decoded = avcodec_receive_frame(codec_context.get(), frame) == 0;
+  }
+  return decoded;
+}
+
+void Extractor::apply_crop(AVFrame *frame) const {
+  // STEP 1: Skip frames that need no crop or that it does not fit
+  if (crop.width <= 0 || crop.height <= 0 ||
+      (crop.width == frame->width && crop.height == frame->height) ||
+      crop.x + crop.width > frame->width ||
+      crop.y + crop.height > frame->height) {
+    return;
+  }
+
+  // STEP 2: Move the data pointers to the rectangle
+  frame->crop_left = crop.x;
+  frame->crop_top = crop.y;
+  frame->crop_right = frame->width - crop.x - crop.width;
+  frame->crop_bottom = frame->height - crop.y - crop.height;
+  if (av_frame_apply_cropping(frame, AV_FRAME_CROP_UNALIGNED) < 0) {
+    logging::error() << "Failed to crop the frame.";
+  }
+}
+
+double Extractor::timestamp_to_seconds(int64_t timestamp) const {
+  const AVStream *stream = get_video_stream();
+  if (!stream || timestamp == AV_NOPTS_VALUE) {
+    return 0.0;
+  }
+  if (stream->start_time != AV_NOPTS_VALUE) {
+    timestamp -= stream->start_time;
+  }
+  return timestamp * av_q2d(stream->time_base);
 }
 
 void Extractor::find_video_stream() {
@@ -124,28 +656,28 @@ void Extractor::find_video_stream() {
 
   // STEP 5: Check if the video stream index was found
   if (video_stream_index == -1) {
-    std::cerr << "Failed to find video stream." << std::endl;
+    logging::error() << "Failed to find video stream.";
     return;
   }
 }
 
-void Extractor::init_video_codec() {
+void Extractor::init_video_codec(int threads) {
   // STEP 1: Allocate the codec context
-  codec_context = avcodec_alloc_context3(nullptr);
+  codec_context.reset(avcodec_alloc_context3(nullptr));
 
   if (!codec_context) {
-    std::cerr << "Failed to allocate codec context." << std::endl;
+    logging::error() << "Failed to allocate codec context.";
     return;
   }
 
   // STEP 2: Copy codec parameters to the codec context
   const auto *codecpars = format_context->streams[video_stream_index]->codecpar;
   const auto params_result =
-      avcodec_parameters_to_context(codec_context, codecpars);
+      avcodec_parameters_to_context(codec_context.get(), codecpars);
 
   if (params_result < 0) {
-    avcodec_free_context(&codec_context);
-    std::cerr << "Failed to copy codec parameters to context." << std::endl;
+    codec_context.reset();
+    logging::error() << "Failed to copy codec parameters to context.";
     return;
   }
 
@@ -154,159 +686,105 @@ void Extractor::init_video_codec() {
 
   if (!codec) {
 
-    avcodec_free_context(&codec_context);
-    std::cerr << "Failed to find video decoder." << std::endl;
+    codec_context.reset();
+    logging::error() << "Failed to find video decoder.";
     return;
   }
 
-  // STEP 4: Open the video codec
+  // STEP 4: Open the video codec, with frame and slice threads if asked
+  if (threads > 0) {
+    codec_context->thread_count = threads;
+  }
 
-  const auto init_result = avcodec_open2(codec_context, codec, nullptr);
+  const auto init_result = avcodec_open2(codec_context.get(), codec, nullptr);
 
   if (init_result < 0) {
-    avcodec_free_context(&codec_context);
-    std::cerr << "Failed to open video codec." << std::endl;
+    codec_context.reset();
+    logging::error() << "Failed to open video codec.";
     return;
   }
 }
 
-void Extractor::save_frame_as_image(AVFrame *frame,
-                                         const std::string &frame_path) {
-  // STEP 1: Find the PNG codec
-  AVCodec *png_codec =
-      const_cast<AVCodec *>(avcodec_find_encoder(AV_CODEC_ID_PNG));
-  if (!png_codec) {
-    std::cerr << "Failed to find PNG codec." << std::endl;
-    return;
+bool Extractor::save_frame_as_image(AVFrame *frame,
+                                    const std::string &frame_path) const {
+  // STEP 1: Convert the frame to RGBA, unless the format keeps the
+  // decoder's pixel format
+  ffmpeg::FramePtr rgba_frame;
+  const AVFrame *image = frame;
+  if (intermediate_needs_rgba(intermediate_format)) {
+    rgba_frame = create_rgba_frame(frame);
+    if (!rgba_frame || !convert_frame_to_rgba(frame, rgba_frame.get())) {
+      return false;
+    }
+    image = rgba_frame.get();
   }
 
-  // Allocate and initialize the PNG codec context
-  AVCodecContext *png_codec_context =
-      initialize_png_codec_context(png_codec, frame);
-
-  // STEP 2: Create a temporary frame for the PNG conversion
-  AVFrame *png_frame = create_png_frame(png_codec_context);
-
-  // Convert the input frame to the PNG pixel format
-  convert_frame_to_png(frame, png_frame, png_codec_context);
+  // STEP 2: Encode the image in the intermediate format
+  std::vector<std::uint8_t> data;
+  if (!encode_intermediate(image, intermediate_format, data)) {
+    logging::error() << "Failed to encode frame as "
+                     << intermediate_format_name(intermediate_format) << ".";
+    return false;
+  }
 
-  // STEP 3: Open the output file for writing
+  // STEP 3: Write the encoded image to the output file
   std::ofstream output_file(frame_path, std::ios::binary);
   if (!output_file) {
-    std::cerr << "Failed to open output file." << std::endl;
-    av_frame_free(&png_frame);
-    avcodec_free_context(&png_codec_context);
-    return;
+    logging::error() << "Failed to open output file.";
+    return false;
   }
-
-  // Encode the PNG frame and write the data to the output file
-  encode_png_frame(png_codec_context, png_frame, output_file);
-
-  // Clean up
+  output_file.write(reinterpret_cast<const char *>(data.data()),
+                    static_cast<std::streamsize>(data.size()));
   output_file.close();
-  av_frame_free(&png_frame);
-  avcodec_free_context(&png_codec_context);
+  return !output_file.fail();
 }
 
-AVCodecContext *Extractor::initialize_png_codec_context(AVCodec *png_codec,
-                                                             AVFrame *frame) {
-  // STEP 1: Allocate and initialize the PNG codec context
-  AVCodecContext *png_codec_context = avcodec_alloc_context3(png_codec);
-  if (!png_codec_context) {
-    std::cerr << "Failed to allocate PNG codec context." << std::endl;
+ffmpeg::FramePtr Extractor::create_rgba_frame(const AVFrame *frame) const {
+  // STEP 1: Create a temporary frame for the RGBA conversion
+  ffmpeg::FramePtr rgba_frame = ffmpeg::make_frame();
+  if (!rgba_frame) {
+    logging::error() << "Failed to allocate RGBA frame.";
     return nullptr;
   }
 
-  // STEP 2: Set the PNG codec parameters
-  png_codec_context->width = frame->width;
-  png_codec_context->height = frame->height;
-  png_codec_context->pix_fmt = AV_PIX_FMT_RGBA;
-  png_codec_context->time_base =
-      format_context->streams[video_stream_index]->time_base;
+  // STEP 2: Set the RGBA frame parameters
+  rgba_frame->format = AV_PIX_FMT_RGBA;
+  rgba_frame->width = frame->width;
+  rgba_frame->height = frame->height;
 
-  if (avcodec_open2(png_codec_context, png_codec, nullptr) < 0) {
-    std::cerr << "Failed to open PNG codec." << std::endl;
-    avcodec_free_context(&png_codec_context);
+  // STEP 3: Allocate the RGBA frame buffer
+  if (av_frame_get_buffer(rgba_frame.get(), 0) < 0) {
+    logging::error() << "Failed to allocate RGBA frame buffer.";
     return nullptr;
   }
 
-  return png_codec_context;
+  return rgba_frame;
 }
 
-AVFrame *Extractor::create_png_frame(AVCodecContext *png_codec_context) {
-  // STEP 1: Create a temporary frame for the PNG conversion
-  AVFrame *png_frame = av_frame_alloc();
-  if (!png_frame) {
-    std::cerr << "Failed to allocate PNG frame." << std::endl;
-    avcodec_free_context(&png_codec_context);
-    return nullptr;
+bool Extractor::convert_frame_to_rgba(const AVFrame *frame,
+                                      AVFrame *rgba_frame) const {
+  // STEP 1: Use the SIMD kernels if they cover the conversion and scale
+  // like the selected algorithm
+  if (simd_kernels && kernels_match(scale_algorithm, frame, rgba_frame) &&
+      simd::convert_frame(frame, rgba_frame)) {
+    return true;
   }
 
-  // STEP 2: Set the PNG frame parameters
-  png_frame->format = png_codec_context->pix_fmt;
-  png_frame->width = png_codec_context->width;
-  png_frame->height = png_codec_context->height;
-
-  // STEP 3: Allocate the PNG frame buffer
-  if (av_frame_get_buffer(png_frame, 0) < 0) {
-    std::cerr << "Failed to allocate PNG frame buffer." << std::endl;
-    av_frame_free(&png_frame);
-    avcodec_free_context(&png_codec_context);
-    return nullptr;
-  }
-
-  return png_frame;
-}
-
-void Extractor::convert_frame_to_png(AVFrame *frame, AVFrame *png_frame,
-                                          AVCodecContext *png_codec_context) {
-  // STEP 1: Create the frame conversion context
-  SwsContext *sws_context = sws_getContext(
+  // STEP 2: Create the frame conversion context
+  const ffmpeg::SwsContextPtr sws_context(sws_getContext(
       frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
-      png_codec_context->width, png_codec_context->height,
-      png_codec_context->pix_fmt, 0, nullptr, nullptr, nullptr);
+      rgba_frame->width, rgba_frame->height,
+      static_cast<AVPixelFormat>(rgba_frame->format),
+      to_sws_flags(scale_algorithm), nullptr, nullptr, nullptr));
 
   if (!sws_context) {
-    std::cerr << "Failed to create frame conversion context." << std::endl;
-    av_frame_free(&png_frame);
-    avcodec_free_context(&png_codec_context);
-    return;
-  }
-
-  // STEP 2: Perform the frame conversion
-  sws_scale(sws_context, frame->data, frame->linesize, 0, frame->height,
-            png_frame->data, png_frame->linesize);
-
-  // STEP 3: Free the frame conversion context
-  sws_freeContext(sws_context);
-}
-
-void Extractor::encode_png_frame(AVCodecContext *png_codec_context,
-                                      AVFrame *png_frame,
-                                      std::ofstream &output_file) {
-  // STEP 1: Allocate the PNG packet
-  AVPacket *png_packet = av_packet_alloc();
-  if (!png_packet) {
-    std::cerr << "Failed to allocate PNG packet." << std::endl;
-    av_frame_free(&png_frame);
-    avcodec_free_context(&png_codec_context);
-    return;
-  }
-
-  // STEP 2: Send the PNG frame to the PNG codec
-  const auto frame_result = avcodec_send_frame(png_codec_context, png_frame);
-
-  // STEP 3: Receive the encoded PNG packet from the PNG codec
-  const auto packet_result =
-      avcodec_receive_packet(png_codec_context, png_packet);
-
-  // STEP 4: Write the packet data to the output file
-  if (frame_result >= 0 && packet_result >= 0) {
-    output_file.write(reinterpret_cast<const char *>(png_packet->data),
-                      png_packet->size);
+    logging::error() << "Failed to create frame conversion context.";
+    return false;
   }
+  use_bt709_colors(sws_context.get(), frame);
 
-  // STEP 5: Cleanup
-  av_packet_unref(png_packet);
-  av_packet_free(&png_packet);
+  // STEP 3: Perform the frame conversion
+  sws_scale(sws_context.get(), frame->data, frame->linesize, 0, frame->height,
+            rgba_frame->data, rgba_frame->linesize);
+  return true;
 }
@@ -1,6 +1,17 @@
 #ifndef FRAME_EXTRACTOR
 #define FRAME_EXTRACTOR
 
+#include "../compose/layout.hpp"
+#include "../ffmpeg/handles.hpp"
+#include "../io/input_source.hpp"
+#include "../pipeline/frame_allocator.hpp"
+#include "../pipeline/frame_queue.hpp"
+#include "../pipeline/progress.hpp"
+#include "frame_manifest.hpp"
+#include "scaler.hpp"
+#include "thumbnails.hpp"
+#include <atomic>
+#include <memory>
 #include <string>
 
 extern "C" {
@@ -10,27 +21,68 @@ extern "C" {
 
 namespace frame {
 /**
- * @brief Structure for extracting frames from a video.
+ * @brief Part of a video to keep, in seconds from its start.
+ */
+struct TrimRange {
+  double start = 0.0; /**< The start of the range. */
+  double end = 0.0;   /**< The end of the range, 0 for the end of the video. */
+};
+
+/**
+ * @brief Structure for extracting frames from a video. Extractors are
+ * movable but not copyable.
  */
 class Extractor {
 public:
   /**
    * @brief Constructs a FrameExtractor object.
    * @param video_path The path to the video file.
+   * @param input_options The options for reading the video file.
    */
-  Extractor(const std::string &video_path);
+  Extractor(const std::string &video_path,
+            const io::InputOptions &input_options = io::InputOptions());
+
+  Extractor(const Extractor &) = delete;
+  Extractor &operator=(const Extractor &) = delete;
+  Extractor(Extractor &&) = default;
+  Extractor &operator=(Extractor &&) = default;
 
   /**
-   * @brief Destructor for FrameExtractor.
+   * @brief Extracts frames from the video and saves them as images in the
+   * format set by set_intermediate_format(), named by frame_file_name(),
+   * and records every frame in a manifest in decode order.
+   * @param output_dir The directory to save the extracted frames.
+   * @param manifest The manifest of the directory.
+   * @param source The id the frames are recorded under.
+   * @return `true` if every decoded frame was saved and recorded, `false`
+   * if one failed, which stops the extraction.
    */
-  ~Extractor();
+  bool extract_frames(const std::string &output_dir,
+                      FrameManifestWriter &manifest, std::uint32_t source);
 
   /**
-   * @brief Extracts frames from the video and saves them as images.
-   * @param output_dir The directory to save the extracted frames.
-   * @param width The width of the output frames (aspect ratio is maintained).
+   * @brief Decodes the video and pushes the frames into a queue.
+   * @param queue The queue to push the decoded frames into. It is closed once
+   * the video is exhausted, and pushing stops early if it is closed by the
+   * consumer.
+   */
+  void extract_frames(pipeline::FrameQueue &queue);
+
+  /**
+   * @brief Writes thumbnails of the video without decoding every frame.
+   *
+   * Only keyframes are decoded: the packets of other frames never reach the
+   * decoder. In keyframe mode the packets are read through once; in
+   * interval mode the video is seeked to every interval, so a full-length
+   * movie takes a few hundred seeks and keyframe decodes. The video is
+   * rewound to the start afterwards.
+   * @param output_path The directory the thumbnails are written to, or the
+   * image file of the contact sheet.
+   * @param options How thumbnails are picked and written.
+   * @return The number of thumbnails taken.
    */
-  void extract_frames(const std::string &output_dir, int width);
+  int extract_thumbnails(const std::string &output_path,
+                         const ThumbnailOptions &options);
 
   /**
    * @brief Gets the number of leading zeros in the frame count.
@@ -38,12 +90,154 @@ public:
    */
   int get_leading_zeros();
 
+  /**
+   * @brief Restricts extract_frames() with a queue to part of the video.
+   * @param trim The range of the video to decode.
+   */
+  void set_trim(const TrimRange &trim);
+
+  /**
+   * @brief Sets the algorithm used to convert frames to images.
+   * @param algorithm The scaler algorithm.
+   */
+  void set_scale_algorithm(ScaleAlgorithm algorithm);
+
+  /**
+   * @brief Sets whether the SIMD kernels convert frames to images when they
+   * cover the conversion.
+   * @param enabled `true` to use the kernels, `false` to always use swscale.
+   */
+  void set_simd_kernels(bool enabled);
+
+  /**
+   * @brief Sets the format extract_frames() saves frames in.
+   * @param format The intermediate format.
+   */
+  void set_intermediate_format(IntermediateFormat format);
+
+  /**
+   * @brief Makes the decoder allocate its frames through a frame allocator,
+   * so they land on huge pages of the consumer's NUMA node. Call it before
+   * extracting.
+   * @param allocator The allocator. It must outlive the extractor.
+   */
+  void set_frame_allocator(pipeline::FrameAllocator *allocator);
+
+  /**
+   * @brief Stops extracting early once a flag is set, as if the video had
+   * ended.
+   * @param flag The flag, `nullptr` to never stop early. It must outlive
+   * the extract calls.
+   */
+  void set_cancel_flag(const std::atomic<bool> *flag);
+
+  /**
+   * @brief Counts the frames extract_frames() decodes.
+   * @param counters The counters, `nullptr` for none. They must outlive
+   * the extract calls.
+   */
+  void set_progress_counters(pipeline::ProgressCounters *counters);
+
+  /**
+   * @brief Detects black bars, such as a letterbox, from a few frames spread
+   * over the video.
+   *
+   * Only a decimated subset of the luma rows and columns next to the edges
+   * is read: rows are scanned inwards until one with picture content is
+   * found. The least aggressive crop over the sampled frames wins, so a
+   * single dark frame cannot crop away content. The video is rewound to the
+   * start afterwards.
+   * @param samples The number of frames to sample.
+   * @return The rectangle without the bars, the whole frame if there are
+   * none or the frames cannot be read.
+   */
+  compose::Rect detect_crop(int samples = 6);
+
+  /**
+   * @brief Crops every extracted frame to a rectangle, such as the one
+   * returned by detect_crop(). The crop only changes frame pointers, so no
+   * pixels are copied.
+   * @param rect The rectangle to keep, empty for no crop.
+   */
+  void set_crop(const compose::Rect &rect);
+
+  /**
+   * @brief Gets the video stream.
+   * @return The video stream, or `nullptr` if the video could not be opened.
+   */
+  const AVStream *get_video_stream() const;
+
+  /**
+   * @brief Seeks to the last keyframe at or before a time.
+   * @param seconds The time in seconds from the start of the video.
+   * @return `true` if seeking was successful, `false` otherwise.
+   */
+  bool seek_to_keyframe(double seconds);
+
+  /**
+   * @brief Reads the next compressed packet of the video stream.
+   * @param packet The packet to store the data in. The caller unrefs it.
+   * @return `true` if a packet was read, `false` at the end of the video.
+   */
+  bool read_video_packet(AVPacket *packet);
+
+  /**
+   * @brief Converts a timestamp of the video stream to seconds from the start
+   * of the video.
+   * @param timestamp The timestamp in the time base of the video stream.
+   * @return The time in seconds.
+   */
+  double timestamp_to_seconds(int64_t timestamp) const;
+
 private:
-  AVFormatContext *format_context; /**< The format context for the video. */
-  AVCodecContext *codec_context; /**< The codec context for decoding frames. */
+  std::unique_ptr<io::InputSource>
+      input_source; /**< The I/O layer the video is read through. */
+  ffmpeg::InputContextPtr
+      format_context; /**< The format context for the video. It reads
+                           through the input source, so it is declared
+                           after it and closed before it. */
+  ffmpeg::CodecContextPtr
+      codec_context; /**< The codec context for decoding frames. */
   AVCodec *codec;                /**< The codec used for decoding frames. */
   int video_stream_index;        /**< The index of the video stream. */
   int frame_count;               /**< The number of frames extracted. */
+  TrimRange trim;                /**< The range of the video to decode. */
+  ScaleAlgorithm scale_algorithm; /**< The algorithm frames are scaled with. */
+  bool simd_kernels; /**< Whether the SIMD kernels convert frames. */
+  IntermediateFormat
+      intermediate_format; /**< The format frames are saved in. */
+  compose::Rect crop; /**< The rectangle of every frame to keep. */
+  const std::atomic<bool> *cancel_flag; /**< Stops extracting, if set. */
+  pipeline::ProgressCounters
+      *progress_counters; /**< Counts the decoded frames, if set. */
+
+  /**
+   * @brief Checks if the cancel flag is set.
+   * @return `true` if extracting should stop, `false` otherwise.
+   */
+  bool cancelled() const;
+
+  /**
+   * @brief Decodes the next frame from the current position.
+   * @param frame The frame to decode into.
+   * @return `true` if a frame was decoded, `false` at the end of the video.
+   */
+  bool decode_next_frame(AVFrame *frame);
+
+  /**
+   * @brief Decodes the next keyframe from the current position, dropping
+   * the packets of other frames unread by the decoder.
+   * @param frame The frame to decode into.
+   * @return `true` if a frame was decoded, `false` at the end of the video.
+   */
+  bool decode_next_keyframe(AVFrame *frame);
+
+  /**
+   * @brief Crops a decoded frame to the configured rectangle, if any.
+   * @param frame The frame.
+   */
+  void apply_crop(AVFrame *frame) const;
+
   /**
    * @brief Finds the video stream in the format context.
    */
@@ -51,49 +245,43 @@ private:
 
   /**
    * @brief Initializes the video codec.
+   * @param threads The decoder threads, 0 for FFmpeg's default.
    */
-  void init_video_codec();
+  void init_video_codec(int threads);
 
   /**
-   * @brief Saves a frame as an image.
-   * @param frame The frame to save.
-   * @param frame_path The path to save the frame as an image.
+   * @brief Hands a decoded frame over to a queue.
+   * @param queue The queue to push the frame into.
+   * @param frame The decoded frame. Its reference is moved into the queue.
+   * @return `true` if the frame was queued, `false` if the queue was closed
+   * or the frame could not be allocated.
    */
-  void save_frame_as_image(AVFrame *frame, const std::string &frame_path);
+  bool queue_frame(pipeline::FrameQueue &queue, AVFrame *frame);
 
   /**
-   * @brief Initializes the PNG codec context.
-   * @param png_codec The PNG codec.
-   * @param frame The frame for which to initialize the codec context.
-   * @return The initialized PNG codec context.
+   * @brief Saves a frame as an image. Several frames may be saved at once
+   * from different threads.
+   * @param frame The frame to save.
+   * @param frame_path The path to save the frame as an image.
+   * @return `true` if the image was written, `false` otherwise.
    */
-  AVCodecContext *initialize_png_codec_context(AVCodec *png_codec,
-                                               AVFrame *frame);
+  bool save_frame_as_image(AVFrame *frame,
+                           const std::string &frame_path) const;
 
   /**
-   * @brief Creates a PNG frame for encoding.
-   * @param png_codec_context The PNG codec context.
-   * @return The created PNG frame.
+   * @brief Creates an RGBA frame the size of another frame.
+   * @param frame The frame to match.
+   * @return The created RGBA frame, empty if it failed.
    */
-  AVFrame *create_png_frame(AVCodecContext *png_codec_context);
+  ffmpeg::FramePtr create_rgba_frame(const AVFrame *frame) const;
 
   /**
-   * @brief Converts a frame to PNG format.
+   * @brief Converts a frame to RGBA.
    * @param frame The input frame to convert.
-   * @param png_frame The PNG frame to store the converted frame.
-   * @param png_codec_context The PNG codec context.
-   */
-  void convert_frame_to_png(AVFrame *frame, AVFrame *png_frame,
-                            AVCodecContext *png_codec_context);
-
-  /**
-   * @brief Encodes a PNG frame and writes it to an output file.
-   * @param png_codec_context The PNG codec context.
-   * @param png_frame The PNG frame to encode.
-   * @param output_file The output file stream to write the encoded frame.
+   * @param rgba_frame The RGBA frame to store the converted frame.
+   * @return `true` if the frame was converted, `false` otherwise.
    */
-  void encode_png_frame(AVCodecContext *png_codec_context, AVFrame *png_frame,
-                        std::ofstream &output_file);
+  bool convert_frame_to_rgba(const AVFrame *frame, AVFrame *rgba_frame) const;
 };
 } // namespace frame
 #endif
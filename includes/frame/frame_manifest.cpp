@@ -0,0 +1,94 @@
+#include "frame_manifest.hpp"
+#include "../logging/logger.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace frame;
+
+namespace {
+/** The first bytes of a frame manifest, with its version. */
+const char MANIFEST_MAGIC[8] = {'G', 'F', 'X', 'M', 'A', 'N', '0', '1'};
+} // namespace
+
+std::string frame::frame_file_name(std::uint32_t source, std::int64_t index,
+                                   IntermediateFormat format) {
+  return "frame_" + std::to_string(source) + "_" + std::to_string(index) +
+         intermediate_extension(format);
+}
+
+FrameManifestWriter::FrameManifestWriter(const std::string &path)
+    : file_(std::fopen(path.c_str(), "wb")), failed_(false), mutex_() {
+  if (!file_) {
+    logging::error() << "Failed to create the frame manifest " << path;
+    return;
+  }
+  if (std::fwrite(MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC), 1, file_) != 1) {
+    failed_ = true;
+  }
+}
+
+FrameManifestWriter::~FrameManifestWriter() { close(); }
+
+bool FrameManifestWriter::valid() const { return file_ != nullptr; }
+
+bool FrameManifestWriter::append(const FrameManifestEntry &entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_ || std::fwrite(&entry, sizeof(entry), 1, file_) != 1) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool FrameManifestWriter::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_) {
+    failed_ = std::fclose(file_) != 0 || failed_;
+    file_ = nullptr;
+  }
+  return !failed_;
+}
+
+bool frame::read_frame_manifest(const std::string &path,
+                                std::vector<FrameManifestEntry> &entries) {
+  // STEP 1: Check the magic
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    logging::error() << "Missing frame manifest " << path;
+    return false;
+  }
+  char magic[sizeof(MANIFEST_MAGIC)];
+  if (std::fread(magic, sizeof(magic), 1, file) != 1 ||
+      std::memcmp(magic, MANIFEST_MAGIC, sizeof(magic)) != 0) {
+    std::fclose(file);
+    logging::error() << "Not a frame manifest: " << path;
+    return false;
+  }
+
+  // STEP 2: Read the entries of every source, which each extractor wrote
+  // in decode order
+  std::vector<std::vector<FrameManifestEntry>> sources;
+  FrameManifestEntry entry;
+  while (std::fread(&entry, sizeof(entry), 1, file) == 1) {
+    if (entry.source >= sources.size()) {
+      sources.resize(entry.source + 1);
+    }
+    sources[entry.source].push_back(entry);
+  }
+  std::fclose(file);
+
+  // STEP 3: Interleave the sources by position, in linear time
+  entries.clear();
+  std::size_t longest = 0;
+  for (const std::vector<FrameManifestEntry> &source : sources) {
+    longest = std::max(longest, source.size());
+  }
+  for (std::size_t i = 0; i < longest; ++i) {
+    for (const std::vector<FrameManifestEntry> &source : sources) {
+      if (i < source.size()) {
+        entries.push_back(source[i]);
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,99 @@
+#ifndef FRAME_FRAME_MANIFEST
+#define FRAME_FRAME_MANIFEST
+
+#include "intermediate.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace frame {
+/** The name of the frame manifest in a directory of extracted frames. */
+static const char *const FRAME_MANIFEST_NAME = "frames.manifest";
+
+/**
+ * @brief One extracted frame, as recorded in a frame manifest. Entries are
+ * stored as they are in memory, so a manifest is read on the machine that
+ * wrote it.
+ */
+struct FrameManifestEntry {
+  std::uint32_t source = 0; /**< The input the frame came from. */
+  std::uint32_t format = 0; /**< The IntermediateFormat of the file. */
+  std::int64_t index = 0;   /**< The index of the frame in its source. */
+  std::int64_t pts = 0;     /**< The timestamp of the decoded frame. */
+  std::uint64_t offset = 0; /**< Where the frame starts in its file. */
+  std::uint64_t size = 0;   /**< The bytes of the frame, 0 for the file. */
+};
+
+/**
+ * @brief Gets the name of the file a frame is extracted to, within the
+ * directory of its manifest.
+ * @param source The input the frame came from.
+ * @param index The index of the frame in its source.
+ * @param format The format the frame is extracted to.
+ * @return The name, e.g. "frame_1_42.png".
+ */
+std::string
+frame_file_name(std::uint32_t source, std::int64_t index,
+                IntermediateFormat format = IntermediateFormat::Png);
+
+/**
+ * @brief Appends entries to a frame manifest. Extractors of several
+ * sources may share one writer.
+ */
+class FrameManifestWriter {
+public:
+  /**
+   * @brief Constructs a FrameManifestWriter object and creates the
+   * manifest, replacing any manifest at the path.
+   * @param path The path to the manifest.
+   */
+  explicit FrameManifestWriter(const std::string &path);
+
+  /**
+   * @brief Closes the manifest.
+   */
+  ~FrameManifestWriter();
+
+  FrameManifestWriter(const FrameManifestWriter &) = delete;
+  FrameManifestWriter &operator=(const FrameManifestWriter &) = delete;
+
+  /**
+   * @brief Checks if the manifest was created.
+   * @return `true` if it was, `false` otherwise.
+   */
+  bool valid() const;
+
+  /**
+   * @brief Appends an entry.
+   * @param entry The entry.
+   * @return `true` if it was written, `false` otherwise.
+   */
+  bool append(const FrameManifestEntry &entry);
+
+  /**
+   * @brief Writes the buffered entries and closes the manifest.
+   * @return `true` if every entry was written, `false` otherwise.
+   */
+  bool close();
+
+private:
+  std::FILE *file_; /**< The manifest, `nullptr` once closed. */
+  bool failed_;     /**< Whether a write failed. */
+  std::mutex mutex_; /**< Serializes the appends. */
+};
+
+/**
+ * @brief Reads a frame manifest and orders its frames for the combiner:
+ * the first frame of every source by source id, then the second of every
+ * source, and so on, with the frames of the longer sources at the end.
+ * @param path The path to the manifest.
+ * @param entries Set to the entries, in that order.
+ * @return `true` if the manifest was read, `false` if it is missing or
+ * not a frame manifest.
+ */
+bool read_frame_manifest(const std::string &path,
+                         std::vector<FrameManifestEntry> &entries);
+} // namespace frame
+#endif
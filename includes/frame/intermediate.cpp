@@ -0,0 +1,430 @@
+#include "intermediate.hpp"
+#include "../logging/logger.hpp"
+#include <cstring>
+#include <stdexcept>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+}
+
+using namespace frame;
+
+namespace {
+/** The first bytes of a raw frame, with its version. */
+const char RAW_MAGIC[8] = {'G', 'F', 'X', 'R', 'A', 'W', '0', '1'};
+/** The bytes of a raw frame header: the magic, then the width, height and
+ * pixel format as native 32-bit integers. */
+const std::size_t RAW_HEADER_SIZE = sizeof(RAW_MAGIC) + 3 * sizeof(int32_t);
+/** The bytes of a QOI header. */
+const std::size_t QOI_HEADER_SIZE = 14;
+/** The bytes that end a QOI stream. */
+const std::uint8_t QOI_END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+/** The QOI opcodes, in their top two bits or in a whole byte. */
+const std::uint8_t QOI_OP_INDEX = 0x00;
+const std::uint8_t QOI_OP_DIFF = 0x40;
+const std::uint8_t QOI_OP_LUMA = 0x80;
+const std::uint8_t QOI_OP_RUN = 0xc0;
+const std::uint8_t QOI_OP_RGB = 0xfe;
+const std::uint8_t QOI_OP_RGBA = 0xff;
+/** The longest run one QOI_OP_RUN encodes. */
+const int QOI_MAX_RUN = 62;
+
+/**
+ * @brief An RGBA pixel, compared as one word.
+ */
+union Pixel {
+  std::uint8_t rgba[4];
+  std::uint32_t value;
+};
+
+/**
+ * @brief Gets the slot of a pixel in the QOI index.
+ */
+int qoi_hash(const Pixel &pixel) {
+  return (pixel.rgba[0] * 3 + pixel.rgba[1] * 5 + pixel.rgba[2] * 7 +
+          pixel.rgba[3] * 11) %
+         64;
+}
+
+/**
+ * @brief Writes a 32-bit integer in big-endian order.
+ */
+void put_be32(std::vector<std::uint8_t> &data, std::uint32_t value) {
+  data.push_back(static_cast<std::uint8_t>(value >> 24));
+  data.push_back(static_cast<std::uint8_t>(value >> 16));
+  data.push_back(static_cast<std::uint8_t>(value >> 8));
+  data.push_back(static_cast<std::uint8_t>(value));
+}
+
+/**
+ * @brief Reads a 32-bit integer in big-endian order.
+ */
+std::uint32_t get_be32(const std::uint8_t *data) {
+  return static_cast<std::uint32_t>(data[0]) << 24 |
+         static_cast<std::uint32_t>(data[1]) << 16 |
+         static_cast<std::uint32_t>(data[2]) << 8 | data[3];
+}
+
+/**
+ * @brief Allocates a frame with buffers.
+ */
+ffmpeg::FramePtr allocate_frame(int width, int height, int format) {
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  if (!frame) {
+    return nullptr;
+  }
+  frame->width = width;
+  frame->height = height;
+  frame->format = format;
+  if (av_frame_get_buffer(frame.get(), 0) < 0) {
+    return nullptr;
+  }
+  return frame;
+}
+
+/**
+ * @brief Encodes an RGBA frame as QOI, row by row so the padding of the
+ * lines is skipped.
+ */
+bool encode_qoi(const AVFrame *frame, std::vector<std::uint8_t> &data) {
+  // STEP 1: Write the header: 4 channels, sRGB with linear alpha
+  data.clear();
+  data.reserve(QOI_HEADER_SIZE +
+               static_cast<std::size_t>(frame->width) * frame->height * 2);
+  data.insert(data.end(), {'q', 'o', 'i', 'f'});
+  put_be32(data, static_cast<std::uint32_t>(frame->width));
+  put_be32(data, static_cast<std::uint32_t>(frame->height));
+  data.push_back(4);
+  data.push_back(0);
+
+  // STEP 2: Encode every pixel against the previous one and the index
+  Pixel index[64] = {};
+  Pixel previous = {{0, 0, 0, 255}};
+  int run = 0;
+  for (int y = 0; y < frame->height; ++y) {
+    const std::uint8_t *row = frame->data[0] + y * frame->linesize[0];
+    for (int x = 0; x < frame->width; ++x) {
+      Pixel pixel;
+      std::memcpy(pixel.rgba, row + 4 * x, 4);
+      if (pixel.value == previous.value) {
+        if (++run == QOI_MAX_RUN) {
+          data.push_back(QOI_OP_RUN | (run - 1));
+          run = 0;
+        }
+        continue;
+      }
+      if (run > 0) {
+        data.push_back(QOI_OP_RUN | (run - 1));
+        run = 0;
+      }
+
+      const int slot = qoi_hash(pixel);
+      if (index[slot].value == pixel.value) {
+        data.push_back(QOI_OP_INDEX | slot);
+      } else if (pixel.rgba[3] == previous.rgba[3]) {
+        index[slot] = pixel;
+        const std::int8_t dr = static_cast<std::int8_t>(pixel.rgba[0] -
+                                                        previous.rgba[0]);
+        const std::int8_t dg = static_cast<std::int8_t>(pixel.rgba[1] -
+                                                        previous.rgba[1]);
+        const std::int8_t db = static_cast<std::int8_t>(pixel.rgba[2] -
+                                                        previous.rgba[2]);
+        const int dr_dg = dr - dg;
+        const int db_dg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+            db <= 1) {
+          data.push_back(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 |
+                         (db + 2));
+        } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                   db_dg >= -8 && db_dg <= 7) {
+          data.push_back(QOI_OP_LUMA | (dg + 32));
+          data.push_back(static_cast<std::uint8_t>((dr_dg + 8) << 4 |
+                                                   (db_dg + 8)));
+        } else {
+          data.insert(data.end(),
+                      {QOI_OP_RGB, pixel.rgba[0], pixel.rgba[1],
+                       pixel.rgba[2]});
+        }
+      } else {
+        index[slot] = pixel;
+        data.insert(data.end(), {QOI_OP_RGBA, pixel.rgba[0], pixel.rgba[1],
+                                 pixel.rgba[2], pixel.rgba[3]});
+      }
+      previous = pixel;
+    }
+  }
+  if (run > 0) {
+    data.push_back(QOI_OP_RUN | (run - 1));
+  }
+  data.insert(data.end(), QOI_END, QOI_END + sizeof(QOI_END));
+  return true;
+}
+
+/**
+ * @brief Decodes a QOI image into an RGBA frame.
+ */
+ffmpeg::FramePtr decode_qoi(const std::uint8_t *data, std::size_t size) {
+  // STEP 1: Check the header
+  if (size < QOI_HEADER_SIZE + sizeof(QOI_END) ||
+      std::memcmp(data, "qoif", 4) != 0) {
+    return nullptr;
+  }
+  const std::uint32_t width = get_be32(data + 4);
+  const std::uint32_t height = get_be32(data + 8);
+  if (width == 0 || height == 0 || width > 65536 || height > 65536) {
+    return nullptr;
+  }
+  ffmpeg::FramePtr frame = allocate_frame(static_cast<int>(width),
+                                          static_cast<int>(height),
+                                          AV_PIX_FMT_RGBA);
+  if (!frame) {
+    return nullptr;
+  }
+
+  // STEP 2: Decode the pixels, stopping at the end marker
+  Pixel index[64] = {};
+  Pixel pixel = {{0, 0, 0, 255}};
+  int run = 0;
+  std::size_t pos = QOI_HEADER_SIZE;
+  const std::size_t end = size - sizeof(QOI_END);
+  for (std::uint32_t y = 0; y < height; ++y) {
+    std::uint8_t *row = frame->data[0] + y * frame->linesize[0];
+    for (std::uint32_t x = 0; x < width; ++x) {
+      if (run > 0) {
+        --run;
+      } else if (pos < end) {
+        const std::uint8_t byte = data[pos++];
+        if (byte == QOI_OP_RGB && pos + 3 <= end) {
+          std::memcpy(pixel.rgba, data + pos, 3);
+          pos += 3;
+        } else if (byte == QOI_OP_RGBA && pos + 4 <= end) {
+          std::memcpy(pixel.rgba, data + pos, 4);
+          pos += 4;
+        } else if ((byte & 0xc0) == QOI_OP_INDEX) {
+          pixel = index[byte];
+        } else if ((byte & 0xc0) == QOI_OP_DIFF) {
+          pixel.rgba[0] += ((byte >> 4) & 0x03) - 2;
+          pixel.rgba[1] += ((byte >> 2) & 0x03) - 2;
+          pixel.rgba[2] += (byte & 0x03) - 2;
+        } else if ((byte & 0xc0) == QOI_OP_LUMA && pos < end) {
+          const std::uint8_t next = data[pos++];
+          const int dg = (byte & 0x3f) - 32;
+          pixel.rgba[0] += dg - 8 + ((next >> 4) & 0x0f);
+          pixel.rgba[1] += dg;
+          pixel.rgba[2] += dg - 8 + (next & 0x0f);
+        } else if ((byte & 0xc0) == QOI_OP_RUN) {
+          run = byte & 0x3f;
+        } else {
+          return nullptr;
+        }
+        index[qoi_hash(pixel)] = pixel;
+      } else {
+        return nullptr;
+      }
+      std::memcpy(row + 4 * x, pixel.rgba, 4);
+    }
+  }
+  return frame;
+}
+
+/**
+ * @brief Copies the planes of a frame after a header with its size and
+ * pixel format.
+ */
+bool pack_raw(const AVFrame *frame, std::vector<std::uint8_t> &data) {
+  const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+  const int planes_size =
+      av_image_get_buffer_size(format, frame->width, frame->height, 1);
+  if (planes_size < 0) {
+    return false;
+  }
+  data.resize(RAW_HEADER_SIZE + static_cast<std::size_t>(planes_size));
+  const int32_t header[3] = {frame->width, frame->height, frame->format};
+  std::memcpy(data.data(), RAW_MAGIC, sizeof(RAW_MAGIC));
+  std::memcpy(data.data() + sizeof(RAW_MAGIC), header, sizeof(header));
+  return av_image_copy_to_buffer(data.data() + RAW_HEADER_SIZE, planes_size,
+                                 frame->data, frame->linesize, format,
+                                 frame->width, frame->height, 1) >= 0;
+}
+
+/**
+ * @brief Copies the planes after a raw header into a new frame.
+ */
+ffmpeg::FramePtr unpack_raw(const std::uint8_t *data, std::size_t size) {
+  // STEP 1: Check the header against the size of the planes
+  if (size < RAW_HEADER_SIZE ||
+      std::memcmp(data, RAW_MAGIC, sizeof(RAW_MAGIC)) != 0) {
+    return nullptr;
+  }
+  int32_t header[3];
+  std::memcpy(header, data + sizeof(RAW_MAGIC), sizeof(header));
+  const AVPixelFormat format = static_cast<AVPixelFormat>(header[2]);
+  const int planes_size =
+      av_image_get_buffer_size(format, header[0], header[1], 1);
+  if (planes_size < 0 ||
+      size - RAW_HEADER_SIZE < static_cast<std::size_t>(planes_size)) {
+    return nullptr;
+  }
+
+  // STEP 2: Copy the planes into aligned buffers
+  ffmpeg::FramePtr frame = allocate_frame(header[0], header[1], header[2]);
+  if (!frame) {
+    return nullptr;
+  }
+  std::uint8_t *planes[4] = {};
+  int linesizes[4] = {};
+  if (av_image_fill_arrays(planes, linesizes, data + RAW_HEADER_SIZE, format,
+                           header[0], header[1], 1) < 0) {
+    return nullptr;
+  }
+  av_image_copy(frame->data, frame->linesize,
+                const_cast<const std::uint8_t **>(planes), linesizes, format,
+                header[0], header[1]);
+  return frame;
+}
+
+/**
+ * @brief Encodes an RGBA frame as PNG with FFmpeg's encoder.
+ */
+bool encode_png(const AVFrame *frame, bool fast,
+                std::vector<std::uint8_t> &data) {
+  // STEP 1: Open the PNG encoder for the frame
+  const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_PNG);
+  if (!codec) {
+    logging::error() << "Failed to find PNG codec.";
+    return false;
+  }
+  ffmpeg::CodecContextPtr codec_context(avcodec_alloc_context3(codec));
+  if (!codec_context) {
+    logging::error() << "Failed to allocate PNG codec context.";
+    return false;
+  }
+  codec_context->width = frame->width;
+  codec_context->height = frame->height;
+  codec_context->pix_fmt = AV_PIX_FMT_RGBA;
+  codec_context->time_base = {1, 25};
+  if (fast) {
+    // Deflate only stores the rows, which is most of the cost of PNG
+    codec_context->compression_level = 0;
+  }
+  if (avcodec_open2(codec_context.get(), codec, nullptr) < 0) {
+    logging::error() << "Failed to open PNG codec.";
+    return false;
+  }
+
+  // STEP 2: Encode the frame into one packet
+  const ffmpeg::PacketPtr packet = ffmpeg::make_packet();
+  if (!packet || avcodec_send_frame(codec_context.get(), frame) < 0 ||
+      avcodec_receive_packet(codec_context.get(), packet.get()) < 0) {
+    logging::error() << "Failed to encode PNG frame.";
+    return false;
+  }
+  data.assign(packet->data, packet->data + packet->size);
+  return true;
+}
+
+/**
+ * @brief Decodes a PNG image with FFmpeg's decoder.
+ */
+ffmpeg::FramePtr decode_png(const std::uint8_t *data, std::size_t size) {
+  // STEP 1: Open the PNG decoder
+  const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_PNG);
+  if (!codec) {
+    return nullptr;
+  }
+  ffmpeg::CodecContextPtr codec_context(avcodec_alloc_context3(codec));
+  if (!codec_context ||
+      avcodec_open2(codec_context.get(), codec, nullptr) < 0) {
+    return nullptr;
+  }
+
+  // STEP 2: Decode the image from a padded copy of the bytes
+  ffmpeg::PacketPtr packet = ffmpeg::make_packet();
+  if (!packet || av_new_packet(packet.get(), static_cast<int>(size)) < 0) {
+    return nullptr;
+  }
+  std::memcpy(packet->data, data, size);
+  ffmpeg::FramePtr frame = ffmpeg::make_frame();
+  if (!frame || avcodec_send_packet(codec_context.get(), packet.get()) < 0 ||
+      avcodec_receive_frame(codec_context.get(), frame.get()) < 0) {
+    return nullptr;
+  }
+  return frame;
+}
+} // namespace
+
+IntermediateFormat frame::parse_intermediate_format(const std::string &name) {
+  if (name == "png") {
+    return IntermediateFormat::Png;
+  }
+  if (name == "png-fast") {
+    return IntermediateFormat::PngFast;
+  }
+  if (name == "qoi") {
+    return IntermediateFormat::Qoi;
+  }
+  if (name == "raw") {
+    return IntermediateFormat::Raw;
+  }
+  throw std::invalid_argument("Unknown intermediate format: " + name);
+}
+
+const char *frame::intermediate_format_name(IntermediateFormat format) {
+  switch (format) {
+  case IntermediateFormat::Png:
+    return "png";
+  case IntermediateFormat::PngFast:
+    return "png-fast";
+  case IntermediateFormat::Qoi:
+    return "qoi";
+  case IntermediateFormat::Raw:
+    return "raw";
+  }
+  return "unknown";
+}
+
+const char *frame::intermediate_extension(IntermediateFormat format) {
+  switch (format) {
+  case IntermediateFormat::Qoi:
+    return ".qoi";
+  case IntermediateFormat::Raw:
+    return ".raw";
+  default:
+    return ".png";
+  }
+}
+
+bool frame::intermediate_needs_rgba(IntermediateFormat format) {
+  return format != IntermediateFormat::Raw;
+}
+
+bool frame::encode_intermediate(const AVFrame *frame,
+                                IntermediateFormat format,
+                                std::vector<std::uint8_t> &data) {
+  switch (format) {
+  case IntermediateFormat::Png:
+  case IntermediateFormat::PngFast:
+    return encode_png(frame, format == IntermediateFormat::PngFast, data);
+  case IntermediateFormat::Qoi:
+    return frame->format == AV_PIX_FMT_RGBA && encode_qoi(frame, data);
+  case IntermediateFormat::Raw:
+    return pack_raw(frame, data);
+  }
+  return false;
+}
+
+ffmpeg::FramePtr frame::decode_intermediate(const std::uint8_t *data,
+                                            std::size_t size,
+                                            IntermediateFormat format) {
+  switch (format) {
+  case IntermediateFormat::Png:
+  case IntermediateFormat::PngFast:
+    return decode_png(data, size);
+  case IntermediateFormat::Qoi:
+    return decode_qoi(data, size);
+  case IntermediateFormat::Raw:
+    return unpack_raw(data, size);
+  }
+  return nullptr;
+}
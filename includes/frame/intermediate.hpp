@@ -0,0 +1,78 @@
+#ifndef FRAME_INTERMEDIATE
+#define FRAME_INTERMEDIATE
+
+#include "../ffmpeg/handles.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace frame {
+/**
+ * @brief The lossless formats frames are extracted to between the
+ * extractors and the combiner.
+ */
+enum class IntermediateFormat {
+  Png,     /**< RGBA PNG at FFmpeg's default compression. */
+  PngFast, /**< RGBA PNG at compression level 0, so zlib only stores. */
+  Qoi,     /**< RGBA QOI, a byte-wise format without entropy coding. */
+  Raw,     /**< The decoded planes as they are, with a small header. */
+};
+
+/**
+ * @brief Parses the name of an intermediate format.
+ * @param name "png", "png-fast", "qoi" or "raw".
+ * @return The format.
+ * @throws std::invalid_argument If the name is not a known format.
+ */
+IntermediateFormat parse_intermediate_format(const std::string &name);
+
+/**
+ * @brief Gets the name of an intermediate format.
+ * @param format The format.
+ * @return The name parse_intermediate_format() accepts.
+ */
+const char *intermediate_format_name(IntermediateFormat format);
+
+/**
+ * @brief Gets the file extension of an intermediate format.
+ * @param format The format.
+ * @return The extension, with its dot.
+ */
+const char *intermediate_extension(IntermediateFormat format);
+
+/**
+ * @brief Checks if frames are converted to RGBA before they are encoded in
+ * a format.
+ * @param format The format.
+ * @return `true` for the PNG and QOI formats, `false` for raw frames,
+ * which keep the decoder's pixel format.
+ */
+bool intermediate_needs_rgba(IntermediateFormat format);
+
+/**
+ * @brief Encodes a frame in an intermediate format.
+ * @param frame The frame, in RGBA if intermediate_needs_rgba().
+ * @param format The format.
+ * @param data Set to the encoded bytes.
+ * @return `true` if the frame was encoded, `false` otherwise.
+ */
+bool encode_intermediate(const AVFrame *frame, IntermediateFormat format,
+                         std::vector<std::uint8_t> &data);
+
+/**
+ * @brief Decodes a frame encoded by encode_intermediate().
+ * @param data The encoded bytes.
+ * @param size The number of bytes.
+ * @param format The format they are in.
+ * @return The frame, empty if the bytes are not a frame of the format.
+ */
+ffmpeg::FramePtr decode_intermediate(const std::uint8_t *data,
+                                     std::size_t size,
+                                     IntermediateFormat format);
+} // namespace frame
+#endif
@@ -0,0 +1,77 @@
+#include "scaler.hpp"
+#include <stdexcept>
+
+using namespace frame;
+
+ScaleAlgorithm ScalerTiers::select(bool is_preview) const {
+  return is_preview ? preview : final;
+}
+
+const std::vector<ScaleAlgorithm> &frame::all_scale_algorithms() {
+  static const std::vector<ScaleAlgorithm> algorithms = {
+      ScaleAlgorithm::FastBilinear, ScaleAlgorithm::Bilinear,
+      ScaleAlgorithm::Area,         ScaleAlgorithm::Bicubic,
+      ScaleAlgorithm::Lanczos,
+  };
+  return algorithms;
+}
+
+ScaleAlgorithm frame::parse_scale_algorithm(const std::string &name) {
+  for (ScaleAlgorithm algorithm : all_scale_algorithms()) {
+    if (scale_algorithm_name(algorithm) == name) {
+      return algorithm;
+    }
+  }
+  throw std::invalid_argument("Unknown scaler algorithm: " + name);
+}
+
+std::string frame::scale_algorithm_name(ScaleAlgorithm algorithm) {
+  switch (algorithm) {
+  case ScaleAlgorithm::FastBilinear:
+    return "fast-bilinear";
+  case ScaleAlgorithm::Bilinear:
+    return "bilinear";
+  case ScaleAlgorithm::Area:
+    return "area";
+  case ScaleAlgorithm::Bicubic:
+    return "bicubic";
+  case ScaleAlgorithm::Lanczos:
+    return "lanczos";
+  }
+  return "bicubic";
+}
+
+int frame::to_sws_flags(ScaleAlgorithm algorithm) {
+  switch (algorithm) {
+  case ScaleAlgorithm::FastBilinear:
+    return SWS_FAST_BILINEAR;
+  case ScaleAlgorithm::Bilinear:
+    return SWS_BILINEAR;
+  case ScaleAlgorithm::Area:
+    return SWS_AREA;
+  case ScaleAlgorithm::Bicubic:
+    return SWS_BICUBIC;
+  case ScaleAlgorithm::Lanczos:
+    return SWS_LANCZOS;
+  }
+  return SWS_BICUBIC;
+}
+
+bool frame::kernels_match(ScaleAlgorithm algorithm, const AVFrame *src_frame,
+                          const AVFrame *dst_frame) {
+  return algorithm == ScaleAlgorithm::FastBilinear ||
+         algorithm == ScaleAlgorithm::Bilinear ||
+         (src_frame->width == dst_frame->width &&
+          src_frame->height == dst_frame->height);
+}
+
+void frame::use_bt709_colors(SwsContext *context, const AVFrame *src_frame) {
+  // The swscale color spaces share their values with AVColorSpace
+  const int src_colorspace = src_frame->colorspace == AVCOL_SPC_UNSPECIFIED
+                                 ? SWS_CS_ITU709
+                                 : src_frame->colorspace;
+  const int src_range = src_frame->color_range == AVCOL_RANGE_JPEG ? 1 : 0;
+  sws_setColorspaceDetails(context, sws_getCoefficients(src_colorspace),
+                           src_range, sws_getCoefficients(SWS_CS_ITU709), 0,
+                           0, 1 << 16, 1 << 16);
+}
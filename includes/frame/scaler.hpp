@@ -0,0 +1,88 @@
+#ifndef FRAME_SCALER
+#define FRAME_SCALER
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace frame {
+/**
+ * @brief The swscale algorithms frames can be scaled with, fastest first.
+ */
+enum class ScaleAlgorithm {
+  FastBilinear, /**< SWS_FAST_BILINEAR */
+  Bilinear,     /**< SWS_BILINEAR */
+  Area,         /**< SWS_AREA */
+  Bicubic,      /**< SWS_BICUBIC */
+  Lanczos,      /**< SWS_LANCZOS */
+};
+
+/**
+ * @brief The scaler algorithms used for preview and for final renders.
+ */
+struct ScalerTiers {
+  ScaleAlgorithm preview = ScaleAlgorithm::FastBilinear; /**< For previews. */
+  ScaleAlgorithm final = ScaleAlgorithm::Bicubic; /**< For final renders. */
+
+  /**
+   * @brief Selects the algorithm of a tier.
+   * @param is_preview Whether the render is a preview.
+   * @return The algorithm of the tier.
+   */
+  ScaleAlgorithm select(bool is_preview) const;
+};
+
+/**
+ * @brief Gets every scaler algorithm, fastest first.
+ * @return The scaler algorithms.
+ */
+const std::vector<ScaleAlgorithm> &all_scale_algorithms();
+
+/**
+ * @brief Parses a scaler algorithm name such as "bicubic".
+ * @param name The name to parse.
+ * @return The scaler algorithm.
+ * @throws std::invalid_argument If the name is not a known algorithm.
+ */
+ScaleAlgorithm parse_scale_algorithm(const std::string &name);
+
+/**
+ * @brief Gets the name of a scaler algorithm.
+ * @param algorithm The scaler algorithm.
+ * @return The name, as accepted by parse_scale_algorithm().
+ */
+std::string scale_algorithm_name(ScaleAlgorithm algorithm);
+
+/**
+ * @brief Gets the swscale flags of a scaler algorithm.
+ * @param algorithm The scaler algorithm.
+ * @return The flags to pass to sws_getContext().
+ */
+int to_sws_flags(ScaleAlgorithm algorithm);
+
+/**
+ * @brief Checks if the SIMD kernels scale between two frames like an
+ * algorithm. The kernels resize bilinearly, so they only stand in for the
+ * other algorithms when the size stays the same.
+ * @param algorithm The scaler algorithm selected.
+ * @param src_frame The source frame.
+ * @param dst_frame The destination frame.
+ * @return `true` if the kernels may convert the frame, `false` otherwise.
+ */
+bool kernels_match(ScaleAlgorithm algorithm, const AVFrame *src_frame,
+                   const AVFrame *dst_frame);
+
+/**
+ * @brief Sets a scaler context up to convert colors like the SIMD kernels,
+ * to BT.709 limited range instead of the BT.601 default of swscale. Sources
+ * keep their own color space and range when they specify them.
+ * @param context The scaler context.
+ * @param src_frame The source frame.
+ */
+void use_bt709_colors(SwsContext *context, const AVFrame *src_frame);
+} // namespace frame
+#endif
@@ -0,0 +1,108 @@
+#include "scene_detector.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace frame;
+
+/** The width of the luma thumbnail, in blocks. */
+static const int GRID_WIDTH = 64;
+/** The height of the luma thumbnail, in blocks. */
+static const int GRID_HEIGHT = 36;
+/** The distance between the pixels averaged into a block. */
+static const int BLOCK_SAMPLE_STEP = 4;
+/** The smallest mean block difference, out of 255, that can be a cut. */
+static const double CUT_MIN_DIFFERENCE = 12.0;
+/** How many times the recent average difference a cut has to exceed. */
+static const double CUT_RATIO = 3.0;
+/** The weight of a new difference in the running average. */
+static const double AVERAGE_WEIGHT = 0.125;
+
+namespace {
+bool has_8bit_luma(const AVFrame *frame) {
+  switch (frame->format) {
+  case AV_PIX_FMT_YUV420P:
+  case AV_PIX_FMT_YUVJ420P:
+  case AV_PIX_FMT_YUVA420P:
+  case AV_PIX_FMT_YUV422P:
+  case AV_PIX_FMT_YUV444P:
+  case AV_PIX_FMT_NV12:
+    return true;
+  default:
+    return false;
+  }
+}
+} // namespace
+
+SceneDetector::SceneDetector(int min_cut_distance)
+    : thumbnail_(), previous_(), average_difference_(0.0),
+      min_cut_distance_(min_cut_distance), frames_since_cut_(0) {}
+
+bool SceneDetector::is_scene_cut(const AVFrame *frame) {
+  if (!has_8bit_luma(frame) || frame->width < GRID_WIDTH ||
+      frame->height < GRID_HEIGHT) {
+    return false;
+  }
+
+  // STEP 1: Reduce the frame to its thumbnail, keeping the previous one
+  thumbnail_.swap(previous_);
+  downscale_luma(frame);
+  ++frames_since_cut_;
+  if (previous_.size() != thumbnail_.size()) {
+    frames_since_cut_ = 0;
+    return false;
+  }
+
+  // STEP 2: Take the mean difference of the blocks
+  int sum = 0;
+  for (std::size_t i = 0; i < thumbnail_.size(); ++i) {
+    sum += std::abs(thumbnail_[i] - previous_[i]);
+  }
+  const double difference = static_cast<double>(sum) / thumbnail_.size();
+
+  // STEP 3: A cut stands out from the recent differences
+  const bool cut = frames_since_cut_ >= min_cut_distance_ &&
+                   difference >= CUT_MIN_DIFFERENCE &&
+                   difference >= CUT_RATIO * average_difference_;
+  average_difference_ +=
+      AVERAGE_WEIGHT * (difference - average_difference_);
+  if (cut) {
+    frames_since_cut_ = 0;
+  }
+  return cut;
+}
+
+void SceneDetector::mark_keyframe() { frames_since_cut_ = 0; }
+
+void SceneDetector::reset() {
+  thumbnail_.clear();
+  previous_.clear();
+  average_difference_ = 0.0;
+  frames_since_cut_ = 0;
+}
+
+void SceneDetector::downscale_luma(const AVFrame *frame) {
+  thumbnail_.resize(GRID_WIDTH * GRID_HEIGHT);
+  const int block_width = frame->width / GRID_WIDTH;
+  const int block_height = frame->height / GRID_HEIGHT;
+  const int step_x = std::min(BLOCK_SAMPLE_STEP, block_width);
+  const int step_y = std::min(BLOCK_SAMPLE_STEP, block_height);
+
+  for (int gy = 0; gy < GRID_HEIGHT; ++gy) {
+    for (int gx = 0; gx < GRID_WIDTH; ++gx) {
+      // Average a sparse subset of the block's pixels
+      int sum = 0;
+      int count = 0;
+      for (int y = gy * block_height; y < (gy + 1) * block_height;
+           y += step_y) {
+        const std::uint8_t *row = frame->data[0] + y * frame->linesize[0];
+        for (int x = gx * block_width; x < (gx + 1) * block_width;
+             x += step_x) {
+          sum += row[x];
+          ++count;
+        }
+      }
+      thumbnail_[gy * GRID_WIDTH + gx] =
+          static_cast<std::uint8_t>(sum / count);
+    }
+  }
+}
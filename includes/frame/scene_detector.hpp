@@ -0,0 +1,63 @@
+#ifndef FRAME_SCENE_DETECTOR
+#define FRAME_SCENE_DETECTOR
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace frame {
+/**
+ * @brief Detects scene cuts from a small thumbnail of the luma plane.
+ *
+ * Every frame is reduced to a fixed grid of block averages, and a cut is a
+ * frame whose grid differs from the previous one by much more than the
+ * recent frames differed from each other. Comparing against the recent
+ * average keeps fast motion and camera pans from being taken for cuts.
+ */
+class SceneDetector {
+public:
+  /**
+   * @brief Constructs a SceneDetector object.
+   * @param min_cut_distance The fewest frames between two cuts, so flashes
+   * and strobes do not cut on every frame.
+   */
+  explicit SceneDetector(int min_cut_distance = 12);
+
+  /**
+   * @brief Checks if a frame starts a new scene.
+   * @param frame The frame, with an 8-bit luma plane first, such as
+   * YUV420P. Other frames are never cuts.
+   * @return `true` if the frame starts a new scene, `false` otherwise. The
+   * first frame is not a cut, since the encoder starts with a keyframe.
+   */
+  bool is_scene_cut(const AVFrame *frame);
+
+  /**
+   * @brief Records that the encoder was given a keyframe for another
+   * reason, such as a transition, so no cut is reported right after it.
+   */
+  void mark_keyframe();
+
+  /**
+   * @brief Forgets the previous frames.
+   */
+  void reset();
+
+private:
+  std::vector<std::uint8_t> thumbnail_; /**< The grid of the last frame. */
+  std::vector<std::uint8_t> previous_;  /**< The grid of the frame before. */
+  double average_difference_; /**< The running average of the differences. */
+  int min_cut_distance_;      /**< The fewest frames between two cuts. */
+  int frames_since_cut_;      /**< The frames since the last keyframe. */
+
+  /**
+   * @brief Reduces the luma plane of a frame to the thumbnail grid.
+   * @param frame The frame.
+   */
+  void downscale_luma(const AVFrame *frame);
+};
+} // namespace frame
+#endif
@@ -0,0 +1,226 @@
+#include "thumbnails.hpp"
+#include "../logging/logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+}
+
+using namespace frame;
+
+/** The JPEG quantizer scale, 2 (best) to 31 (smallest). */
+static const int JPEG_QSCALE = 3;
+
+namespace {
+AVPixelFormat pixel_format_of(ImageFormat format) {
+  return format == ImageFormat::Jpeg ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_RGB24;
+}
+
+/**
+ * @brief Gets the planes of an image in the pixel format of an image
+ * format.
+ */
+int plane_count(int pixel_format) {
+  return pixel_format == AV_PIX_FMT_YUVJ420P ? 3 : 1;
+}
+
+/**
+ * @brief Gets the bytes per row and the rows of one plane of an image.
+ */
+void plane_size(int pixel_format, int plane, int width, int height,
+                int &bytes, int &rows) {
+  if (pixel_format == AV_PIX_FMT_YUVJ420P) {
+    bytes = plane == 0 ? width : width / 2;
+    rows = plane == 0 ? height : height / 2;
+  } else {
+    bytes = width * 3;
+    rows = height;
+  }
+}
+
+/**
+ * @brief Allocates an image of a size and pixel format.
+ */
+ffmpeg::FramePtr allocate_image(int pixel_format, int width, int height) {
+  ffmpeg::FramePtr image = ffmpeg::make_frame();
+  if (!image) {
+    return nullptr;
+  }
+  image->format = pixel_format;
+  image->width = width;
+  image->height = height;
+  if (av_frame_get_buffer(image.get(), 32) < 0) {
+    return nullptr;
+  }
+  return image;
+}
+} // namespace
+
+ThumbnailMode frame::parse_thumbnail_mode(const std::string &name) {
+  if (name == "keyframes") {
+    return ThumbnailMode::Keyframes;
+  }
+  if (name == "interval") {
+    return ThumbnailMode::Interval;
+  }
+  throw std::invalid_argument("Unknown thumbnail mode: " + name);
+}
+
+ImageFormat frame::parse_image_format(const std::string &name) {
+  if (name == "jpeg" || name == "jpg") {
+    return ImageFormat::Jpeg;
+  }
+  if (name == "png") {
+    return ImageFormat::Png;
+  }
+  throw std::invalid_argument("Unknown image format: " + name);
+}
+
+const char *frame::image_extension(ImageFormat format) {
+  return format == ImageFormat::Jpeg ? ".jpg" : ".png";
+}
+
+ffmpeg::FramePtr frame::scale_thumbnail(const AVFrame *frame, int width,
+                                        ImageFormat format,
+                                        ScaleAlgorithm algorithm,
+                                        ffmpeg::SwsContextPtr &sws_context) {
+  // STEP 1: Keep the aspect ratio with even sizes, which 4:2:0 JPEG needs
+  width = std::max(2, width & ~1);
+  const int height = std::max(
+      2, static_cast<int>(static_cast<int64_t>(width) * frame->height /
+                          frame->width) &
+             ~1);
+
+  // STEP 2: Allocate the thumbnail
+  const AVPixelFormat pixel_format = pixel_format_of(format);
+  ffmpeg::FramePtr thumbnail = allocate_image(pixel_format, width, height);
+  if (!thumbnail) {
+    logging::error() << "Failed to allocate the thumbnail.";
+    return nullptr;
+  }
+
+  // STEP 3: Scale the frame down
+  SwsContext *context = ffmpeg::update_sws_context(
+      sws_context, frame->width, frame->height,
+      static_cast<AVPixelFormat>(frame->format), width, height, pixel_format,
+      to_sws_flags(algorithm));
+  if (!context) {
+    logging::error() << "Failed to initialize the image converter.";
+    return nullptr;
+  }
+  sws_scale(context, frame->data, frame->linesize, 0, frame->height,
+            thumbnail->data, thumbnail->linesize);
+  thumbnail->pts = frame->pts;
+  return thumbnail;
+}
+
+ffmpeg::FramePtr
+frame::tile_contact_sheet(const std::vector<ffmpeg::FramePtr> &thumbnails,
+                          int columns) {
+  if (thumbnails.empty() || columns <= 0) {
+    return nullptr;
+  }
+
+  // STEP 1: Allocate a sheet with room for every thumbnail
+  const AVFrame *first = thumbnails.front().get();
+  const int tile_width = first->width;
+  const int tile_height = first->height;
+  columns = std::min(columns, static_cast<int>(thumbnails.size()));
+  const int rows =
+      (static_cast<int>(thumbnails.size()) + columns - 1) / columns;
+  ffmpeg::FramePtr sheet =
+      allocate_image(first->format, columns * tile_width, rows * tile_height);
+  if (!sheet) {
+    logging::error() << "Failed to allocate the contact sheet.";
+    return nullptr;
+  }
+
+  // STEP 2: Start from black
+  for (int plane = 0; plane < plane_count(sheet->format); ++plane) {
+    int bytes = 0;
+    int plane_rows = 0;
+    plane_size(sheet->format, plane, sheet->width, sheet->height, bytes,
+               plane_rows);
+    const int black = plane == 0 ? 0 : 128;
+    for (int y = 0; y < plane_rows; ++y) {
+      std::memset(sheet->data[plane] + y * sheet->linesize[plane], black,
+                  bytes);
+    }
+  }
+
+  // STEP 3: Copy every thumbnail into its tile
+  for (std::size_t i = 0; i < thumbnails.size(); ++i) {
+    const AVFrame *thumbnail = thumbnails[i].get();
+    const int column = static_cast<int>(i) % columns;
+    const int row = static_cast<int>(i) / columns;
+    for (int plane = 0; plane < plane_count(sheet->format); ++plane) {
+      int bytes = 0;
+      int plane_rows = 0;
+      plane_size(sheet->format, plane, tile_width, tile_height, bytes,
+                 plane_rows);
+      std::uint8_t *tile = sheet->data[plane] +
+                           row * plane_rows * sheet->linesize[plane] +
+                           column * bytes;
+      av_image_copy_plane(tile, sheet->linesize[plane],
+                          thumbnail->data[plane], thumbnail->linesize[plane],
+                          bytes, plane_rows);
+    }
+  }
+
+  return sheet;
+}
+
+bool frame::write_image(const AVFrame *image, ImageFormat format,
+                        const std::string &path) {
+  // STEP 1: Open the image encoder
+  const AVCodec *codec = avcodec_find_encoder(
+      format == ImageFormat::Jpeg ? AV_CODEC_ID_MJPEG : AV_CODEC_ID_PNG);
+  if (!codec) {
+    logging::error() << "Failed to find the image encoder.";
+    return false;
+  }
+  const ffmpeg::CodecContextPtr codec_context(avcodec_alloc_context3(codec));
+  if (!codec_context) {
+    logging::error() << "Failed to allocate the image codec context.";
+    return false;
+  }
+  codec_context->width = image->width;
+  codec_context->height = image->height;
+  codec_context->pix_fmt = static_cast<AVPixelFormat>(image->format);
+  codec_context->time_base = {1, 1};
+  if (format == ImageFormat::Jpeg) {
+    codec_context->flags |= AV_CODEC_FLAG_QSCALE;
+    codec_context->global_quality = FF_QP2LAMBDA * JPEG_QSCALE;
+  }
+  if (avcodec_open2(codec_context.get(), codec, nullptr) < 0) {
+    logging::error() << "Failed to open the image encoder.";
+    return false;
+  }
+
+  // STEP 2: Encode the image. The JPEG encoder takes its quantizer from the
+  // frame.
+  const ffmpeg::FramePtr frame(av_frame_clone(image));
+  const ffmpeg::PacketPtr packet = ffmpeg::make_packet();
+  bool written = false;
+  if (frame && packet) {
+    frame->quality = codec_context->global_quality;
+    frame->pts = 0;
+    if (avcodec_send_frame(codec_context.get(), frame.get()) >= 0 &&
+        avcodec_send_frame(codec_context.get(), nullptr) >= 0 &&
+        avcodec_receive_packet(codec_context.get(), packet.get()) >= 0) {
+      // STEP 3: Write the encoded image
+      std::ofstream output_file(path, std::ios::binary);
+      output_file.write(reinterpret_cast<const char *>(packet->data),
+                        packet->size);
+      written = static_cast<bool>(output_file);
+    }
+  }
+  if (!written) {
+    logging::error() << "Failed to write the image " << path;
+  }
+  return written;
+}
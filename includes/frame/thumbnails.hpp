@@ -0,0 +1,107 @@
+#ifndef FRAME_THUMBNAILS
+#define FRAME_THUMBNAILS
+
+#include "../ffmpeg/handles.hpp"
+#include "scaler.hpp"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace frame {
+/**
+ * @brief How the frames of a video are picked for thumbnails.
+ */
+enum class ThumbnailMode {
+  Keyframes, /**< The keyframes, which encoders place at scene cuts. */
+  Interval,  /**< The keyframe at or before every interval. */
+};
+
+/**
+ * @brief The file formats thumbnails are written in.
+ */
+enum class ImageFormat {
+  Jpeg, /**< Baseline JPEG. */
+  Png,  /**< RGB PNG. */
+};
+
+/**
+ * @brief How thumbnails are picked and written.
+ */
+struct ThumbnailOptions {
+  ThumbnailMode mode = ThumbnailMode::Keyframes; /**< How frames are picked. */
+  double interval_seconds = 10.0; /**< The distance between thumbnails. In
+                                       keyframe mode, the shortest one. */
+  int width = 320; /**< The width of a thumbnail. The height keeps the
+                        aspect ratio. */
+  ImageFormat format = ImageFormat::Jpeg; /**< The file format. */
+  int columns = 0; /**< The columns of the contact sheet, 0 to write every
+                        thumbnail to its own file. */
+  int max_thumbnails = 0; /**< The most thumbnails to take, 0 for no limit. */
+};
+
+/**
+ * @brief Parses the name of a thumbnail mode.
+ * @param name "keyframes" or "interval".
+ * @return The thumbnail mode.
+ * @throws std::invalid_argument If the name is not a known mode.
+ */
+ThumbnailMode parse_thumbnail_mode(const std::string &name);
+
+/**
+ * @brief Parses the name of an image format.
+ * @param name "jpeg", "jpg" or "png".
+ * @return The image format.
+ * @throws std::invalid_argument If the name is not a known format.
+ */
+ImageFormat parse_image_format(const std::string &name);
+
+/**
+ * @brief Gets the file extension of an image format.
+ * @param format The image format.
+ * @return The extension, with its dot.
+ */
+const char *image_extension(ImageFormat format);
+
+/**
+ * @brief Scales a frame down to a thumbnail in the pixel format of an image
+ * format.
+ * @param frame The decoded frame.
+ * @param width The width of the thumbnail. The height keeps the aspect
+ * ratio, and both are rounded to even.
+ * @param format The image format the thumbnail is written in.
+ * @param algorithm The scaler algorithm.
+ * @param sws_context The cached scaler context, created or updated as
+ * needed.
+ * @return The thumbnail, empty if scaling failed.
+ */
+ffmpeg::FramePtr scale_thumbnail(const AVFrame *frame, int width,
+                                 ImageFormat format, ScaleAlgorithm algorithm,
+                                 ffmpeg::SwsContextPtr &sws_context);
+
+/**
+ * @brief Tiles thumbnails of the same size and format into a contact sheet,
+ * row by row. Unused tiles of the last row are black.
+ * @param thumbnails The thumbnails.
+ * @param columns The number of columns.
+ * @return The contact sheet, empty if there are no thumbnails or
+ * allocation failed.
+ */
+ffmpeg::FramePtr
+tile_contact_sheet(const std::vector<ffmpeg::FramePtr> &thumbnails,
+                   int columns);
+
+/**
+ * @brief Encodes a frame as an image file.
+ * @param image The frame, in the pixel format of scale_thumbnail().
+ * @param format The image format.
+ * @param path The path of the image file.
+ * @return `true` if the file was written, `false` otherwise.
+ */
+bool write_image(const AVFrame *image, ImageFormat format,
+                 const std::string &path);
+} // namespace frame
+#endif
@@ -0,0 +1,115 @@
+#include "engine.hpp"
+#include "../pipeline/task_scheduler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+using namespace gameflix;
+
+/**
+ * @brief A submitted job and how to deliver its status.
+ */
+struct JobHandle::State {
+  JobDescription job;             /**< The job. */
+  ProgressCallback progress;      /**< Reports progress, if set. */
+  std::atomic<bool> cancelled;    /**< Set to stop the job. */
+  std::promise<JobStatus> status; /**< Delivers the status. */
+  std::shared_future<JobStatus> future; /**< Receives the status. */
+  std::size_t id;                       /**< The id of the job. */
+
+  State(const JobDescription &job, ProgressCallback progress, std::size_t id)
+      : job(job), progress(std::move(progress)), cancelled(false), status(),
+        future(status.get_future().share()), id(id) {}
+};
+
+JobHandle::JobHandle() : state_() {}
+
+JobHandle::JobHandle(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+bool JobHandle::valid() const { return state_ != nullptr; }
+
+std::shared_future<JobStatus> JobHandle::future() const {
+  return state_ ? state_->future : std::shared_future<JobStatus>();
+}
+
+JobStatus JobHandle::wait() const { return state_->future.get(); }
+
+void JobHandle::cancel() {
+  if (state_) {
+    state_->cancelled = true;
+  }
+}
+
+std::size_t JobHandle::id() const { return state_ ? state_->id : 0; }
+
+Engine::Engine(std::size_t max_jobs)
+    : planner_(), pending_(), next_id_(1), stopping_(false), mutex_(),
+      wake_(), runners_() {
+  // STEP 1: Start the workers before a job pins its thread, so they do not
+  // inherit its CPUs
+  pipeline::TaskScheduler::global();
+  planner_ = std::make_unique<pipeline::PlacementPlanner>(
+      pipeline::PlacementPolicy::None, pipeline::NumaTopology::detect());
+
+  // STEP 2: Start the runners
+  for (std::size_t i = 0; i < std::max<std::size_t>(1, max_jobs); ++i) {
+    runners_.emplace_back([this] { run(); });
+  }
+}
+
+Engine::~Engine() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &runner : runners_) {
+    runner.join();
+  }
+}
+
+JobHandle Engine::submit(const JobDescription &job,
+                         ProgressCallback progress) {
+  std::shared_ptr<JobHandle::State> state;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    state = std::make_shared<JobHandle::State>(job, std::move(progress),
+                                               next_id_++);
+    pending_.push_back(state);
+  }
+  wake_.notify_one();
+  return JobHandle(state);
+}
+
+void Engine::run() {
+  while (true) {
+    // STEP 1: Take the oldest pending job
+    std::shared_ptr<JobHandle::State> state;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+      if (pending_.empty()) {
+        return;
+      }
+      state = std::move(pending_.front());
+      pending_.pop_front();
+    }
+
+    // STEP 2: A job cancelled while it was queued never starts
+    if (state->cancelled) {
+      state->status.set_value(JobStatus::Cancelled);
+      continue;
+    }
+
+    // STEP 3: Run it on a fresh thread, so its pinning ends with it, as its
+    // own job on the shared scheduler
+    JobStatus status = JobStatus::Failed;
+    std::thread job_thread([&] {
+      pipeline::TaskScheduler::set_current_job(state->id);
+      status = run_job(state->job, *planner_, &state->cancelled,
+                       state->progress);
+    });
+    job_thread.join();
+    state->status.set_value(status);
+  }
+}
@@ -0,0 +1,121 @@
+#ifndef GAMEFLIX_ENGINE
+#define GAMEFLIX_ENGINE
+
+#include "job.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gameflix {
+class Engine;
+
+/**
+ * @brief A job submitted to an Engine. Copies refer to the same job.
+ */
+class JobHandle {
+public:
+  /**
+   * @brief Constructs a JobHandle object that refers to no job.
+   */
+  JobHandle();
+
+  /**
+   * @brief Checks if the handle refers to a job.
+   * @return `true` if it does, `false` otherwise.
+   */
+  bool valid() const;
+
+  /**
+   * @brief Gets the future the status of the job is delivered through.
+   * @return The future.
+   */
+  std::shared_future<JobStatus> future() const;
+
+  /**
+   * @brief Waits for the job to end.
+   * @return How the job ended.
+   */
+  JobStatus wait() const;
+
+  /**
+   * @brief Asks the job to stop. A queued job never starts, and a running
+   * one finishes its output with the frames written so far.
+   */
+  void cancel();
+
+  /**
+   * @brief Gets the id of the job, which is also the job its tasks run as
+   * on the task scheduler.
+   * @return The id, 0 for no job.
+   */
+  std::size_t id() const;
+
+private:
+  friend class Engine;
+
+  struct State;
+
+  std::shared_ptr<State> state_; /**< The job, shared with the engine. */
+
+  /**
+   * @brief Constructs a JobHandle object for a submitted job.
+   * @param state The job.
+   */
+  explicit JobHandle(std::shared_ptr<State> state);
+};
+
+/**
+ * @brief Runs submitted jobs in the background, up to a number at a time.
+ * Every job runs on a fresh thread, so its pinning ends with it, and its
+ * stages share the global task scheduler.
+ */
+class Engine {
+public:
+  /**
+   * @brief Constructs an Engine object and starts its runner threads.
+   * @param max_jobs The jobs that may run at the same time.
+   */
+  explicit Engine(std::size_t max_jobs = 1);
+
+  /**
+   * @brief Runs the queued jobs and stops the runners. Cancel the handles
+   * first to stop early.
+   */
+  ~Engine();
+
+  Engine(const Engine &) = delete;
+  Engine &operator=(const Engine &) = delete;
+
+  /**
+   * @brief Queues a job.
+   * @param job The job.
+   * @param progress Called with the progress at every progress interval of
+   * the job, on its reporter thread, if set.
+   * @return The handle to wait for or cancel the job with.
+   */
+  JobHandle submit(const JobDescription &job,
+                   ProgressCallback progress = nullptr);
+
+private:
+  std::unique_ptr<pipeline::PlacementPlanner>
+      planner_; /**< Places the jobs on NUMA nodes. */
+  std::deque<std::shared_ptr<JobHandle::State>>
+      pending_;           /**< The jobs not yet started, oldest first. */
+  std::size_t next_id_;   /**< The id of the next job. */
+  bool stopping_;         /**< Whether the runners should exit. */
+  std::mutex mutex_;      /**< Guards the pending jobs and stopping. */
+  std::condition_variable wake_; /**< Wakes idle runners. */
+  std::vector<std::thread> runners_; /**< The runner threads. */
+
+  /**
+   * @brief The loop of a runner thread.
+   */
+  void run();
+};
+} // namespace gameflix
+#endif
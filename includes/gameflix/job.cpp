@@ -0,0 +1,400 @@
+#include "job.hpp"
+#include "../frame/combiner.hpp"
+#include "../logging/logger.hpp"
+#include "../pipeline/frame_queue.hpp"
+#include "../pipeline/memory_budget.hpp"
+#include "../pipeline/run_report.hpp"
+#include "../pipeline/task_scheduler.hpp"
+#include "../pipeline/workspace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+using namespace gameflix;
+
+/** The frames an in-memory decoder may queue ahead of the combiner. */
+static const std::size_t QUEUE_FRAMES = 8;
+
+namespace {
+/**
+ * @brief What a running job shares between its pipelines.
+ */
+struct JobControl {
+  pipeline::JobPlacement placement; /**< The CPUs the job was placed on. */
+  const std::atomic<bool> *cancel_flag; /**< Stops the job, if set. */
+  pipeline::ProgressCounters *counters; /**< Counts the progress. */
+};
+
+/**
+ * @brief Crops the black bars of a video away, if the job asks for it.
+ */
+void configure_crop(frame::Extractor &extractor, const std::string &video_path,
+                    const JobOptions &job_options) {
+  if (!job_options.auto_crop) {
+    return;
+  }
+
+  const compose::Rect crop = extractor.detect_crop();
+  extractor.set_crop(crop);
+  logging::info() << "Cropping " << video_path << " to " << crop.width << "x"
+                  << crop.height << "+" << crop.x << "+" << crop.y;
+}
+
+/**
+ * @brief Estimates the frames of the output from the frame counts the
+ * inputs declare.
+ * @return The frames expected, 0 if unknown.
+ */
+std::int64_t expected_frames(const frame::Extractor &extractor1,
+                             const frame::Extractor &extractor2,
+                             const JobOptions &job_options) {
+  const AVStream *stream1 = extractor1.get_video_stream();
+  const AVStream *stream2 = extractor2.get_video_stream();
+  const bool trimmed =
+      job_options.trim.start > 0.0 || job_options.trim.end > 0.0;
+  if (!stream1 || !stream2 || stream1->nb_frames <= 0 ||
+      stream2->nb_frames <= 0 || trimmed) {
+    return 0;
+  }
+
+  // Layouts compose one frame from every source, until the longest ends
+  if (job_options.layout != compose::LayoutKind::Interleave) {
+    return std::max(stream1->nb_frames, stream2->nb_frames);
+  }
+  return stream1->nb_frames + stream2->nb_frames;
+}
+
+/**
+ * @brief Hands the cancel flag and progress counters of the job to the
+ * extractors.
+ */
+void configure_control(frame::Extractor &extractor1,
+                       frame::Extractor &extractor2,
+                       const JobControl &control) {
+  extractor1.set_cancel_flag(control.cancel_flag);
+  extractor2.set_cancel_flag(control.cancel_flag);
+  extractor1.set_progress_counters(control.counters);
+  extractor2.set_progress_counters(control.counters);
+}
+
+/**
+ * @brief Concatenates the videos by copying their packets, if possible.
+ * @return `true` if the output was written, `false` if the inputs need to be
+ * re-encoded.
+ */
+bool run_remux(const JobDescription &job, const JobControl &control) {
+  const JobOptions &job_options = job.options;
+  logging::set_thread_stage("remux");
+  pipeline::RunReport report;
+  report.record_placement(control.placement);
+  frame::Extractor frame_extractor1(job.video_path1,
+                                    job_options.input_options);
+  frame::Extractor frame_extractor2(job.video_path2,
+                                    job_options.input_options);
+
+  frame::Combiner frame_combiner("");
+  if (!frame_combiner.can_remux(frame_extractor1) ||
+      !frame_combiner.can_remux(frame_extractor2)) {
+    logging::info() << "The inputs do not match the output format, so they "
+                       "are re-encoded.";
+    return false;
+  }
+
+  frame_combiner.set_fragment_duration(job_options.fragment_seconds);
+  frame_combiner.set_keyframe_interval(job_options.keyframe_seconds);
+  frame_combiner.set_cancel_flag(control.cancel_flag);
+  frame_combiner.set_progress_counters(control.counters);
+  if (!frame_combiner.remux_to_video({&frame_extractor1, &frame_extractor2},
+                                     job_options.trim, job.output_path)) {
+    // A cancelled copy is not re-encoded
+    if (!control.cancel_flag || !*control.cancel_flag) {
+      logging::warning() << "Failed to copy the inputs, so they are "
+                            "re-encoded.";
+    }
+    return false;
+  }
+
+  logging::info() << "Copied the inputs without re-encoding.";
+  // The report follows the job's log lines
+  logging::flush();
+  report.print(logging::info_stream());
+  return true;
+}
+
+/**
+ * @brief Decodes both videos on their own threads and hands the frames to the
+ * combiner through bounded queues that share the job's memory budget.
+ * @return `true` if the output was written, `false` otherwise.
+ */
+bool run_in_memory(const JobDescription &job, const JobControl &control) {
+  const JobOptions &job_options = job.options;
+  pipeline::RunReport report;
+  report.record_placement(control.placement);
+  pipeline::StageTimer combine_timer("compose+encode");
+  pipeline::MemoryBudget budget(job_options.max_memory);
+  pipeline::FrameQueue queue1(budget, QUEUE_FRAMES);
+  pipeline::FrameQueue queue2(budget, QUEUE_FRAMES);
+  // The buffers land on the job's node, or on the node of this thread, which
+  // runs the combiner
+  pipeline::FrameAllocator frame_allocator(job_options.frame_pages,
+                                           control.placement.node);
+
+  frame::Extractor frame_extractor1(job.video_path1,
+                                    job_options.input_options);
+  frame::Extractor frame_extractor2(job.video_path2,
+                                    job_options.input_options);
+  frame_extractor1.set_frame_allocator(&frame_allocator);
+  frame_extractor2.set_frame_allocator(&frame_allocator);
+  frame_extractor1.set_trim(job_options.trim);
+  frame_extractor2.set_trim(job_options.trim);
+  frame_extractor1.set_scale_algorithm(job_options.scale_algorithm);
+  frame_extractor2.set_scale_algorithm(job_options.scale_algorithm);
+  frame_extractor1.set_simd_kernels(job_options.simd_kernels);
+  frame_extractor2.set_simd_kernels(job_options.simd_kernels);
+  configure_control(frame_extractor1, frame_extractor2, control);
+  configure_crop(frame_extractor1, job.video_path1, job_options);
+  configure_crop(frame_extractor2, job.video_path2, job_options);
+  control.counters->set_frames_expected(
+      expected_frames(frame_extractor1, frame_extractor2, job_options));
+  // The decoders submit their conversions as this job
+  const std::size_t job_id = pipeline::TaskScheduler::current_job();
+  pipeline::StageStats decode_stats1;
+  pipeline::StageStats decode_stats2;
+  std::thread extractor_thread1([&] {
+    pipeline::TaskScheduler::set_current_job(job_id);
+    logging::set_thread_stage("decode 1");
+    pipeline::StageTimer timer("decode 1");
+    frame_extractor1.extract_frames(queue1);
+    decode_stats1 = timer.stop();
+  });
+  std::thread extractor_thread2([&] {
+    pipeline::TaskScheduler::set_current_job(job_id);
+    logging::set_thread_stage("decode 2");
+    pipeline::StageTimer timer("decode 2");
+    frame_extractor2.extract_frames(queue2);
+    decode_stats2 = timer.stop();
+  });
+
+  logging::set_thread_stage("compose+encode");
+  frame::Combiner frame_combiner("");
+  frame_combiner.set_fragment_duration(job_options.fragment_seconds);
+  frame_combiner.set_keyframe_interval(job_options.keyframe_seconds);
+  frame_combiner.set_encoder_threads(job_options.encoder_threads);
+  frame_combiner.set_concatenate(job_options.concatenate);
+  frame_combiner.set_scale_algorithm(job_options.scale_algorithm);
+  frame_combiner.set_simd_kernels(job_options.simd_kernels);
+  frame_combiner.set_frame_allocator(&frame_allocator);
+  frame_combiner.set_crossfade_duration(job_options.crossfade_seconds);
+  frame_combiner.set_cancel_flag(control.cancel_flag);
+  frame_combiner.set_progress_counters(control.counters);
+  frame_combiner.set_memory_budget(&budget);
+  for (const frame::OutputSpec &rendition : job_options.renditions) {
+    frame_combiner.add_rendition(rendition);
+  }
+  if (job_options.layout != compose::LayoutKind::Interleave) {
+    frame_combiner.set_layout(
+        compose::make_layout(job_options.layout, job_options.opacity));
+  }
+  const bool written =
+      frame_combiner.combine_queues_to_video({&queue1, &queue2},
+                                             job.output_path);
+  const pipeline::StageStats combine_stats = combine_timer.stop();
+
+  extractor_thread1.join();
+  extractor_thread2.join();
+
+  if (frame_allocator.mode() != pipeline::PageMode::Default) {
+    logging::info()
+        << "Mapped "
+        << pipeline::format_byte_size(frame_allocator.mapped_bytes()) << " of "
+        << pipeline::page_mode_name(frame_allocator.mode())
+        << " frame buffers on NUMA node " << frame_allocator.numa_node();
+  }
+  report.record_memory(budget);
+  report.record_stage(decode_stats1);
+  report.record_stage(decode_stats2);
+  report.record_stage(combine_stats);
+  for (const pipeline::StageStats &stats :
+       frame_combiner.get_rendition_stats()) {
+    // Renditions that failed to open never ran a thread
+    if (!stats.name.empty()) {
+      report.record_stage(stats);
+    }
+  }
+  logging::flush();
+  report.print(logging::info_stream());
+  return written;
+}
+
+/**
+ * @brief Extracts both videos to PNG frames in a workspace of the job's own
+ * and combines them. The workspace is removed in the background.
+ * @return `true` if the output was written, `false` otherwise.
+ */
+bool run_with_workspace(const JobDescription &job,
+                        const JobControl &control) {
+  const JobOptions &job_options = job.options;
+  const pipeline::Workspace workspace(job_options.workspace_root);
+  if (!workspace.valid()) {
+    return false;
+  }
+  logging::info() << "Created workspace " << workspace.path();
+
+  // STEP 1: Extract the frames of both videos into the workspace
+  logging::set_thread_stage("extract");
+  frame::Extractor frame_extractor1(job.video_path1,
+                                    job_options.input_options);
+  frame::Extractor frame_extractor2(job.video_path2,
+                                    job_options.input_options);
+  frame_extractor1.set_scale_algorithm(job_options.scale_algorithm);
+  frame_extractor2.set_scale_algorithm(job_options.scale_algorithm);
+  frame_extractor1.set_simd_kernels(job_options.simd_kernels);
+  frame_extractor2.set_simd_kernels(job_options.simd_kernels);
+  frame_extractor1.set_intermediate_format(job_options.intermediate_format);
+  frame_extractor2.set_intermediate_format(job_options.intermediate_format);
+  configure_control(frame_extractor1, frame_extractor2, control);
+  configure_crop(frame_extractor1, job.video_path1, job_options);
+  configure_crop(frame_extractor2, job.video_path2, job_options);
+  control.counters->set_frames_expected(
+      expected_frames(frame_extractor1, frame_extractor2, job_options));
+  {
+    // The manifest is complete once the writer closes it
+    frame::FrameManifestWriter manifest(workspace.path() + "/" +
+                                        frame::FRAME_MANIFEST_NAME);
+    if (!manifest.valid()) {
+      return false;
+    }
+    // A frame missing from the workspace fails the job instead of leaving
+    // a gap in the output
+    const bool extracted =
+        frame_extractor1.extract_frames(workspace.path(), manifest, 0) &&
+        frame_extractor2.extract_frames(workspace.path(), manifest, 1);
+    if (!manifest.close()) {
+      logging::error() << "Failed to write the frame manifest.";
+      return false;
+    }
+    if (!extracted) {
+      return false;
+    }
+  }
+
+  // STEP 2: Combine the frames the manifest lists into the output
+  logging::set_thread_stage("combine");
+  frame::Combiner frame_combiner(workspace.path());
+  frame_combiner.set_fragment_duration(job_options.fragment_seconds);
+  frame_combiner.set_keyframe_interval(job_options.keyframe_seconds);
+  frame_combiner.set_encoder_threads(job_options.encoder_threads);
+  frame_combiner.set_input_options(job_options.input_options);
+  frame_combiner.set_scale_algorithm(job_options.scale_algorithm);
+  frame_combiner.set_simd_kernels(job_options.simd_kernels);
+  frame_combiner.set_cancel_flag(control.cancel_flag);
+  frame_combiner.set_progress_counters(control.counters);
+  for (const frame::OutputSpec &rendition : job_options.renditions) {
+    frame_combiner.add_rendition(rendition);
+  }
+  return frame_combiner.combine_frames_to_video(job.output_path);
+}
+} // namespace
+
+const char *gameflix::job_status_name(JobStatus status) {
+  switch (status) {
+  case JobStatus::Succeeded:
+    return "succeeded";
+  case JobStatus::Failed:
+    return "failed";
+  case JobStatus::Cancelled:
+    return "cancelled";
+  }
+  return "unknown";
+}
+
+JobStatus gameflix::run_job(const JobDescription &job,
+                            pipeline::PlacementPlanner &planner,
+                            const std::atomic<bool> *cancel_flag,
+                            const ProgressCallback &progress) {
+  const JobOptions &job_options = job.options;
+  auto is_cancelled = [cancel_flag] {
+    return cancel_flag && cancel_flag->load(std::memory_order_relaxed);
+  };
+
+  // STEP 1: Pin this thread before it starts the stage threads, which
+  // inherit its CPUs
+  pipeline::ProgressCounters counters;
+  JobControl control;
+  control.placement =
+      planner.acquire(job_options.placement, job_options.numa_node);
+  control.cancel_flag = cancel_flag;
+  control.counters = &counters;
+  pipeline::pin_current_thread(control.placement.cpus);
+
+  // STEP 2: Log and hand on the counters from a reporter thread, which
+  // is pinned with the stages but asleep almost all the time. The lines go
+  // through the logger, so they never interleave with its other records.
+  auto report = [&job_options, &progress](const JobProgress &snapshot) {
+    if (job_options.progress_format != pipeline::ProgressFormat::None) {
+      logging::info().stage("progress") << pipeline::format_progress(
+          snapshot, job_options.progress_format);
+    }
+    if (progress) {
+      progress(snapshot);
+    }
+  };
+  pipeline::ProgressReporter reporter(
+      counters,
+      std::chrono::milliseconds(
+          static_cast<long long>(1000.0 * job_options.progress_interval)),
+      report);
+
+  // STEP 3: Concatenation jobs, trimmed or not, copy packets when the
+  // inputs already match the output format and nothing is composed
+  const bool composed =
+      job_options.layout != compose::LayoutKind::Interleave;
+  const bool trimmed =
+      job_options.trim.start > 0.0 || job_options.trim.end > 0.0;
+  const bool remuxed =
+      job_options.concatenate && job_options.remux && !composed &&
+      job_options.crossfade_seconds <= 0.0 && !job_options.auto_crop &&
+      job_options.renditions.empty() && run_remux(job, control);
+
+  // STEP 4: Concatenation, trimming and layouts need to know which source a
+  // frame came from, which only the in-memory pipeline does. A cancelled
+  // remux does not fall back to re-encoding.
+  bool written = remuxed;
+  if (remuxed || is_cancelled()) {
+    // The packets were copied as they are, or the job was cancelled
+  } else if (job_options.in_memory || job_options.concatenate || trimmed ||
+             composed) {
+    written = run_in_memory(job, control);
+  } else {
+    written = run_with_workspace(job, control);
+  }
+  reporter.stop();
+  planner.release(control.placement);
+
+  if (is_cancelled()) {
+    return JobStatus::Cancelled;
+  }
+  return written ? JobStatus::Succeeded : JobStatus::Failed;
+}
+
+int gameflix::run_thumbnails(const std::string &video_path,
+                             const std::string &output_path,
+                             const frame::ThumbnailOptions &thumbnail_options,
+                             const JobOptions &job_options) {
+  pipeline::RunReport report;
+  if (thumbnail_options.columns <= 0) {
+    std::filesystem::create_directories(output_path);
+  }
+
+  frame::Extractor frame_extractor(video_path, job_options.input_options);
+  frame_extractor.set_scale_algorithm(job_options.scale_algorithm);
+  configure_crop(frame_extractor, video_path, job_options);
+  const int count =
+      frame_extractor.extract_thumbnails(output_path, thumbnail_options);
+
+  logging::info() << "Took " << count << " thumbnails.";
+  logging::flush();
+  report.print(logging::info_stream());
+  return count;
+}
@@ -0,0 +1,130 @@
+#ifndef GAMEFLIX_JOB
+#define GAMEFLIX_JOB
+
+#include "../compose/layout.hpp"
+#include "../frame/encoder.hpp"
+#include "../frame/extractor.hpp"
+#include "../frame/intermediate.hpp"
+#include "../frame/scaler.hpp"
+#include "../frame/thumbnails.hpp"
+#include "../io/input_source.hpp"
+#include "../pipeline/frame_allocator.hpp"
+#include "../pipeline/placement.hpp"
+#include "../pipeline/progress.hpp"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace gameflix {
+/**
+ * @brief Everything a job needs to know besides its inputs and output.
+ */
+struct JobOptions {
+  io::InputOptions input_options; /**< How input files are read. */
+  std::size_t max_memory = 0;     /**< The memory budget for queued frames. */
+  double fragment_seconds = 0.0;  /**< The fragment duration, 0 for none. */
+  double keyframe_seconds = 4.0;  /**< The longest keyframe distance. */
+  int encoder_threads = 0; /**< The threads of each encoder, 0 for default. */
+  bool concatenate = false;       /**< Whether the inputs play back to back. */
+  bool remux = true;   /**< Whether packets may be copied without encoding. */
+  frame::TrimRange trim; /**< The range of each input to keep. */
+  frame::ScaleAlgorithm scale_algorithm =
+      frame::ScaleAlgorithm::Bicubic; /**< The algorithm to scale frames. */
+  bool simd_kernels = true; /**< Whether the SIMD kernels convert frames. */
+  compose::LayoutKind layout =
+      compose::LayoutKind::Interleave; /**< How the inputs are arranged. */
+  int opacity = compose::OPAQUE; /**< The opacity of the input on top. */
+  double crossfade_seconds = 0.0; /**< The crossfade between inputs. */
+  bool auto_crop = false; /**< Whether black bars are cropped away. */
+  std::vector<frame::OutputSpec>
+      renditions; /**< The extra sizes the output is written at. */
+  pipeline::PageMode frame_pages =
+      pipeline::PageMode::Default; /**< The pages frames are allocated on. */
+  bool in_memory = false; /**< Whether frames skip the workspace. */
+  std::string workspace_root; /**< Where workspaces go, empty for TMPDIR. */
+  frame::IntermediateFormat intermediate_format =
+      frame::IntermediateFormat::Png; /**< The format of workspace frames. */
+  pipeline::PlacementPolicy placement =
+      pipeline::PlacementPolicy::None; /**< Where the stages may run. */
+  int numa_node = -1; /**< The node to pin to, -1 for the least loaded. */
+  pipeline::ProgressFormat progress_format =
+      pipeline::ProgressFormat::None; /**< How progress is printed. */
+  double progress_interval = 1.0; /**< The seconds between reports. */
+};
+
+/**
+ * @brief A job: two input videos combined into one output. Only the video
+ * streams are combined; the output has no audio.
+ */
+struct JobDescription {
+  std::string video_path1; /**< The path to the first video. */
+  std::string video_path2; /**< The path to the second video. */
+  std::string output_path; /**< The path to the output, "-" for stdout. */
+  JobOptions options;      /**< How the videos are combined. */
+};
+
+/**
+ * @brief How a job ended.
+ */
+enum class JobStatus {
+  Succeeded, /**< The output was written. */
+  Failed,    /**< An input could not be read or the output written. */
+  Cancelled, /**< The job was cancelled before it was done. */
+};
+
+/**
+ * @brief Gets the name of a job status.
+ * @param status The status.
+ * @return "succeeded", "failed" or "cancelled".
+ */
+const char *job_status_name(JobStatus status);
+
+/**
+ * @brief How far a job has come.
+ */
+using JobProgress = pipeline::ProgressSnapshot;
+
+/**
+ * @brief Called with the progress of a job at every progress interval and
+ * once more when it ends, on its reporter thread.
+ */
+using ProgressCallback = std::function<void(const JobProgress &)>;
+
+/**
+ * @brief Runs a job on the calling thread, on the pipeline it needs.
+ *
+ * The thread is pinned to the CPUs the planner places the job on before
+ * the stage threads start, so they inherit the CPUs. The thread keeps the
+ * pinning afterwards. The stages only bump atomic counters, which a
+ * reporter thread prints and hands to the progress callback.
+ * @param job The job.
+ * @param planner Places the job on a NUMA node, with the job's policy.
+ * @param cancel_flag Stops the job early once set, `nullptr` for never.
+ * @param progress Called with the progress at every progress interval, if
+ * set.
+ * @return How the job ended.
+ */
+JobStatus run_job(const JobDescription &job,
+                  pipeline::PlacementPlanner &planner,
+                  const std::atomic<bool> *cancel_flag = nullptr,
+                  const ProgressCallback &progress = nullptr);
+
+/**
+ * @brief Writes thumbnails or a contact sheet of one video, on the calling
+ * thread.
+ * @param video_path The path to the video.
+ * @param output_path The directory of the thumbnails, or the path of the
+ * contact sheet.
+ * @param thumbnail_options Which thumbnails to take and how.
+ * @param job_options How the video is read, scaled and cropped.
+ * @return The number of thumbnails taken, 0 if the video could not be
+ * read.
+ */
+int run_thumbnails(const std::string &video_path,
+                   const std::string &output_path,
+                   const frame::ThumbnailOptions &thumbnail_options,
+                   const JobOptions &job_options);
+} // namespace gameflix
+#endif
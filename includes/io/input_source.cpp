@@ -0,0 +1,268 @@
+#include "input_source.hpp"
+#include "../logging/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+using namespace io;
+
+/** The AVIOContext buffer size in the mmap mode, where reads are memcpy()s. */
+static const std::size_t MMAP_AVIO_BUFFER_SIZE = 256 << 10;
+/** The smallest AVIOContext buffer size in the buffered mode. */
+static const std::size_t MIN_AVIO_BUFFER_SIZE = 4 << 10;
+
+InputMode io::parse_input_mode(const std::string &name) {
+  if (name == "default") {
+    return InputMode::Default;
+  }
+  if (name == "mmap") {
+    return InputMode::Mmap;
+  }
+  if (name == "buffered") {
+    return InputMode::Buffered;
+  }
+  throw std::invalid_argument("Unknown input mode: " + name);
+}
+
+InputSource::InputSource(const std::string &path, const InputOptions &options)
+    : path_(path), options_(options), fd_(-1), map_(nullptr), size_(0),
+      position_(0), advised_(0), avio_context_(nullptr), read_calls_(0),
+      bytes_read_(0) {}
+
+InputSource::~InputSource() {
+  // STEP 1: Free the custom I/O context and its buffer
+  if (avio_context_) {
+    av_freep(&avio_context_->buffer);
+    avio_context_free(&avio_context_);
+  }
+
+  // STEP 2: Unmap and close the file
+  if (map_) {
+    munmap(map_, size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+bool InputSource::open_format_context(AVFormatContext **format_context) {
+  // STEP 1: Let libavformat open the file itself in the default mode
+  if (options_.mode == InputMode::Default) {
+    if (avformat_open_input(format_context, path_.c_str(), nullptr,
+                            nullptr) != 0) {
+      logging::error() << "Failed to open input file.";
+      return false;
+    }
+    return true;
+  }
+
+  // STEP 2: Open the file and wrap it in a custom I/O context
+  if (!open_file() || !create_avio_context()) {
+    return false;
+  }
+
+  // STEP 3: Open the format context on top of the custom I/O context
+  *format_context = avformat_alloc_context();
+  if (!*format_context) {
+    logging::error() << "Failed to allocate format context.";
+    return false;
+  }
+  (*format_context)->pb = avio_context_;
+  (*format_context)->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+  if (avformat_open_input(format_context, path_.c_str(), nullptr, nullptr) !=
+      0) {
+    logging::error() << "Failed to open input file.";
+    return false;
+  }
+
+  return true;
+}
+
+std::uint64_t InputSource::read_calls() const { return read_calls_; }
+
+std::uint64_t InputSource::bytes_read() const { return bytes_read_; }
+
+bool InputSource::open_file() {
+  // STEP 1: Open the file and get its size
+  fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    logging::error() << "Failed to open input file: " << std::strerror(errno);
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) != 0) {
+    logging::error() << "Failed to stat input file: " << std::strerror(errno);
+    return false;
+  }
+  size_ = static_cast<std::size_t>(file_stat.st_size);
+
+  // STEP 2: Tell the kernel the file is read front to back
+  if (options_.mode == InputMode::Buffered) {
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    advise_read_ahead();
+    return true;
+  }
+
+  // STEP 3: Map the file for the mmap mode
+  if (size_ == 0) {
+    return true;
+  }
+
+  void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (map == MAP_FAILED) {
+    logging::error() << "Failed to map input file: " << std::strerror(errno);
+    return false;
+  }
+  map_ = static_cast<std::uint8_t *>(map);
+  madvise(map_, size_, MADV_SEQUENTIAL);
+  advise_read_ahead();
+
+  return true;
+}
+
+bool InputSource::create_avio_context() {
+  // STEP 1: Allocate the buffer. In the buffered mode it spans the whole
+  // read-ahead window, so each refill is a single large pread().
+  std::size_t buffer_size = MMAP_AVIO_BUFFER_SIZE;
+  if (options_.mode == InputMode::Buffered) {
+    buffer_size = std::min<std::size_t>(
+        std::max(options_.read_ahead, MIN_AVIO_BUFFER_SIZE), INT_MAX / 2);
+  }
+
+  auto *buffer = static_cast<unsigned char *>(av_malloc(buffer_size));
+  if (!buffer) {
+    logging::error() << "Failed to allocate I/O buffer.";
+    return false;
+  }
+
+  // STEP 2: Create the I/O context
+  avio_context_ = avio_alloc_context(buffer, static_cast<int>(buffer_size), 0,
+                                     this, &InputSource::read_packet, nullptr,
+                                     &InputSource::seek);
+  if (!avio_context_) {
+    logging::error() << "Failed to allocate I/O context.";
+    av_free(buffer);
+    return false;
+  }
+
+  return true;
+}
+
+void InputSource::advise_read_ahead() {
+  // STEP 1: Wait until the reader is halfway through the current window
+  if (options_.read_ahead == 0 || advised_ >= size_ ||
+      advised_ > position_ + options_.read_ahead / 2) {
+    return;
+  }
+
+  // STEP 2: Request the pages up to one window past the read position
+  const std::size_t start = std::max(position_, advised_);
+  const std::size_t end = std::min(size_, position_ + options_.read_ahead);
+  if (end <= start) {
+    return;
+  }
+
+  if (map_) {
+    const std::size_t page_size = static_cast<std::size_t>(getpagesize());
+    const std::size_t aligned_start = start - start % page_size;
+    madvise(map_ + aligned_start, end - aligned_start, MADV_WILLNEED);
+  } else {
+    posix_fadvise(fd_, static_cast<off_t>(start),
+                  static_cast<off_t>(end - start), POSIX_FADV_WILLNEED);
+  }
+  advised_ = end;
+}
+
+int InputSource::read_packet(void *opaque, std::uint8_t *buf, int buf_size) {
+  auto *source = static_cast<InputSource *>(opaque);
+  if (source->position_ >= source->size_) {
+    return AVERROR_EOF;
+  }
+
+  // STEP 1: Keep the kernel ahead of the reader
+  source->advise_read_ahead();
+
+  const std::size_t wanted = std::min<std::size_t>(
+      static_cast<std::size_t>(buf_size), source->size_ - source->position_);
+
+  // STEP 2: Copy out of the mapping, or read from the file
+  std::size_t got = 0;
+  if (source->map_) {
+    std::memcpy(buf, source->map_ + source->position_, wanted);
+    got = wanted;
+  } else {
+    ssize_t result;
+    do {
+      result = pread(source->fd_, buf, wanted,
+                     static_cast<off_t>(source->position_));
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+      return AVERROR(errno);
+    }
+    if (result == 0) {
+      return AVERROR_EOF;
+    }
+    got = static_cast<std::size_t>(result);
+  }
+
+  // STEP 3: Advance the read position
+  source->position_ += got;
+  source->read_calls_ += 1;
+  source->bytes_read_ += got;
+
+  return static_cast<int>(got);
+}
+
+std::int64_t InputSource::seek(void *opaque, std::int64_t offset,
+                               int whence) {
+  auto *source = static_cast<InputSource *>(opaque);
+
+  // STEP 1: Report the file size if asked to
+  if (whence & AVSEEK_SIZE) {
+    return static_cast<std::int64_t>(source->size_);
+  }
+
+  // STEP 2: Compute the new position
+  std::int64_t position;
+  switch (whence & ~AVSEEK_FORCE) {
+  case SEEK_SET:
+    position = offset;
+    break;
+  case SEEK_CUR:
+    position = static_cast<std::int64_t>(source->position_) + offset;
+    break;
+  case SEEK_END:
+    position = static_cast<std::int64_t>(source->size_) + offset;
+    break;
+  default:
+    return AVERROR(EINVAL);
+  }
+
+  if (position < 0) {
+    return AVERROR(EINVAL);
+  }
+
+  // STEP 3: Restart the read-ahead window if the jump left it
+  source->position_ = static_cast<std::size_t>(position);
+  if (source->position_ > source->advised_ ||
+      source->position_ + source->options_.read_ahead < source->advised_) {
+    source->advised_ = source->position_;
+  }
+
+  return position;
+}
@@ -0,0 +1,136 @@
+#ifndef IO_INPUT_SOURCE
+#define IO_INPUT_SOURCE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace io {
+/**
+ * @brief How input files are read by libavformat.
+ */
+enum class InputMode {
+  Default,  /**< libavformat's own `file:` protocol. */
+  Mmap,     /**< A custom AVIOContext that copies out of an mmap'ed file. */
+  Buffered, /**< A custom AVIOContext that issues large pread() calls. */
+};
+
+/**
+ * @brief Options for opening input files.
+ */
+struct InputOptions {
+  InputMode mode = InputMode::Default; /**< How the file is read. */
+  std::size_t read_ahead = 4 << 20;    /**< The read-ahead window in bytes. */
+  int decoder_threads = 0; /**< The decoder threads, 0 for FFmpeg's default. */
+};
+
+/**
+ * @brief Parses an input mode name ("default", "mmap" or "buffered").
+ * @param name The name to parse.
+ * @return The input mode.
+ * @throws std::invalid_argument If the name is not a known mode.
+ */
+InputMode parse_input_mode(const std::string &name);
+
+/**
+ * @brief An input file opened for libavformat with a configurable I/O layer.
+ *
+ * In the mmap mode the file is mapped once with MADV_SEQUENTIAL, and the
+ * pages of the next read-ahead window are requested with MADV_WILLNEED as
+ * the demuxer advances. In the buffered mode reads go through pread() with a
+ * buffer of the size of the read-ahead window, and the kernel is told about
+ * the window with posix_fadvise(). The source must outlive the format context
+ * opened from it.
+ */
+class InputSource {
+public:
+  /**
+   * @brief Constructs an InputSource object.
+   * @param path The path to the input file.
+   * @param options The options for reading the file.
+   */
+  InputSource(const std::string &path, const InputOptions &options);
+
+  /**
+   * @brief Destroys the InputSource object and releases the file.
+   */
+  ~InputSource();
+
+  InputSource(const InputSource &) = delete;
+  InputSource &operator=(const InputSource &) = delete;
+
+  /**
+   * @brief Opens a format context that reads from this source.
+   * @param format_context The pointer to the format context to store the
+   * opened file. It must be closed with avformat_close_input() before the
+   * source is destroyed.
+   * @return `true` if opening was successful, `false` otherwise.
+   */
+  bool open_format_context(AVFormatContext **format_context);
+
+  /**
+   * @brief Gets the number of read requests served by the custom I/O layer.
+   * @return The number of read requests, 0 in the default mode.
+   */
+  std::uint64_t read_calls() const;
+
+  /**
+   * @brief Gets the number of bytes served by the custom I/O layer.
+   * @return The number of bytes read, 0 in the default mode.
+   */
+  std::uint64_t bytes_read() const;
+
+private:
+  std::string path_;      /**< The path to the input file. */
+  InputOptions options_;  /**< The options for reading the file. */
+  int fd_;                /**< The file descriptor, -1 if not open. */
+  std::uint8_t *map_;     /**< The mapped file in the mmap mode. */
+  std::size_t size_;      /**< The size of the file in bytes. */
+  std::size_t position_;  /**< The current read position. */
+  std::size_t advised_;   /**< The end of the last read-ahead request. */
+  AVIOContext *avio_context_; /**< The custom I/O context. */
+  std::uint64_t read_calls_;  /**< The number of read requests served. */
+  std::uint64_t bytes_read_;  /**< The number of bytes served. */
+
+  /**
+   * @brief Opens and, in the mmap mode, maps the file.
+   * @return `true` if opening was successful, `false` otherwise.
+   */
+  bool open_file();
+
+  /**
+   * @brief Creates the custom I/O context.
+   * @return `true` if creation was successful, `false` otherwise.
+   */
+  bool create_avio_context();
+
+  /**
+   * @brief Requests the read-ahead window following the current position.
+   */
+  void advise_read_ahead();
+
+  /**
+   * @brief AVIOContext read callback.
+   * @param opaque The InputSource.
+   * @param buf The buffer to fill.
+   * @param buf_size The size of the buffer.
+   * @return The number of bytes read, or AVERROR_EOF at the end of the file.
+   */
+  static int read_packet(void *opaque, std::uint8_t *buf, int buf_size);
+
+  /**
+   * @brief AVIOContext seek callback.
+   * @param opaque The InputSource.
+   * @param offset The offset to seek to.
+   * @param whence SEEK_SET, SEEK_CUR, SEEK_END or AVSEEK_SIZE.
+   * @return The new position, the file size for AVSEEK_SIZE, or a negative
+   * error code.
+   */
+  static std::int64_t seek(void *opaque, std::int64_t offset, int whence);
+};
+} // namespace io
+#endif
@@ -0,0 +1,542 @@
+#include "logger.hpp"
+#include "../pipeline/task_scheduler.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+using namespace logging;
+
+/** The records a thread's ring buffer holds. */
+static const std::size_t RING_RECORDS = 256;
+/** How long the drain thread sleeps between passes. */
+static const std::chrono::milliseconds DRAIN_INTERVAL(20);
+
+namespace {
+/**
+ * @brief The records of one thread. The thread is the only producer and the
+ * drain the only consumer, so neither side takes a lock.
+ */
+struct Ring {
+  std::array<Record, RING_RECORDS> records; /**< The slots. */
+  std::atomic<std::size_t> head{0}; /**< The next slot to write. */
+  std::atomic<std::size_t> tail{0}; /**< The next slot to read. */
+  std::atomic<bool> retired{false}; /**< Whether the thread exited. */
+
+  /**
+   * @brief Copies a record into the next free slot, on the owning thread.
+   * @return `true` if it was copied, `false` if the ring is full.
+   */
+  bool push(const Record &record) {
+    const std::size_t position = head.load(std::memory_order_relaxed);
+    if (position - tail.load(std::memory_order_acquire) == RING_RECORDS) {
+      return false;
+    }
+    records[position % RING_RECORDS] = record;
+    head.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Copies the oldest record out, on the drain.
+   * @return `true` if there was one, `false` if the ring is empty.
+   */
+  bool pop(Record &record) {
+    const std::size_t position = tail.load(std::memory_order_relaxed);
+    if (position == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    record = records[position % RING_RECORDS];
+    tail.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Checks if every record was read.
+   */
+  bool empty() const {
+    return tail.load(std::memory_order_acquire) ==
+           head.load(std::memory_order_acquire);
+  }
+};
+
+/**
+ * @brief Gets the tag text records of a level start with.
+ */
+const char *level_tag(Level level) {
+  switch (level) {
+  case Level::Debug:
+    return "[DEBUG]";
+  case Level::Info:
+    return "[INFO]";
+  case Level::Warning:
+    return "[WARNING]";
+  default:
+    return "[ERROR]";
+  }
+}
+
+/**
+ * @brief The ring of the calling thread, which is retired when the thread
+ * exits so the drain can free it once it is read.
+ */
+struct ThreadRing {
+  std::shared_ptr<Ring> ring; /**< The ring, shared with the logger. */
+
+  ~ThreadRing() {
+    if (ring) {
+      ring->retired = true;
+    }
+  }
+};
+
+/** The ring of the calling thread, created on its first record. */
+thread_local ThreadRing thread_ring;
+/** The stage the calling thread logs for. */
+thread_local char thread_stage[MAX_STAGE] = "";
+/** Which streams records are written to, kept outside the logger so it
+ * can be set before the logger starts. */
+std::atomic<Output> log_output{Output::Split};
+
+/**
+ * @brief Collects the rings of every thread and writes their records from
+ * a background thread, so logging threads never wait on a stream.
+ */
+class Logger {
+public:
+  std::atomic<Level> level;   /**< The lowest level logged. */
+  std::atomic<Format> format; /**< How records are written. */
+  std::atomic<std::size_t> dropped; /**< The records dropped. */
+
+  /**
+   * @brief Gets the logger of the process, starting it on first use. It
+   * is never destroyed, so threads may log until the process exits, and
+   * it flushes from an atexit() handler.
+   */
+  static Logger &global() {
+    static Logger *logger = new Logger();
+    return *logger;
+  }
+
+  /**
+   * @brief Hands a record to the calling thread's ring, or drops it if the
+   * ring is full.
+   */
+  void submit(const Record &record) {
+    if (!ring().push(record)) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // Errors are written right away, everything else on the next pass
+    if (record.level == Level::Error) {
+      wake_.notify_one();
+    }
+  }
+
+  /**
+   * @brief Writes every record submitted so far.
+   */
+  void flush() { drain(); }
+
+private:
+  std::chrono::steady_clock::time_point start_; /**< When it started. */
+  std::vector<std::shared_ptr<Ring>> rings_;    /**< The rings. */
+  std::mutex rings_mutex_;    /**< Guards the rings. */
+  std::mutex drain_mutex_;    /**< Makes one pass drain at a time. */
+  std::vector<Record> pending_; /**< The records of a pass. */
+  std::size_t reported_dropped_; /**< The drops written so far. */
+  std::mutex mutex_;             /**< Guards the sleeping drain. */
+  std::condition_variable wake_; /**< Wakes the drain early. */
+  std::thread thread_;           /**< The drain thread. */
+
+  Logger()
+      : level(Level::Info), format(Format::Text), dropped(0),
+        start_(std::chrono::steady_clock::now()), rings_(), rings_mutex_(),
+        drain_mutex_(), pending_(), reported_dropped_(0), mutex_(), wake_(),
+        thread_() {
+    thread_ = std::thread([this] { run(); });
+    std::atexit([] { Logger::global().flush(); });
+  }
+
+  /**
+   * @brief Gets the ring of the calling thread, registering it first.
+   */
+  Ring &ring() {
+    if (!thread_ring.ring) {
+      thread_ring.ring = std::make_shared<Ring>();
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      rings_.push_back(thread_ring.ring);
+    }
+    return *thread_ring.ring;
+  }
+
+  /**
+   * @brief The loop of the drain thread.
+   */
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_.wait_for(lock, DRAIN_INTERVAL);
+      lock.unlock();
+      drain();
+      lock.lock();
+    }
+  }
+
+  /**
+   * @brief Writes the records of every ring in the order they were logged.
+   */
+  void drain() {
+    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+
+    // STEP 1: Read every ring, freeing those of exited threads once empty
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                  [](const std::shared_ptr<Ring> &ring) {
+                                    return ring->retired && ring->empty();
+                                  }),
+                   rings_.end());
+      rings = rings_;
+    }
+    pending_.clear();
+    Record record;
+    for (const std::shared_ptr<Ring> &ring : rings) {
+      while (ring->pop(record)) {
+        pending_.push_back(record);
+      }
+    }
+
+    // STEP 2: Interleave the threads by time
+    std::stable_sort(pending_.begin(), pending_.end(),
+                     [](const Record &a, const Record &b) {
+                       return a.time < b.time;
+                     });
+
+    // STEP 3: Write every record as one line, errors and warnings to
+    // stderr and the rest to the info stream
+    const Format line_format = format.load();
+    std::ostream &info = info_stream();
+    std::string line;
+    for (const Record &pending : pending_) {
+      format_line(pending, line_format, line);
+      std::ostream &stream =
+          pending.level >= Level::Warning ? std::cerr : info;
+      stream.write(line.data(), static_cast<std::streamsize>(line.size()));
+    }
+
+    // STEP 4: Tell how many records were lost to full rings
+    const std::size_t total_dropped = dropped.load();
+    if (total_dropped != reported_dropped_) {
+      std::cerr << "[WARNING] Dropped " << total_dropped - reported_dropped_
+                << " log records.\n";
+      reported_dropped_ = total_dropped;
+    }
+    if (!pending_.empty()) {
+      info.flush();
+    }
+  }
+
+  /**
+   * @brief Formats a record as one line, with the newline.
+   */
+  void format_line(const Record &record, Format line_format,
+                   std::string &line) const {
+    char field[64];
+    line.clear();
+    if (line_format == Format::Json) {
+      const double seconds =
+          std::chrono::duration<double>(record.time - start_).count();
+      std::snprintf(field, sizeof(field), "{\"time\":%.3f,\"level\":\"%s\"",
+                    seconds, level_name(record.level));
+      line += field;
+      if (record.job != 0) {
+        std::snprintf(field, sizeof(field), ",\"job\":%zu", record.job);
+        line += field;
+      }
+      if (record.stage[0] != '\0') {
+        line += ",\"stage\":";
+        append_json_string(record.stage, line);
+      }
+      if (record.frame >= 0) {
+        std::snprintf(field, sizeof(field), ",\"frame\":%lld",
+                      static_cast<long long>(record.frame));
+        line += field;
+      }
+      line += ",\"message\":";
+      append_json_string(record.message, line);
+      line += "}\n";
+      return;
+    }
+
+    line += level_tag(record.level);
+    line += ' ';
+    line += record.message;
+    if (record.job != 0) {
+      std::snprintf(field, sizeof(field), " job=%zu", record.job);
+      line += field;
+    }
+    if (record.stage[0] != '\0') {
+      line += " stage=\"";
+      line += record.stage;
+      line += '"';
+    }
+    if (record.frame >= 0) {
+      std::snprintf(field, sizeof(field), " frame=%lld",
+                    static_cast<long long>(record.frame));
+      line += field;
+    }
+    line += '\n';
+  }
+
+  /**
+   * @brief Appends text as a quoted JSON string.
+   */
+  static void append_json_string(const char *text, std::string &line) {
+    line += '"';
+    for (; *text; ++text) {
+      const unsigned char character = static_cast<unsigned char>(*text);
+      if (character == '"' || character == '\\') {
+        line += '\\';
+        line += static_cast<char>(character);
+      } else if (character < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+        line += escaped;
+      } else {
+        line += static_cast<char>(character);
+      }
+    }
+    line += '"';
+  }
+};
+
+/**
+ * @brief Maps an FFmpeg log level to a logger level.
+ */
+Level ffmpeg_level(int level) {
+  if (level <= AV_LOG_ERROR) {
+    return Level::Error;
+  }
+  if (level <= AV_LOG_WARNING) {
+    return Level::Warning;
+  }
+  if (level <= AV_LOG_INFO) {
+    return Level::Info;
+  }
+  return Level::Debug;
+}
+
+/**
+ * @brief The av_log() callback: formats the message with FFmpeg's prefix
+ * and logs it as one record.
+ */
+void log_ffmpeg_message(void *context, int level, const char *format,
+                        va_list args) {
+  if (level > av_log_get_level() || !enabled(ffmpeg_level(level))) {
+    return;
+  }
+
+  // FFmpeg may log a line in pieces; only the first gets the prefix
+  thread_local int print_prefix = 1;
+  char line[MAX_MESSAGE];
+  av_log_format_line2(context, level, format, args, line, sizeof(line),
+                      &print_prefix);
+  std::size_t length = std::strlen(line);
+  while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+    line[--length] = '\0';
+  }
+  if (length > 0) {
+    Message(ffmpeg_level(level)).stage("ffmpeg") << line;
+  }
+}
+} // namespace
+
+Level logging::parse_level(const std::string &name) {
+  if (name == "debug") {
+    return Level::Debug;
+  }
+  if (name == "info") {
+    return Level::Info;
+  }
+  if (name == "warning") {
+    return Level::Warning;
+  }
+  if (name == "error") {
+    return Level::Error;
+  }
+  throw std::invalid_argument("Unknown log level: " + name);
+}
+
+const char *logging::level_name(Level level) {
+  switch (level) {
+  case Level::Debug:
+    return "debug";
+  case Level::Info:
+    return "info";
+  case Level::Warning:
+    return "warning";
+  default:
+    return "error";
+  }
+}
+
+Format logging::parse_format(const std::string &name) {
+  if (name == "text") {
+    return Format::Text;
+  }
+  if (name == "json") {
+    return Format::Json;
+  }
+  throw std::invalid_argument("Unknown log format: " + name);
+}
+
+void logging::set_output(Output output) { log_output = output; }
+
+std::ostream &logging::info_stream() {
+  return log_output.load() == Output::Stderr ? std::cerr : std::cout;
+}
+
+void logging::set_level(Level level) { Logger::global().level = level; }
+
+void logging::set_format(Format format) { Logger::global().format = format; }
+
+bool logging::enabled(Level level) {
+  return level >= Logger::global().level.load(std::memory_order_relaxed);
+}
+
+void logging::set_thread_stage(const std::string &stage) {
+  const std::size_t length = std::min(stage.size(), MAX_STAGE - 1);
+  std::memcpy(thread_stage, stage.data(), length);
+  thread_stage[length] = '\0';
+}
+
+void logging::route_ffmpeg_logs() { av_log_set_callback(log_ffmpeg_message); }
+
+void logging::flush() { Logger::global().flush(); }
+
+std::size_t logging::dropped_records() { return Logger::global().dropped; }
+
+Message::Message(Level level) : record_(), length_(0), enabled_(false) {
+  enabled_ = enabled(level);
+  if (!enabled_) {
+    return;
+  }
+  record_.level = level;
+  record_.time = std::chrono::steady_clock::now();
+  record_.job = pipeline::TaskScheduler::current_job();
+  record_.frame = -1;
+  std::memcpy(record_.stage, thread_stage, MAX_STAGE);
+}
+
+Message::~Message() {
+  if (enabled_) {
+    Logger::global().submit(record_);
+  }
+}
+
+Message &Message::frame(std::int64_t index) {
+  record_.frame = index;
+  return *this;
+}
+
+Message &Message::stage(const char *name) {
+  if (enabled_) {
+    std::snprintf(record_.stage, MAX_STAGE, "%s", name);
+  }
+  return *this;
+}
+
+Message &Message::operator<<(const char *text) {
+  if (enabled_ && text) {
+    append(text, std::strlen(text));
+  }
+  return *this;
+}
+
+Message &Message::operator<<(const std::string &text) {
+  if (enabled_) {
+    append(text.data(), text.size());
+  }
+  return *this;
+}
+
+Message &Message::operator<<(char character) {
+  if (enabled_) {
+    append(&character, 1);
+  }
+  return *this;
+}
+
+Message &Message::operator<<(int value) {
+  return *this << static_cast<long long>(value);
+}
+
+Message &Message::operator<<(long value) {
+  return *this << static_cast<long long>(value);
+}
+
+Message &Message::operator<<(long long value) {
+  if (enabled_) {
+    char text[32];
+    const int length = std::snprintf(text, sizeof(text), "%lld", value);
+    append(text, static_cast<std::size_t>(length));
+  }
+  return *this;
+}
+
+Message &Message::operator<<(unsigned int value) {
+  return *this << static_cast<unsigned long long>(value);
+}
+
+Message &Message::operator<<(unsigned long value) {
+  return *this << static_cast<unsigned long long>(value);
+}
+
+Message &Message::operator<<(unsigned long long value) {
+  if (enabled_) {
+    char text[32];
+    const int length = std::snprintf(text, sizeof(text), "%llu", value);
+    append(text, static_cast<std::size_t>(length));
+  }
+  return *this;
+}
+
+Message &Message::operator<<(double value) {
+  if (enabled_) {
+    char text[32];
+    const int length = std::snprintf(text, sizeof(text), "%g", value);
+    append(text, static_cast<std::size_t>(length));
+  }
+  return *this;
+}
+
+void Message::append(const char *text, std::size_t length) {
+  length = std::min(length, MAX_MESSAGE - 1 - length_);
+  std::memcpy(record_.message + length_, text, length);
+  length_ += length;
+  record_.message[length_] = '\0';
+}
+
+Message logging::debug() { return Message(Level::Debug); }
+
+Message logging::info() { return Message(Level::Info); }
+
+Message logging::warning() { return Message(Level::Warning); }
+
+Message logging::error() { return Message(Level::Error); }
@@ -0,0 +1,268 @@
+#ifndef LOGGING_LOGGER
+#define LOGGING_LOGGER
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace logging {
+/**
+ * @brief How important a log record is.
+ */
+enum class Level {
+  Debug,   /**< Details for debugging. */
+  Info,    /**< Progress of a job. */
+  Warning, /**< Something went wrong, but the job goes on. */
+  Error,   /**< Something failed. */
+};
+
+/**
+ * @brief How log records are written.
+ */
+enum class Format {
+  Text, /**< "[LEVEL] message key=value...", one record per line. */
+  Json, /**< One JSON object per line. */
+};
+
+/**
+ * @brief Which streams records are written to.
+ */
+enum class Output {
+  Split,  /**< Warnings and errors to stderr, the rest to stdout. */
+  Stderr, /**< Every record to stderr, for when stdout carries a video. */
+};
+
+/** The longest stage name a record holds. */
+static const std::size_t MAX_STAGE = 32;
+/** The longest message a record holds; longer ones are cut short. */
+static const std::size_t MAX_MESSAGE = 256;
+
+/**
+ * @brief One log record, of a fixed size so it is copied into a ring buffer
+ * without allocating.
+ */
+struct Record {
+  Level level;                                /**< The level. */
+  std::chrono::steady_clock::time_point time; /**< When it was logged. */
+  std::size_t job;                            /**< The job, 0 for none. */
+  std::int64_t frame;         /**< The frame index, -1 for none. */
+  char stage[MAX_STAGE];      /**< The stage, empty for none. */
+  char message[MAX_MESSAGE];  /**< The message. */
+};
+
+/**
+ * @brief Parses the name of a log level.
+ * @param name "debug", "info", "warning" or "error".
+ * @return The level.
+ * @throws std::invalid_argument If the name is not a known level.
+ */
+Level parse_level(const std::string &name);
+
+/**
+ * @brief Gets the name of a log level.
+ * @param level The level.
+ * @return The name parse_level() accepts.
+ */
+const char *level_name(Level level);
+
+/**
+ * @brief Parses the name of a log format.
+ * @param name "text" or "json".
+ * @return The format.
+ * @throws std::invalid_argument If the name is not a known format.
+ */
+Format parse_format(const std::string &name);
+
+/**
+ * @brief Sets which streams records are written to. It does not start the
+ * logger, so call it before anything is logged: records already written to
+ * stdout stay there.
+ * @param output The streams.
+ */
+void set_output(Output output);
+
+/**
+ * @brief Gets the stream info records are written to, for text the user
+ * reads next to them, such as run reports.
+ * @return std::cout, or std::cerr if the output is Output::Stderr.
+ */
+std::ostream &info_stream();
+
+/**
+ * @brief Sets the lowest level that is logged.
+ * @param level The level.
+ */
+void set_level(Level level);
+
+/**
+ * @brief Sets how records are written.
+ * @param format The format.
+ */
+void set_format(Format format);
+
+/**
+ * @brief Checks if records of a level are logged.
+ * @param level The level.
+ * @return `true` if they are, `false` if they are dropped.
+ */
+bool enabled(Level level);
+
+/**
+ * @brief Sets the stage the records of the calling thread are logged for.
+ * @param stage The stage, cut short at MAX_STAGE - 1 characters.
+ */
+void set_thread_stage(const std::string &stage);
+
+/**
+ * @brief Routes the messages FFmpeg logs through av_log() into the logger,
+ * at FFmpeg's own log level.
+ */
+void route_ffmpeg_logs();
+
+/**
+ * @brief Writes every record logged so far, and returns once they are
+ * written.
+ */
+void flush();
+
+/**
+ * @brief Gets the records dropped because a thread's ring buffer was full.
+ * @return The number of records dropped.
+ */
+std::size_t dropped_records();
+
+/**
+ * @brief A record being built. It is handed to the calling thread's ring
+ * buffer when destroyed, which never blocks: the record is dropped if the
+ * buffer is full. Records are tagged with the calling thread's job and
+ * stage.
+ */
+class Message {
+public:
+  /**
+   * @brief Constructs a Message object.
+   * @param level The level. Nothing is formatted if it is not logged.
+   */
+  explicit Message(Level level);
+
+  /**
+   * @brief Hands the record to the calling thread's ring buffer.
+   */
+  ~Message();
+
+  Message(const Message &) = delete;
+  Message &operator=(const Message &) = delete;
+
+  /**
+   * @brief Tags the record with a frame index.
+   * @param index The index.
+   * @return This message.
+   */
+  Message &frame(std::int64_t index);
+
+  /**
+   * @brief Tags the record with a stage other than the thread's.
+   * @param name The stage.
+   * @return This message.
+   */
+  Message &stage(const char *name);
+
+  /**
+   * @brief Appends text to the message.
+   * @param text The text.
+   * @return This message.
+   */
+  Message &operator<<(const char *text);
+
+  /**
+   * @brief Appends text to the message.
+   * @param text The text.
+   * @return This message.
+   */
+  Message &operator<<(const std::string &text);
+
+  /**
+   * @brief Appends a character to the message.
+   * @param character The character.
+   * @return This message.
+   */
+  Message &operator<<(char character);
+
+  /**
+   * @brief Appends a number to the message.
+   * @param value The number.
+   * @return This message.
+   */
+  Message &operator<<(int value);
+
+  /**
+   * @copydoc operator<<(int)
+   */
+  Message &operator<<(long value);
+
+  /**
+   * @copydoc operator<<(int)
+   */
+  Message &operator<<(long long value);
+
+  /**
+   * @copydoc operator<<(int)
+   */
+  Message &operator<<(unsigned int value);
+
+  /**
+   * @copydoc operator<<(int)
+   */
+  Message &operator<<(unsigned long value);
+
+  /**
+   * @copydoc operator<<(int)
+   */
+  Message &operator<<(unsigned long long value);
+
+  /**
+   * @copydoc operator<<(int)
+   */
+  Message &operator<<(double value);
+
+private:
+  Record record_;      /**< The record. */
+  std::size_t length_; /**< The length of the message so far. */
+  bool enabled_;       /**< Whether the level is logged. */
+
+  /**
+   * @brief Appends characters to the message, cutting them short if the
+   * record is full.
+   * @param text The characters.
+   * @param length The number of characters.
+   */
+  void append(const char *text, std::size_t length);
+};
+
+/**
+ * @brief Starts a debug record.
+ * @return The message.
+ */
+Message debug();
+
+/**
+ * @brief Starts an info record.
+ * @return The message.
+ */
+Message info();
+
+/**
+ * @brief Starts a warning record.
+ * @return The message.
+ */
+Message warning();
+
+/**
+ * @brief Starts an error record.
+ * @return The message.
+ */
+Message error();
+} // namespace logging
+#endif
@@ -0,0 +1,77 @@
+#include "batch_manifest.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace pipeline;
+
+namespace {
+/**
+ * @brief Applies one `key=value` setting to a job.
+ * @throws std::invalid_argument If the setting is not known or valid.
+ */
+void apply_setting(BatchJob &job, const std::string &setting) {
+  const std::size_t equals = setting.find('=');
+  if (equals == std::string::npos) {
+    throw std::invalid_argument("Expected key=value: " + setting);
+  }
+  const std::string key = setting.substr(0, equals);
+  const std::string value = setting.substr(equals + 1);
+
+  if (key == "placement") {
+    job.placement = parse_placement_policy(value);
+    job.has_placement = true;
+  } else if (key == "numa-node") {
+    std::size_t end = 0;
+    try {
+      job.numa_node = std::stoi(value, &end);
+    } catch (const std::logic_error &) {
+      end = 0;
+    }
+    if (end == 0 || end != value.size() || job.numa_node < 0) {
+      throw std::invalid_argument("Invalid NUMA node: " + value);
+    }
+  } else {
+    throw std::invalid_argument("Unknown setting: " + key);
+  }
+}
+} // namespace
+
+std::vector<BatchJob> pipeline::read_batch_manifest(const std::string &path) {
+  std::ifstream manifest_file(path);
+  if (!manifest_file) {
+    throw std::invalid_argument("Failed to read the batch manifest " + path);
+  }
+
+  std::vector<BatchJob> jobs;
+  std::string line;
+  for (int line_number = 1; std::getline(manifest_file, line);
+       ++line_number) {
+    // STEP 1: Skip blank lines and comments
+    std::istringstream fields(line);
+    std::string first;
+    if (!(fields >> first) || first[0] == '#') {
+      continue;
+    }
+
+    // STEP 2: Read the paths, then the settings
+    BatchJob job;
+    job.video_path1 = first;
+    try {
+      if (!(fields >> job.video_path2 >> job.output_path)) {
+        throw std::invalid_argument(
+            "Expected two input paths and an output path");
+      }
+      std::string setting;
+      while (fields >> setting) {
+        apply_setting(job, setting);
+      }
+    } catch (const std::invalid_argument &e) {
+      throw std::invalid_argument(path + ":" + std::to_string(line_number) +
+                                  ": " + e.what());
+    }
+    jobs.push_back(job);
+  }
+  return jobs;
+}
@@ -0,0 +1,36 @@
+#ifndef PIPELINE_BATCH_MANIFEST
+#define PIPELINE_BATCH_MANIFEST
+
+#include "placement.hpp"
+#include <string>
+#include <vector>
+
+namespace pipeline {
+/**
+ * @brief One job of a batch manifest.
+ */
+struct BatchJob {
+  std::string video_path1; /**< The path to the first video. */
+  std::string video_path2; /**< The path to the second video. */
+  std::string output_path; /**< The path to the output video. */
+  bool has_placement = false; /**< Whether the job sets its own policy. */
+  PlacementPolicy placement =
+      PlacementPolicy::None; /**< The policy, if `has_placement`. */
+  int numa_node = -1; /**< The node to run on, -1 for the least loaded. */
+};
+
+/**
+ * @brief Reads a batch manifest.
+ *
+ * Every line is one job: the two input paths and the output path,
+ * separated by whitespace, then optional settings such as
+ * `placement=node` or `numa-node=1`. Blank lines and lines starting with
+ * `#` are skipped. Paths cannot contain whitespace.
+ * @param path The path to the manifest.
+ * @return The jobs, in the order they are listed.
+ * @throws std::invalid_argument If the manifest cannot be read or a line
+ * is not a valid job.
+ */
+std::vector<BatchJob> read_batch_manifest(const std::string &path);
+} // namespace pipeline
+#endif
@@ -0,0 +1,283 @@
+#include "frame_allocator.hpp"
+#include "../logging/logger.hpp"
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+using namespace pipeline;
+
+/** The alignment of every line of a pooled frame, enough for AVX-512. */
+static const int BUFFER_ALIGN = 64;
+/** The padding after the last plane that SIMD readers may overrun into. */
+static const std::size_t BUFFER_PADDING = 16 + BUFFER_ALIGN - 1;
+
+namespace {
+/**
+ * @brief Rounds a size up to a multiple of a power of two.
+ */
+std::size_t align_up(std::size_t size, std::size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @brief Maps anonymous memory aligned to a huge page and advises the kernel
+ * to back it with transparent huge pages.
+ * @return The mapping, or `MAP_FAILED`.
+ */
+void *map_transparent(std::size_t length) {
+  // STEP 1: Over-allocate by a huge page so an aligned start fits
+  void *raw = mmap(nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+
+  // STEP 2: Unmap the unaligned head and the tail
+  const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw);
+  const std::uintptr_t aligned = align_up(start, HUGE_PAGE_SIZE);
+  if (aligned > start) {
+    munmap(raw, aligned - start);
+  }
+  const std::size_t tail = start + HUGE_PAGE_SIZE - aligned;
+  if (tail > 0) {
+    munmap(reinterpret_cast<void *>(aligned + length), tail);
+  }
+
+  // STEP 3: Ask for huge pages. Kernels without THP ignore the advice.
+  void *data = reinterpret_cast<void *>(aligned);
+  madvise(data, length, MADV_HUGEPAGE);
+  return data;
+}
+
+/**
+ * @brief Prefers a NUMA node for the pages of a mapping that was not
+ * touched yet. Single-node systems and kernels without NUMA ignore it.
+ */
+void bind_to_node(void *data, std::size_t length, int node) {
+  if (node < 0) {
+    return;
+  }
+  const std::size_t bits = sizeof(unsigned long) * CHAR_BIT;
+  std::vector<unsigned long> mask(node / bits + 1, 0);
+  mask[node / bits] |= 1UL << (node % bits);
+  syscall(SYS_mbind, data, length, MPOL_PREFERRED, mask.data(),
+          mask.size() * bits + 1, 0);
+}
+} // namespace
+
+PageMode pipeline::parse_page_mode(const std::string &name) {
+  if (name == "default") {
+    return PageMode::Default;
+  }
+  if (name == "thp") {
+    return PageMode::Transparent;
+  }
+  if (name == "hugetlb") {
+    return PageMode::Explicit;
+  }
+  throw std::invalid_argument("Unknown page mode: " + name);
+}
+
+const char *pipeline::page_mode_name(PageMode mode) {
+  switch (mode) {
+  case PageMode::Transparent:
+    return "thp";
+  case PageMode::Explicit:
+    return "hugetlb";
+  default:
+    return "default";
+  }
+}
+
+int pipeline::current_numa_node() {
+  unsigned int cpu = 0;
+  unsigned int node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return -1;
+  }
+  return static_cast<int>(node);
+}
+
+FrameAllocator::FrameAllocator(PageMode mode, int numa_node)
+    : mode_(mode), numa_node_(numa_node >= 0 ? numa_node : current_numa_node()),
+      mapped_bytes_(0), fallbacks_(0), pools_(), mutex_() {}
+
+FrameAllocator::~FrameAllocator() {
+  for (auto &pool : pools_) {
+    av_buffer_pool_uninit(&pool.second);
+  }
+}
+
+PageMode FrameAllocator::mode() const { return mode_; }
+
+int FrameAllocator::numa_node() const { return numa_node_; }
+
+std::size_t FrameAllocator::mapped_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return mapped_bytes_;
+}
+
+std::size_t FrameAllocator::fallbacks() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return fallbacks_;
+}
+
+bool FrameAllocator::get_buffer(AVFrame *frame) {
+  if (mode_ != PageMode::Default && fill_buffer(frame, BUFFER_ALIGN)) {
+    return true;
+  }
+  return av_frame_get_buffer(frame, 32) >= 0;
+}
+
+void FrameAllocator::attach(AVCodecContext *codec_context) {
+  if (mode_ == PageMode::Default || !codec_context) {
+    return;
+  }
+  codec_context->opaque = this;
+  codec_context->get_buffer2 = get_buffer2;
+}
+
+bool FrameAllocator::fill_buffer(AVFrame *frame, int align) {
+  // STEP 1: Leave paletted and hardware frames to FFmpeg
+  const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+  const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(format);
+  if (!descriptor ||
+      (descriptor->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL))) {
+    return false;
+  }
+
+  // STEP 2: Lay the planes out with aligned lines
+  int linesizes[4] = {0, 0, 0, 0};
+  if (av_image_fill_linesizes(linesizes, format,
+                              static_cast<int>(align_up(frame->width,
+                                                        align))) < 0) {
+    return false;
+  }
+  ptrdiff_t strides[4];
+  for (int plane = 0; plane < 4; ++plane) {
+    linesizes[plane] = static_cast<int>(align_up(linesizes[plane], align));
+    strides[plane] = linesizes[plane];
+  }
+  std::size_t sizes[4] = {0, 0, 0, 0};
+  if (av_image_fill_plane_sizes(sizes, format, frame->height, strides) < 0) {
+    return false;
+  }
+  std::size_t total = BUFFER_PADDING;
+  for (std::size_t size : sizes) {
+    total += size;
+  }
+
+  // STEP 3: Take a buffer from the pool of that size
+  AVBufferPool *pool = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AVBufferPool *&slot_pool = pools_[total];
+    if (!slot_pool) {
+      PoolSlot *slot = new PoolSlot{this, total};
+      slot_pool = av_buffer_pool_init2(total, slot, allocate, free_pool);
+      if (!slot_pool) {
+        delete slot;
+        pools_.erase(total);
+        logging::error() << "Failed to create the frame pool.";
+        return false;
+      }
+    }
+    pool = slot_pool;
+  }
+  AVBufferRef *buffer = av_buffer_pool_get(pool);
+  if (!buffer) {
+    return false;
+  }
+
+  // STEP 4: Point the planes into it
+  frame->buf[0] = buffer;
+  std::size_t offset = 0;
+  for (int plane = 0; plane < 4 && sizes[plane] > 0; ++plane) {
+    frame->data[plane] = buffer->data + offset;
+    frame->linesize[plane] = linesizes[plane];
+    offset += sizes[plane];
+  }
+  frame->extended_data = frame->data;
+  return true;
+}
+
+AVBufferRef *FrameAllocator::allocate(void *opaque, std::size_t size) {
+  PoolSlot *slot = static_cast<PoolSlot *>(opaque);
+  FrameAllocator *allocator = slot->allocator;
+  const std::size_t length = align_up(size, HUGE_PAGE_SIZE);
+
+  // STEP 1: Map reserved huge pages, or transparent ones if there are none
+  // left
+  void *data = MAP_FAILED;
+  bool fell_back = false;
+  if (allocator->mode_ == PageMode::Explicit) {
+    data = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    fell_back = data == MAP_FAILED;
+  }
+  if (data == MAP_FAILED) {
+    data = map_transparent(length);
+  }
+  if (data == MAP_FAILED) {
+    logging::error() << "Failed to map a frame buffer.";
+    return nullptr;
+  }
+
+  // STEP 2: Place the pages on the consumer's node before they are touched
+  bind_to_node(data, length, allocator->numa_node_);
+
+  // STEP 3: Wrap the mapping
+  AVBufferRef *buffer = av_buffer_create(static_cast<std::uint8_t *>(data),
+                                         size, release, slot, 0);
+  if (!buffer) {
+    munmap(data, length);
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(allocator->mutex_);
+  allocator->mapped_bytes_ += length;
+  allocator->fallbacks_ += fell_back ? 1 : 0;
+  return buffer;
+}
+
+void FrameAllocator::release(void *opaque, std::uint8_t *data) {
+  const PoolSlot *slot = static_cast<const PoolSlot *>(opaque);
+  munmap(data, align_up(slot->size, HUGE_PAGE_SIZE));
+}
+
+void FrameAllocator::free_pool(void *opaque) {
+  delete static_cast<PoolSlot *>(opaque);
+}
+
+int FrameAllocator::get_buffer2(AVCodecContext *codec_context, AVFrame *frame,
+                                int flags) {
+  // STEP 1: Only decoders that accept caller buffers can use the pools
+  FrameAllocator *allocator =
+      static_cast<FrameAllocator *>(codec_context->opaque);
+  if (!allocator || !codec_context->codec ||
+      !(codec_context->codec->capabilities & AV_CODEC_CAP_DR1)) {
+    return avcodec_default_get_buffer2(codec_context, frame, flags);
+  }
+
+  // STEP 2: Allocate the padded size the decoder writes into, and keep the
+  // visible size on the frame
+  const int width = frame->width;
+  const int height = frame->height;
+  int linesize_align[AV_NUM_DATA_POINTERS];
+  avcodec_align_dimensions2(codec_context, &frame->width, &frame->height,
+                            linesize_align);
+  const bool filled = allocator->fill_buffer(frame, BUFFER_ALIGN);
+  frame->width = width;
+  frame->height = height;
+  return filled ? 0 : avcodec_default_get_buffer2(codec_context, frame, flags);
+}
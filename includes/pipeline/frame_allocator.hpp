@@ -0,0 +1,172 @@
+#ifndef PIPELINE_FRAME_ALLOCATOR
+#define PIPELINE_FRAME_ALLOCATOR
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+}
+
+namespace pipeline {
+/** The size of a huge page on x86-64 and arm64. */
+static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * @brief The pages frame buffers are backed by.
+ */
+enum class PageMode {
+  Default,     /**< av_frame_get_buffer() and the decoder's own pools. */
+  Transparent, /**< Anonymous mappings advised to use transparent huge
+                    pages. */
+  Explicit,    /**< Pages reserved in the hugetlbfs pool, falling back to
+                    transparent huge pages when the pool is empty. */
+};
+
+/**
+ * @brief Parses the name of a page mode.
+ * @param name "default", "thp" or "hugetlb".
+ * @return The page mode.
+ * @throws std::invalid_argument If the name is not a known mode.
+ */
+PageMode parse_page_mode(const std::string &name);
+
+/**
+ * @brief Gets the name of a page mode.
+ * @param mode The page mode.
+ * @return The name parse_page_mode() accepts.
+ */
+const char *page_mode_name(PageMode mode);
+
+/**
+ * @brief Gets the NUMA node of the CPU the calling thread runs on.
+ * @return The node, or -1 if it is not known.
+ */
+int current_numa_node();
+
+/**
+ * @brief Allocates frame buffers on huge pages of one NUMA node.
+ *
+ * A 1080p YUV420P frame is 3 MB, so with 4 KB pages every frame touched by
+ * a blend or a scale walks hundreds of TLB entries. The allocator maps
+ * buffers in 2 MB huge pages, binds them to the node of the thread that
+ * consumes the frames, and keeps them in one AVBufferPool per buffer size
+ * so steady-state frames reuse mappings instead of faulting new ones.
+ *
+ * Frames may outlive the allocator: each pool is freed once its last
+ * buffer is returned. Buffers are requested from any thread.
+ */
+class FrameAllocator {
+public:
+  /**
+   * @brief Constructs a FrameAllocator object.
+   * @param mode The pages buffers are backed by.
+   * @param numa_node The node buffers are bound to, -1 for the node of the
+   * calling thread, which should be the one consuming the frames.
+   */
+  explicit FrameAllocator(PageMode mode, int numa_node = -1);
+
+  /**
+   * @brief Destroys the FrameAllocator object. Pools with buffers still in
+   * use are freed when the last one is returned.
+   */
+  ~FrameAllocator();
+
+  FrameAllocator(const FrameAllocator &) = delete;
+  FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+  /**
+   * @brief Gets the page mode.
+   * @return The pages buffers are backed by.
+   */
+  PageMode mode() const;
+
+  /**
+   * @brief Gets the NUMA node buffers are bound to.
+   * @return The node, or -1 if buffers are not bound.
+   */
+  int numa_node() const;
+
+  /**
+   * @brief Gets the bytes mapped for buffers so far, including buffers
+   * that were returned to the pools.
+   * @return The number of bytes.
+   */
+  std::size_t mapped_bytes() const;
+
+  /**
+   * @brief Gets the number of buffers that wanted reserved huge pages but
+   * fell back to transparent ones.
+   * @return The number of buffers.
+   */
+  std::size_t fallbacks() const;
+
+  /**
+   * @brief Allocates the buffer of a video frame, like
+   * av_frame_get_buffer().
+   * @param frame The frame, with its format, width and height set.
+   * @return `true` if the buffer was allocated, `false` otherwise.
+   */
+  bool get_buffer(AVFrame *frame);
+
+  /**
+   * @brief Makes a decoder allocate its frames through the allocator. Must
+   * be called before decoding starts, and the allocator must outlive the
+   * decoder.
+   * @param codec_context The opened decoder.
+   */
+  void attach(AVCodecContext *codec_context);
+
+private:
+  /**
+   * @brief The buffer size and allocator of one pool, freed with the pool.
+   */
+  struct PoolSlot {
+    FrameAllocator *allocator; /**< The allocator, only used to allocate. */
+    std::size_t size;          /**< The size of the buffers. */
+  };
+
+  PageMode mode_; /**< The pages buffers are backed by. */
+  int numa_node_; /**< The node buffers are bound to, -1 for none. */
+  std::size_t mapped_bytes_; /**< The bytes mapped so far. */
+  std::size_t fallbacks_;    /**< Buffers that fell back to THP. */
+  std::map<std::size_t, AVBufferPool *>
+      pools_; /**< The pools, by buffer size. */
+  mutable std::mutex mutex_; /**< Guards the pools and the counters. */
+
+  /**
+   * @brief Lays out the planes of a frame in one pooled buffer.
+   * @param frame The frame, with its format and allocated size set.
+   * @param align The alignment of every line.
+   * @return `true` if the buffer was allocated, `false` otherwise.
+   */
+  bool fill_buffer(AVFrame *frame, int align);
+
+  /**
+   * @brief Maps a buffer, for AVBufferPool.
+   */
+  static AVBufferRef *allocate(void *opaque, std::size_t size);
+
+  /**
+   * @brief Unmaps a buffer, for AVBufferRef.
+   */
+  static void release(void *opaque, std::uint8_t *data);
+
+  /**
+   * @brief Frees the slot of a pool, for AVBufferPool.
+   */
+  static void free_pool(void *opaque);
+
+  /**
+   * @brief Allocates a decoded frame, for AVCodecContext::get_buffer2.
+   */
+  static int get_buffer2(AVCodecContext *codec_context, AVFrame *frame,
+                         int flags);
+};
+} // namespace pipeline
+#endif
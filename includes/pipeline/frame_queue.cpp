@@ -0,0 +1,90 @@
+#include "frame_queue.hpp"
+#include <mutex>
+
+using namespace pipeline;
+
+FrameQueue::FrameQueue(MemoryBudget &budget, std::size_t max_frames)
+    : budget_(budget), max_frames_(max_frames > 0 ? max_frames : 1), frames_(),
+      closed_(false) {}
+
+FrameQueue::~FrameQueue() {
+  std::lock_guard<std::mutex> lock(budget_.mutex_);
+  for (auto &entry : frames_) {
+    budget_.in_flight_ -= entry.second;
+    av_frame_free(&entry.first);
+  }
+  frames_.clear();
+}
+
+bool FrameQueue::push(AVFrame *frame) {
+  const std::size_t bytes = frame_bytes(frame);
+  std::unique_lock<std::mutex> lock(budget_.mutex_);
+
+  // STEP 1: Wait until the queue and the budget have room for the frame
+  auto has_room = [&] {
+    if (closed_) {
+      return true;
+    }
+    if (frames_.size() >= max_frames_) {
+      return false;
+    }
+    return frames_.empty() ||
+           budget_.in_flight_ + bytes <= budget_.capacity_;
+  };
+
+  if (!has_room()) {
+    budget_.stalls_ += 1;
+    budget_.changed_.wait(lock, has_room);
+  }
+
+  // STEP 2: Drop the frame if the consumer has gone away
+  if (closed_) {
+    lock.unlock();
+    av_frame_free(&frame);
+    return false;
+  }
+
+  // STEP 3: Charge the budget and queue the frame
+  budget_.in_flight_ += bytes;
+  budget_.frames_ += 1;
+  if (budget_.in_flight_ > budget_.peak_) {
+    budget_.peak_ = budget_.in_flight_;
+  }
+  frames_.emplace_back(frame, bytes);
+
+  lock.unlock();
+  budget_.changed_.notify_all();
+  return true;
+}
+
+AVFrame *FrameQueue::pop() {
+  std::unique_lock<std::mutex> lock(budget_.mutex_);
+
+  // STEP 1: Wait for a frame or for the producer to finish
+  budget_.changed_.wait(lock, [&] { return !frames_.empty() || closed_; });
+  if (frames_.empty()) {
+    return nullptr;
+  }
+
+  // STEP 2: Refund the budget and hand the frame to the caller
+  auto entry = frames_.front();
+  frames_.pop_front();
+  budget_.in_flight_ -= entry.second;
+
+  lock.unlock();
+  budget_.changed_.notify_all();
+  return entry.first;
+}
+
+void FrameQueue::close() {
+  {
+    std::lock_guard<std::mutex> lock(budget_.mutex_);
+    closed_ = true;
+  }
+  budget_.changed_.notify_all();
+}
+
+std::size_t FrameQueue::size() const {
+  std::lock_guard<std::mutex> lock(budget_.mutex_);
+  return frames_.size();
+}
@@ -0,0 +1,74 @@
+#ifndef PIPELINE_FRAME_QUEUE
+#define PIPELINE_FRAME_QUEUE
+
+#include "memory_budget.hpp"
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace pipeline {
+/**
+ * @brief Bounded queue of decoded frames between two pipeline stages.
+ *
+ * Pushing blocks while the queue is full or while the shared MemoryBudget has
+ * no room for the frame, which stalls the producing stage until the consumer
+ * catches up. An empty queue always accepts one frame so that a consumer
+ * waiting on it can make progress even if other queues hold the whole budget.
+ */
+class FrameQueue {
+public:
+  /**
+   * @brief Constructs a FrameQueue object.
+   * @param budget The memory budget charged for queued frames.
+   * @param max_frames The maximum number of queued frames.
+   */
+  FrameQueue(MemoryBudget &budget, std::size_t max_frames = 8);
+
+  /**
+   * @brief Destroys the FrameQueue object and frees any queued frames.
+   */
+  ~FrameQueue();
+
+  FrameQueue(const FrameQueue &) = delete;
+  FrameQueue &operator=(const FrameQueue &) = delete;
+
+  /**
+   * @brief Pushes a frame, blocking until there is room for it.
+   * @param frame The frame to push. The queue takes ownership of it.
+   * @return `true` if the frame was queued, `false` if the queue was closed
+   * (the frame is freed in that case).
+   */
+  bool push(AVFrame *frame);
+
+  /**
+   * @brief Pops a frame, blocking until one is available.
+   * @return The oldest frame (owned by the caller), or `nullptr` once the
+   * queue is closed and drained.
+   */
+  AVFrame *pop();
+
+  /**
+   * @brief Closes the queue. Pending frames can still be popped, but further
+   * pushes fail.
+   */
+  void close();
+
+  /**
+   * @brief Gets the number of queued frames.
+   * @return The number of queued frames.
+   */
+  std::size_t size() const;
+
+private:
+  MemoryBudget &budget_;  /**< The budget charged for queued frames. */
+  std::size_t max_frames_; /**< The maximum number of queued frames. */
+  std::deque<std::pair<AVFrame *, std::size_t>>
+      frames_;  /**< The queued frames and their sizes in bytes. */
+  bool closed_; /**< Whether the queue has been closed. */
+};
+} // namespace pipeline
+#endif
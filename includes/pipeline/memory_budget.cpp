@@ -0,0 +1,127 @@
+#include "memory_budget.hpp"
+#include <cctype>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+using namespace pipeline;
+
+MemoryBudget::MemoryBudget(std::size_t capacity)
+    : capacity_(capacity), in_flight_(0), peak_(0), stalls_(0), frames_(0),
+      held_(0), peak_held_(0), mutex_(), changed_() {}
+
+std::size_t MemoryBudget::capacity() const { return capacity_; }
+
+std::size_t MemoryBudget::in_flight() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return in_flight_;
+}
+
+std::size_t MemoryBudget::peak() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return peak_;
+}
+
+std::size_t MemoryBudget::stalls() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stalls_;
+}
+
+std::size_t MemoryBudget::frames() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frames_;
+}
+
+void MemoryBudget::hold(std::size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  in_flight_ += bytes;
+  held_ += bytes;
+  if (in_flight_ > peak_) {
+    peak_ = in_flight_;
+  }
+  if (held_ > peak_held_) {
+    peak_held_ = held_;
+  }
+}
+
+void MemoryBudget::release(std::size_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_ -= bytes;
+    held_ -= bytes;
+  }
+  changed_.notify_all();
+}
+
+std::size_t MemoryBudget::peak_held() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return peak_held_;
+}
+
+std::size_t pipeline::frame_bytes(const AVFrame *frame) {
+  std::size_t bytes = 0;
+  for (const AVBufferRef *buf : frame->buf) {
+    if (buf) {
+      bytes += buf->size;
+    }
+  }
+  return bytes;
+}
+
+std::size_t pipeline::parse_byte_size(const std::string &text) {
+  // STEP 1: Parse the numeric part
+  std::size_t consumed = 0;
+  double value = 0.0;
+  try {
+    value = std::stod(text, &consumed);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid byte size: " + text);
+  }
+
+  if (value < 0.0) {
+    throw std::invalid_argument("Invalid byte size: " + text);
+  }
+
+  // STEP 2: Apply the unit suffix, if any
+  std::string suffix = text.substr(consumed);
+  double multiplier = 1.0;
+  if (suffix.empty() || suffix == "B") {
+    multiplier = 1.0;
+  } else {
+    switch (std::toupper(static_cast<unsigned char>(suffix[0]))) {
+    case 'K':
+      multiplier = 1024.0;
+      break;
+    case 'M':
+      multiplier = 1024.0 * 1024.0;
+      break;
+    case 'G':
+      multiplier = 1024.0 * 1024.0 * 1024.0;
+      break;
+    default:
+      throw std::invalid_argument("Invalid byte size: " + text);
+    }
+
+    std::string rest = suffix.substr(1);
+    if (!rest.empty() && rest != "B" && rest != "iB") {
+      throw std::invalid_argument("Invalid byte size: " + text);
+    }
+  }
+
+  return static_cast<std::size_t>(value * multiplier);
+}
+
+std::string pipeline::format_byte_size(std::size_t bytes) {
+  static const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+
+  double value = static_cast<double>(bytes);
+  unsigned int unit = 0;
+  while (value >= 1024.0 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+    value /= 1024.0;
+    unit += 1;
+  }
+
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.1f %s", value, units[unit]);
+  return buffer;
+}
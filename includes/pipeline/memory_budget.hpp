@@ -0,0 +1,119 @@
+#ifndef PIPELINE_MEMORY_BUDGET
+#define PIPELINE_MEMORY_BUDGET
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace pipeline {
+/**
+ * @brief Per-job limit on the number of frame bytes held between stages.
+ *
+ * A budget is shared by every FrameQueue of a job. Queues charge the budget
+ * when a frame is pushed and refund it when the frame is popped, so the
+ * counters always describe the bytes that are queued between stages, plus
+ * the bytes a stage holds back through hold().
+ */
+class MemoryBudget {
+public:
+  /**
+   * @brief Constructs a MemoryBudget object.
+   * @param capacity The maximum number of bytes that may be in flight.
+   */
+  explicit MemoryBudget(std::size_t capacity);
+
+  MemoryBudget(const MemoryBudget &) = delete;
+  MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+  /**
+   * @brief Gets the configured capacity.
+   * @return The maximum number of bytes that may be in flight.
+   */
+  std::size_t capacity() const;
+
+  /**
+   * @brief Gets the number of bytes currently in flight.
+   * @return The number of bytes held by the queues of this budget.
+   */
+  std::size_t in_flight() const;
+
+  /**
+   * @brief Gets the highest number of bytes that were in flight at once.
+   * @return The peak number of bytes held by the queues of this budget.
+   */
+  std::size_t peak() const;
+
+  /**
+   * @brief Gets the number of pushes that had to wait for memory.
+   * @return The number of backpressure stalls.
+   */
+  std::size_t stalls() const;
+
+  /**
+   * @brief Gets the number of frames that went through the budget.
+   * @return The number of frames pushed by all queues.
+   */
+  std::size_t frames() const;
+
+  /**
+   * @brief Charges bytes a stage holds outside any queue, such as frames
+   * held back for a crossfade. It never blocks: the queues wait for the
+   * bytes to be released instead.
+   * @param bytes The number of bytes.
+   */
+  void hold(std::size_t bytes);
+
+  /**
+   * @brief Refunds bytes charged by hold().
+   * @param bytes The number of bytes.
+   */
+  void release(std::size_t bytes);
+
+  /**
+   * @brief Gets the highest number of bytes that were held at once.
+   * @return The peak number of bytes charged by hold().
+   */
+  std::size_t peak_held() const;
+
+private:
+  friend class FrameQueue;
+
+  std::size_t capacity_;  /**< The maximum number of bytes in flight. */
+  std::size_t in_flight_; /**< The number of bytes in flight. */
+  std::size_t peak_;      /**< The peak number of bytes in flight. */
+  std::size_t stalls_;    /**< The number of pushes that had to wait. */
+  std::size_t frames_;    /**< The number of frames pushed. */
+  std::size_t held_;      /**< The bytes held outside the queues. */
+  std::size_t peak_held_; /**< The peak bytes held outside the queues. */
+  mutable std::mutex mutex_; /**< Guards the budget and its queues. */
+  std::condition_variable changed_; /**< Signalled on every queue change. */
+};
+
+/**
+ * @brief Gets the number of bytes referenced by a frame.
+ * @param frame The frame to measure.
+ * @return The total size of the buffers backing the frame.
+ */
+std::size_t frame_bytes(const AVFrame *frame);
+
+/**
+ * @brief Parses a human readable byte size such as "512M" or "2G".
+ * @param text The size to parse. The suffixes K, M and G are powers of 1024.
+ * @return The number of bytes.
+ * @throws std::invalid_argument If the text is not a valid size.
+ */
+std::size_t parse_byte_size(const std::string &text);
+
+/**
+ * @brief Formats a byte count as a human readable string such as "3.0 MiB".
+ * @param bytes The number of bytes.
+ * @return The formatted string.
+ */
+std::string format_byte_size(std::size_t bytes);
+} // namespace pipeline
+#endif
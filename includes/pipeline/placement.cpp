@@ -0,0 +1,225 @@
+#include "placement.hpp"
+#include "../logging/logger.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <dirent.h>
+#include <sched.h>
+
+using namespace pipeline;
+
+/** The directory the kernel lists the NUMA nodes in. */
+static const std::string NODE_DIR = "/sys/devices/system/node";
+
+namespace {
+/**
+ * @brief Gets the CPUs in the affinity mask of the process.
+ */
+std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return cpus;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+/**
+ * @brief Parses a non-negative CPU or node number.
+ */
+int parse_index(const std::string &text, const std::string &list) {
+  std::size_t end = 0;
+  int value = -1;
+  try {
+    value = std::stoi(text, &end);
+  } catch (const std::logic_error &) {
+    end = 0;
+  }
+  if (end == 0 || end != text.size() || value < 0) {
+    throw std::invalid_argument("Invalid CPU list: " + list);
+  }
+  return value;
+}
+} // namespace
+
+PlacementPolicy pipeline::parse_placement_policy(const std::string &name) {
+  if (name == "none") {
+    return PlacementPolicy::None;
+  }
+  if (name == "node") {
+    return PlacementPolicy::Node;
+  }
+  throw std::invalid_argument("Unknown placement policy: " + name);
+}
+
+std::vector<int> pipeline::parse_cpu_list(const std::string &text) {
+  std::vector<int> cpus;
+  std::stringstream ranges(text);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    const std::size_t dash = range.find('-');
+    const int first = parse_index(range.substr(0, dash), text);
+    const int last = dash == std::string::npos
+                         ? first
+                         : parse_index(range.substr(dash + 1), text);
+    if (last < first) {
+      throw std::invalid_argument("Invalid CPU list: " + text);
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::string pipeline::format_cpu_list(const std::vector<int> &cpus) {
+  std::ostringstream list;
+  for (std::size_t i = 0; i < cpus.size();) {
+    // Collapse every run of consecutive CPUs into a range
+    std::size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+      ++j;
+    }
+    list << (i > 0 ? "," : "") << cpus[i];
+    if (j > i) {
+      list << "-" << cpus[j];
+    }
+    i = j + 1;
+  }
+  return list.str();
+}
+
+NumaTopology NumaTopology::detect() {
+  NumaTopology topology;
+  const std::vector<int> allowed = allowed_cpus();
+
+  // STEP 1: Read the CPUs of every node directory
+  if (DIR *directory = opendir(NODE_DIR.c_str())) {
+    while (const dirent *entry = readdir(directory)) {
+      const std::string name = entry->d_name;
+      if (name.size() < 5 || name.compare(0, 4, "node") != 0 ||
+          name.find_first_not_of("0123456789", 4) != std::string::npos) {
+        continue;
+      }
+      std::ifstream cpulist_file(NODE_DIR + "/" + name + "/cpulist");
+      std::string cpulist;
+      std::getline(cpulist_file, cpulist);
+
+      // STEP 2: Keep the CPUs the process may run on. Nodes without any,
+      // such as memory-only nodes, are skipped.
+      std::vector<int> cpus;
+      try {
+        for (int cpu : parse_cpu_list(cpulist)) {
+          if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+            cpus.push_back(cpu);
+          }
+        }
+      } catch (const std::invalid_argument &) {
+        continue;
+      }
+      if (!cpus.empty()) {
+        topology.nodes.push_back(std::stoi(name.substr(4)));
+        topology.cpus.push_back(cpus);
+      }
+    }
+    closedir(directory);
+  }
+
+  // STEP 3: Sort the nodes, or fall back to one node with every CPU
+  std::vector<std::size_t> order(topology.nodes.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    return topology.nodes[a] < topology.nodes[b];
+  });
+  NumaTopology sorted;
+  for (std::size_t i : order) {
+    sorted.nodes.push_back(topology.nodes[i]);
+    sorted.cpus.push_back(topology.cpus[i]);
+  }
+  if (sorted.nodes.empty() && !allowed.empty()) {
+    sorted.nodes.push_back(0);
+    sorted.cpus.push_back(allowed);
+  }
+  return sorted;
+}
+
+PlacementPlanner::PlacementPlanner(PlacementPolicy policy,
+                                   const NumaTopology &topology)
+    : policy_(policy), topology_(topology),
+      active_(topology.nodes.size(), 0), mutex_() {}
+
+JobPlacement PlacementPlanner::acquire(int node) {
+  return acquire(policy_, node);
+}
+
+JobPlacement PlacementPlanner::acquire(PlacementPolicy policy, int node) {
+  JobPlacement placement;
+  if (policy == PlacementPolicy::None || topology_.nodes.empty()) {
+    return placement;
+  }
+
+  // STEP 1: Use the requested node, or the one running the fewest jobs
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::size_t index = topology_.nodes.size();
+  for (std::size_t i = 0; i < topology_.nodes.size(); ++i) {
+    if (topology_.nodes[i] == node) {
+      index = i;
+    }
+  }
+  if (index == topology_.nodes.size()) {
+    if (node >= 0) {
+      logging::warning() << "NUMA node " << node
+                         << " has no usable CPUs, placing the job elsewhere.";
+    }
+    index = static_cast<std::size_t>(
+        std::min_element(active_.begin(), active_.end()) - active_.begin());
+  }
+
+  // STEP 2: Count the job against it
+  ++active_[index];
+  placement.node = topology_.nodes[index];
+  placement.cpus = topology_.cpus[index];
+  return placement;
+}
+
+void PlacementPlanner::release(const JobPlacement &placement) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0; i < topology_.nodes.size(); ++i) {
+    if (topology_.nodes[i] == placement.node && active_[i] > 0) {
+      --active_[i];
+    }
+  }
+}
+
+bool pipeline::pin_current_thread(const std::vector<int> &cpus) {
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    logging::error() << "Failed to pin the thread to CPUs "
+                     << format_cpu_list(cpus);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,120 @@
+#ifndef PIPELINE_PLACEMENT
+#define PIPELINE_PLACEMENT
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pipeline {
+/**
+ * @brief Where the stage threads of a job may run.
+ */
+enum class PlacementPolicy {
+  None, /**< Anywhere, as the scheduler decides. */
+  Node, /**< On the CPUs of one NUMA node. Concurrent jobs go to the node
+             running the fewest jobs. */
+};
+
+/**
+ * @brief Parses the name of a placement policy.
+ * @param name "none" or "node".
+ * @return The placement policy.
+ * @throws std::invalid_argument If the name is not a known policy.
+ */
+PlacementPolicy parse_placement_policy(const std::string &name);
+
+/**
+ * @brief Parses a Linux CPU list such as "0-3,8,10-11".
+ * @param text The CPU list.
+ * @return The CPUs, in the order they are listed.
+ * @throws std::invalid_argument If the text is not a valid CPU list.
+ */
+std::vector<int> parse_cpu_list(const std::string &text);
+
+/**
+ * @brief Formats CPUs as a Linux CPU list such as "0-3,8".
+ * @param cpus The CPUs, in ascending order.
+ * @return The CPU list.
+ */
+std::string format_cpu_list(const std::vector<int> &cpus);
+
+/**
+ * @brief The NUMA nodes of the machine and the CPUs the process may use on
+ * each of them.
+ */
+struct NumaTopology {
+  std::vector<int> nodes; /**< The node numbers, in ascending order. */
+  std::vector<std::vector<int>>
+      cpus; /**< The allowed CPUs of each node, by index in `nodes`. */
+
+  /**
+   * @brief Reads the topology from /sys/devices/system/node, keeping the
+   * CPUs in the affinity mask of the process. Machines without NUMA
+   * information are one node 0 with every allowed CPU.
+   * @return The topology.
+   */
+  static NumaTopology detect();
+};
+
+/**
+ * @brief The CPUs a job's stages are pinned to.
+ */
+struct JobPlacement {
+  int node = -1;         /**< The NUMA node, -1 if the job is not pinned. */
+  std::vector<int> cpus; /**< The CPUs, empty if the job is not pinned. */
+};
+
+/**
+ * @brief Hands out NUMA nodes to concurrent jobs, least loaded first.
+ */
+class PlacementPlanner {
+public:
+  /**
+   * @brief Constructs a PlacementPlanner object.
+   * @param policy The default policy of the jobs.
+   * @param topology The nodes to place jobs on.
+   */
+  PlacementPlanner(PlacementPolicy policy, const NumaTopology &topology);
+
+  PlacementPlanner(const PlacementPlanner &) = delete;
+  PlacementPlanner &operator=(const PlacementPlanner &) = delete;
+
+  /**
+   * @brief Places a job. Release the placement when the job is done.
+   * @param policy The policy of the job.
+   * @param node The node to use, -1 to pick the least loaded one. Unknown
+   * nodes fall back to the least loaded one.
+   * @return The placement, unpinned with the None policy.
+   */
+  JobPlacement acquire(PlacementPolicy policy, int node = -1);
+
+  /**
+   * @brief Places a job with the default policy.
+   * @param node The node to use, -1 to pick the least loaded one.
+   * @return The placement.
+   */
+  JobPlacement acquire(int node = -1);
+
+  /**
+   * @brief Marks a job's node as free again.
+   * @param placement The placement returned by acquire().
+   */
+  void release(const JobPlacement &placement);
+
+private:
+  PlacementPolicy policy_;          /**< The default policy. */
+  NumaTopology topology_;           /**< The nodes jobs are placed on. */
+  std::vector<std::size_t> active_; /**< The running jobs of each node. */
+  std::mutex mutex_;                /**< Guards the job counts. */
+};
+
+/**
+ * @brief Pins the calling thread to CPUs. Threads it starts afterwards
+ * inherit the CPUs, so pinning a job's thread pins all of its stages.
+ * @param cpus The CPUs, empty to leave the thread as it is.
+ * @return `true` if the thread was pinned, `false` otherwise.
+ */
+bool pin_current_thread(const std::vector<int> &cpus);
+} // namespace pipeline
+#endif
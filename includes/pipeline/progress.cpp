@@ -0,0 +1,169 @@
+#include "progress.hpp"
+#include "memory_budget.hpp"
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+
+using namespace pipeline;
+
+ProgressFormat pipeline::parse_progress_format(const std::string &name) {
+  if (name == "none") {
+    return ProgressFormat::None;
+  }
+  if (name == "human") {
+    return ProgressFormat::Human;
+  }
+  if (name == "json") {
+    return ProgressFormat::Json;
+  }
+  throw std::invalid_argument("Unknown progress format: " + name);
+}
+
+double ProgressSnapshot::frames_per_second() const {
+  return elapsed_seconds > 0.0 ? frames_encoded / elapsed_seconds : 0.0;
+}
+
+double ProgressSnapshot::eta_seconds() const {
+  const double fps = frames_per_second();
+  if (frames_expected <= 0 || fps <= 0.0) {
+    return -1.0;
+  }
+  const std::int64_t left = frames_expected - frames_encoded;
+  return left > 0 ? left / fps : 0.0;
+}
+
+ProgressCounters::ProgressCounters()
+    : decoded_(), composited_(), encoded_(), bytes_written_(), expected_(),
+      start_(std::chrono::steady_clock::now()) {}
+
+void ProgressCounters::add_decoded() {
+  decoded_.value.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProgressCounters::add_composited() {
+  composited_.value.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProgressCounters::add_encoded() {
+  encoded_.value.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProgressCounters::add_bytes_written(std::int64_t bytes) {
+  bytes_written_.value.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void ProgressCounters::set_frames_expected(std::int64_t frames) {
+  expected_.value.store(frames, std::memory_order_relaxed);
+}
+
+ProgressSnapshot ProgressCounters::snapshot() const {
+  ProgressSnapshot snapshot;
+  snapshot.elapsed_seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start_)
+                                 .count();
+  snapshot.frames_decoded = decoded_.value.load(std::memory_order_relaxed);
+  snapshot.frames_composited =
+      composited_.value.load(std::memory_order_relaxed);
+  snapshot.frames_encoded = encoded_.value.load(std::memory_order_relaxed);
+  snapshot.bytes_written =
+      bytes_written_.value.load(std::memory_order_relaxed);
+  snapshot.frames_expected = expected_.value.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+std::string pipeline::format_progress(const ProgressSnapshot &snapshot,
+                                      ProgressFormat format) {
+  char buffer[256];
+  const double eta = snapshot.eta_seconds();
+
+  // STEP 1: One JSON object, with a null ETA when it is unknown
+  if (format == ProgressFormat::Json) {
+    char eta_text[32] = "null";
+    if (eta >= 0.0) {
+      std::snprintf(eta_text, sizeof(eta_text), "%.1f", eta);
+    }
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"elapsed\":%.2f,\"decoded\":%lld,\"composited\":%lld,"
+                  "\"encoded\":%lld,\"expected\":%lld,\"bytes_written\":%lld,"
+                  "\"fps\":%.1f,\"eta\":%s}",
+                  snapshot.elapsed_seconds,
+                  static_cast<long long>(snapshot.frames_decoded),
+                  static_cast<long long>(snapshot.frames_composited),
+                  static_cast<long long>(snapshot.frames_encoded),
+                  static_cast<long long>(snapshot.frames_expected),
+                  static_cast<long long>(snapshot.bytes_written),
+                  snapshot.frames_per_second(), eta_text);
+    return buffer;
+  }
+
+  // STEP 2: The encoded frames, out of the expected ones if known
+  std::string line = "[PROGRESS] ";
+  if (snapshot.frames_expected > 0) {
+    std::snprintf(buffer, sizeof(buffer), "%lld/%lld frames (%.0f%%)",
+                  static_cast<long long>(snapshot.frames_encoded),
+                  static_cast<long long>(snapshot.frames_expected),
+                  100.0 * snapshot.frames_encoded / snapshot.frames_expected);
+  } else {
+    std::snprintf(buffer, sizeof(buffer), "%lld frames",
+                  static_cast<long long>(snapshot.frames_encoded));
+  }
+  line += buffer;
+
+  // STEP 3: The other stages, the output size, the rate and the ETA
+  std::snprintf(buffer, sizeof(buffer),
+                " | decoded %lld, composited %lld | %s | %.1f fps",
+                static_cast<long long>(snapshot.frames_decoded),
+                static_cast<long long>(snapshot.frames_composited),
+                format_byte_size(snapshot.bytes_written).c_str(),
+                snapshot.frames_per_second());
+  line += buffer;
+  if (eta >= 0.0) {
+    const long long seconds = static_cast<long long>(eta + 0.5);
+    std::snprintf(buffer, sizeof(buffer), " | ETA %lld:%02lld", seconds / 60,
+                  seconds % 60);
+    line += buffer;
+  }
+  return line;
+}
+
+ProgressReporter::ProgressReporter(
+    const ProgressCounters &counters, std::chrono::milliseconds interval,
+    std::function<void(const ProgressSnapshot &)> report)
+    : counters_(counters), interval_(interval), report_(std::move(report)),
+      stopping_(false), mutex_(), wake_(), thread_() {
+  thread_ = std::thread([this] { run(); });
+}
+
+ProgressReporter::~ProgressReporter() { stop(); }
+
+void ProgressReporter::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void ProgressReporter::run() {
+  // STEP 1: Report at every interval until stopped
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (interval_.count() <= 0) {
+      wake_.wait(lock, [this] { return stopping_; });
+      break;
+    }
+    if (wake_.wait_for(lock, interval_, [this] { return stopping_; })) {
+      break;
+    }
+    lock.unlock();
+    report_(counters_.snapshot());
+    lock.lock();
+  }
+  lock.unlock();
+
+  // STEP 2: Report the final counts
+  report_(counters_.snapshot());
+}
@@ -0,0 +1,176 @@
+#ifndef PIPELINE_PROGRESS
+#define PIPELINE_PROGRESS
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace pipeline {
+/**
+ * @brief How progress is reported.
+ */
+enum class ProgressFormat {
+  None,  /**< Not at all. */
+  Human, /**< One line with the rate and ETA per report. */
+  Json,  /**< One JSON object per line. */
+};
+
+/**
+ * @brief Parses the name of a progress format.
+ * @param name "none", "human" or "json".
+ * @return The progress format.
+ * @throws std::invalid_argument If the name is not a known format.
+ */
+ProgressFormat parse_progress_format(const std::string &name);
+
+/**
+ * @brief The progress of a job at one moment.
+ */
+struct ProgressSnapshot {
+  double elapsed_seconds = 0.0;     /**< The time since the job started. */
+  std::int64_t frames_decoded = 0;  /**< The frames decoded, of every input. */
+  std::int64_t frames_composited = 0; /**< The frames handed to the encoder. */
+  std::int64_t frames_encoded = 0;  /**< The frames of the main output. */
+  std::int64_t bytes_written = 0;   /**< The bytes of every output. */
+  std::int64_t frames_expected = 0; /**< The frames of the main output when
+                                         done, 0 if unknown. */
+
+  /**
+   * @brief Gets the average encoding rate so far.
+   * @return The frames encoded per second.
+   */
+  double frames_per_second() const;
+
+  /**
+   * @brief Estimates the time left from the average rate so far.
+   * @return The seconds left, negative if unknown.
+   */
+  double eta_seconds() const;
+};
+
+/**
+ * @brief The progress counters of a job's stages. Every stage bumps its own
+ * counter with a relaxed atomic add, on its own cache line, so counting
+ * costs the hot paths neither a lock nor false sharing.
+ */
+class ProgressCounters {
+public:
+  /**
+   * @brief Constructs a ProgressCounters object and starts its clock.
+   */
+  ProgressCounters();
+
+  ProgressCounters(const ProgressCounters &) = delete;
+  ProgressCounters &operator=(const ProgressCounters &) = delete;
+
+  /**
+   * @brief Counts a decoded frame.
+   */
+  void add_decoded();
+
+  /**
+   * @brief Counts a frame handed to the encoder.
+   */
+  void add_composited();
+
+  /**
+   * @brief Counts an encoded frame of the main output.
+   */
+  void add_encoded();
+
+  /**
+   * @brief Counts bytes written to an output.
+   * @param bytes The bytes.
+   */
+  void add_bytes_written(std::int64_t bytes);
+
+  /**
+   * @brief Sets the frames the main output should have when done.
+   * @param frames The frames, 0 if unknown.
+   */
+  void set_frames_expected(std::int64_t frames);
+
+  /**
+   * @brief Reads every counter. The counters are read one by one, so a
+   * snapshot taken while the stages run may be a frame apart.
+   * @return The progress so far.
+   */
+  ProgressSnapshot snapshot() const;
+
+private:
+  /**
+   * @brief A counter on a cache line of its own.
+   */
+  struct alignas(64) Counter {
+    std::atomic<std::int64_t> value{0}; /**< The count. */
+  };
+
+  Counter decoded_;     /**< The frames decoded. */
+  Counter composited_;  /**< The frames handed to the encoder. */
+  Counter encoded_;     /**< The frames encoded. */
+  Counter bytes_written_; /**< The bytes written. */
+  Counter expected_;    /**< The frames expected. */
+  std::chrono::steady_clock::time_point start_; /**< When the job started. */
+};
+
+/**
+ * @brief Formats a progress snapshot as one line, without the newline.
+ * @param snapshot The progress.
+ * @param format Human or Json.
+ * @return The line.
+ */
+std::string format_progress(const ProgressSnapshot &snapshot,
+                            ProgressFormat format);
+
+/**
+ * @brief A thread that reads a job's counters at an interval and reports
+ * them, so the stages never do console I/O per frame.
+ */
+class ProgressReporter {
+public:
+  /**
+   * @brief Constructs a ProgressReporter object and starts its thread.
+   * @param counters The counters to read. They must outlive the reporter.
+   * @param interval The time between reports, 0 to report only once stopped.
+   * @param report Called with every snapshot, on the reporter thread.
+   */
+  ProgressReporter(const ProgressCounters &counters,
+                   std::chrono::milliseconds interval,
+                   std::function<void(const ProgressSnapshot &)> report);
+
+  /**
+   * @brief Stops the reporter.
+   */
+  ~ProgressReporter();
+
+  ProgressReporter(const ProgressReporter &) = delete;
+  ProgressReporter &operator=(const ProgressReporter &) = delete;
+
+  /**
+   * @brief Reports the final counts and stops the thread. Later calls do
+   * nothing.
+   */
+  void stop();
+
+private:
+  const ProgressCounters &counters_; /**< The counters. */
+  std::chrono::milliseconds interval_; /**< The time between reports. */
+  std::function<void(const ProgressSnapshot &)>
+      report_;                     /**< Called with every snapshot. */
+  bool stopping_;                  /**< Whether the thread should exit. */
+  std::mutex mutex_;               /**< Guards stopping. */
+  std::condition_variable wake_;   /**< Wakes the thread to stop. */
+  std::thread thread_;             /**< The reporter thread. */
+
+  /**
+   * @brief The loop of the reporter thread.
+   */
+  void run();
+};
+} // namespace pipeline
+#endif
@@ -0,0 +1,125 @@
+#include "run_report.hpp"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/resource.h>
+
+using namespace pipeline;
+
+namespace {
+/**
+ * @brief Reads the counters of the calling thread since it started.
+ */
+StageStats read_thread_counters(const std::string &name) {
+  StageStats stats;
+  stats.name = name;
+
+  // STEP 1: CPU time and context switches
+  rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+    stats.user_seconds =
+        usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    stats.system_seconds =
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    stats.voluntary_switches = usage.ru_nvcsw;
+    stats.involuntary_switches = usage.ru_nivcsw;
+  }
+
+  // STEP 2: Migrations, which kernels with scheduler debugging report
+  std::ifstream sched_file("/proc/thread-self/sched");
+  std::string line;
+  while (std::getline(sched_file, line)) {
+    if (line.compare(0, 16, "se.nr_migrations") == 0) {
+      std::istringstream fields(line.substr(line.find(':') + 1));
+      fields >> stats.migrations;
+    }
+  }
+  return stats;
+}
+} // namespace
+
+StageTimer::StageTimer(const std::string &name)
+    : start_(read_thread_counters(name)) {}
+
+StageStats StageTimer::stop() const {
+  StageStats stats = read_thread_counters(start_.name);
+  stats.user_seconds -= start_.user_seconds;
+  stats.system_seconds -= start_.system_seconds;
+  stats.voluntary_switches -= start_.voluntary_switches;
+  stats.involuntary_switches -= start_.involuntary_switches;
+  if (stats.migrations >= 0 && start_.migrations >= 0) {
+    stats.migrations -= start_.migrations;
+  }
+  return stats;
+}
+
+RunReport::RunReport()
+    : start_(std::chrono::steady_clock::now()), has_memory_(false),
+      budget_bytes_(0), peak_bytes_(0), peak_held_(0), final_bytes_(0),
+      stalls_(0),
+      frames_(0), has_placement_(false), placement_(), stages_() {}
+
+void RunReport::record_memory(const MemoryBudget &budget) {
+  has_memory_ = true;
+  budget_bytes_ = budget.capacity();
+  peak_bytes_ = budget.peak();
+  peak_held_ = budget.peak_held();
+  final_bytes_ = budget.in_flight();
+  stalls_ = budget.stalls();
+  frames_ = budget.frames();
+}
+
+void RunReport::record_placement(const JobPlacement &placement) {
+  has_placement_ = true;
+  placement_ = placement;
+}
+
+void RunReport::record_stage(const StageStats &stats) {
+  stages_.push_back(stats);
+}
+
+void RunReport::print(std::ostream &out) const {
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_;
+
+  out << "[REPORT] Wall time: " << std::fixed << std::setprecision(2)
+      << elapsed.count() << " s" << std::endl;
+
+  if (has_memory_) {
+    out << "[REPORT] Memory budget: " << format_byte_size(budget_bytes_)
+        << ", peak in flight: " << format_byte_size(peak_bytes_);
+    if (peak_held_ > 0) {
+      out << " (held back for crossfades: " << format_byte_size(peak_held_)
+          << ")";
+    }
+    out << ", in flight at exit: " << format_byte_size(final_bytes_)
+        << std::endl;
+    out << "[REPORT] Frames queued: " << frames_
+        << ", backpressure stalls: " << stalls_ << std::endl;
+  }
+
+  if (has_placement_) {
+    if (placement_.cpus.empty()) {
+      out << "[REPORT] Placement: unpinned" << std::endl;
+    } else {
+      out << "[REPORT] Placement: NUMA node " << placement_.node << ", CPUs "
+          << format_cpu_list(placement_.cpus) << std::endl;
+    }
+  }
+
+  for (const StageStats &stage : stages_) {
+    out << "[REPORT] Stage " << stage.name << ": CPU "
+        << stage.user_seconds + stage.system_seconds << " s (user "
+        << stage.user_seconds << " s, system " << stage.system_seconds
+        << " s), context switches: " << stage.voluntary_switches
+        << " voluntary, " << stage.involuntary_switches
+        << " involuntary, migrations: ";
+    if (stage.migrations >= 0) {
+      out << stage.migrations;
+    } else {
+      out << "n/a";
+    }
+    out << std::endl;
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef PIPELINE_RUN_REPORT
+#define PIPELINE_RUN_REPORT
+
+#include "memory_budget.hpp"
+#include "placement.hpp"
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pipeline {
+/**
+ * @brief What one stage thread of a job cost.
+ */
+struct StageStats {
+  std::string name;            /**< The name of the stage. */
+  double user_seconds = 0.0;   /**< The CPU time spent in user space. */
+  double system_seconds = 0.0; /**< The CPU time spent in the kernel. */
+  long voluntary_switches = 0; /**< The times the thread blocked. */
+  long involuntary_switches = 0; /**< The times the thread was preempted. */
+  long migrations = -1; /**< The times the thread moved to another CPU, -1
+                             if the kernel does not report it. */
+};
+
+/**
+ * @brief Measures the calling thread from its construction until stop().
+ */
+class StageTimer {
+public:
+  /**
+   * @brief Constructs a StageTimer object and reads the thread's counters.
+   * @param name The name of the stage.
+   */
+  explicit StageTimer(const std::string &name);
+
+  /**
+   * @brief Reads the thread's counters again. Call it on the thread that
+   * constructed the timer.
+   * @return What the stage cost since the timer was constructed.
+   */
+  StageStats stop() const;
+
+private:
+  StageStats start_; /**< The counters at construction. */
+};
+
+/**
+ * @brief Summary of a finished job, printed at the end of a run.
+ */
+class RunReport {
+public:
+  /**
+   * @brief Constructs a RunReport object and starts its wall clock.
+   */
+  RunReport();
+
+  /**
+   * @brief Records the memory statistics of a job's budget.
+   * @param budget The budget shared by the job's queues, the renditions'
+   * queues and the frames held back for crossfades.
+   */
+  void record_memory(const MemoryBudget &budget);
+
+  /**
+   * @brief Records the CPUs the job's stages were pinned to.
+   * @param placement The placement of the job.
+   */
+  void record_placement(const JobPlacement &placement);
+
+  /**
+   * @brief Records what a stage thread cost.
+   * @param stats The stage's counters.
+   */
+  void record_stage(const StageStats &stats);
+
+  /**
+   * @brief Prints the report.
+   * @param out The stream to print the report to.
+   */
+  void print(std::ostream &out) const;
+
+private:
+  std::chrono::steady_clock::time_point
+      start_;                  /**< When the job started. */
+  bool has_memory_;            /**< Whether memory stats were recorded. */
+  std::size_t budget_bytes_;   /**< The configured memory budget. */
+  std::size_t peak_bytes_;     /**< The peak number of bytes in flight. */
+  std::size_t peak_held_;      /**< The peak bytes held outside queues. */
+  std::size_t final_bytes_;    /**< The bytes in flight at the end. */
+  std::size_t stalls_;         /**< The number of backpressure stalls. */
+  std::size_t frames_;         /**< The number of frames queued. */
+  bool has_placement_;         /**< Whether a placement was recorded. */
+  JobPlacement placement_;     /**< The CPUs the stages were pinned to. */
+  std::vector<StageStats> stages_; /**< The stages, in recording order. */
+};
+} // namespace pipeline
+#endif
@@ -0,0 +1,243 @@
+#include "task_scheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+using namespace pipeline;
+
+/** How long a waiting worker sleeps when there is nothing to help with. */
+static const std::chrono::milliseconds HELP_POLL(1);
+
+namespace {
+/** The number of workers the global scheduler starts with. */
+std::atomic<std::size_t> global_workers(0);
+/** The scheduler the calling thread is a worker of, if any. */
+thread_local TaskScheduler *worker_scheduler = nullptr;
+/** The index of the calling worker in its scheduler. */
+thread_local std::size_t worker_index = 0;
+/** The job the calling thread submits tasks for. */
+thread_local std::size_t thread_job = 0;
+} // namespace
+
+TaskScheduler::TaskScheduler(std::size_t workers)
+    : workers_(), injected_(), last_job_(0), queued_(0), stopping_(false),
+      mutex_(), wake_() {
+  if (workers == 0) {
+    workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // Every worker exists before any of them starts stealing
+  for (std::size_t i = 0; i < workers; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (std::size_t i = 0; i < workers; ++i) {
+    workers_[i]->thread = std::thread([this, i] { work(i); });
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::unique_ptr<Worker> &worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+TaskScheduler &TaskScheduler::global() {
+  static TaskScheduler scheduler(global_workers.load());
+  return scheduler;
+}
+
+TaskScheduler &TaskScheduler::current() {
+  return worker_scheduler ? *worker_scheduler : global();
+}
+
+void TaskScheduler::set_global_workers(std::size_t workers) {
+  global_workers = workers;
+}
+
+void TaskScheduler::set_current_job(std::size_t job) { thread_job = job; }
+
+std::size_t TaskScheduler::current_job() { return thread_job; }
+
+std::size_t TaskScheduler::worker_count() const { return workers_.size(); }
+
+void TaskScheduler::submit(Task task) {
+  // STEP 1: Count the task first, so it is never taken before it is
+  // counted, and under the lock, so a worker about to sleep sees it
+  const bool on_worker = worker_scheduler == this;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++queued_;
+    if (!on_worker) {
+      injected_[task.job].push_back(std::move(task));
+    }
+  }
+
+  // STEP 2: Keep the task on the submitting worker, then wake an idle one
+  if (on_worker) {
+    Worker &worker = *workers_[worker_index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  wake_.notify_one();
+}
+
+bool TaskScheduler::take_task(std::size_t index, Task &task) {
+  const std::size_t count = workers_.size();
+
+  // STEP 1: The worker's own newest task, which is still in its cache
+  if (index < count) {
+    Worker &worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.tasks.empty()) {
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+      --queued_;
+      return true;
+    }
+  }
+
+  // STEP 2: The oldest task of the job after the one served last
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!injected_.empty()) {
+      auto next = injected_.upper_bound(last_job_);
+      if (next == injected_.end()) {
+        next = injected_.begin();
+      }
+      task = std::move(next->second.front());
+      next->second.pop_front();
+      last_job_ = next->first;
+      if (next->second.empty()) {
+        injected_.erase(next);
+      }
+      --queued_;
+      return true;
+    }
+  }
+
+  // STEP 3: The oldest task of another worker
+  for (std::size_t offset = 1; offset <= count; ++offset) {
+    const std::size_t victim = (index + offset) % count;
+    if (victim == index) {
+      continue;
+    }
+    Worker &worker = *workers_[victim];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.tasks.empty()) {
+      task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+      --queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TaskScheduler::run_one() {
+  Task task;
+  if (worker_scheduler != this || !take_task(worker_index, task)) {
+    return false;
+  }
+  run(task);
+  return true;
+}
+
+void TaskScheduler::run(Task &task) {
+  const std::size_t previous_job = thread_job;
+  thread_job = task.job;
+  task.run();
+  thread_job = previous_job;
+
+  // Release what the task captured before its group may be destroyed
+  task.run = nullptr;
+  task.group->finish();
+}
+
+void TaskScheduler::work(std::size_t index) {
+  worker_scheduler = this;
+  worker_index = index;
+
+  Task task;
+  while (true) {
+    if (take_task(index, task)) {
+      run(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_ && queued_ == 0) {
+      return;
+    }
+    wake_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+  }
+}
+
+TaskGroup::TaskGroup(TaskScheduler &scheduler)
+    : scheduler_(scheduler), pending_(0), mutex_(), done_() {}
+
+TaskGroup::~TaskGroup() { wait(); }
+
+void TaskGroup::run(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_;
+  }
+  scheduler_.submit({std::move(task), thread_job, this});
+}
+
+void TaskGroup::wait(std::size_t pending) {
+  const bool on_worker = worker_scheduler == &scheduler_;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (pending_ > pending) {
+    if (!on_worker) {
+      done_.wait(lock);
+      continue;
+    }
+
+    // A worker runs other tasks while it waits, so nested groups cannot
+    // block every worker
+    lock.unlock();
+    const bool ran = scheduler_.run_one();
+    lock.lock();
+    if (!ran) {
+      done_.wait_for(lock, HELP_POLL);
+    }
+  }
+}
+
+TaskScheduler &TaskGroup::scheduler() const { return scheduler_; }
+
+void TaskGroup::finish() {
+  // Notify under the lock: the waiter may destroy the group once it sees
+  // the count drop
+  std::lock_guard<std::mutex> lock(mutex_);
+  --pending_;
+  done_.notify_all();
+}
+
+void pipeline::parallel_for(int begin, int end, int grain,
+                            const std::function<void(int, int)> &body) {
+  grain = std::max(1, grain);
+  TaskScheduler &scheduler = TaskScheduler::current();
+  if (end - begin <= grain || scheduler.worker_count() <= 1) {
+    if (begin < end) {
+      body(begin, end);
+    }
+    return;
+  }
+
+  // Hand out every chunk but the last, which this thread runs itself
+  TaskGroup group(scheduler);
+  int first = begin;
+  for (; end - first > grain; first += grain) {
+    const int last = first + grain;
+    group.run([&body, first, last] { body(first, last); });
+  }
+  body(first, end);
+  group.wait();
+}
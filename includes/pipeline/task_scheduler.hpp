@@ -0,0 +1,213 @@
+#ifndef PIPELINE_TASK_SCHEDULER
+#define PIPELINE_TASK_SCHEDULER
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pipeline {
+class TaskGroup;
+
+/**
+ * @brief Work-stealing pool of worker threads shared by every stage and job.
+ *
+ * Tasks submitted by a worker go to the back of its own deque, which it
+ * works through newest first while idle workers steal the oldest tasks from
+ * the front. Tasks submitted by any other thread are queued per job, and
+ * workers take them from the jobs in turn, so a job with many tasks cannot
+ * starve the others. Tasks must not throw.
+ */
+class TaskScheduler {
+public:
+  /**
+   * @brief Constructs a TaskScheduler object and starts its workers.
+   * @param workers The number of worker threads, 0 for one per CPU.
+   */
+  explicit TaskScheduler(std::size_t workers = 0);
+
+  /**
+   * @brief Runs the queued tasks and stops the workers. Wait for every
+   * TaskGroup first.
+   */
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler &) = delete;
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+  /**
+   * @brief Gets the scheduler shared by the whole process, starting it on
+   * first use.
+   * @return The global scheduler.
+   */
+  static TaskScheduler &global();
+
+  /**
+   * @brief Gets the scheduler running the calling thread, so nested tasks
+   * stay on it.
+   * @return The scheduler of the calling worker, or the global scheduler.
+   */
+  static TaskScheduler &current();
+
+  /**
+   * @brief Sets the number of workers of the global scheduler. Only calls
+   * made before its first use have an effect.
+   * @param workers The number of worker threads, 0 for one per CPU.
+   */
+  static void set_global_workers(std::size_t workers);
+
+  /**
+   * @brief Sets the job the calling thread submits tasks for. Tasks run
+   * as the job that submitted them.
+   * @param job The job.
+   */
+  static void set_current_job(std::size_t job);
+
+  /**
+   * @brief Gets the job the calling thread submits tasks for.
+   * @return The job, 0 unless set_current_job() was called.
+   */
+  static std::size_t current_job();
+
+  /**
+   * @brief Gets the number of worker threads.
+   * @return The number of workers.
+   */
+  std::size_t worker_count() const;
+
+private:
+  friend class TaskGroup;
+
+  /**
+   * @brief A queued task.
+   */
+  struct Task {
+    std::function<void()> run; /**< The work. */
+    std::size_t job;           /**< The job that submitted it. */
+    TaskGroup *group;          /**< The group to notify when it is done. */
+  };
+
+  /**
+   * @brief A worker thread and the tasks it submitted.
+   */
+  struct Worker {
+    std::deque<Task> tasks; /**< Its tasks, newest at the back. */
+    std::mutex mutex;       /**< Guards the tasks. */
+    std::thread thread;     /**< The thread. */
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_; /**< The workers. */
+  std::map<std::size_t, std::deque<Task>>
+      injected_; /**< The tasks submitted by other threads, by job. */
+  std::size_t last_job_; /**< The job the last injected task came from. */
+  std::atomic<std::size_t> queued_; /**< The tasks not yet taken. */
+  bool stopping_;                   /**< Whether the workers should exit. */
+  std::mutex mutex_; /**< Guards the injected tasks and stopping. */
+  std::condition_variable wake_; /**< Wakes idle workers. */
+
+  /**
+   * @brief Queues a task on the calling worker, or with its job.
+   * @param task The task.
+   */
+  void submit(Task task);
+
+  /**
+   * @brief Takes the next task for a worker: its own newest, then the next
+   * job's oldest injected, then the oldest of another worker.
+   * @param index The worker, or the number of workers for none.
+   * @param task The task taken.
+   * @return `true` if a task was taken, `false` if there is none.
+   */
+  bool take_task(std::size_t index, Task &task);
+
+  /**
+   * @brief Runs one task on the calling worker, if there is one.
+   * @return `true` if a task was run, `false` otherwise.
+   */
+  bool run_one();
+
+  /**
+   * @brief Runs a task as its job and notifies its group.
+   * @param task The task.
+   */
+  void run(Task &task);
+
+  /**
+   * @brief The loop of a worker thread.
+   * @param index The worker.
+   */
+  void work(std::size_t index);
+};
+
+/**
+ * @brief Tasks submitted together and waited for together. Waiting on a
+ * worker runs other tasks meanwhile, so groups may nest.
+ */
+class TaskGroup {
+public:
+  /**
+   * @brief Constructs a TaskGroup object.
+   * @param scheduler The scheduler to run the tasks on.
+   */
+  explicit TaskGroup(TaskScheduler &scheduler = TaskScheduler::current());
+
+  /**
+   * @brief Waits for the remaining tasks.
+   */
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  /**
+   * @brief Submits a task for the job of the calling thread.
+   * @param task The task. It must not throw.
+   */
+  void run(std::function<void()> task);
+
+  /**
+   * @brief Waits until at most some of the group's tasks are unfinished,
+   * which bounds the work in flight.
+   * @param pending The number of tasks that may still be unfinished.
+   */
+  void wait(std::size_t pending = 0);
+
+  /**
+   * @brief Gets the scheduler the tasks run on.
+   * @return The scheduler.
+   */
+  TaskScheduler &scheduler() const;
+
+private:
+  friend class TaskScheduler;
+
+  TaskScheduler &scheduler_;      /**< The scheduler. */
+  std::size_t pending_;           /**< The unfinished tasks. */
+  std::mutex mutex_;              /**< Guards the unfinished tasks. */
+  std::condition_variable done_;  /**< Signals finished tasks. */
+
+  /**
+   * @brief Marks a task as finished.
+   */
+  void finish();
+};
+
+/**
+ * @brief Runs a loop body over chunks of a range in parallel, and returns
+ * once every chunk is done. Small ranges run on the calling thread.
+ * @param begin The first index.
+ * @param end One past the last index.
+ * @param grain The number of indices in a chunk.
+ * @param body The body, called with the first and one past the last index
+ * of a chunk.
+ */
+void parallel_for(int begin, int end, int grain,
+                  const std::function<void(int, int)> &body);
+} // namespace pipeline
+#endif
@@ -0,0 +1,141 @@
+#include "workspace.hpp"
+#include "../logging/logger.hpp"
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace pipeline;
+
+namespace {
+/** The name of a workspace, with the characters mkdtemp() replaces. */
+const char *const WORKSPACE_TEMPLATE = "gameflix-XXXXXX";
+
+/**
+ * @brief Removes directories on a thread of its own.
+ */
+class Cleaner {
+public:
+  /**
+   * @brief Gets the cleaner of the process, starting it on first use. It
+   * is never destroyed, so workspaces may be dropped until the process
+   * exits, and it finishes its queue from an atexit() handler.
+   */
+  static Cleaner &global() {
+    static Cleaner *cleaner = new Cleaner();
+    return *cleaner;
+  }
+
+  /**
+   * @brief Queues a directory to be removed.
+   */
+  void push(const std::string &path) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.push_back(path);
+    }
+    wake_.notify_all();
+  }
+
+  /**
+   * @brief Waits until the queue is empty and no removal is running.
+   */
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return pending_.empty() && !removing_; });
+  }
+
+private:
+  std::deque<std::string> pending_; /**< The directories to remove. */
+  bool removing_;                   /**< Whether a removal is running. */
+  std::mutex mutex_;                /**< Guards the queue. */
+  std::condition_variable wake_;    /**< Wakes the thread. */
+  std::condition_variable idle_;    /**< Wakes the waiters. */
+  std::thread thread_;              /**< The cleaner thread. */
+
+  Cleaner()
+      : pending_(), removing_(false), mutex_(), wake_(), idle_(), thread_() {
+    thread_ = std::thread([this] { run(); });
+    thread_.detach();
+    std::atexit([] { Cleaner::global().wait(); });
+  }
+
+  /**
+   * @brief The loop of the cleaner thread.
+   */
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_.wait(lock, [this] { return !pending_.empty(); });
+      const std::string path = pending_.front();
+      pending_.pop_front();
+      removing_ = true;
+      lock.unlock();
+
+      std::error_code error;
+      std::filesystem::remove_all(path, error);
+      if (error) {
+        logging::warning() << "Failed to remove the workspace " << path
+                           << ": " << error.message();
+      }
+
+      lock.lock();
+      removing_ = false;
+      if (pending_.empty()) {
+        idle_.notify_all();
+      }
+    }
+  }
+};
+} // namespace
+
+std::string pipeline::default_workspace_root() {
+  std::error_code error;
+  const std::filesystem::path root =
+      std::filesystem::temp_directory_path(error);
+  return error ? "/tmp" : root.string();
+}
+
+Workspace::Workspace(const std::string &root) : path_() {
+  // STEP 1: Make sure the root exists
+  const std::string dir = root.empty() ? default_workspace_root() : root;
+  std::error_code error;
+  std::filesystem::create_directories(dir, error);
+  if (error) {
+    logging::error() << "Failed to create the workspace root " << dir << ": "
+                     << error.message();
+    return;
+  }
+
+  // STEP 2: Create a directory no other job or process has
+  const std::string pattern =
+      (std::filesystem::path(dir) / WORKSPACE_TEMPLATE).string();
+  std::vector<char> name(pattern.begin(), pattern.end());
+  name.push_back('\0');
+  if (!mkdtemp(name.data())) {
+    logging::error() << "Failed to create a workspace in " << dir;
+    return;
+  }
+  path_ = name.data();
+}
+
+Workspace::~Workspace() {
+  if (!path_.empty()) {
+    remove_in_background(path_);
+  }
+}
+
+bool Workspace::valid() const { return !path_.empty(); }
+
+const std::string &Workspace::path() const { return path_; }
+
+void pipeline::remove_in_background(const std::string &path) {
+  Cleaner::global().push(path);
+}
+
+void pipeline::wait_for_cleanup() { Cleaner::global().wait(); }
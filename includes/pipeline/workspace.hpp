@@ -0,0 +1,69 @@
+#ifndef PIPELINE_WORKSPACE
+#define PIPELINE_WORKSPACE
+
+#include <string>
+
+namespace pipeline {
+/**
+ * @brief Gets the directory workspaces are created in when none is given:
+ * the system temp directory, which honours TMPDIR.
+ * @return The directory.
+ */
+std::string default_workspace_root();
+
+/**
+ * @brief A directory of its own for the intermediate files of one job, so
+ * jobs in the same process or working directory never share files.
+ *
+ * The directory is created with a unique name under a root, such as
+ * /dev/shm to keep the files on tmpfs. It is removed on a background
+ * thread once the workspace is destroyed, so deleting many frames never
+ * holds up the next job.
+ */
+class Workspace {
+public:
+  /**
+   * @brief Constructs a Workspace object and creates its directory.
+   * @param root The directory to create it in, empty for
+   * default_workspace_root(). It is created if it does not exist.
+   */
+  explicit Workspace(const std::string &root = "");
+
+  /**
+   * @brief Hands the directory to the background cleaner.
+   */
+  ~Workspace();
+
+  Workspace(const Workspace &) = delete;
+  Workspace &operator=(const Workspace &) = delete;
+
+  /**
+   * @brief Checks if the directory was created.
+   * @return `true` if it was, `false` otherwise.
+   */
+  bool valid() const;
+
+  /**
+   * @brief Gets the path to the directory.
+   * @return The path, empty if it could not be created.
+   */
+  const std::string &path() const;
+
+private:
+  std::string path_; /**< The directory, empty if it was not created. */
+};
+
+/**
+ * @brief Removes a directory and everything in it on the background
+ * cleaner thread. The removals still queued when the process exits are
+ * finished from an atexit() handler.
+ * @param path The directory.
+ */
+void remove_in_background(const std::string &path);
+
+/**
+ * @brief Waits until every removal queued so far is done.
+ */
+void wait_for_cleanup();
+} // namespace pipeline
+#endif
@@ -0,0 +1,195 @@
+#include "convert.hpp"
+#include "../pipeline/task_scheduler.hpp"
+#include <algorithm>
+#include <vector>
+
+using namespace simd;
+
+/** The output rows converted by one scheduler task. */
+static const int ROWS_PER_TASK = 64;
+
+namespace {
+/**
+ * @brief A plane of 8-bit samples.
+ */
+struct Plane {
+  std::uint8_t *data;
+  int linesize;
+  int width;
+  int height;
+
+  std::uint8_t *row(int y) const { return data + y * linesize; }
+};
+
+enum class Resize { Same, Up, Down, Unsupported };
+
+/**
+ * @brief Checks if a YUV frame has the colors the kernels convert with:
+ * BT.709 or unspecified, in limited range.
+ */
+bool bt709_limited(const AVFrame *frame) {
+  return (frame->colorspace == AVCOL_SPC_BT709 ||
+          frame->colorspace == AVCOL_SPC_UNSPECIFIED) &&
+         frame->color_range != AVCOL_RANGE_JPEG;
+}
+
+Resize resize_between(const AVFrame *src_frame, const AVFrame *dst_frame) {
+  const int src_width = src_frame->width, src_height = src_frame->height;
+  const int dst_width = dst_frame->width, dst_height = dst_frame->height;
+  if (src_width % 4 != 0 || src_height % 4 != 0 || dst_width % 4 != 0 ||
+      dst_height % 4 != 0) {
+    return Resize::Unsupported;
+  }
+  if (dst_width == src_width && dst_height == src_height) {
+    return Resize::Same;
+  }
+  if (2 * dst_width == 3 * src_width && 2 * dst_height == 3 * src_height) {
+    return Resize::Up;
+  }
+  if (2 * dst_width == src_width && 2 * dst_height == src_height) {
+    return Resize::Down;
+  }
+  return Resize::Unsupported;
+}
+
+/**
+ * @brief Gets plane `index` of a YUV420P frame.
+ */
+Plane yuv_plane(const AVFrame *frame, int index) {
+  const int shift = index == 0 ? 0 : 1;
+  return {frame->data[index], frame->linesize[index], frame->width >> shift,
+          frame->height >> shift};
+}
+
+void upscale_plane(const Kernels &kernels, const Plane &src,
+                   const Plane &dst) {
+  auto upscale_rows = [&](int first, int last) {
+    // The two source rows an output row blends are always consecutive, so
+    // keying the horizontally scaled rows by parity scales each row once
+    std::vector<std::uint8_t> scaled(2 * dst.width);
+    int scaled_rows[2] = {-1, -1};
+    auto scaled_row = [&](int y) {
+      std::uint8_t *row = scaled.data() + (y % 2) * dst.width;
+      if (scaled_rows[y % 2] != y) {
+        kernels.upscale_row_3_2(src.row(y), src.width, row);
+        scaled_rows[y % 2] = y;
+      }
+      return row;
+    };
+
+    for (int y = first; y < last; ++y) {
+      const int k = y / 3;
+      const int r = y % 3;
+      const int top = std::max(0, 2 * k + r - 1);
+      const int bottom = std::min(src.height - 1, 2 * k + r);
+      const std::uint8_t *top_row = scaled_row(top);
+      const std::uint8_t *bottom_row = scaled_row(bottom);
+      kernels.blend_rows(top_row, bottom_row, dst.row(y), dst.width,
+                         UPSCALE_3_2_WEIGHTS[r]);
+    }
+  };
+  pipeline::parallel_for(0, dst.height, ROWS_PER_TASK, upscale_rows);
+}
+
+void downscale_plane(const Kernels &kernels, const Plane &src,
+                     const Plane &dst) {
+  auto downscale_rows = [&](int first, int last) {
+    for (int y = first; y < last; ++y) {
+      kernels.downscale_rows_2(src.row(2 * y), src.row(2 * y + 1),
+                               dst.row(y), dst.width);
+    }
+  };
+  pipeline::parallel_for(0, dst.height, ROWS_PER_TASK, downscale_rows);
+}
+
+void rgba_to_yuv420p(const Kernels &kernels, const Plane &rgba,
+                     const Plane &y, const Plane &u, const Plane &v) {
+  // Rows are converted in pairs, which share a chroma row
+  auto convert_pairs = [&](int first, int last) {
+    for (int pair = first; pair < last; ++pair) {
+      const int row = 2 * pair;
+      kernels.rgba_to_yuv420p_rows(rgba.row(row), rgba.row(row + 1),
+                                   y.row(row), y.row(row + 1), u.row(pair),
+                                   v.row(pair), y.width);
+    }
+  };
+  pipeline::parallel_for(0, y.height / 2, ROWS_PER_TASK / 2, convert_pairs);
+}
+
+void yuv420p_to_rgba(const Kernels &kernels, const Plane &y, const Plane &u,
+                     const Plane &v, const Plane &rgba) {
+  auto convert_rows = [&](int first, int last) {
+    for (int row = first; row < last; ++row) {
+      kernels.yuv420p_to_rgba_row(y.row(row), u.row(row / 2),
+                                  v.row(row / 2), rgba.row(row), y.width);
+    }
+  };
+  pipeline::parallel_for(0, y.height, ROWS_PER_TASK, convert_rows);
+}
+} // namespace
+
+bool simd::convert_frame(const AVFrame *src_frame, AVFrame *dst_frame,
+                         const Kernels &kernels) {
+  // STEP 1: Find out if the kernels cover the conversion
+  const Resize resize = resize_between(src_frame, dst_frame);
+  if (resize == Resize::Unsupported) {
+    return false;
+  }
+
+  const bool src_yuv = src_frame->format == AV_PIX_FMT_YUV420P;
+  const bool src_rgba = src_frame->format == AV_PIX_FMT_RGBA;
+  const bool dst_yuv = dst_frame->format == AV_PIX_FMT_YUV420P;
+  const bool dst_rgba = dst_frame->format == AV_PIX_FMT_RGBA;
+  const Plane src_rgba_plane = {src_frame->data[0], src_frame->linesize[0],
+                                src_frame->width, src_frame->height};
+  if (src_yuv && !bt709_limited(src_frame)) {
+    return false;
+  }
+
+  // STEP 2: Resize YUV420P plane by plane
+  if (src_yuv && dst_yuv && resize != Resize::Same) {
+    for (int index = 0; index < 3; ++index) {
+      if (resize == Resize::Up) {
+        upscale_plane(kernels, yuv_plane(src_frame, index),
+                      yuv_plane(dst_frame, index));
+      } else {
+        downscale_plane(kernels, yuv_plane(src_frame, index),
+                        yuv_plane(dst_frame, index));
+      }
+    }
+    return true;
+  }
+
+  // STEP 3: Convert RGBA to YUV420P, through a source-sized frame if it is
+  // resized as well
+  if (src_rgba && dst_yuv && resize == Resize::Same) {
+    rgba_to_yuv420p(kernels, src_rgba_plane, yuv_plane(dst_frame, 0),
+                    yuv_plane(dst_frame, 1), yuv_plane(dst_frame, 2));
+    return true;
+  }
+  if (src_rgba && dst_yuv && resize == Resize::Up) {
+    const int width = src_frame->width, height = src_frame->height;
+    std::vector<std::uint8_t> yuv(width * height * 3 / 2);
+    const Plane y = {yuv.data(), width, width, height};
+    const Plane u = {yuv.data() + width * height, width / 2, width / 2,
+                     height / 2};
+    const Plane v = {u.data + width * height / 4, width / 2, width / 2,
+                     height / 2};
+    rgba_to_yuv420p(kernels, src_rgba_plane, y, u, v);
+    upscale_plane(kernels, y, yuv_plane(dst_frame, 0));
+    upscale_plane(kernels, u, yuv_plane(dst_frame, 1));
+    upscale_plane(kernels, v, yuv_plane(dst_frame, 2));
+    return true;
+  }
+
+  // STEP 4: Convert YUV420P to RGBA
+  if (src_yuv && dst_rgba && resize == Resize::Same) {
+    const Plane rgba = {dst_frame->data[0], dst_frame->linesize[0],
+                        dst_frame->width, dst_frame->height};
+    yuv420p_to_rgba(kernels, yuv_plane(src_frame, 0), yuv_plane(src_frame, 1),
+                    yuv_plane(src_frame, 2), rgba);
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,31 @@
+#ifndef SIMD_CONVERT
+#define SIMD_CONVERT
+
+#include "kernels.hpp"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace simd {
+/**
+ * @brief Converts a frame with the SIMD kernels, if they cover the
+ * conversion.
+ *
+ * Covered are 1.5x and 0.5x YUV420P resizes, RGBA to YUV420P at the same
+ * size or 1.5x, and YUV420P to RGBA at the same size. Dimensions must be
+ * multiples of 4. Colors use BT.709 limited-range coefficients, so YUV
+ * sources must be BT.709 or unspecified, in limited range. Resizes are
+ * bilinear.
+ *
+ * @param src_frame The source frame.
+ * @param dst_frame The destination frame, with its format, size and buffers
+ * already set up.
+ * @param kernels The kernels to convert with.
+ * @return `true` if the frame was converted, `false` if the conversion is
+ * not covered and the caller needs to fall back to swscale.
+ */
+bool convert_frame(const AVFrame *src_frame, AVFrame *dst_frame,
+                   const Kernels &kernels = active_kernels());
+} // namespace simd
+#endif
@@ -0,0 +1,28 @@
+#include "cpu.hpp"
+
+using namespace simd;
+
+CpuLevel simd::detect_cpu_level() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return CpuLevel::Avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return CpuLevel::Avx2;
+  }
+#endif
+  return CpuLevel::Scalar;
+}
+
+const char *simd::cpu_level_name(CpuLevel level) {
+  switch (level) {
+  case CpuLevel::Scalar:
+    return "scalar";
+  case CpuLevel::Avx2:
+    return "avx2";
+  case CpuLevel::Avx512:
+    return "avx512";
+  }
+  return "scalar";
+}
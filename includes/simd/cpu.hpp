@@ -0,0 +1,27 @@
+#ifndef SIMD_CPU
+#define SIMD_CPU
+
+namespace simd {
+/**
+ * @brief The instruction set levels the kernels are written for.
+ */
+enum class CpuLevel {
+  Scalar, /**< Portable C++. */
+  Avx2,   /**< AVX2. */
+  Avx512, /**< AVX-512 F and BW. */
+};
+
+/**
+ * @brief Detects the highest level supported by this CPU and OS.
+ * @return The detected level.
+ */
+CpuLevel detect_cpu_level();
+
+/**
+ * @brief Gets the name of a level.
+ * @param level The level.
+ * @return The name, such as "avx2".
+ */
+const char *cpu_level_name(CpuLevel level);
+} // namespace simd
+#endif
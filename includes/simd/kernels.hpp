@@ -0,0 +1,165 @@
+#ifndef SIMD_KERNELS
+#define SIMD_KERNELS
+
+#include "cpu.hpp"
+#include <cstdint>
+
+namespace simd {
+/**
+ * @brief Weights of the 1.5x resize, in 1/128ths, for the three output
+ * phases. Output pixel 3k + r sits between source pixels 2k + r - 1 and
+ * 2k + r, with this weight on the first one.
+ */
+static const int UPSCALE_3_2_WEIGHTS[3] = {21, 64, 107};
+
+/**
+ * @brief Row kernels of one instruction set level.
+ *
+ * Every level computes exactly the same integer results as the scalar
+ * kernels, so the levels are interchangeable bit for bit.
+ */
+struct Kernels {
+  /**
+   * @brief Resizes a row to 1.5 times its width with bilinear weights.
+   * @param src The source row.
+   * @param src_width The source width. Must be even.
+   * @param dst The destination row, `src_width * 3 / 2` pixels wide.
+   */
+  void (*upscale_row_3_2)(const std::uint8_t *src, int src_width,
+                          std::uint8_t *dst);
+
+  /**
+   * @brief Blends two rows: `(a * weight + b * (128 - weight) + 64) >> 7`.
+   * @param a The first row.
+   * @param b The second row.
+   * @param dst The destination row.
+   * @param width The width of the rows.
+   * @param weight The weight of the first row, 0 to 127.
+   */
+  void (*blend_rows)(const std::uint8_t *a, const std::uint8_t *b,
+                     std::uint8_t *dst, int width, int weight);
+
+  /**
+   * @brief Averages 2x2 blocks of two rows into one row of half the width.
+   * @param row0 The first source row.
+   * @param row1 The second source row.
+   * @param dst The destination row.
+   * @param dst_width The destination width.
+   */
+  void (*downscale_rows_2)(const std::uint8_t *row0, const std::uint8_t *row1,
+                           std::uint8_t *dst, int dst_width);
+
+  /**
+   * @brief Converts two RGBA rows to two luma rows and one row of each
+   * chroma plane with BT.709 limited-range coefficients.
+   * @param rgba0 The first RGBA row.
+   * @param rgba1 The second RGBA row.
+   * @param y0 The first luma row.
+   * @param y1 The second luma row.
+   * @param u The U row, `width / 2` pixels wide.
+   * @param v The V row, `width / 2` pixels wide.
+   * @param width The width of the rows. Must be even.
+   */
+  void (*rgba_to_yuv420p_rows)(const std::uint8_t *rgba0,
+                               const std::uint8_t *rgba1, std::uint8_t *y0,
+                               std::uint8_t *y1, std::uint8_t *u,
+                               std::uint8_t *v, int width);
+
+  /**
+   * @brief Converts one luma row and its chroma rows to an RGBA row with
+   * BT.709 limited-range coefficients.
+   * @param y The luma row.
+   * @param u The U row, `width / 2` pixels wide.
+   * @param v The V row, `width / 2` pixels wide.
+   * @param rgba The RGBA row.
+   * @param width The width of the row. Must be even.
+   */
+  void (*yuv420p_to_rgba_row)(const std::uint8_t *y, const std::uint8_t *u,
+                              const std::uint8_t *v, std::uint8_t *rgba,
+                              int width);
+
+  /**
+   * @brief Mixes two rows with a constant alpha:
+   * `(a * alpha + b * (255 - alpha)) / 255`, rounded to nearest.
+   * @param a The first row.
+   * @param b The second row.
+   * @param dst The destination row. May be `a` or `b`.
+   * @param width The width of the rows.
+   * @param alpha The alpha of the first row, 0 to 255.
+   */
+  void (*mix_rows)(const std::uint8_t *a, const std::uint8_t *b,
+                   std::uint8_t *dst, int width, int alpha);
+
+  /**
+   * @brief Blends a row over another with per-pixel alpha:
+   * `(src * alpha + dst * (255 - alpha)) / 255`, rounded to nearest.
+   * @param src The row on top.
+   * @param alpha The alpha of each pixel of the row on top.
+   * @param dst The row underneath, overwritten with the result.
+   * @param width The width of the rows.
+   */
+  void (*alpha_over_row)(const std::uint8_t *src, const std::uint8_t *alpha,
+                         std::uint8_t *dst, int width);
+};
+
+/**
+ * @brief Gets the kernels of a level, or of the highest supported level
+ * below it.
+ * @param level The requested level.
+ * @return The kernels.
+ */
+const Kernels &kernels_for(CpuLevel level);
+
+/**
+ * @brief Gets the kernels of the level detected at startup.
+ * @return The kernels.
+ */
+const Kernels &active_kernels();
+
+namespace scalar {
+/** @brief Scalar Kernels::upscale_row_3_2 for groups [k_begin, k_end). */
+void upscale_row_3_2_range(const std::uint8_t *src, int src_width,
+                           std::uint8_t *dst, int k_begin, int k_end);
+/** @brief Scalar Kernels::blend_rows for pixels [begin, end). */
+void blend_rows_range(const std::uint8_t *a, const std::uint8_t *b,
+                      std::uint8_t *dst, int begin, int end, int weight);
+/** @brief Scalar Kernels::downscale_rows_2 for pixels [begin, end). */
+void downscale_rows_2_range(const std::uint8_t *row0,
+                            const std::uint8_t *row1, std::uint8_t *dst,
+                            int begin, int end);
+/** @brief Scalar Kernels::rgba_to_yuv420p_rows for pixels [begin, end). */
+void rgba_to_yuv420p_rows_range(const std::uint8_t *rgba0,
+                                const std::uint8_t *rgba1, std::uint8_t *y0,
+                                std::uint8_t *y1, std::uint8_t *u,
+                                std::uint8_t *v, int begin, int end);
+/** @brief Scalar Kernels::yuv420p_to_rgba_row for pixels [begin, end). */
+void yuv420p_to_rgba_row_range(const std::uint8_t *y, const std::uint8_t *u,
+                               const std::uint8_t *v, std::uint8_t *rgba,
+                               int begin, int end);
+/** @brief Scalar Kernels::mix_rows for pixels [begin, end). */
+void mix_rows_range(const std::uint8_t *a, const std::uint8_t *b,
+                    std::uint8_t *dst, int begin, int end, int alpha);
+/** @brief Scalar Kernels::alpha_over_row for pixels [begin, end). */
+void alpha_over_row_range(const std::uint8_t *src, const std::uint8_t *alpha,
+                          std::uint8_t *dst, int begin, int end);
+
+/** @brief The scalar kernels. */
+extern const Kernels KERNELS;
+} // namespace scalar
+
+#if defined(__x86_64__) || defined(__i386__)
+namespace avx2 {
+/** @brief The AVX2 kernels. */
+extern const Kernels KERNELS;
+} // namespace avx2
+
+namespace avx512 {
+/**
+ * @brief The AVX-512 kernels. The color conversions and the blends use
+ * AVX2.
+ */
+extern const Kernels KERNELS;
+} // namespace avx512
+#endif
+} // namespace simd
+#endif
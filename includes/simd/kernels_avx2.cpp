@@ -0,0 +1,405 @@
+#include "kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+using namespace simd;
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+namespace {
+/**
+ * @brief Shuffle masks that gather, for 8 and then 4 outputs of a 1.5x row
+ * group, the pair of source bytes each output blends. Output j of a lane
+ * blends source bytes 2 * (j / 3) + j % 3 and the one after it, counted from
+ * the byte before the lane's first source pixel.
+ */
+alignas(16) const std::int8_t UPSCALE_PAIRS_LO[16] = {
+    0, 1, 1, 2, 2, 3, 2, 3, 3, 4, 4, 5, 4, 5, 5, 6};
+alignas(16) const std::int8_t UPSCALE_PAIRS_HI[16] = {
+    6, 7, 6, 7, 7, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9, 9};
+
+/** The weight pairs matching the shuffle masks, in 1/128ths. */
+alignas(16) const std::int8_t UPSCALE_WEIGHTS_LO[16] = {
+    21, 107, 64, 64, 107, 21, 21, 107, 64, 64, 107, 21, 21, 107, 64, 64};
+alignas(16) const std::int8_t UPSCALE_WEIGHTS_HI[16] = {
+    107, 21, 21, 107, 64, 64, 107, 21, 0, 0, 0, 0, 0, 0, 0, 0};
+
+AVX2_TARGET void upscale_row_3_2(const std::uint8_t *src, int src_width,
+                                 std::uint8_t *dst) {
+  const int groups = src_width / 2;
+  const int dst_width = 3 * groups;
+  const __m256i pairs_lo = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(UPSCALE_PAIRS_LO)));
+  const __m256i pairs_hi = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(UPSCALE_PAIRS_HI)));
+  const __m256i weights_lo = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(UPSCALE_WEIGHTS_LO)));
+  const __m256i weights_hi = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(UPSCALE_WEIGHTS_HI)));
+  const __m256i rounding = _mm256_set1_epi16(64);
+
+  // STEP 1: The first group reads the pixel before the row, clamp it
+  scalar::upscale_row_3_2_range(src, src_width, dst, 0, 1);
+
+  // STEP 2: Each lane turns 4 groups (8 source pixels) into 12 outputs
+  int k = 1;
+  for (; 2 * k + 23 <= src_width && 3 * k + 28 <= dst_width; k += 8) {
+    const std::uint8_t *source = src + 2 * k - 1;
+    const __m256i pixels = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(source))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 8)), 1);
+
+    __m256i lo = _mm256_maddubs_epi16(_mm256_shuffle_epi8(pixels, pairs_lo),
+                                      weights_lo);
+    __m256i hi = _mm256_maddubs_epi16(_mm256_shuffle_epi8(pixels, pairs_hi),
+                                      weights_hi);
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, rounding), 7);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, rounding), 7);
+    const __m256i packed = _mm256_packus_epi16(lo, hi);
+
+    // The second store overwrites the 4 unused bytes of the first
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * k),
+                     _mm256_castsi256_si128(packed));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * k + 12),
+                     _mm256_extracti128_si256(packed, 1));
+  }
+
+  // STEP 3: The tail, including the group that reads past the row
+  scalar::upscale_row_3_2_range(src, src_width, dst, k, groups);
+}
+
+AVX2_TARGET void blend_rows(const std::uint8_t *a, const std::uint8_t *b,
+                            std::uint8_t *dst, int width, int weight) {
+  // A weight of 0 puts 128 on the second row, which does not fit maddubs
+  if (weight <= 0) {
+    scalar::blend_rows_range(a, b, dst, 0, width, weight);
+    return;
+  }
+
+  const __m256i weights = _mm256_set1_epi16(
+      static_cast<std::int16_t>((weight & 0xff) | ((128 - weight) << 8)));
+  const __m256i rounding = _mm256_set1_epi16(64);
+
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i row_a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + x));
+    const __m256i row_b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + x));
+
+    __m256i lo =
+        _mm256_maddubs_epi16(_mm256_unpacklo_epi8(row_a, row_b), weights);
+    __m256i hi =
+        _mm256_maddubs_epi16(_mm256_unpackhi_epi8(row_a, row_b), weights);
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, rounding), 7);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, rounding), 7);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x),
+                        _mm256_packus_epi16(lo, hi));
+  }
+
+  scalar::blend_rows_range(a, b, dst, x, width, weight);
+}
+
+/**
+ * @brief Averages the 2x2 blocks of 32 pixels of two rows into 16 words.
+ */
+AVX2_TARGET inline __m256i average_blocks(const std::uint8_t *row0,
+                                          const std::uint8_t *row1) {
+  const __m256i ones = _mm256_set1_epi8(1);
+  const __m256i top =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row0));
+  const __m256i bottom =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row1));
+  const __m256i sum = _mm256_add_epi16(_mm256_maddubs_epi16(top, ones),
+                                       _mm256_maddubs_epi16(bottom, ones));
+  return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+AVX2_TARGET void downscale_rows_2(const std::uint8_t *row0,
+                                  const std::uint8_t *row1, std::uint8_t *dst,
+                                  int dst_width) {
+  int x = 0;
+  for (; x + 32 <= dst_width; x += 32) {
+    const __m256i packed = _mm256_packus_epi16(
+        average_blocks(row0 + 2 * x, row1 + 2 * x),
+        average_blocks(row0 + 2 * x + 32, row1 + 2 * x + 32));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x),
+                        _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+
+  scalar::downscale_rows_2_range(row0, row1, dst, x, dst_width);
+}
+
+/**
+ * @brief Computes `(sum + 128) >> 8 + offset` of 8 pixels whose weighted
+ * channel pairs were summed by two madds, in pixel order.
+ */
+AVX2_TARGET inline __m256i finish_pixels(__m256i madd_lo, __m256i madd_hi,
+                                         __m256i offset) {
+  // hadd leaves pixels 0 1 4 5 | 2 3 6 7
+  const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+  __m256i sums = _mm256_hadd_epi32(madd_lo, madd_hi);
+  sums = _mm256_permutevar8x32_epi32(sums, order);
+  sums = _mm256_srai_epi32(_mm256_add_epi32(sums, _mm256_set1_epi32(128)), 8);
+  return _mm256_add_epi32(sums, offset);
+}
+
+/**
+ * @brief Stores 8 32-bit values as saturated bytes.
+ */
+AVX2_TARGET inline void store_bytes_8(std::uint8_t *dst, __m256i values) {
+  __m256i words = _mm256_packs_epi32(values, values);
+  words = _mm256_permute4x64_epi64(words, 0xD8);
+  const __m256i bytes = _mm256_packus_epi16(words, words);
+  _mm_storel_epi64(reinterpret_cast<__m128i *>(dst),
+                   _mm256_castsi256_si128(bytes));
+}
+
+/**
+ * @brief Stores 4 32-bit values as saturated bytes.
+ */
+AVX2_TARGET inline void store_bytes_4(std::uint8_t *dst, __m128i values) {
+  const __m128i words = _mm_packs_epi32(values, values);
+  const __m128i bytes = _mm_packus_epi16(words, words);
+  const int packed = _mm_cvtsi128_si32(bytes);
+  __builtin_memcpy(dst, &packed, 4);
+}
+
+AVX2_TARGET void rgba_to_yuv420p_rows(const std::uint8_t *rgba0,
+                                      const std::uint8_t *rgba1,
+                                      std::uint8_t *y0, std::uint8_t *y1,
+                                      std::uint8_t *u, std::uint8_t *v,
+                                      int width) {
+  const __m256i luma_weights = _mm256_setr_epi16(
+      47, 157, 16, 0, 47, 157, 16, 0, 47, 157, 16, 0, 47, 157, 16, 0);
+  const __m256i chroma_weights =
+      _mm256_setr_epi16(-26, -86, 112, 0, 112, -102, -10, 0, -26, -86, 112, 0,
+                        112, -102, -10, 0);
+  const __m256i luma_offset = _mm256_set1_epi32(16);
+  const __m256i chroma_offset = _mm256_set1_epi32(128);
+  const __m256i two = _mm256_set1_epi16(2);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    // STEP 1: Widen 8 pixels of each row to 16-bit channels, 2 per lane
+    const __m256i top = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(rgba0 + 4 * x));
+    const __m256i bottom = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(rgba1 + 4 * x));
+    const __m256i top_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(top));
+    const __m256i top_hi =
+        _mm256_cvtepu8_epi16(_mm256_extracti128_si256(top, 1));
+    const __m256i bottom_lo =
+        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bottom));
+    const __m256i bottom_hi =
+        _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bottom, 1));
+
+    // STEP 2: Luma of every pixel
+    store_bytes_8(y0 + x,
+                  finish_pixels(_mm256_madd_epi16(top_lo, luma_weights),
+                                _mm256_madd_epi16(top_hi, luma_weights),
+                                luma_offset));
+    store_bytes_8(y1 + x,
+                  finish_pixels(_mm256_madd_epi16(bottom_lo, luma_weights),
+                                _mm256_madd_epi16(bottom_hi, luma_weights),
+                                luma_offset));
+
+    // STEP 3: Average the 2x2 blocks. Each lane holds two horizontal
+    // neighbours, so adding the lane shifted by one pixel sums a block.
+    __m256i block_lo = _mm256_add_epi16(top_lo, bottom_lo);
+    __m256i block_hi = _mm256_add_epi16(top_hi, bottom_hi);
+    block_lo = _mm256_add_epi16(block_lo, _mm256_srli_si256(block_lo, 8));
+    block_hi = _mm256_add_epi16(block_hi, _mm256_srli_si256(block_hi, 8));
+    block_lo = _mm256_srli_epi16(_mm256_add_epi16(block_lo, two), 2);
+    block_hi = _mm256_srli_epi16(_mm256_add_epi16(block_hi, two), 2);
+    block_lo = _mm256_unpacklo_epi64(block_lo, block_lo);
+    block_hi = _mm256_unpacklo_epi64(block_hi, block_hi);
+
+    // STEP 4: U and V of the 4 blocks. hadd leaves U0 V0 U2 V2 | U1 V1 U3
+    // V3, which the permute turns into U0 U1 U2 U3 | V0 V1 V2 V3.
+    const __m256i order = _mm256_setr_epi32(0, 4, 2, 6, 1, 5, 3, 7);
+    __m256i chroma =
+        _mm256_hadd_epi32(_mm256_madd_epi16(block_lo, chroma_weights),
+                          _mm256_madd_epi16(block_hi, chroma_weights));
+    chroma = _mm256_permutevar8x32_epi32(chroma, order);
+    chroma = _mm256_srai_epi32(
+        _mm256_add_epi32(chroma, _mm256_set1_epi32(128)), 8);
+    chroma = _mm256_add_epi32(chroma, chroma_offset);
+    store_bytes_4(u + x / 2, _mm256_castsi256_si128(chroma));
+    store_bytes_4(v + x / 2, _mm256_extracti128_si256(chroma, 1));
+  }
+
+  scalar::rgba_to_yuv420p_rows_range(rgba0, rgba1, y0, y1, u, v, x, width);
+}
+
+/**
+ * @brief Turns the rounded sums of 16 pixels of one channel, split across
+ * two registers by unpacklo/hi, into 16-bit values in pixel order.
+ */
+AVX2_TARGET inline __m256i finish(__m256i lo, __m256i hi) {
+  return _mm256_packs_epi32(_mm256_srai_epi32(lo, 8),
+                            _mm256_srai_epi32(hi, 8));
+}
+
+AVX2_TARGET void yuv420p_to_rgba_row(const std::uint8_t *y,
+                                     const std::uint8_t *u,
+                                     const std::uint8_t *v, std::uint8_t *rgba,
+                                     int width) {
+  const __m256i luma_bias = _mm256_set1_epi16(16);
+  const __m256i chroma_bias = _mm256_set1_epi16(128);
+  const __m256i one = _mm256_set1_epi16(1);
+  const __m256i red_weights = _mm256_setr_epi16(
+      298, 459, 298, 459, 298, 459, 298, 459, 298, 459, 298, 459, 298, 459,
+      298, 459);
+  const __m256i green_weights = _mm256_setr_epi16(
+      298, -55, 298, -55, 298, -55, 298, -55, 298, -55, 298, -55, 298, -55,
+      298, -55);
+  const __m256i green_v_weights = _mm256_setr_epi16(
+      -136, 128, -136, 128, -136, 128, -136, 128, -136, 128, -136, 128, -136,
+      128, -136, 128);
+  const __m256i blue_weights = _mm256_setr_epi16(
+      298, 541, 298, 541, 298, 541, 298, 541, 298, 541, 298, 541, 298, 541,
+      298, 541);
+  const __m256i rounding = _mm256_set1_epi32(128);
+  const __m256i alpha = _mm256_set1_epi16(255);
+
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    // STEP 1: Widen 16 luma samples and their 8 chroma samples (each used
+    // twice) to 16 bits and remove the offsets
+    const __m256i luma = _mm256_sub_epi16(
+        _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x))),
+        luma_bias);
+    const __m128i u8 =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2));
+    const __m128i v8 =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2));
+    const __m256i cb = _mm256_sub_epi16(
+        _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8)), chroma_bias);
+    const __m256i cr = _mm256_sub_epi16(
+        _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8)), chroma_bias);
+
+    // STEP 2: Pair the samples for the madds. unpacklo/hi leave pixels
+    // 0-3 8-11 and 4-7 12-15, which packs_epi32 puts back in order.
+    const __m256i luma_cb_lo = _mm256_unpacklo_epi16(luma, cb);
+    const __m256i luma_cb_hi = _mm256_unpackhi_epi16(luma, cb);
+    const __m256i luma_cr_lo = _mm256_unpacklo_epi16(luma, cr);
+    const __m256i luma_cr_hi = _mm256_unpackhi_epi16(luma, cr);
+    const __m256i cr_one_lo = _mm256_unpacklo_epi16(cr, one);
+    const __m256i cr_one_hi = _mm256_unpackhi_epi16(cr, one);
+
+    // STEP 3: R, G and B of each pixel
+    const __m256i red = finish(
+        _mm256_add_epi32(_mm256_madd_epi16(luma_cr_lo, red_weights), rounding),
+        _mm256_add_epi32(_mm256_madd_epi16(luma_cr_hi, red_weights),
+                         rounding));
+    const __m256i green =
+        finish(_mm256_add_epi32(_mm256_madd_epi16(luma_cb_lo, green_weights),
+                                _mm256_madd_epi16(cr_one_lo, green_v_weights)),
+               _mm256_add_epi32(_mm256_madd_epi16(luma_cb_hi, green_weights),
+                                _mm256_madd_epi16(cr_one_hi, green_v_weights)));
+    const __m256i blue = finish(
+        _mm256_add_epi32(_mm256_madd_epi16(luma_cb_lo, blue_weights),
+                         rounding),
+        _mm256_add_epi32(_mm256_madd_epi16(luma_cb_hi, blue_weights),
+                         rounding));
+
+    // STEP 4: Interleave the channels into RGBA
+    const __m256i red_blue = _mm256_packus_epi16(red, blue);
+    const __m256i green_alpha = _mm256_packus_epi16(green, alpha);
+    const __m256i red_green = _mm256_unpacklo_epi8(red_blue, green_alpha);
+    const __m256i blue_alpha = _mm256_unpackhi_epi8(red_blue, green_alpha);
+    const __m256i pixels_lo = _mm256_unpacklo_epi16(red_green, blue_alpha);
+    const __m256i pixels_hi = _mm256_unpackhi_epi16(red_green, blue_alpha);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(rgba + 4 * x),
+                        _mm256_permute2x128_si256(pixels_lo, pixels_hi, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(rgba + 4 * x + 32),
+                        _mm256_permute2x128_si256(pixels_lo, pixels_hi, 0x31));
+  }
+
+  scalar::yuv420p_to_rgba_row_range(y, u, v, rgba, x, width);
+}
+
+/**
+ * @brief Computes `(a * alpha + b * inverse) / 255`, rounded, on 16 words
+ * whose products fit in 16 bits.
+ */
+AVX2_TARGET inline __m256i mix_words(__m256i a, __m256i b, __m256i alpha,
+                                     __m256i inverse) {
+  __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, alpha),
+                                 _mm256_mullo_epi16(b, inverse));
+  sum = _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_srli_epi16(sum, 8)),
+                           8);
+}
+
+AVX2_TARGET void mix_rows(const std::uint8_t *a, const std::uint8_t *b,
+                          std::uint8_t *dst, int width, int alpha) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i alpha_words = _mm256_set1_epi16(static_cast<short>(alpha));
+  const __m256i inverse_words =
+      _mm256_set1_epi16(static_cast<short>(255 - alpha));
+
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i row_a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + x));
+    const __m256i row_b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + x));
+
+    // unpack and packus both work per lane, so the order is kept
+    const __m256i lo = mix_words(_mm256_unpacklo_epi8(row_a, zero),
+                                 _mm256_unpacklo_epi8(row_b, zero),
+                                 alpha_words, inverse_words);
+    const __m256i hi = mix_words(_mm256_unpackhi_epi8(row_a, zero),
+                                 _mm256_unpackhi_epi8(row_b, zero),
+                                 alpha_words, inverse_words);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x),
+                        _mm256_packus_epi16(lo, hi));
+  }
+
+  scalar::mix_rows_range(a, b, dst, x, width, alpha);
+}
+
+AVX2_TARGET void alpha_over_row(const std::uint8_t *src,
+                                const std::uint8_t *alpha, std::uint8_t *dst,
+                                int width) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i opaque = _mm256_set1_epi16(255);
+
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i top =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x));
+    const __m256i bottom =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + x));
+    const __m256i alphas =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(alpha + x));
+
+    const __m256i alpha_lo = _mm256_unpacklo_epi8(alphas, zero);
+    const __m256i alpha_hi = _mm256_unpackhi_epi8(alphas, zero);
+    const __m256i lo = mix_words(_mm256_unpacklo_epi8(top, zero),
+                                 _mm256_unpacklo_epi8(bottom, zero), alpha_lo,
+                                 _mm256_sub_epi16(opaque, alpha_lo));
+    const __m256i hi = mix_words(_mm256_unpackhi_epi8(top, zero),
+                                 _mm256_unpackhi_epi8(bottom, zero), alpha_hi,
+                                 _mm256_sub_epi16(opaque, alpha_hi));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x),
+                        _mm256_packus_epi16(lo, hi));
+  }
+
+  scalar::alpha_over_row_range(src, alpha, dst, x, width);
+}
+} // namespace
+
+const Kernels avx2::KERNELS = {
+    upscale_row_3_2,      blend_rows,          downscale_rows_2,
+    rgba_to_yuv420p_rows, yuv420p_to_rgba_row, mix_rows,
+    alpha_over_row,
+};
+#endif
@@ -0,0 +1,150 @@
+#include "kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+using namespace simd;
+
+#define AVX512_TARGET __attribute__((target("avx512f,avx512bw")))
+
+namespace {
+/**
+ * @brief Same layout as the AVX2 masks: per 128-bit lane, the source byte
+ * pairs and weights of 8 and then 4 outputs of a 1.5x row group.
+ */
+alignas(16) const std::int8_t UPSCALE_PAIRS_LO[16] = {
+    0, 1, 1, 2, 2, 3, 2, 3, 3, 4, 4, 5, 4, 5, 5, 6};
+alignas(16) const std::int8_t UPSCALE_PAIRS_HI[16] = {
+    6, 7, 6, 7, 7, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9, 9};
+alignas(16) const std::int8_t UPSCALE_WEIGHTS_LO[16] = {
+    21, 107, 64, 64, 107, 21, 21, 107, 64, 64, 107, 21, 21, 107, 64, 64};
+alignas(16) const std::int8_t UPSCALE_WEIGHTS_HI[16] = {
+    107, 21, 21, 107, 64, 64, 107, 21, 0, 0, 0, 0, 0, 0, 0, 0};
+
+AVX512_TARGET inline __m512i broadcast_lane(const std::int8_t *values) {
+  return _mm512_broadcast_i32x4(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(values)));
+}
+
+AVX512_TARGET void upscale_row_3_2(const std::uint8_t *src, int src_width,
+                                   std::uint8_t *dst) {
+  const int groups = src_width / 2;
+  const int dst_width = 3 * groups;
+  const __m512i pairs_lo = broadcast_lane(UPSCALE_PAIRS_LO);
+  const __m512i pairs_hi = broadcast_lane(UPSCALE_PAIRS_HI);
+  const __m512i weights_lo = broadcast_lane(UPSCALE_WEIGHTS_LO);
+  const __m512i weights_hi = broadcast_lane(UPSCALE_WEIGHTS_HI);
+  const __m512i rounding = _mm512_set1_epi16(64);
+
+  // STEP 1: The first group reads the pixel before the row, clamp it
+  scalar::upscale_row_3_2_range(src, src_width, dst, 0, 1);
+
+  // STEP 2: Each of the 4 lanes turns 4 groups into 12 outputs
+  int k = 1;
+  for (; 2 * k + 39 <= src_width && 3 * k + 52 <= dst_width; k += 16) {
+    const std::uint8_t *source = src + 2 * k - 1;
+    __m512i pixels = _mm512_castsi128_si512(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source)));
+    pixels = _mm512_inserti32x4(
+        pixels, _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 8)),
+        1);
+    pixels = _mm512_inserti32x4(
+        pixels,
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 16)), 2);
+    pixels = _mm512_inserti32x4(
+        pixels,
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 24)), 3);
+
+    __m512i lo = _mm512_maddubs_epi16(_mm512_shuffle_epi8(pixels, pairs_lo),
+                                      weights_lo);
+    __m512i hi = _mm512_maddubs_epi16(_mm512_shuffle_epi8(pixels, pairs_hi),
+                                      weights_hi);
+    lo = _mm512_srli_epi16(_mm512_add_epi16(lo, rounding), 7);
+    hi = _mm512_srli_epi16(_mm512_add_epi16(hi, rounding), 7);
+    const __m512i packed = _mm512_packus_epi16(lo, hi);
+
+    // Each store overwrites the 4 unused bytes of the one before
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * k),
+                     _mm512_castsi512_si128(packed));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * k + 12),
+                     _mm512_extracti32x4_epi32(packed, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * k + 24),
+                     _mm512_extracti32x4_epi32(packed, 2));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * k + 36),
+                     _mm512_extracti32x4_epi32(packed, 3));
+  }
+
+  // STEP 3: The tail, including the group that reads past the row
+  scalar::upscale_row_3_2_range(src, src_width, dst, k, groups);
+}
+
+AVX512_TARGET void blend_rows(const std::uint8_t *a, const std::uint8_t *b,
+                              std::uint8_t *dst, int width, int weight) {
+  // A weight of 0 puts 128 on the second row, which does not fit maddubs
+  if (weight <= 0) {
+    scalar::blend_rows_range(a, b, dst, 0, width, weight);
+    return;
+  }
+
+  const __m512i weights = _mm512_set1_epi16(
+      static_cast<std::int16_t>((weight & 0xff) | ((128 - weight) << 8)));
+  const __m512i rounding = _mm512_set1_epi16(64);
+
+  int x = 0;
+  for (; x + 64 <= width; x += 64) {
+    const __m512i row_a = _mm512_loadu_si512(a + x);
+    const __m512i row_b = _mm512_loadu_si512(b + x);
+
+    __m512i lo =
+        _mm512_maddubs_epi16(_mm512_unpacklo_epi8(row_a, row_b), weights);
+    __m512i hi =
+        _mm512_maddubs_epi16(_mm512_unpackhi_epi8(row_a, row_b), weights);
+    lo = _mm512_srli_epi16(_mm512_add_epi16(lo, rounding), 7);
+    hi = _mm512_srli_epi16(_mm512_add_epi16(hi, rounding), 7);
+
+    _mm512_storeu_si512(dst + x, _mm512_packus_epi16(lo, hi));
+  }
+
+  scalar::blend_rows_range(a, b, dst, x, width, weight);
+}
+
+/**
+ * @brief Averages the 2x2 blocks of 64 pixels of two rows into 32 words.
+ */
+AVX512_TARGET inline __m512i average_blocks(const std::uint8_t *row0,
+                                            const std::uint8_t *row1) {
+  const __m512i ones = _mm512_set1_epi8(1);
+  const __m512i sum =
+      _mm512_add_epi16(_mm512_maddubs_epi16(_mm512_loadu_si512(row0), ones),
+                       _mm512_maddubs_epi16(_mm512_loadu_si512(row1), ones));
+  return _mm512_srli_epi16(_mm512_add_epi16(sum, _mm512_set1_epi16(2)), 2);
+}
+
+AVX512_TARGET void downscale_rows_2(const std::uint8_t *row0,
+                                    const std::uint8_t *row1,
+                                    std::uint8_t *dst, int dst_width) {
+  // packus interleaves the two halves per lane, put them back in order
+  const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+
+  int x = 0;
+  for (; x + 64 <= dst_width; x += 64) {
+    const __m512i packed = _mm512_packus_epi16(
+        average_blocks(row0 + 2 * x, row1 + 2 * x),
+        average_blocks(row0 + 2 * x + 64, row1 + 2 * x + 64));
+    _mm512_storeu_si512(dst + x, _mm512_permutexvar_epi64(order, packed));
+  }
+
+  scalar::downscale_rows_2_range(row0, row1, dst, x, dst_width);
+}
+} // namespace
+
+const Kernels avx512::KERNELS = {
+    upscale_row_3_2,
+    blend_rows,
+    downscale_rows_2,
+    avx2::KERNELS.rgba_to_yuv420p_rows,
+    avx2::KERNELS.yuv420p_to_rgba_row,
+    avx2::KERNELS.mix_rows,
+    avx2::KERNELS.alpha_over_row,
+};
+#endif
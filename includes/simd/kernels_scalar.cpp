@@ -0,0 +1,191 @@
+#include "kernels.hpp"
+#include <algorithm>
+
+using namespace simd;
+
+namespace {
+/** BT.709 limited-range RGB to YCbCr coefficients, in 1/256ths. */
+const int Y_R = 47, Y_G = 157, Y_B = 16;
+const int U_R = -26, U_G = -86, U_B = 112;
+const int V_R = 112, V_G = -102, V_B = -10;
+
+/** BT.709 limited-range YCbCr to RGB coefficients, in 1/256ths. */
+const int C_Y = 298, R_V = 459, G_U = -55, G_V = -136, B_U = 541;
+
+inline std::uint8_t clamp_byte(int value) {
+  return static_cast<std::uint8_t>(std::min(255, std::max(0, value)));
+}
+
+/**
+ * @brief Divides by 255, rounding to nearest, for values up to 255 * 255.
+ */
+inline std::uint8_t div255(int value) {
+  value += 128;
+  return static_cast<std::uint8_t>((value + (value >> 8)) >> 8);
+}
+
+inline std::uint8_t luma(const std::uint8_t *rgba) {
+  return clamp_byte(
+      ((Y_R * rgba[0] + Y_G * rgba[1] + Y_B * rgba[2] + 128) >> 8) + 16);
+}
+
+/**
+ * @brief Computes one output pixel of the 1.5x resize.
+ */
+inline std::uint8_t upscale_pixel(const std::uint8_t *src, int src_width,
+                                  int j) {
+  const int k = j / 3;
+  const int r = j % 3;
+  const int left = std::max(0, 2 * k + r - 1);
+  const int right = std::min(src_width - 1, 2 * k + r);
+  const int weight = UPSCALE_3_2_WEIGHTS[r];
+  return static_cast<std::uint8_t>(
+      (src[left] * weight + src[right] * (128 - weight) + 64) >> 7);
+}
+
+void upscale_row_3_2(const std::uint8_t *src, int src_width,
+                     std::uint8_t *dst) {
+  scalar::upscale_row_3_2_range(src, src_width, dst, 0, src_width / 2);
+}
+
+void blend_rows(const std::uint8_t *a, const std::uint8_t *b,
+                std::uint8_t *dst, int width, int weight) {
+  scalar::blend_rows_range(a, b, dst, 0, width, weight);
+}
+
+void downscale_rows_2(const std::uint8_t *row0, const std::uint8_t *row1,
+                      std::uint8_t *dst, int dst_width) {
+  scalar::downscale_rows_2_range(row0, row1, dst, 0, dst_width);
+}
+
+void rgba_to_yuv420p_rows(const std::uint8_t *rgba0, const std::uint8_t *rgba1,
+                          std::uint8_t *y0, std::uint8_t *y1, std::uint8_t *u,
+                          std::uint8_t *v, int width) {
+  scalar::rgba_to_yuv420p_rows_range(rgba0, rgba1, y0, y1, u, v, 0, width);
+}
+
+void yuv420p_to_rgba_row(const std::uint8_t *y, const std::uint8_t *u,
+                         const std::uint8_t *v, std::uint8_t *rgba,
+                         int width) {
+  scalar::yuv420p_to_rgba_row_range(y, u, v, rgba, 0, width);
+}
+
+void mix_rows(const std::uint8_t *a, const std::uint8_t *b, std::uint8_t *dst,
+              int width, int alpha) {
+  scalar::mix_rows_range(a, b, dst, 0, width, alpha);
+}
+
+void alpha_over_row(const std::uint8_t *src, const std::uint8_t *alpha,
+                    std::uint8_t *dst, int width) {
+  scalar::alpha_over_row_range(src, alpha, dst, 0, width);
+}
+} // namespace
+
+void scalar::upscale_row_3_2_range(const std::uint8_t *src, int src_width,
+                                   std::uint8_t *dst, int k_begin,
+                                   int k_end) {
+  for (int j = 3 * k_begin; j < 3 * k_end; ++j) {
+    dst[j] = upscale_pixel(src, src_width, j);
+  }
+}
+
+void scalar::blend_rows_range(const std::uint8_t *a, const std::uint8_t *b,
+                              std::uint8_t *dst, int begin, int end,
+                              int weight) {
+  for (int x = begin; x < end; ++x) {
+    dst[x] = static_cast<std::uint8_t>(
+        (a[x] * weight + b[x] * (128 - weight) + 64) >> 7);
+  }
+}
+
+void scalar::downscale_rows_2_range(const std::uint8_t *row0,
+                                    const std::uint8_t *row1,
+                                    std::uint8_t *dst, int begin, int end) {
+  for (int x = begin; x < end; ++x) {
+    dst[x] = static_cast<std::uint8_t>(
+        (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2) >>
+        2);
+  }
+}
+
+void scalar::rgba_to_yuv420p_rows_range(const std::uint8_t *rgba0,
+                                        const std::uint8_t *rgba1,
+                                        std::uint8_t *y0, std::uint8_t *y1,
+                                        std::uint8_t *u, std::uint8_t *v,
+                                        int begin, int end) {
+  for (int x = begin; x < end; x += 2) {
+    const std::uint8_t *p00 = rgba0 + 4 * x;
+    const std::uint8_t *p01 = p00 + 4;
+    const std::uint8_t *p10 = rgba1 + 4 * x;
+    const std::uint8_t *p11 = p10 + 4;
+
+    // STEP 1: Luma of each pixel
+    y0[x] = luma(p00);
+    y0[x + 1] = luma(p01);
+    y1[x] = luma(p10);
+    y1[x + 1] = luma(p11);
+
+    // STEP 2: Chroma of the averaged 2x2 block
+    const int r = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+    const int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+    const int b = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+    u[x / 2] = clamp_byte(((U_R * r + U_G * g + U_B * b + 128) >> 8) + 128);
+    v[x / 2] = clamp_byte(((V_R * r + V_G * g + V_B * b + 128) >> 8) + 128);
+  }
+}
+
+void scalar::yuv420p_to_rgba_row_range(const std::uint8_t *y,
+                                       const std::uint8_t *u,
+                                       const std::uint8_t *v,
+                                       std::uint8_t *rgba, int begin,
+                                       int end) {
+  for (int x = begin; x < end; ++x) {
+    const int c = y[x] - 16;
+    const int d = u[x / 2] - 128;
+    const int e = v[x / 2] - 128;
+    rgba[4 * x + 0] = clamp_byte((C_Y * c + R_V * e + 128) >> 8);
+    rgba[4 * x + 1] = clamp_byte((C_Y * c + G_U * d + G_V * e + 128) >> 8);
+    rgba[4 * x + 2] = clamp_byte((C_Y * c + B_U * d + 128) >> 8);
+    rgba[4 * x + 3] = 255;
+  }
+}
+
+void scalar::mix_rows_range(const std::uint8_t *a, const std::uint8_t *b,
+                            std::uint8_t *dst, int begin, int end,
+                            int alpha) {
+  for (int x = begin; x < end; ++x) {
+    dst[x] = div255(a[x] * alpha + b[x] * (255 - alpha));
+  }
+}
+
+void scalar::alpha_over_row_range(const std::uint8_t *src,
+                                  const std::uint8_t *alpha,
+                                  std::uint8_t *dst, int begin, int end) {
+  for (int x = begin; x < end; ++x) {
+    dst[x] = div255(src[x] * alpha[x] + dst[x] * (255 - alpha[x]));
+  }
+}
+
+const Kernels scalar::KERNELS = {
+    upscale_row_3_2,      blend_rows,          downscale_rows_2,
+    rgba_to_yuv420p_rows, yuv420p_to_rgba_row, mix_rows,
+    alpha_over_row,
+};
+
+const Kernels &simd::kernels_for(CpuLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+  const CpuLevel supported = detect_cpu_level();
+  if (level == CpuLevel::Avx512 && supported == CpuLevel::Avx512) {
+    return avx512::KERNELS;
+  }
+  if (level != CpuLevel::Scalar && supported != CpuLevel::Scalar) {
+    return avx2::KERNELS;
+  }
+#endif
+  return scalar::KERNELS;
+}
+
+const Kernels &simd::active_kernels() {
+  static const Kernels &kernels = kernels_for(detect_cpu_level());
+  return kernels;
+}
@@ -0,0 +1,279 @@
+#include "perf.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace {
+/** Scales a median absolute deviation to a standard deviation. */
+const double MAD_TO_SIGMA = 1.4826;
+
+/**
+ * @brief Gets the median of some values.
+ */
+double median(std::vector<double> values) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  const std::size_t middle = values.size() / 2;
+  return values.size() % 2 ? values[middle]
+                           : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+/**
+ * @brief Gets the median absolute deviation of some values, as a standard
+ * deviation.
+ */
+double robust_noise(const std::vector<double> &values) {
+  const double center = median(values);
+  std::vector<double> deviations;
+  for (double value : values) {
+    deviations.push_back(std::fabs(value - center));
+  }
+  return MAD_TO_SIGMA * median(deviations);
+}
+
+/**
+ * @brief Reads the flat objects of a baseline, skipping the "jobs" key and
+ * the array around them. Values are kept as text.
+ * @return `false` if the text is not made of such objects.
+ */
+bool parse_objects(const std::string &text,
+                   std::vector<std::map<std::string, std::string>> &objects) {
+  std::size_t pos = text.find("\"jobs\"");
+  if (pos == std::string::npos) {
+    return false;
+  }
+  auto skip_space = [&text, &pos] {
+    while (pos < text.size() && std::isspace(text[pos])) {
+      ++pos;
+    }
+  };
+  // Reads a string, with the escapes write_baseline() writes
+  auto read_string = [&text, &pos](std::string &value) {
+    value.clear();
+    for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+      if (text[pos] == '\\' && pos + 1 < text.size()) {
+        ++pos;
+      }
+      value += text[pos];
+    }
+    ++pos;
+    return pos <= text.size();
+  };
+
+  pos = text.find('[', pos);
+  if (pos == std::string::npos) {
+    return false;
+  }
+  ++pos;
+  while (true) {
+    skip_space();
+    if (pos >= text.size() || text[pos] == ']') {
+      return pos < text.size();
+    }
+    if (text[pos] == ',') {
+      ++pos;
+      continue;
+    }
+    if (text[pos] != '{') {
+      return false;
+    }
+    ++pos;
+    std::map<std::string, std::string> object;
+    while (true) {
+      skip_space();
+      if (pos < text.size() && text[pos] == ',') {
+        ++pos;
+        skip_space();
+      }
+      if (pos >= text.size()) {
+        return false;
+      }
+      if (text[pos] == '}') {
+        ++pos;
+        break;
+      }
+      std::string key;
+      std::string value;
+      if (text[pos] != '"' || !read_string(key)) {
+        return false;
+      }
+      skip_space();
+      if (pos >= text.size() || text[pos] != ':') {
+        return false;
+      }
+      ++pos;
+      skip_space();
+      if (pos < text.size() && text[pos] == '"') {
+        if (!read_string(value)) {
+          return false;
+        }
+      } else {
+        while (pos < text.size() && text[pos] != ',' && text[pos] != '}' &&
+               !std::isspace(text[pos])) {
+          value += text[pos++];
+        }
+      }
+      object[key] = value;
+    }
+    objects.push_back(object);
+  }
+}
+
+/**
+ * @brief Compares one metric of a job, where more is worse.
+ */
+perf::Comparison compare_metric(const std::string &job,
+                                const std::string &metric, double baseline,
+                                double current, double allowed_increase,
+                                double threshold) {
+  perf::Comparison comparison;
+  comparison.job = job;
+  comparison.metric = metric;
+  comparison.baseline = baseline;
+  comparison.current = current;
+  comparison.change = baseline > 0.0 ? (current - baseline) / baseline : 0.0;
+  comparison.regressed = comparison.change > threshold &&
+                         current - baseline > allowed_increase;
+  return comparison;
+}
+} // namespace
+
+perf::JobSummary perf::summarize(const std::string &name,
+                                 const std::vector<RunStats> &runs) {
+  JobSummary summary;
+  summary.name = name;
+  summary.runs = static_cast<int>(runs.size());
+  std::vector<double> wall;
+  std::vector<double> cpu;
+  std::vector<double> fps;
+  std::vector<double> output;
+  for (const RunStats &run : runs) {
+    wall.push_back(run.wall_seconds);
+    cpu.push_back(run.cpu_seconds);
+    fps.push_back(run.wall_seconds > 0.0 ? run.frames / run.wall_seconds
+                                         : 0.0);
+    output.push_back(static_cast<double>(run.output_bytes));
+    summary.peak_rss_bytes =
+        std::max(summary.peak_rss_bytes, run.peak_rss_bytes);
+  }
+  summary.wall_seconds = median(wall);
+  summary.wall_noise = robust_noise(wall);
+  summary.cpu_seconds = median(cpu);
+  summary.cpu_noise = robust_noise(cpu);
+  summary.fps = median(fps);
+  summary.output_bytes = static_cast<std::uint64_t>(median(output));
+  return summary;
+}
+
+bool perf::write_baseline(const std::string &path,
+                          const std::vector<JobSummary> &jobs) {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Failed to write the baseline " << path << std::endl;
+    return false;
+  }
+  file << "{\n  \"jobs\": [";
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    const JobSummary &job = jobs[i];
+    std::string name;
+    for (char character : job.name) {
+      if (character == '"' || character == '\\') {
+        name += '\\';
+      }
+      name += character;
+    }
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "%s\n    {\"name\": \"%s\", \"runs\": %d, "
+                  "\"wall_seconds\": %.6f, \"wall_noise\": %.6f, "
+                  "\"cpu_seconds\": %.6f, \"cpu_noise\": %.6f, "
+                  "\"fps\": %.3f, \"peak_rss_bytes\": %llu, "
+                  "\"output_bytes\": %llu}",
+                  i ? "," : "", name.c_str(), job.runs, job.wall_seconds,
+                  job.wall_noise, job.cpu_seconds, job.cpu_noise, job.fps,
+                  static_cast<unsigned long long>(job.peak_rss_bytes),
+                  static_cast<unsigned long long>(job.output_bytes));
+    file << line;
+  }
+  file << "\n  ]\n}\n";
+  return static_cast<bool>(file);
+}
+
+bool perf::read_baseline(const std::string &path,
+                         std::vector<JobSummary> &jobs) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  std::vector<std::map<std::string, std::string>> objects;
+  if (!parse_objects(text.str(), objects)) {
+    std::cerr << "Not a baseline: " << path << std::endl;
+    return false;
+  }
+
+  jobs.clear();
+  for (std::map<std::string, std::string> &object : objects) {
+    // Missing numbers read as 0, so older baselines still load
+    auto number = [&object](const char *key) {
+      return std::strtod(object[key].c_str(), nullptr);
+    };
+    JobSummary job;
+    job.name = object["name"];
+    job.runs = static_cast<int>(number("runs"));
+    job.wall_seconds = number("wall_seconds");
+    job.wall_noise = number("wall_noise");
+    job.cpu_seconds = number("cpu_seconds");
+    job.cpu_noise = number("cpu_noise");
+    job.fps = number("fps");
+    job.peak_rss_bytes = static_cast<std::uint64_t>(number("peak_rss_bytes"));
+    job.output_bytes = static_cast<std::uint64_t>(number("output_bytes"));
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+std::vector<perf::Comparison>
+perf::compare(const std::vector<JobSummary> &baseline,
+              const std::vector<JobSummary> &current, double threshold,
+              double noise_factor) {
+  std::vector<Comparison> comparisons;
+  for (const JobSummary &job : current) {
+    auto base = std::find_if(
+        baseline.begin(), baseline.end(),
+        [&job](const JobSummary &other) { return other.name == job.name; });
+    if (base == baseline.end()) {
+      continue;
+    }
+
+    // STEP 1: Times must also rise above the noise of both sides
+    const double wall_noise =
+        noise_factor * std::hypot(base->wall_noise, job.wall_noise);
+    const double cpu_noise =
+        noise_factor * std::hypot(base->cpu_noise, job.cpu_noise);
+    comparisons.push_back(compare_metric(job.name, "wall_seconds",
+                                         base->wall_seconds, job.wall_seconds,
+                                         wall_noise, threshold));
+    comparisons.push_back(compare_metric(job.name, "cpu_seconds",
+                                         base->cpu_seconds, job.cpu_seconds,
+                                         cpu_noise, threshold));
+
+    // STEP 2: Memory and output size barely vary between runs
+    comparisons.push_back(compare_metric(
+        job.name, "peak_rss_bytes", static_cast<double>(base->peak_rss_bytes),
+        static_cast<double>(job.peak_rss_bytes), 0.0, threshold));
+    comparisons.push_back(compare_metric(
+        job.name, "output_bytes", static_cast<double>(base->output_bytes),
+        static_cast<double>(job.output_bytes), 0.0, threshold));
+  }
+  return comparisons;
+}
@@ -0,0 +1,232 @@
+#include "../includes/compose/layout.hpp"
+#include "../includes/gameflix/engine.hpp"
+#include "../includes/logging/logger.hpp"
+#include "perf.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cxxopts.hpp>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+static const std::string PROGRAM_NAME = "Gameflix performance harness";
+static const std::string DEFAULT_BASELINE = "perf_baseline.json";
+
+/**
+ * @brief Lists the corpus clips in a directory, sorted so jobs pair the
+ * same clips every time.
+ */
+static std::vector<std::filesystem::path>
+list_clips(const std::string &corpus_dir) {
+  std::vector<std::filesystem::path> clips;
+  for (const std::filesystem::directory_entry &entry :
+       std::filesystem::directory_iterator(corpus_dir)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".mkv") {
+      clips.push_back(entry.path());
+    }
+  }
+  std::sort(clips.begin(), clips.end());
+  return clips;
+}
+
+/**
+ * @brief Runs a job in a child process, so its CPU time and peak RSS are
+ * its own and no state carries over between runs.
+ * @param job The job.
+ * @param stats Set to what the run cost.
+ * @return `true` if the job succeeded, `false` otherwise.
+ */
+static bool run_isolated(const gameflix::JobDescription &job,
+                         perf::RunStats &stats) {
+  int frames_pipe[2];
+  if (pipe(frames_pipe) != 0) {
+    return false;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const pid_t child = fork();
+  if (child < 0) {
+    close(frames_pipe[0]);
+    close(frames_pipe[1]);
+    return false;
+  }
+  if (child == 0) {
+    // STEP 1: The child runs the job with its report silenced and hands
+    // the frames it encoded to the parent
+    close(frames_pipe[0]);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDOUT_FILENO);
+    }
+    logging::set_level(logging::Level::Warning);
+    std::int64_t frames = 0;
+    gameflix::JobStatus status;
+    {
+      gameflix::Engine engine;
+      status = engine
+                   .submit(job,
+                           [&frames](const gameflix::JobProgress &progress) {
+                             frames = progress.frames_encoded;
+                           })
+                   .wait();
+    }
+    logging::flush();
+    const bool sent =
+        write(frames_pipe[1], &frames, sizeof(frames)) == sizeof(frames);
+    _exit(status == gameflix::JobStatus::Succeeded && sent ? 0 : 1);
+  }
+
+  // STEP 2: The parent collects the child's time and memory
+  close(frames_pipe[1]);
+  std::int64_t frames = 0;
+  const bool received =
+      read(frames_pipe[0], &frames, sizeof(frames)) == sizeof(frames);
+  close(frames_pipe[0]);
+  int exit_status = 0;
+  struct rusage usage = {};
+  if (wait4(child, &exit_status, 0, &usage) != child) {
+    return false;
+  }
+  const std::chrono::duration<double> wall =
+      std::chrono::steady_clock::now() - start;
+
+  stats.wall_seconds = wall.count();
+  stats.cpu_seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  // Linux reports the peak RSS in kilobytes
+  stats.peak_rss_bytes = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+  stats.frames = frames;
+  std::error_code error;
+  const std::uintmax_t size =
+      std::filesystem::file_size(job.output_path, error);
+  stats.output_bytes = error ? 0 : size;
+  std::filesystem::remove(job.output_path, error);
+  return received && WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0;
+}
+
+int main(int argc, char **argv) {
+  cxxopts::Options options(argv[0], PROGRAM_NAME);
+  options.positional_help("<corpus_dir>");
+  // clang-format off
+  options.add_options()
+      ("h,help", "Print usage")
+      ("corpus_dir", "Directory of corpus clips, as written by 'gameflix_bench corpus'", cxxopts::value<std::string>())
+      ("runs", "Measured runs of every job; each job pairs two clips of the corpus", cxxopts::value<int>()->default_value("5"))
+      ("warmup", "Runs of every job before the measured ones, to warm the page cache", cxxopts::value<int>()->default_value("1"))
+      ("max-jobs", "Jobs to run at most (0 for one per pair of clips)", cxxopts::value<int>()->default_value("0"))
+      ("layout", "How every job arranges its clips: interleave, vertical, pip or overlay", cxxopts::value<std::string>()->default_value("interleave"))
+      ("baseline", "Baseline file to compare with", cxxopts::value<std::string>()->default_value(DEFAULT_BASELINE))
+      ("save", "Write the results to the baseline file instead of comparing with it")
+      ("threshold", "Relative slowdown, memory or size growth that fails the comparison", cxxopts::value<double>()->default_value("0.05"))
+      ("noise-factor", "Times the combined run-to-run noise a slowdown must also exceed", cxxopts::value<double>()->default_value("2"));
+  // clang-format on
+  options.parse_positional({"corpus_dir"});
+
+  try {
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("corpus_dir")) {
+      std::cout << options.help() << std::endl;
+      return 1;
+    }
+
+    const int runs = std::max(1, result["runs"].as<int>());
+    const int warmup = std::max(0, result["warmup"].as<int>());
+    const std::string baseline_path = result["baseline"].as<std::string>();
+    const std::vector<std::filesystem::path> clips =
+        list_clips(result["corpus_dir"].as<std::string>());
+    if (clips.size() < 2) {
+      std::cerr << "The corpus needs at least two clips" << std::endl;
+      return 1;
+    }
+
+    // STEP 1: Pair the clips, the last one with the first if they are odd
+    std::size_t job_count = (clips.size() + 1) / 2;
+    if (result["max-jobs"].as<int>() > 0) {
+      job_count = std::min(
+          job_count, static_cast<std::size_t>(result["max-jobs"].as<int>()));
+    }
+    gameflix::JobOptions job_options;
+    job_options.layout =
+        compose::parse_layout_kind(result["layout"].as<std::string>());
+    job_options.in_memory = true;
+    job_options.remux = false;
+    job_options.progress_interval = 0.0;
+
+    // STEP 2: Run every job
+    std::vector<perf::JobSummary> current;
+    bool failed = false;
+    for (std::size_t i = 0; i < job_count; ++i) {
+      gameflix::JobDescription job;
+      const std::filesystem::path &clip1 = clips[2 * i];
+      const std::filesystem::path &clip2 = clips[(2 * i + 1) % clips.size()];
+      job.video_path1 = clip1.string();
+      job.video_path2 = clip2.string();
+      job.output_path =
+          (std::filesystem::temp_directory_path() / "gameflix_perf.mp4")
+              .string();
+      job.options = job_options;
+      const std::string name =
+          clip1.stem().string() + "+" + clip2.stem().string();
+
+      std::vector<perf::RunStats> measured;
+      for (int run = 0; run < warmup + runs; ++run) {
+        perf::RunStats stats;
+        if (!run_isolated(job, stats)) {
+          std::cerr << "Job failed: " << name << std::endl;
+          failed = true;
+          break;
+        }
+        if (run >= warmup) {
+          measured.push_back(stats);
+        }
+      }
+      if (measured.empty()) {
+        continue;
+      }
+      const perf::JobSummary summary = perf::summarize(name, measured);
+      std::printf("%-80s %8.2f s +-%5.2f %8.2f cpu s %8.1f fps %6.0f MB\n",
+                  name.c_str(), summary.wall_seconds, summary.wall_noise,
+                  summary.cpu_seconds, summary.fps,
+                  summary.peak_rss_bytes / 1048576.0);
+      current.push_back(summary);
+    }
+    if (failed) {
+      return 1;
+    }
+
+    // STEP 3: Store the results, or compare them with the baseline
+    std::vector<perf::JobSummary> baseline;
+    if (result.count("save") || !perf::read_baseline(baseline_path, baseline)) {
+      if (!perf::write_baseline(baseline_path, current)) {
+        return 1;
+      }
+      std::cout << "Wrote the baseline " << baseline_path << std::endl;
+      return 0;
+    }
+
+    bool regressed = false;
+    for (const perf::Comparison &comparison :
+         perf::compare(baseline, current, result["threshold"].as<double>(),
+                       result["noise-factor"].as<double>())) {
+      if (comparison.regressed) {
+        std::printf("REGRESSION %s %s: %.6g -> %.6g (%+.1f%%)\n",
+                    comparison.job.c_str(), comparison.metric.c_str(),
+                    comparison.baseline, comparison.current,
+                    100.0 * comparison.change);
+        regressed = true;
+      }
+    }
+    std::cout << (regressed ? "Regressed against " : "No regressions against ")
+              << baseline_path << std::endl;
+    return regressed ? 1 : 0;
+  } catch (const std::exception &e) {
+    std::cerr << "Error parsing options: " << e.what() << std::endl;
+    return 1;
+  }
+}
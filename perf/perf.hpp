@@ -0,0 +1,93 @@
+#ifndef GAMEFLIX_PERF
+#define GAMEFLIX_PERF
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace perf {
+/**
+ * @brief What one run of a job cost.
+ */
+struct RunStats {
+  double wall_seconds = 0.0;       /**< The wall-clock time. */
+  double cpu_seconds = 0.0;        /**< The user and system CPU time. */
+  std::int64_t frames = 0;         /**< The frames encoded. */
+  std::uint64_t peak_rss_bytes = 0; /**< The peak resident set size. */
+  std::uint64_t output_bytes = 0;  /**< The size of the output file. */
+};
+
+/**
+ * @brief The runs of a job, reduced to medians and their noise, as stored
+ * in a baseline.
+ */
+struct JobSummary {
+  std::string name;          /**< The job, named after its two clips. */
+  int runs = 0;              /**< The runs summarized. */
+  double wall_seconds = 0.0; /**< The median wall-clock time. */
+  double wall_noise = 0.0;   /**< The robust spread of the wall time. */
+  double cpu_seconds = 0.0;  /**< The median CPU time. */
+  double cpu_noise = 0.0;    /**< The robust spread of the CPU time. */
+  double fps = 0.0;          /**< The median frames per second. */
+  std::uint64_t peak_rss_bytes = 0; /**< The largest peak RSS of a run. */
+  std::uint64_t output_bytes = 0;   /**< The median output size. */
+};
+
+/**
+ * @brief One metric of a job compared against the baseline.
+ */
+struct Comparison {
+  std::string job;       /**< The job. */
+  std::string metric;    /**< The metric, e.g. "wall_seconds". */
+  double baseline = 0.0; /**< The baseline value. */
+  double current = 0.0;  /**< The value of this run. */
+  double change = 0.0;   /**< The relative change, 0.05 for 5% more. */
+  bool regressed = false; /**< Whether the change is a regression. */
+};
+
+/**
+ * @brief Reduces the runs of a job to their medians. The noise is the
+ * median absolute deviation scaled to a standard deviation, so a single
+ * slow run does not hide a regression.
+ * @param name The job.
+ * @param runs The runs, at least one.
+ * @return The summary.
+ */
+JobSummary summarize(const std::string &name,
+                     const std::vector<RunStats> &runs);
+
+/**
+ * @brief Writes a baseline file.
+ * @param path The path to the file.
+ * @param jobs The jobs.
+ * @return `true` if the file was written, `false` otherwise.
+ */
+bool write_baseline(const std::string &path,
+                    const std::vector<JobSummary> &jobs);
+
+/**
+ * @brief Reads a baseline file written by write_baseline().
+ * @param path The path to the file.
+ * @param jobs Set to the jobs of the file.
+ * @return `true` if the file was read, `false` if it is missing or not a
+ * baseline.
+ */
+bool read_baseline(const std::string &path, std::vector<JobSummary> &jobs);
+
+/**
+ * @brief Compares the jobs of a run with a baseline. A time is a
+ * regression if it grew by more than the threshold and by more than
+ * `noise_factor` times the combined noise of both sides; the peak RSS and
+ * the output size only need to grow by more than the threshold. Jobs
+ * missing from the baseline are left out.
+ * @param baseline The baseline jobs.
+ * @param current The jobs of this run.
+ * @param threshold The relative change that is tolerated, 0.05 for 5%.
+ * @param noise_factor How many times the noise a slowdown must exceed.
+ * @return The comparisons, one per job and metric.
+ */
+std::vector<Comparison> compare(const std::vector<JobSummary> &baseline,
+                                const std::vector<JobSummary> &current,
+                                double threshold, double noise_factor);
+} // namespace perf
+#endif
@@ -1,15 +1,71 @@
-#include "../includes/frame/combiner.hpp"
-#include "../includes/frame/extractor.hpp"
+#include "../includes/compose/layout.hpp"
+#include "../includes/frame/encoder.hpp"
+#include "../includes/frame/intermediate.hpp"
+#include "../includes/frame/scaler.hpp"
+#include "../includes/frame/thumbnails.hpp"
+#include "../includes/gameflix/engine.hpp"
+#include "../includes/gameflix/job.hpp"
+#include "../includes/io/input_source.hpp"
+#include "../includes/logging/logger.hpp"
+#include "../includes/pipeline/batch_manifest.hpp"
+#include "../includes/pipeline/frame_allocator.hpp"
+#include "../includes/pipeline/memory_budget.hpp"
+#include "../includes/pipeline/placement.hpp"
+#include "../includes/pipeline/progress.hpp"
+#include "../includes/pipeline/task_scheduler.hpp"
 #include <algorithm>
+#include <cmath>
 #include <cxxopts.hpp>
-#include <filesystem>
 #include <iostream>
 #include <string>
+#include <vector>
 
 static const std::string VERSION = "0.1.0";
 static const std::string AUTHOR = "Brighton Sikarskie";
 static const std::string PROGRAM_NAME = "Gameflix";
-static const std::string VIDEO_TMP_DIR = ".tmp/gameflix_video_path_tmp_dir";
+static const std::string DEFAULT_MAX_MEMORY = "512M";
+static const std::string DEFAULT_READ_AHEAD = "4M";
+
+/**
+ * @brief Runs the jobs of a batch manifest, up to `concurrency` at a time.
+ * @return `true` if every job succeeded, `false` otherwise.
+ */
+static bool run_batch(const std::vector<pipeline::BatchJob> &jobs,
+                      int concurrency,
+                      const gameflix::JobOptions &job_options) {
+  gameflix::Engine engine(
+      static_cast<std::size_t>(std::max(1, concurrency)));
+  std::vector<gameflix::JobHandle> handles;
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    const pipeline::BatchJob &batch_job = jobs[i];
+    gameflix::JobDescription job;
+    job.video_path1 = batch_job.video_path1;
+    job.video_path2 = batch_job.video_path2;
+    job.output_path = batch_job.output_path;
+    job.options = job_options;
+    if (batch_job.has_placement) {
+      job.options.placement = batch_job.placement;
+    }
+    if (batch_job.numa_node >= 0) {
+      job.options.numa_node = batch_job.numa_node;
+    }
+    logging::info() << "Job " << i + 1 << "/" << jobs.size() << ": "
+                    << job.output_path;
+    handles.push_back(engine.submit(job));
+  }
+
+  bool succeeded = true;
+  for (std::size_t i = 0; i < handles.size(); ++i) {
+    const gameflix::JobStatus status = handles[i].wait();
+    if (status != gameflix::JobStatus::Succeeded) {
+      logging::error() << "Job " << i + 1 << "/" << jobs.size() << " "
+                       << gameflix::job_status_name(status) << ": "
+                       << jobs[i].output_path;
+      succeeded = false;
+    }
+  }
+  return succeeded;
+}
 
 int main(int argc, char **argv) {
   cxxopts::Options options(argv[0], PROGRAM_NAME);
@@ -20,22 +76,50 @@ int main(int argc, char **argv) {
       ("v,version", "Print version information")
       ("video_path_1", "Path to the first video file", cxxopts::value<std::string>())
       ("video_path_2", "Path to the second video file", cxxopts::value<std::string>())
-      ("output_file_path", "Path to the output file", cxxopts::value<std::string>());
+      ("output_file_path", "Path to the output file", cxxopts::value<std::string>())
+      ("in-memory", "Pass frames between stages in memory instead of through the job's workspace")
+      ("workspace-root", "Directory the per-job workspaces of PNG frames are created in, e.g. /dev/shm for tmpfs (defaults to TMPDIR or /tmp)", cxxopts::value<std::string>()->default_value(""))
+      ("intermediate-format", "Format of the frames in the workspace: png, png-fast (PNG at compression level 0), qoi or raw (the decoded planes)", cxxopts::value<std::string>()->default_value("png"))
+      ("max-memory", "Memory budget for frames in flight between stages (e.g. 512M, 2G)", cxxopts::value<std::string>()->default_value(DEFAULT_MAX_MEMORY))
+      ("fragment-seconds", "Write fragmented MP4 with fragments of at least this many seconds (implied for '-', which writes to stdout)", cxxopts::value<double>()->default_value("0"))
+      ("keyframe-interval", "Longest distance between two keyframes in seconds; scene cuts and transitions get their own keyframes (clamped to the fragment duration when fragmenting)", cxxopts::value<double>()->default_value("4"))
+      ("input-mode", "How input files are read: default, mmap or buffered", cxxopts::value<std::string>()->default_value("default"))
+      ("read-ahead", "Read-ahead window for the mmap and buffered input modes (e.g. 4M)", cxxopts::value<std::string>()->default_value(DEFAULT_READ_AHEAD))
+      ("concat", "Play the videos one after the other instead of interleaving their frames")
+      ("trim-start", "Start each video at this many seconds", cxxopts::value<double>()->default_value("0"))
+      ("trim-end", "End each video at this many seconds (0 for the end)", cxxopts::value<double>()->default_value("0"))
+      ("no-remux", "Always re-encode, even if the packets could be copied as is")
+      ("preview", "Render a preview, using the preview scaler")
+      ("scaler", "Scaler for final renders: fast-bilinear, bilinear, area, bicubic or lanczos", cxxopts::value<std::string>()->default_value("bicubic"))
+      ("preview-scaler", "Scaler for previews: fast-bilinear, bilinear, area, bicubic or lanczos", cxxopts::value<std::string>()->default_value("fast-bilinear"))
+      ("layout", "How the videos are arranged: interleave (their frames alternate), vertical (stacked on a 1080x1920 canvas), pip (the second inset over the first) or overlay (the second over the first)", cxxopts::value<std::string>()->default_value("interleave"))
+      ("opacity", "Opacity of the second video in the pip and overlay layouts, 0 to 1 (default 1 for pip, 0.5 for overlay)", cxxopts::value<double>())
+      ("crossfade", "Crossfade between the videos for this many seconds (with --concat)", cxxopts::value<double>()->default_value("0"))
+      ("rendition", "Also write the output at another size, e.g. 720x1280:clip_720.mp4, scaled from the same decoded frames (repeatable)", cxxopts::value<std::vector<std::string>>())
+      ("thumbnails", "Write thumbnails of the first video to the directory given as the second path, decoding only keyframes: keyframes (one per scene, at least --thumbnail-interval apart) or interval (one every --thumbnail-interval seconds)", cxxopts::value<std::string>())
+      ("thumbnail-interval", "Seconds between thumbnails", cxxopts::value<double>()->default_value("10"))
+      ("thumbnail-width", "Width of a thumbnail; the height keeps the aspect ratio", cxxopts::value<int>()->default_value("320"))
+      ("thumbnail-format", "Image format of the thumbnails: jpeg or png", cxxopts::value<std::string>()->default_value("jpeg"))
+      ("contact-sheet", "Tile the thumbnails into one image with this many columns, written to the second path", cxxopts::value<int>()->default_value("0"))
+      ("max-thumbnails", "Stop after this many thumbnails (0 for no limit)", cxxopts::value<int>()->default_value("0"))
+      ("frame-pages", "Pages the frames of the in-memory pipeline are allocated on: default, thp (transparent huge pages) or hugetlb (reserved huge pages, falling back to thp); huge-page buffers are placed on the NUMA node of the combining thread", cxxopts::value<std::string>()->default_value("default"))
+      ("placement", "Where the stages of a job run: none (anywhere) or node (pinned to the CPUs of one NUMA node, concurrent jobs spread across nodes)", cxxopts::value<std::string>()->default_value("none"))
+      ("numa-node", "NUMA node to pin jobs to with --placement node (-1 for the least loaded one)", cxxopts::value<int>()->default_value("-1"))
+      ("batch", "Run the jobs listed in a manifest instead of the positional paths: one job per line, '<video_path_1> <video_path_2> <output_file_path> [placement=none|node] [numa-node=N]'", cxxopts::value<std::string>())
+      ("jobs", "Batch jobs to run at the same time", cxxopts::value<int>()->default_value("1"))
+      ("decoder-threads", "Threads each input's decoder may use (0 for FFmpeg's default)", cxxopts::value<int>()->default_value("0"))
+      ("encoder-threads", "Threads each output's encoder may use (0 for FFmpeg's default)", cxxopts::value<int>()->default_value("0"))
+      ("workers", "Worker threads shared by every stage and job for PNG encoding and decoding, scaling and blending (0 for one per CPU)", cxxopts::value<int>()->default_value("0"))
+      ("progress", "How progress is printed: human (a line with the rate and ETA), json (one object per line) or none", cxxopts::value<std::string>()->default_value("human"))
+      ("progress-interval", "Seconds between progress reports (0 for one report when the job ends)", cxxopts::value<double>()->default_value("1"))
+      ("log-level", "Lowest level of the log records written, FFmpeg's included: debug, info, warning or error", cxxopts::value<std::string>()->default_value("info"))
+      ("log-format", "How log records are written: text or json (one object per line with the level, job, stage, frame and message)", cxxopts::value<std::string>()->default_value("text"))
+      ("auto-crop", "Detect black bars such as letterboxes and crop them away before scaling")
+      ("no-simd", "Use swscale for every conversion instead of the SIMD kernels for 1.5x/0.5x YUV420P resizes and RGBA<->YUV420P");
   // clang-format on
   options.parse_positional(
       {"video_path_1", "video_path_2", "output_file_path"});
 
-  try {
-    // Remvoe the previous files
-    std::filesystem::remove_all(VIDEO_TMP_DIR);
-    std::cout << "[INFO] Removed previous tmp dir." << std::endl;
-    // Create the directory and its parent directories if they don't exist
-    std::filesystem::create_directories(VIDEO_TMP_DIR);
-    std::cout << "[INFO] Created tmp dir." << std::endl;
-  } catch (const std::filesystem::filesystem_error &e) {
-    std::cout << "Failed to create directories: " << e.what() << std::endl;
-  }
-
   try {
     auto result = options.parse(argc, argv);
 
@@ -50,26 +134,113 @@ int main(int argc, char **argv) {
       return 1;
     }
 
-    std::string video_path1 = result["video_path_1"].as<std::string>();
-    std::string video_path2 = result["video_path_2"].as<std::string>();
-    std::string output_file_path = result["output_file_path"].as<std::string>();
+    // A video written to stdout must not get log lines or reports mixed
+    // into it, so the logger is pointed at stderr before it starts
+    if (result.count("output_file_path") &&
+        result["output_file_path"].as<std::string>() == "-") {
+      logging::set_output(logging::Output::Stderr);
+    }
+    logging::set_level(
+        logging::parse_level(result["log-level"].as<std::string>()));
+    logging::set_format(
+        logging::parse_format(result["log-format"].as<std::string>()));
+    logging::route_ffmpeg_logs();
 
-    // extract frames
-    // TODO: ADD AUDIO
-    frame::Extractor frame_extractor1(video_path1);
-    frame::Extractor frame_extractor2(video_path2);
-    int width = std::max(frame_extractor1.get_leading_zeros(),
-                         frame_extractor2.get_leading_zeros());
-    frame_extractor1.extract_frames(VIDEO_TMP_DIR, width);
-    frame_extractor2.extract_frames(VIDEO_TMP_DIR, width);
+    gameflix::JobOptions job_options;
+    job_options.input_options.mode =
+        io::parse_input_mode(result["input-mode"].as<std::string>());
+    job_options.input_options.read_ahead =
+        pipeline::parse_byte_size(result["read-ahead"].as<std::string>());
+    job_options.input_options.decoder_threads =
+        std::max(0, result["decoder-threads"].as<int>());
+    job_options.max_memory =
+        pipeline::parse_byte_size(result["max-memory"].as<std::string>());
+    job_options.fragment_seconds = result["fragment-seconds"].as<double>();
+    job_options.keyframe_seconds = result["keyframe-interval"].as<double>();
+    job_options.encoder_threads =
+        std::max(0, result["encoder-threads"].as<int>());
+    job_options.concatenate = result.count("concat") > 0;
+    job_options.remux = result.count("no-remux") == 0;
+    job_options.trim.start = result["trim-start"].as<double>();
+    job_options.trim.end = result["trim-end"].as<double>();
 
-    // stack frames
-    // TODO
+    frame::ScalerTiers scaler_tiers;
+    scaler_tiers.final =
+        frame::parse_scale_algorithm(result["scaler"].as<std::string>());
+    scaler_tiers.preview = frame::parse_scale_algorithm(
+        result["preview-scaler"].as<std::string>());
+    job_options.scale_algorithm =
+        scaler_tiers.select(result.count("preview") > 0);
+    job_options.simd_kernels = result.count("no-simd") == 0;
+    job_options.layout =
+        compose::parse_layout_kind(result["layout"].as<std::string>());
+    double opacity =
+        job_options.layout == compose::LayoutKind::Overlay ? 0.5 : 1.0;
+    if (result.count("opacity")) {
+      opacity = std::min(1.0, std::max(0.0, result["opacity"].as<double>()));
+    }
+    job_options.opacity =
+        static_cast<int>(std::lround(opacity * compose::OPAQUE));
+    job_options.crossfade_seconds = result["crossfade"].as<double>();
+    job_options.auto_crop = result.count("auto-crop") > 0;
+    job_options.frame_pages =
+        pipeline::parse_page_mode(result["frame-pages"].as<std::string>());
+    job_options.in_memory = result.count("in-memory") > 0;
+    job_options.workspace_root = result["workspace-root"].as<std::string>();
+    job_options.intermediate_format = frame::parse_intermediate_format(
+        result["intermediate-format"].as<std::string>());
+    job_options.placement = pipeline::parse_placement_policy(
+        result["placement"].as<std::string>());
+    job_options.numa_node = result["numa-node"].as<int>();
+    job_options.progress_format = pipeline::parse_progress_format(
+        result["progress"].as<std::string>());
+    job_options.progress_interval =
+        std::max(0.0, result["progress-interval"].as<double>());
+    if (result.count("rendition")) {
+      for (const std::string &rendition :
+           result["rendition"].as<std::vector<std::string>>()) {
+        job_options.renditions.push_back(frame::parse_output_spec(rendition));
+      }
+    }
+    pipeline::TaskScheduler::set_global_workers(
+        static_cast<std::size_t>(std::max(0, result["workers"].as<int>())));
+    if (result.count("batch")) {
+      return run_batch(pipeline::read_batch_manifest(
+                           result["batch"].as<std::string>()),
+                       result["jobs"].as<int>(), job_options)
+                 ? 0
+                 : 1;
+    }
 
-    // combine frames
-    // TODO: ADD AUDIO
-    frame::Combiner frame_combiner(VIDEO_TMP_DIR);
-    frame_combiner.combine_frames_to_video(output_file_path);
+    // Thumbnail jobs read one video and write to the second path
+    std::string video_path1 = result["video_path_1"].as<std::string>();
+    if (result.count("thumbnails")) {
+      frame::ThumbnailOptions thumbnail_options;
+      thumbnail_options.mode = frame::parse_thumbnail_mode(
+          result["thumbnails"].as<std::string>());
+      thumbnail_options.interval_seconds =
+          std::max(0.0, result["thumbnail-interval"].as<double>());
+      thumbnail_options.width = result["thumbnail-width"].as<int>();
+      thumbnail_options.format = frame::parse_image_format(
+          result["thumbnail-format"].as<std::string>());
+      thumbnail_options.columns = result["contact-sheet"].as<int>();
+      thumbnail_options.max_thumbnails = result["max-thumbnails"].as<int>();
+      const int count = gameflix::run_thumbnails(
+          video_path1, result["video_path_2"].as<std::string>(),
+          thumbnail_options, job_options);
+      return count > 0 ? 0 : 1;
+    }
+
+    gameflix::JobDescription job;
+    job.video_path1 = video_path1;
+    job.video_path2 = result["video_path_2"].as<std::string>();
+    job.output_path = result["output_file_path"].as<std::string>();
+    job.options = job_options;
+
+    gameflix::Engine engine;
+    if (engine.submit(job).wait() != gameflix::JobStatus::Succeeded) {
+      return 1;
+    }
   } catch (const std::exception &e) {
     std::cerr << "Error parsing options: " << e.what() << std::endl;
     return 1;